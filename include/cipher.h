@@ -31,6 +31,7 @@ public:
         OFB = 5,
         CTR = 6,
         OPENPGP = 7,
+        GCM = 8,  // AES only.
     };
     enum Operation {
         Encrypt = 1,
@@ -44,6 +45,7 @@ public:
     bool isValid() const;
     bool isStream() const;
     bool isBlock() const { return !isStream(); }
+    bool isAead() const;  // AES-GCM and ChaCha20Poly1305
     bool setKey(const QByteArray &key);
     QByteArray key() const;
     bool setInitialVector(const QByteArray &iv);
@@ -70,6 +72,25 @@ public:
     QByteArray update(const QByteArray &data) { return addData(data.constData(), data.size()); }
     QByteArray update(const char *data, int len) { return addData(data, len); }
     QByteArray final() { return finalData(); }
+public:
+    // write the output to `out` instead of allocating a new QByteArray. `out` may be the same as `data`, and must
+    // have room for `len + blockSize()` bytes. returns the number of bytes written, or -1 on error.
+    qint32 update(const char *data, qint32 len, char *out);
+    qint32 final(char *out);
+public:
+    // for AEAD ciphers. the additional authenticated data must be set after the iv and before update().
+    bool setAad(const char *data, int len);
+    bool setAad(const QByteArray &aad) { return setAad(aad.constData(), aad.size()); }
+    // the tag is available after final() while encrypting, and must be set before final() while decrypting.
+    QByteArray tag(int size = 16) const;
+    bool setTag(const QByteArray &tag);
+    // encrypt (or decrypt) one message in place with a new iv, and write (or verify) the 16 bytes tag.
+    // open() returns false if the message or the aad is forged. the key is kept, the iv is replaced.
+    bool seal(const char *iv, int ivLen, const char *aad, int aadLen, char *data, qint32 len, char *tag);
+    bool open(const char *iv, int ivLen, const char *aad, int aadLen, char *data, qint32 len, const char *tag);
+    QByteArray seal(const QByteArray &iv, const QByteArray &data, const QByteArray &aad = QByteArray());  // data + tag
+    QByteArray open(const QByteArray &iv, const QByteArray &sealed, const QByteArray &aad = QByteArray(),
+                    bool *ok = nullptr);
 public:
     static QPair<QByteArray, QByteArray> parseSalt(const QByteArray &header);  // parse salt from `openssl enc` header
 private:
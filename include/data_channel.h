@@ -3,6 +3,7 @@
 
 #include <QtCore/qobject.h>
 #include <QtCore/qsharedpointer.h>
+#include <string.h>
 #include "socket.h"
 #include "socket_utils.h"
 
@@ -18,6 +19,23 @@ enum SystemChannelNubmer {
     DataChannelNumber = 1,
 };
 
+struct SocketChannelStats
+{
+    enum { BatchSizeBuckets = 7 };
+    SocketChannelStats()
+        : batches(0)
+        , packets(0)
+        , bytes(0)
+    {
+        memset(batchSizes, 0, sizeof(batchSizes));
+    }
+    quint64 batches;  // the number of writes to the connection.
+    quint64 packets;
+    quint64 bytes;  // including the headers.
+    // batchSizes[i] counts the writes carrying 2^(i-1) < n <= 2^i packets, that is 1, 2, 3-4, ..., 33-64.
+    quint64 batchSizes[BatchSizeBuckets];
+};
+
 class VirtualChannel;
 class DataChannelPrivate;
 class DataChannel : public QObject
@@ -53,6 +71,14 @@ public:
     quint32
     capacity() const;  // so, a data channel may consume `maxPacketSize * capacity` bytes of receiving buffer memory.
     quint32 receivingQueueSize() const;
+    // the channels of a SocketChannel share the connection in proportion to their weights, 1 by default.
+    // the sub channels of a VirtualChannel share the weight of it.
+    bool setSendingWeight(quint32 weight);
+    quint32 sendingWeight() const;
+    // announce the receiving window (the capacity) to the peer, and the peer sends no more packets than that.
+    // the peer replies its window, and the channels made later are flow-controlled too. both peers must support it.
+    void enableFlowControl();
+    bool isFlowControlEnabled() const;
     DataChannelPole pole() const;
     void setName(const QString &name);
     QString name() const;
@@ -61,6 +87,8 @@ public:
     bool sendPacket(const QByteArray &packet);
     bool sendPacketAsync(const QByteArray &packet);
     QByteArray recvPacket();
+    // the large packets of a SocketChannel with streaming threshold are read while they are being received.
+    QSharedPointer<FileLike> recvPacketStream();
     void abort();
     QSharedPointer<VirtualChannel> makeChannel();
     QSharedPointer<VirtualChannel> takeChannel();
@@ -89,6 +117,15 @@ public:
     void setKeepaliveInterval(float keepaliveInterval);
     float keepaliveInterval() const;
     quint32 sendingQueueSize() const;
+    // queued packets are sent in one write up to this many bytes. set to 0 for the default 256k.
+    void setMaxBatchSize(quint32 size);
+    quint32 maxBatchSize() const;
+    SocketChannelStats stats() const;
+    // the packets larger than this are not buffered but read by recvPacketStream(). 0 (default) disables streaming.
+    // the stream buffers 16 chunks of 64KB at most. if the reader falls behind, the stream is dropped and its read()
+    // returns -1, while the connection goes on receiving the other packets.
+    void setStreamingThreshold(quint32 size);
+    quint32 streamingThreshold() const;
     QSharedPointer<SocketLike> connection() const;
 private:
     Q_DECLARE_PRIVATE(SocketChannel)
@@ -0,0 +1,54 @@
+#ifndef QTNG_DNS_H
+#define QTNG_DNS_H
+
+#include <QtCore/qlist.h>
+#include <QtCore/qpair.h>
+#include <QtCore/qstringlist.h>
+#include "hostaddress.h"
+
+QTNETWORKNG_NAMESPACE_BEGIN
+
+// a stub resolver talks to the name servers of /etc/resolv.conf directly, using the event loop instead of
+// the getaddrinfo() thread pool. A and AAAA records are queried in parallel, CNAME chains are followed,
+// and truncated UDP responses are retried over TCP.
+class DnsResolverPrivate;
+class DnsResolver
+{
+public:
+    // the system configuration (/etc/resolv.conf and /etc/hosts) is loaded if `loadSystemConfig` is true.
+    explicit DnsResolver(bool loadSystemConfig = true);
+    virtual ~DnsResolver();
+public:
+    // `ttl` returns the smallest time-to-live (in secs) of the records used by the answer.
+    // if no name server is configured, fallback to Socket::resolve(), and `ttl` is left unchanged.
+    QList<HostAddress> resolve(const QString &hostName,
+                               int allowProtocol = HostAddress::IPv4Protocol | HostAddress::IPv6Protocol,
+                               quint32 *ttl = nullptr);
+    // query one record type without /etc/hosts and search domains. returns false if the name does not exist.
+    bool query(const QString &fullName, HostAddress::NetworkLayerProtocol protocol, QList<HostAddress> *addresses,
+               quint32 *ttl = nullptr);
+
+    QList<QPair<HostAddress, quint16>> nameServers() const;
+    void setNameServers(const QList<QPair<HostAddress, quint16>> &nameServers);
+    void addNameServer(const HostAddress &addr, quint16 port = 53);
+    QStringList searchDomains() const;
+    void setSearchDomains(const QStringList &searchDomains);
+    int ndots() const;
+    void setNdots(int ndots);
+    float timeout() const;  // per attempt, in secs.
+    void setTimeout(float secs);
+    int attempts() const;
+    void setAttempts(int attempts);
+
+    void addHost(const QString &hostName, const HostAddress &addr);
+    bool loadResolvConf(const QString &filePath = QString::fromLatin1("/etc/resolv.conf"));
+    bool loadHosts(const QString &filePath = QString::fromLatin1("/etc/hosts"));
+private:
+    DnsResolverPrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(DnsResolver)
+    Q_DISABLE_COPY(DnsResolver)
+};
+
+QTNETWORKNG_NAMESPACE_END
+
+#endif  // QTNG_DNS_H
@@ -28,6 +28,9 @@ public:
     static void sleep(float secs) { msleep(static_cast<quint32>(secs * 1000)); }
     static Coroutine *spawn(std::function<void()> f);
     static void preferLibev();
+    // use io_uring for the eventloops created later, fallback to libev if the kernel does not support it. io_uring
+    // polls the sockets only, the io is done by the same non-blocking syscalls as libev.
+    static void preferIoUring();
 protected:
     virtual void cleanup() override;
 private:
@@ -2,6 +2,7 @@
 #define QTNG_GZIP_H
 
 #include <QtCore/qbytearray.h>
+#include <QtCore/qlist.h>
 #include "io_utils.h"
 
 QTNETWORKNG_NAMESPACE_BEGIN
@@ -38,6 +39,62 @@ private:
     Q_DECLARE_PRIVATE(GzipDecompressFile);
 };
 
+// streaming codecs selected by the name used in the `Content-Encoding` header of http. zstd and brotli are optional,
+// check isSupported() before using them.
+class CompressFilePrivate;
+class CompressFile : public FileLike
+{
+public:
+    enum Method {
+        Gzip,
+        Deflate,
+        Zstd,
+        Brotli,
+    };
+public:
+    // read() pulls from backend and returns compressed data, write() pushes compressed data to backend.
+    // a file used for writing must be closed to finish the compressed stream, the backend is not closed.
+    CompressFile(Method method, QSharedPointer<FileLike> backend, int level = -1);
+    virtual ~CompressFile() override;
+public:
+    virtual qint32 read(char *data, qint32 size) override;
+    virtual qint32 write(const char *data, qint32 size) override;
+    virtual void close() override;
+    virtual qint64 size() override { return -1; }
+    bool isValid() const;
+public:
+    static bool isSupported(Method method);
+    static QByteArray encodingName(Method method);
+    static bool fromEncodingName(const QByteArray &name, Method *method);
+private:
+    CompressFilePrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(CompressFile);
+};
+
+class DecompressFilePrivate;
+class DecompressFile : public FileLike
+{
+public:
+    DecompressFile(CompressFile::Method method, QSharedPointer<FileLike> backend);
+    virtual ~DecompressFile() override;
+public:
+    virtual qint32 read(char *data, qint32 size) override;
+    virtual qint32 write(const char *data, qint32 size) override;
+    virtual void close() override;
+    virtual qint64 size() override { return -1; }
+    bool isValid() const;
+private:
+    DecompressFilePrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(DecompressFile);
+};
+
+// the supported content encodings, the best first. such as `br, zstd, gzip, deflate`
+QList<QByteArray> supportedContentEncodings();
+// choose the best supported encoding from the `Accept-Encoding` header, returns empty if none is acceptable.
+// `identityAcceptable` is set to false if the client refuses the uncompressed response by `identity;q=0`, or by
+// `*;q=0` without listing identity.
+QByteArray negotiateContentEncoding(const QByteArray &acceptEncoding, bool *identityAcceptable = nullptr);
+
 bool qGzipCompress(QSharedPointer<FileLike> input, QSharedPointer<FileLike> output, int level = -1);
 bool qGzipDecompress(QSharedPointer<FileLike> input, QSharedPointer<FileLike> output);
 
@@ -43,6 +43,9 @@ protected:  // http protocol, parsing request and making response.
     virtual QString errorMessageContentType();
     virtual QString dateTimeString();
     virtual QSharedPointer<FileLike> bodyAsFile(bool processEncoding = true);
+    // the best encoding accepted by client, such as `br` or `gzip`. returns empty if compression is not enabled.
+    // `identityAcceptable` is set to false if the client refuses the uncompressed response.
+    virtual QByteArray chooseContentEncoding(bool *identityAcceptable = nullptr);
 protected:  // support web socket.
     virtual bool switchToWebSocket();
     QBYTEARRAYLIST webSocketProtocols();
@@ -51,6 +54,11 @@ protected:  // util methods.
     void sendHeader(KnownHeader name, const QByteArray &value) { sendHeader(toString(name).toLatin1(), value); }
     void sendHeader(const QByteArray &name, const QByteArray &value);
     bool endHeader();
+    // send the header and the body together without joining them.
+    bool endHeader(const QByteArray &body);
+    // the same as endHeader(body), but compress the body if `enableCompression` is set and the client accepts any
+    // supported encoding. the `Content-Length` and `Vary` headers are sent by this function.
+    bool endHeaderCompressed(const QByteArray &body);
     bool readBody();
 protected:
     virtual QByteArray tryToHandleMagicCode(bool &done);
@@ -67,6 +75,8 @@ protected:
     HttpVersion serverVersion;  // default to HTTP 1.1
     float requestTimeout;  // default to 1 hour.
     qint32 maxBodySize;  // default to 32MB, unlimited if -1
+    bool enableCompression;  // default to false, compress the responses with the best codec accepted by client.
+    qint32 minCompressionSize;  // default to 1KB, the smaller responses are not worth compressing.
     enum CloseConnectionStatus { Yes, No, Maybe } closeConnection;  // determined by http version and connection header.
 };
 
@@ -49,6 +49,43 @@ public:
     QSharedPointer<QFile> f;
 };
 
+class ThreadPool;
+class AsyncFilePrivate;
+// reads and writes the file in a thread pool, so the other coroutines keep running while the disk is slow.
+// the sequential read() and write() use pread() and pwrite() from the current position. pipes and devices which
+// do not support positional io are read and written sequentially.
+class AsyncFile : public FileLike
+{
+public:
+    virtual ~AsyncFile() override;
+    virtual qint32 read(char *data, qint32 size) override;
+    virtual qint32 write(const char *data, qint32 size) override;
+    virtual void close() override;
+    virtual qint64 size() override;
+public:
+    qint32 readAt(qint64 offset, char *data, qint32 size);
+    qint32 writeAt(qint64 offset, const char *data, qint32 size);
+    bool seek(qint64 pos);
+    qint64 pos() const;
+    // after every read, ask the kernel to read the next `bytes` ahead (linux only). 0 disables it.
+    void setReadahead(qint64 bytes);
+    qint64 readahead() const;
+    QString fileName() const;
+    qintptr fileno() const;  // -1 if the file is not opened by the os.
+public:
+    // the pool is shared by all files of this thread if not specified.
+    static QSharedPointer<AsyncFile> open(const QString &filepath, const QString &mode = QString(),
+                                          QSharedPointer<ThreadPool> pool = QSharedPointer<ThreadPool>());
+    static QSharedPointer<AsyncFile> open(const QString &filepath, QIODevice::OpenMode mode,
+                                          QSharedPointer<ThreadPool> pool = QSharedPointer<ThreadPool>());
+    static QSharedPointer<ThreadPool> defaultThreadPool();
+private:
+    explicit AsyncFile(AsyncFilePrivate *d);
+    AsyncFilePrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(AsyncFile)
+    Q_DISABLE_COPY(AsyncFile)
+};
+
 class BytesIOPrivate;
 class BytesIO : public FileLike
 {
@@ -1,5 +1,9 @@
+#include <functional>
 #include <QtCore/qobject.h>
+#include <QtCore/qmap.h>
+#include <QtCore/qpair.h>
 #include <QtCore/qpointer.h>
+#include <QtCore/qsharedpointer.h>
 #include <QtCore/qstring.h>
 #include <QtCore/qendian.h>
 #include "./config.h"
@@ -13,6 +17,29 @@ class Transaction;
 class LmdbIteratorPrivate;
 class LmdbIterator;
 class ConstLmdbIterator;
+class LmdbSnapshot;
+
+// a value of read-only transaction in the memory map. the view keeps the transaction from being reset, so it is valid
+// while the view is alive, even after the transaction finishes. the values of write transactions are copied.
+class LmdbValueView
+{
+public:
+    LmdbValueView() { }
+public:
+    // refers to the memory map, do not keep it longer than this view.
+    inline const QByteArray &bytes() const { return m_bytes; }
+    inline QByteArray toByteArray() const { return QByteArray(m_bytes.constData(), m_bytes.size()); }
+    inline const char *data() const { return m_bytes.constData(); }
+    inline int size() const { return m_bytes.size(); }
+    inline bool isNull() const { return m_bytes.isNull(); }
+    inline bool isEmpty() const { return m_bytes.isEmpty(); }
+    inline bool operator==(const QByteArray &other) const { return m_bytes == other; }
+    inline bool operator!=(const QByteArray &other) const { return m_bytes != other; }
+private:
+    QByteArray m_bytes;
+    QSharedPointer<LmdbSnapshot> m_snapshot;
+    friend class DatabasePrivate;
+};
 
 class ConstLmdbIterator
 {
@@ -113,9 +140,25 @@ public:
     typedef QByteArray mapped_type;
     typedef qptrdiff difference_type;
     typedef qint64 size_type;
+    typedef std::function<bool(const QByteArray &key, const QByteArray &value)> Visitor;
     ~Database();
 public:
     inline QByteArray value(const QByteArray &key) const { return constFind(key).value(); }
+    // returns the value without copying it out of the memory map if the transaction is read-only. a write
+    // transaction may move its pages, so it returns a copy instead. see LmdbValueView.
+    LmdbValueView valueView(const QByteArray &key) const;
+    // looks up the keys in sorted order with one cursor. the missing keys are not in the result.
+    // the values are views as valueView() returns.
+    QMap<QByteArray, LmdbValueView> getMany(QList<QByteArray> keys) const;
+    // visits the items in [from, to) in order until `visitor` returns false. an empty `from` starts from the first
+    // item, and an empty `to` visits to the last item. the key and value passed to `visitor` are views of the memory
+    // map, which are valid only in the call, and the database must not be changed in the call.
+    // returns the number of visited items.
+    qint64 forEach(const QByteArray &from, const QByteArray &to, const Visitor &visitor) const;
+    qint64 forEachPrefix(const QByteArray &prefix, const Visitor &visitor) const;
+    // bulk load sorted items with MDB_APPEND, which is much faster than insert(). every key must be greater than
+    // the last key in the database. returns the number of inserted items, or -1 if failed.
+    qint64 append(const QList<QPair<QByteArray, QByteArray>> &sortedItems);
     iterator insert(const QByteArray &key, const QByteArray &value);
     iterator reserve(const QByteArray &key, size_t size); // insert value using itor.data() and itor.size()
     qint64 insert(const Database &other);
@@ -204,6 +247,7 @@ private:
     }
     TransactionPrivate * const d_ptr;
     friend class TransactionPrivate;
+    friend class LmdbPrivate;
     friend class Lmdb;
 private:
     Q_DISABLE_COPY(Transaction)
@@ -221,6 +265,15 @@ public:
 public:
     QSharedPointer<const Transaction> toRead();
     QSharedPointer<Transaction> toWrite();
+    // group commit: the functions submitted by the coroutines of this thread are applied by one writer coroutine
+    // in one write transaction, so they share one commit and one fsync. every function runs in a nested transaction,
+    // a function returns false to roll back its own changes. returns true if the function succeeded and the shared
+    // transaction was committed. the function should not block, because the others are waiting for it. do not
+    // submit while this coroutine holds a transaction of toWrite(). with writeMap(true), there is no nested
+    // transaction, so a failed function aborts the shared transaction and the others run again in a new one.
+    bool submit(const std::function<bool(Transaction &)> &func);
+    // insert `items` into database `dbName` by group commit. a null value removes the key.
+    bool submit(const QString &dbName, const QMap<QByteArray, QByteArray> &items);
     QString version() const;
     void sync(bool force = false);
     bool backupTo(const QString &dirPath);
@@ -2,6 +2,7 @@
 #define QTNG_MD_H
 
 #include <QtCore/qbytearray.h>
+#include <QtCore/qlist.h>
 #include "crypto.h"
 
 QTNETWORKNG_NAMESPACE_BEGIN
@@ -33,9 +34,20 @@ public:
     inline void update(const char *data, int len) { addData(data, len); }
     inline QByteArray digest() { return result(); }
     inline QByteArray hexDigest() { return result().toHex(); }
+public:
+    // start a new message with the same context, no memory is allocated.
+    void reset();
+    int digestSize() const;  // in bytes.
+    // write the digest to `out`, which must have room for digestSize() bytes.
+    bool result(char *out);
 public:
     static QByteArray hash(const QByteArray &data, Algorithm algo);
     static QByteArray digest(const QByteArray &data, Algorithm algo);
+    // hash many small buffers with one context. `hashMany()` returns hex strings like `hash()`.
+    static QList<QByteArray> hashMany(const QList<QByteArray> &data, Algorithm algo);
+    static QList<QByteArray> digestMany(const QList<QByteArray> &data, Algorithm algo);
+    // the digests are written to `out` one after another, which must have room for `count * digestSize()` bytes.
+    static bool digestMany(const char * const *data, const int *lens, int count, Algorithm algo, char *out);
 private:
     MessageDigestPrivate * const d_ptr;
     Q_DECLARE_PRIVATE(MessageDigest)
@@ -3,10 +3,12 @@
 
 #include <limits>
 #include <type_traits>
+#include <string.h>
 #include <QtCore/qvariant.h>
 #include <QtCore/qiodevice.h>
 #include <QtCore/qdatetime.h>
 #include <QtCore/qendian.h>
+#include <QtCore/qsharedpointer.h>
 #include "config.h"
 
 QTNETWORKNG_NAMESPACE_BEGIN
@@ -29,6 +31,8 @@ class MsgPackStream
 public:
     MsgPackStream();
     MsgPackStream(QIODevice *d);
+    // the byte array is read or written directly without QBuffer, device() returns nullptr.
+    // with QIODevice::ReadWrite, a QBuffer is used instead.
     MsgPackStream(QByteArray *a, QIODevice::OpenMode mode);
     MsgPackStream(const QByteArray &a);
     virtual ~MsgPackStream();
@@ -74,6 +78,9 @@ public:
     bool readArrayHeader(quint32 &len);
     bool readMapHeader(quint32 &len);
     bool readExtHeader(quint32 &len, quint8 msgpackType);
+    bool readStringHeader(quint32 &len);
+    // skip one value, including all elements of array and map.
+    bool skip();
 
     MsgPackStream &operator<<(bool b);
     MsgPackStream &operator<<(quint8 u8);
@@ -173,15 +180,15 @@ inline void _msgpack_store64(quint8 *p, qint64 i)
 {
     qToBigEndian(i, static_cast<void *>(p));
 }
-inline quint16 _msgpack_load16(quint8 *p)
+inline quint16 _msgpack_load16(const quint8 *p)
 {
     return qFromBigEndian<quint16>(static_cast<const void *>(p));
 }
-inline quint32 _msgpack_load32(quint8 *p)
+inline quint32 _msgpack_load32(const quint8 *p)
 {
     return qFromBigEndian<quint32>(static_cast<const void *>(p));
 }
-inline quint64 _msgpack_load64(quint8 *p)
+inline quint64 _msgpack_load64(const quint8 *p)
 {
     return qFromBigEndian<quint64>(static_cast<const void *>(p));
 }
@@ -210,15 +217,15 @@ inline void _msgpack_store64(quint8 *p, qint64 i)
 {
     qToBigEndian(i, static_cast<uchar *>(p));
 }
-inline quint16 _msgpack_load16(quint8 *p)
+inline quint16 _msgpack_load16(const quint8 *p)
 {
     return qFromBigEndian<quint16>(static_cast<const uchar *>(p));
 }
-inline quint32 _msgpack_load32(quint8 *p)
+inline quint32 _msgpack_load32(const quint8 *p)
 {
     return qFromBigEndian<quint32>(static_cast<const uchar *>(p));
 }
-inline quint64 _msgpack_load64(quint8 *p)
+inline quint64 _msgpack_load64(const quint8 *p)
 {
     return qFromBigEndian<quint64>(static_cast<const uchar *>(p));
 }
@@ -234,7 +241,7 @@ inline void _msgpack_store8(quint8 *p, qint8 i)
     *p = static_cast<quint8>(static_cast<qint32>(i));
 }
 
-inline quint8 _msgpack_load8(quint8 *p)
+inline quint8 _msgpack_load8(const quint8 *p)
 {
     return *p;
 }
@@ -423,6 +430,323 @@ MsgPackStream &operator>>(MsgPackStream &s, QHash<K, V> &map)
     return s;
 }
 
+// a read-only view of one msgpack value, which parses the headers only when it is accessed. strings and binaries
+// are returned as QByteArray::fromRawData() slices of the backing buffer, which is shared by all views derived
+// from it, so the slices are valid as long as any of the views is alive.
+class MsgPackView
+{
+public:
+    enum Type {
+        Invalid,
+        Nil,
+        Boolean,
+        Integer,
+        Float,
+        String,
+        Binary,
+        Array,
+        Map,
+        Extension,
+    };
+    class const_iterator
+    {
+    public:
+        MsgPackView key() const;  // only for map.
+        MsgPackView value() const;
+        MsgPackView operator*() const { return value(); }
+        const_iterator &operator++();
+        bool operator==(const const_iterator &other) const;
+        bool operator!=(const const_iterator &other) const { return !(*this == other); }
+    private:
+        const_iterator(const MsgPackView *view, int keyPos, int valuePos, quint32 remaining);
+        const MsgPackView *view;
+        int keyPos;
+        int valuePos;
+        quint32 remaining;
+        friend class MsgPackView;
+    };
+public:
+    MsgPackView();
+    explicit MsgPackView(const QByteArray &data);
+public:
+    Type type() const;
+    bool isValid() const { return type() != Invalid; }
+    bool isNil() const { return type() == Nil; }
+    bool isArray() const { return type() == Array; }
+    bool isMap() const { return type() == Map; }
+    // the number of elements of array and map, or the number of bytes of string, binary and extension.
+    quint32 size() const;
+
+    MsgPackView at(quint32 i) const;
+    MsgPackView value(const char *key, int len) const;
+    MsgPackView value(const QByteArray &key) const { return value(key.constData(), key.size()); }
+    bool contains(const QByteArray &key) const { return value(key).isValid(); }
+    MsgPackView operator[](int i) const { return i < 0 ? MsgPackView() : at(static_cast<quint32>(i)); }
+    MsgPackView operator[](const char *key) const { return value(key, static_cast<int>(strlen(key))); }
+    MsgPackView operator[](const QByteArray &key) const { return value(key); }
+    MsgPackView operator[](const QString &key) const { return value(key.toUtf8()); }
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    bool toBool(bool defaultValue = false) const;
+    qint64 toInt64(bool *ok = nullptr) const;
+    quint64 toUInt64(bool *ok = nullptr) const;
+    int toInt(bool *ok = nullptr) const;
+    double toDouble(bool *ok = nullptr) const;
+    QByteArray toByteArray() const;  // zero-copy, also returns the payload of extension.
+    QString toString() const;
+    quint8 extType() const;
+    QVariant toVariant() const;  // decode the whole value.
+    QByteArray raw() const;  // zero-copy, the encoded bytes of this value.
+    QByteArray data() const { return buf; }
+private:
+    MsgPackView(const QByteArray &buf, int pos);
+private:
+    QByteArray buf;
+    int pos;
+};
+
+// a push-style decoder splits a byte stream into complete msgpack objects, so msgpack rpc can be sent over tcp or
+// kcp without a framing layer. the length limit applies to each object, including all of its elements.
+class SocketLike;
+class MsgPackDecoderPrivate;
+class MsgPackDecoder
+{
+public:
+    MsgPackDecoder();
+    ~MsgPackDecoder();
+public:
+    // returns false if the data is corrupted or an object exceeds the length limit. the decoder stops then.
+    bool feed(const QByteArray &data);
+    bool feed(const char *data, qint32 size);
+    // receive from the socket until one object is completed. returns false if the socket is closed.
+    bool receive(QSharedPointer<SocketLike> socket, qint32 size = 1024 * 64);
+    bool hasPacket() const;
+    int packetCount() const;
+    // the encoded bytes of the next complete object, or an empty byte array if there is none.
+    QByteArray nextPacket();
+    MsgPackView nextView() { return MsgPackView(nextPacket()); }
+    template<typename T>
+    bool next(T &t);
+    qint64 bufferedSize() const;  // the bytes of the incomplete object.
+    void setLengthLimit(quint32 limit);
+    quint32 lengthLimit() const;
+    MsgPackStream::Status status() const;
+    void reset();
+private:
+    MsgPackDecoderPrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(MsgPackDecoder)
+    Q_DISABLE_COPY(MsgPackDecoder)
+};
+
+template<typename T>
+bool MsgPackDecoder::next(T &t)
+{
+    const QByteArray packet = nextPacket();
+    if (packet.isEmpty()) {
+        return false;
+    }
+    MsgPackStream s(packet);
+    s >> t;
+    return s.status() == MsgPackStream::Ok;
+}
+
+template<int... I>
+struct MsgPackIndexes
+{
+};
+
+template<int N, int... I>
+struct MsgPackMakeIndexes : MsgPackMakeIndexes<N - 1, N - 1, I...>
+{
+};
+
+template<int... I>
+struct MsgPackMakeIndexes<0, I...>
+{
+    typedef MsgPackIndexes<I...> type;
+};
+
+// a field name encoded as msgpack fixstr at compile time. `N` includes the terminating zero, which is not encoded.
+template<int N>
+struct MsgPackFieldName
+{
+    static_assert(N - 1 <= 31, "the field name is too long.");
+    constexpr MsgPackFieldName(const char (&name)[N])
+        : MsgPackFieldName(name, typename MsgPackMakeIndexes<N - 1>::type())
+    {
+    }
+    template<int... I>
+    constexpr MsgPackFieldName(const char (&name)[N], MsgPackIndexes<I...>)
+        : bytes { static_cast<char>(FirstByte::FIXSTR | (N - 1)), name[I]... }
+    {
+    }
+    char bytes[N];
+};
+
+#define QTNG_MSGPACK_EXPAND(x) x
+#define QTNG_MSGPACK_CONCAT_(a, b) a##b
+#define QTNG_MSGPACK_CONCAT(a, b) QTNG_MSGPACK_CONCAT_(a, b)
+#define QTNG_MSGPACK_COUNT_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, \
+                             _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, N, ...) \
+    N
+#define QTNG_MSGPACK_COUNT(...) \
+    QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_COUNT_(__VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, \
+                                            16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1))
+#define QTNG_MSGPACK_FOR_EACH(M, ...) \
+    QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_CONCAT(QTNG_MSGPACK_FOR_EACH_, QTNG_MSGPACK_COUNT(__VA_ARGS__))(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_1(M, x) M(x)
+#define QTNG_MSGPACK_FOR_EACH_2(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_1(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_3(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_2(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_4(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_3(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_5(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_4(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_6(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_5(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_7(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_6(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_8(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_7(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_9(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_8(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_10(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_9(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_11(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_10(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_12(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_11(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_13(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_12(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_14(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_13(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_15(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_14(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_16(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_15(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_17(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_16(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_18(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_17(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_19(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_18(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_20(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_19(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_21(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_20(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_22(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_21(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_23(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_22(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_24(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_23(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_25(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_24(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_26(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_25(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_27(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_26(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_28(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_27(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_29(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_28(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_30(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_29(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_31(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_30(M, __VA_ARGS__))
+#define QTNG_MSGPACK_FOR_EACH_32(M, x, ...) M(x) QTNG_MSGPACK_EXPAND(QTNG_MSGPACK_FOR_EACH_31(M, __VA_ARGS__))
+
+#define QTNG_MSGPACK_WRITE_FIELD(field) s << o.field;
+#define QTNG_MSGPACK_READ_FIELD(field)                                          \
+    if (i < len && s.status() == QTNETWORKNG_NAMESPACE::MsgPackStream::Ok) { \
+        s >> o.field;                                                           \
+        ++i;                                                                    \
+    }
+#define QTNG_MSGPACK_WRITE_KEYED_FIELD(field)                                                            \
+    {                                                                                                    \
+        static constexpr QTNETWORKNG_NAMESPACE::MsgPackFieldName<sizeof(#field)> key(#field);           \
+        s.writeBytes(key.bytes, sizeof(key.bytes));                                                      \
+        s << o.field;                                                                                    \
+    }
+#define QTNG_MSGPACK_READ_KEYED_FIELD(field)                                                \
+    if (!found && keyLen == sizeof(#field) - 1 && memcmp(key, #field, keyLen) == 0) {     \
+        s >> o.field;                                                                       \
+        found = true;                                                                       \
+    }
+
+// generate operator<<() and operator>>() for a struct, which pack the fields as a msgpack array in order:
+//
+//     struct Point { qint32 x; qint32 y; QString name; };
+//     QTNG_MSGPACK_FIELDS(Point, x, y, name)
+//
+// use the macro in the namespace of struct. new fields must be appended: the missing fields of old data keep their
+// default values, and the extra fields of new data are skipped.
+#define QTNG_MSGPACK_FIELDS(Type, ...)                                                                               \
+    inline QTNETWORKNG_NAMESPACE::MsgPackStream &operator<<(QTNETWORKNG_NAMESPACE::MsgPackStream &s, const Type &o) \
+    {                                                                                                                \
+        if (s.writeArrayHeader(QTNG_MSGPACK_COUNT(__VA_ARGS__))) {                                                   \
+            QTNG_MSGPACK_FOR_EACH(QTNG_MSGPACK_WRITE_FIELD, __VA_ARGS__)                                             \
+        }                                                                                                            \
+        return s;                                                                                                    \
+    }                                                                                                                \
+    inline QTNETWORKNG_NAMESPACE::MsgPackStream &operator>>(QTNETWORKNG_NAMESPACE::MsgPackStream &s, Type &o)       \
+    {                                                                                                                \
+        quint32 len = 0;                                                                                             \
+        if (!s.readArrayHeader(len)) {                                                                               \
+            return s;                                                                                                \
+        }                                                                                                            \
+        quint32 i = 0;                                                                                               \
+        QTNG_MSGPACK_FOR_EACH(QTNG_MSGPACK_READ_FIELD, __VA_ARGS__)                                                  \
+        for (; i < len && s.skip(); ++i) { }                                                                         \
+        return s;                                                                                                    \
+    }
+
+// the same as QTNG_MSGPACK_FIELDS(), but the schema version is packed as the first element of array. the data of
+// newer versions are rejected as MsgPackStream::ReadCorruptData.
+#define QTNG_MSGPACK_VERSIONED_FIELDS(Type, version, ...)                                                            \
+    inline QTNETWORKNG_NAMESPACE::MsgPackStream &operator<<(QTNETWORKNG_NAMESPACE::MsgPackStream &s, const Type &o) \
+    {                                                                                                                \
+        if (s.writeArrayHeader(QTNG_MSGPACK_COUNT(__VA_ARGS__) + 1)) {                                               \
+            s << static_cast<quint32>(version);                                                                      \
+            QTNG_MSGPACK_FOR_EACH(QTNG_MSGPACK_WRITE_FIELD, __VA_ARGS__)                                             \
+        }                                                                                                            \
+        return s;                                                                                                    \
+    }                                                                                                                \
+    inline QTNETWORKNG_NAMESPACE::MsgPackStream &operator>>(QTNETWORKNG_NAMESPACE::MsgPackStream &s, Type &o)       \
+    {                                                                                                                \
+        quint32 len = 0;                                                                                             \
+        quint32 dataVersion = 0;                                                                                     \
+        if (!s.readArrayHeader(len)) {                                                                               \
+            return s;                                                                                                \
+        }                                                                                                            \
+        if (len < 1) {                                                                                               \
+            s.setStatus(QTNETWORKNG_NAMESPACE::MsgPackStream::ReadCorruptData);                                      \
+            return s;                                                                                                \
+        }                                                                                                            \
+        s >> dataVersion;                                                                                            \
+        if (s.status() == QTNETWORKNG_NAMESPACE::MsgPackStream::Ok && dataVersion > static_cast<quint32>(version)) { \
+            s.setStatus(QTNETWORKNG_NAMESPACE::MsgPackStream::ReadCorruptData);                                      \
+            return s;                                                                                                \
+        }                                                                                                            \
+        quint32 i = 1;                                                                                               \
+        QTNG_MSGPACK_FOR_EACH(QTNG_MSGPACK_READ_FIELD, __VA_ARGS__)                                                  \
+        for (; i < len && s.skip(); ++i) { }                                                                         \
+        return s;                                                                                                    \
+    }
+
+// pack the fields as a msgpack map with the field names as keys, which are encoded at compile time.
+// the unknown keys are skipped, and the missing fields keep their default values.
+#define QTNG_MSGPACK_MAP_FIELDS(Type, ...)                                                                           \
+    inline QTNETWORKNG_NAMESPACE::MsgPackStream &operator<<(QTNETWORKNG_NAMESPACE::MsgPackStream &s, const Type &o) \
+    {                                                                                                                \
+        if (s.writeMapHeader(QTNG_MSGPACK_COUNT(__VA_ARGS__))) {                                                     \
+            QTNG_MSGPACK_FOR_EACH(QTNG_MSGPACK_WRITE_KEYED_FIELD, __VA_ARGS__)                                       \
+        }                                                                                                            \
+        return s;                                                                                                    \
+    }                                                                                                                \
+    inline QTNETWORKNG_NAMESPACE::MsgPackStream &operator>>(QTNETWORKNG_NAMESPACE::MsgPackStream &s, Type &o)       \
+    {                                                                                                                \
+        quint32 len = 0;                                                                                             \
+        if (!s.readMapHeader(len)) {                                                                                 \
+            return s;                                                                                                \
+        }                                                                                                            \
+        for (quint32 i = 0; i < len && s.status() == QTNETWORKNG_NAMESPACE::MsgPackStream::Ok; ++i) {               \
+            quint32 keyLen = 0;                                                                                      \
+            if (!s.readStringHeader(keyLen)) {                                                                       \
+                break;                                                                                               \
+            }                                                                                                        \
+            char key[32];                                                                                            \
+            bool found = false;                                                                                      \
+            if (keyLen <= sizeof(key)) {                                                                             \
+                if (!s.readBytes(key, keyLen)) {                                                                     \
+                    break;                                                                                           \
+                }                                                                                                    \
+                QTNG_MSGPACK_FOR_EACH(QTNG_MSGPACK_READ_KEYED_FIELD, __VA_ARGS__)                                    \
+            } else {                                                                                                 \
+                QByteArray longKey(static_cast<int>(keyLen), Qt::Uninitialized);                                    \
+                if (!s.readBytes(longKey.data(), keyLen)) {                                                          \
+                    break;                                                                                           \
+                }                                                                                                    \
+            }                                                                                                        \
+            if (!found) {                                                                                            \
+                s.skip();                                                                                            \
+            }                                                                                                        \
+        }                                                                                                            \
+        return s;                                                                                                    \
+    }
+
 QTNETWORKNG_NAMESPACE_END
 
 Q_DECLARE_METATYPE(QTNETWORKNG_NAMESPACE::MsgPackExtData)
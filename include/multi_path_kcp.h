@@ -1,10 +1,63 @@
 #ifndef QTNG_MULTI_PATH_KCP_H
 #define QTNG_MULTI_PATH_KCP_H
 
+#include <QtCore/qvector.h>
 #include "kcp_base.h"
 
 QTNETWORKNG_NAMESPACE_BEGIN
 
+struct MultiPathKcpPathStats
+{
+    HostAddress addr;
+    quint16 port;
+    bool active;
+    float srtt;  // smoothed round-trip time in msecs, zero if there is no sample yet.
+    float rttvar;
+    float lossRate;  // 0.0 ~ 1.0
+    float throughput;  // acknowledged bytes per second.
+    quint64 inflightBytes;  // sent but not acknowledged yet.
+    quint64 sentPackets;
+    quint64 sentBytes;
+    quint64 ackedBytes;
+    quint64 receivedBytes;
+    quint64 lastSendTimestamp;  // msecs since epoch.
+    quint64 lastActiveTimestamp;  // msecs since epoch.
+};
+
+enum MultiPathKcpSchedule {
+    RoundRobinSchedule,
+    MinRttSchedule,
+    WeightedSchedule,
+    RedundantSchedule,  // min-rtt, and duplicate acks and retransmissions to the second best path.
+};
+
+class MultiPathKcpScheduler
+{
+public:
+    virtual ~MultiPathKcpScheduler();
+public:
+    // returns the index of path to send the packet through. set `*duplicate` to another index to send a copy.
+    // `urgent` is true for packets that carry no new data (acks, window probes) or retransmissions.
+    virtual int schedule(const QVector<MultiPathKcpPathStats> &paths, bool urgent, int *duplicate) = 0;
+};
+
+QSharedPointer<MultiPathKcpScheduler> createMultiPathKcpScheduler(MultiPathKcpSchedule schedule);
+
+class MultiPathKcpSocketLikeHelper
+{
+public:
+    explicit MultiPathKcpSocketLikeHelper(QSharedPointer<SocketLike> socket = nullptr);
+public:
+    bool isValid() const;
+    void setSocket(QSharedPointer<SocketLike> socket);
+    // for the listening socket, the scheduler applies to every accepted connection.
+    bool setSchedule(MultiPathKcpSchedule schedule);
+    bool setScheduler(std::function<QSharedPointer<MultiPathKcpScheduler>()> factory);
+    QVector<MultiPathKcpPathStats> pathStats() const;
+protected:
+    QSharedPointer<SocketLike> socket;
+};
+
 class MultiPathKcpServerSocketLikeHelper
 {
 public:
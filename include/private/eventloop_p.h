@@ -65,6 +65,11 @@ public:
         Write = 2,
         ReadWrite = 3,
     };
+    enum IoOperation {
+        RecvOperation = 1,
+        SendOperation = 2,
+        AcceptOperation = 3,
+    };
 public:
     virtual ~EventLoopCoroutine() override;
     virtual void run() override;
@@ -74,6 +79,9 @@ public:
     void stopWatcher(int watcherId);
     void removeWatcher(int watcherId);
     void triggerIoWatchers(qintptr fd);
+    // does the io by the eventloop and waits for its completion, the result is the return value of syscall or -errno.
+    // returns false if the eventloop only polls the readiness, which is all but io_uring.
+    bool doIo(IoOperation operation, qintptr fd, char *data, qint32 size, int flags, qint32 *result);
     int callLater(quint32 msecs, Functor *callback);  // the ownership of callback is taken
     void callLaterThreadSafe(quint32 msecs, Functor *callback);  // the ownership of callback is taken
     int callRepeat(quint32 msecs, Functor *callback);  // the ownership of callback is taken
@@ -84,6 +92,7 @@ public:
     bool isQt() const { return objectName() == QString::fromUtf8("qt_eventloop_coroutine"); }
     bool isEv() const { return objectName() == QString::fromUtf8("libev_eventloop_coroutine"); }
     bool isWin() const { return objectName() == QString::fromUtf8("win_eventloop_coroutine"); }
+    bool isIoUring() const { return objectName() == QString::fromUtf8("io_uring_eventloop_coroutine"); }
 public:
     static EventLoopCoroutine *get();
 protected:
@@ -119,6 +128,8 @@ public:
     virtual void stopWatcher(int watcherId) = 0;
     virtual void removeWatcher(int watcherId) = 0;
     virtual void triggerIoWatchers(qintptr fd) = 0;
+    virtual bool doIo(EventLoopCoroutine::IoOperation operation, qintptr fd, char *data, qint32 size, int flags,
+                      qint32 *result);
     virtual int callLater(quint32 msecs, Functor *callback) = 0;
     virtual void callLaterThreadSafe(quint32 msecs, Functor *callback) = 0;
     virtual int callRepeat(quint32 msecs, Functor *callback) = 0;
@@ -159,6 +170,17 @@ public:
 };
 #endif
 
+#ifdef QTNETWORKNG_USE_IO_URING
+// does the io of tcp sockets and polls the others by io_uring (linux 5.11+), submitting all requests and reaping
+// completions in one syscall.
+class IoUringEventLoopCoroutine : public EventLoopCoroutine
+{
+public:
+    IoUringEventLoopCoroutine();
+    static bool isSupported();
+};
+#endif
+
 #ifdef QTNETWOKRNG_USE_WIN
 class WinEventLoopCoroutine : public EventLoopCoroutine
 {
@@ -1,6 +1,7 @@
 #ifndef QTNG_HTTP_P_H
 #define QTNG_HTTP_P_H
 
+#include <QtCore/qcache.h>
 #include "../http.h"
 #include "../locks.h"
 #include "../socket.h"
@@ -14,6 +15,15 @@ QTNETWORKNG_NAMESPACE_BEGIN
 
 class HttpProxy;
 class Socks5Proxy;
+#ifndef QTNG_NO_CRYPTO
+class SslSessionCacheItem
+{
+public:
+    QByteArray session;
+    QDateTime expiration;
+};
+#endif
+
 class ConnectionPoolItem
 {
 public:
@@ -40,12 +50,19 @@ public:
     void setHttpProxy(QSharedPointer<HttpProxy> proxy);
 private:
     ConnectionPoolItem &getItem(const QUrl &url);
+#ifndef QTNG_NO_CRYPTO
+    QByteArray findSslSession(const QUrl &h);
+    void saveSslSession(const QUrl &h, QSharedPointer<SslSocket> ssl);
+#endif
 public:
     QMap<QUrl, ConnectionPoolItem> items;
     QSharedPointer<SocketDnsCache> dnsCache;
     QSharedPointer<BaseProxySwitcher> proxySwitcher;
 #ifndef QTNG_NO_CRYPTO
     SslConfiguration sslConfig;
+    // resumed by new connections to the same server. the least recently used ones are dropped if there are more
+    // sessions than servers in the pool.
+    QCache<QUrl, SslSessionCacheItem> sslSessions;
 #endif
     int maxConnectionsPerServer;
     int timeToLive;
@@ -83,6 +83,11 @@ public:
     qint32 peek(char *data, qint32 size);
     qint32 recv(char *data, qint32 size, bool all);
     qint32 send(const char *data, qint32 size, bool all);
+    qint32 sendv(const IoVector *vectors, int count);
+    qint32 recvv(IoVector *vectors, int count);
+#ifdef Q_OS_LINUX
+    qint64 sendfile(qintptr fileDescriptor, qint64 offset, qint64 size);
+#endif
     qint32 recvfrom(char *data, qint32 size, HostAddress *addr, quint16 *port);
     qint32 sendto(const char *data, qint32 size, const HostAddress &addr, quint16 port);
     bool fetchConnectionParameters();
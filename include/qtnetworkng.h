@@ -6,6 +6,8 @@
 #include "eventloop.h"
 #include "socket.h"
 #include "socket_utils.h"
+#include "dns.h"
+#include "xxhash.h"
 #include "http.h"
 #include "http_proxy.h"
 #include "http_utils.h"
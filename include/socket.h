@@ -4,6 +4,8 @@
 #include <QtCore/qstring.h>
 #include <QtCore/qbytearray.h>
 #include <QtCore/qobject.h>
+#include <QtCore/qvector.h>
+#include <QtCore/qscopeguard.h>
 
 #include "hostaddress.h"
 #include "network_interface.h"
@@ -16,6 +18,33 @@
 
 QTNETWORKNG_NAMESPACE_BEGIN
 
+// a span of memory for scatter/gather io, like the `struct iovec` of posix.
+struct IoVector
+{
+    IoVector()
+        : data(nullptr)
+        , size(0)
+    {
+    }
+    IoVector(char *data, qint32 size)
+        : data(data)
+        , size(size)
+    {
+    }
+    IoVector(const char *data, qint32 size)
+        : data(const_cast<char *>(data))
+        , size(size)
+    {
+    }
+    IoVector(const QByteArray &bs)
+        : data(const_cast<char *>(bs.constData()))
+        , size(bs.size())
+    {
+    }
+    char *data;  // never written by sendv().
+    qint32 size;
+};
+
 class SocketPrivate;
 class SocketDnsCache;
 class Socket
@@ -140,6 +169,13 @@ public:
     qint32 sendall(const char *data, qint32 size);
     qint32 recvfrom(char *data, qint32 size, HostAddress *addr, quint16 *port);
     qint32 sendto(const char *data, qint32 size, const HostAddress &addr, quint16 port);
+    // sendv() sends all vectors in one system call if possible, and returns like sendall().
+    // recvv() scatters the received data to the vectors in order, and returns like recv().
+    qint32 sendv(const IoVector *vectors, int count);
+    qint32 recvv(IoVector *vectors, int count);
+    // sends `size` bytes of the file from `offset` by the kernel without copying them through userspace, and returns
+    // the bytes sent. linux tcp sockets only, returns -1 before sending anything if not supported.
+    qint64 sendfile(qintptr fileDescriptor, qint64 offset, qint64 size);
 
     QByteArray recvall(qint32 size);
     QByteArray recv(qint32 size);
@@ -155,6 +191,10 @@ public:
                                     QSharedPointer<SocketDnsCache> dnsCache = QSharedPointer<SocketDnsCache>(),
                                     int allowProtocol = HostAddress::IPv4Protocol | HostAddress::IPv6Protocol);
     static Socket *createServer(const HostAddress &host, quint16 port, int backlog = 50);
+    // the delay before createConnection() starts the next attempt while the last one is pending (RFC 8305).
+    // set to zero to try the addresses one by one.
+    static void setConnectionAttemptDelay(float secs);
+    static float connectionAttemptDelay();
 private:
     SocketPrivate * const d_ptr;
     Q_DECLARE_PRIVATE(Socket)
@@ -184,6 +224,7 @@ private:
     Q_DECLARE_PRIVATE(Poll)
 };
 
+class DnsResolver;
 class SocketDnsCachePrivate;
 class SocketDnsCache
 {
@@ -195,8 +236,13 @@ public:
     bool hasHost(const QString &hostName) const;
     void addHost(const QString &hostName, const QList<HostAddress> &addrList);
     void addHost(const QString &hostName, const HostAddress &addr);
+    // the hosts added by addHost() never expire. resolved hosts expire after the smaller one of
+    // timeToLive() and the ttl of dns records.
     quint64 timeToLive() const;
     void setTimeToLive(quint64 msecs);
+    // use a DnsResolver instead of the blocking Socket::resolve() if set.
+    QSharedPointer<DnsResolver> resolver() const;
+    void setResolver(QSharedPointer<DnsResolver> resolver);
 private:
     SocketDnsCachePrivate * const d_ptr;
     Q_DECLARE_PRIVATE(SocketDnsCache)
@@ -232,6 +278,13 @@ SocketType *createConnection(const HostAddress &addr, quint16 port, Socket::Sock
     return nullptr;
 }
 
+// sort addresses for happy eyeballs, interleave IPv6 and IPv4 addresses, starting with the first address family.
+QList<HostAddress> interleaveAddresses(const QList<HostAddress> &addresses, int allowProtocol);
+
+// start `connectTo(i)` for every address in turn, starting the next after Socket::connectionAttemptDelay() or
+// after the last attempt fails. returns the index of first succeeded attempt and kill the rest, or -1 if all failed.
+int staggeredConnect(int count, std::function<bool(int)> connectTo);
+
 template<typename SocketType>
 SocketType *createConnection(const QString &hostName, quint16 port, Socket::SocketError *error,
                              QSharedPointer<SocketDnsCache> dnsCache, int allowProtocol,
@@ -255,15 +308,34 @@ SocketType *createConnection(const QString &hostName, quint16 port, Socket::Sock
         }
         return nullptr;
     }
-    for (int i = 0; i < addresses.size(); ++i) {
-        const HostAddress &addr = addresses.at(i);
-        SocketType *socket = createConnection<SocketType>(addr, port, error, allowProtocol, func);
-        if (socket) {
-            return socket;
+    addresses = interleaveAddresses(addresses, allowProtocol);
+    if (addresses.isEmpty()) {
+        if (error) {
+            *error = Socket::HostNotFoundError;
+        }
+        return nullptr;
+    }
+    QVector<SocketType *> sockets(addresses.size(), nullptr);
+    auto cleanup = qScopeGuard([&sockets] { qDeleteAll(sockets); });
+    Socket::SocketError lastError = Socket::NoError;
+    int winner = staggeredConnect(addresses.size(), [&](int i) -> bool {
+        Socket::SocketError e = Socket::NoError;
+        sockets[i] = createConnection<SocketType>(addresses.at(i), port, &e, allowProtocol, func);
+        if (!sockets[i]) {
+            lastError = e;
+        }
+        return sockets[i] != nullptr;
+    });
+    if (winner >= 0) {
+        SocketType *socket = sockets[winner];
+        sockets[winner] = nullptr;
+        if (error) {
+            *error = Socket::NoError;
         }
+        return socket;
     }
-    if (error && *error == Socket::NoError) {
-        *error = Socket::HostNotFoundError;
+    if (error) {
+        *error = lastError == Socket::NoError ? Socket::HostNotFoundError : lastError;
     }
     return nullptr;
 }
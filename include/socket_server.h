@@ -227,11 +227,15 @@ public:
     SslConfiguration sslConfiguration() const;
     void setSslHandshakeTimeout(float sslHandshakeTimeout);
     float sslHandshakeTimeout() const;
+    // handshakes run in the event loop thread by default. set a thread pool to spread them across cores.
+    void setSslHandshakeThreadPool(QSharedPointer<ThreadPool> pool);
+    QSharedPointer<ThreadPool> sslHandshakeThreadPool() const;
     virtual bool isSecure() const override;
 protected:
     virtual QSharedPointer<SocketLike> prepareRequest(QSharedPointer<SocketLike> request) override;
 private:
     SslConfiguration _configuration;
+    QSharedPointer<ThreadPool> _sslHandshakeThreadPool;
     float _sslHandshakeTimeout;
 };
 
@@ -294,6 +298,18 @@ float WithSsl<ServerType>::sslHandshakeTimeout() const
     return this->_sslHandshakeTimeout;
 }
 
+template<typename ServerType>
+void WithSsl<ServerType>::setSslHandshakeThreadPool(QSharedPointer<ThreadPool> pool)
+{
+    this->_sslHandshakeThreadPool = pool;
+}
+
+template<typename ServerType>
+QSharedPointer<ThreadPool> WithSsl<ServerType>::sslHandshakeThreadPool() const
+{
+    return this->_sslHandshakeThreadPool;
+}
+
 template<typename ServerType>
 bool WithSsl<ServerType>::isSecure() const
 {
@@ -306,6 +322,7 @@ QSharedPointer<SocketLike> WithSsl<ServerType>::prepareRequest(QSharedPointer<So
     try {
         Timeout timeout(_sslHandshakeTimeout);
         QSharedPointer<SslSocket> s = QSharedPointer<SslSocket>::create(request, _configuration);
+        s->setHandshakeThreadPool(_sslHandshakeThreadPool);
         if (s->handshake(true, QString())) {
             return asSocketLike(s);
         }
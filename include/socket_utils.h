@@ -57,6 +57,9 @@ public:
     virtual QByteArray recvall(qint32 size) = 0;
     virtual qint32 send(const QByteArray &data) = 0;
     virtual qint32 sendall(const QByteArray &data) = 0;
+    // the default implementations gather the vectors into one buffer for sending, and receive into the first one.
+    virtual qint32 sendv(const IoVector *vectors, int count);
+    virtual qint32 recvv(IoVector *vectors, int count);
 public:
     virtual qint32 read(char *data, qint32 size) override;
     virtual qint32 write(const char *data, qint32 size) override;
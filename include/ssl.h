@@ -1,11 +1,13 @@
 #ifndef QTNG_SSL_H
 #define QTNG_SSL_H
 
+#include <QtCore/qurl.h>
 #include "socket.h"
 #include "certificate.h"
 
 QTNETWORKNG_NAMESPACE_BEGIN
 
+class ThreadPool;
 class SslCipherPrivate;
 class SslCipher
 {
@@ -46,6 +48,32 @@ public:
     virtual QString choose(const QString &hostName) = 0;
 };
 
+// keeps a fresh OCSP response of the local certificate, which is stapled to the server handshakes, so clients need not
+// ask the responder themselves. the responder url defaults to the one of certificate (Authority Information Access).
+class SslOcspStaplerPrivate;
+class SslOcspStapler
+{
+public:
+    SslOcspStapler(const Certificate &certificate, const Certificate &issuer, const QUrl &responderUrl = QUrl());
+    ~SslOcspStapler();
+public:
+    // the DER encoded response, empty if no response is fetched.
+    QByteArray response() const;
+    // the response is stapled as is, it is not checked.
+    void setResponse(const QByteArray &response);
+    QUrl responderUrl() const;
+    void setResponderUrl(const QUrl &responderUrl);
+    // fetch the response from the responder now. the old response is kept if failed.
+    bool refresh();
+    // refresh in background every `interval` secs, or earlier if the response is going to expire.
+    void start(float interval = 3600.0);
+    void stop();
+private:
+    SslOcspStaplerPrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(SslOcspStapler)
+    Q_DISABLE_COPY(SslOcspStapler)
+};
+
 class SslConfigurationPrivate;
 class SslConfiguration
 {
@@ -65,8 +93,12 @@ public:
     Ssl::PeerVerifyMode peerVerifyMode() const;
     int peerVerifyDepth() const;
     PrivateKey privateKey() const;
+    Ssl::SslProtocol sslProtocol() const;
     bool onlySecureProtocol() const;
     bool supportCompression() const;
+    bool kernelTls() const;
+    float peerVerifyCacheTimeout() const;
+    QSharedPointer<SslOcspStapler> ocspStapler() const;
     bool sendTlsExtHostName() const;
     QSharedPointer<ChooseTlsExtNameCallback> tlsExtHostNameCallback() const;
 
@@ -79,10 +111,23 @@ public:
     void setPrivateKey(const PrivateKey &key);
     bool setPrivateKey(const QString &fileName, Ssl::EncodingFormat format = Ssl::Pem,
                        const QByteArray &passPhrase = QByteArray());
+    // limit the protocol versions. the default Ssl::SecureProtocols leaves it to onlySecureProtocol().
     void setSslProtocol(Ssl::SslProtocol protocol);
     void setAllowedNextProtocols(const QList<QByteArray> &protocols);
     void setOnlySecureProtocol(bool onlySecureProtocol);
     void setSupportCompression(bool supportCompression);
+    // hand the record encryption over to the linux kernel (TCP_ULP "tls") after handshake, so send() and recv()
+    // are plain socket i/o. AES-GCM or ChaCha20-Poly1305 over a tcp Socket is supported with TLS 1.2, and with TLS 1.3
+    // if built with OpenSSL 1.1.1+ (not the bundled libressl). other connections stay in userspace silently. the TLS 1.3
+    // clients only hand the sending over, because the server sends session tickets after handshake. see
+    // SslSocket::isKernelTls().
+    void setKernelTls(bool kernelTls);
+    // with Ssl::VerifyPeer, the peer chain is verified against caCertificates() (or the system CA store if empty),
+    // and the leaf certificates verified are remembered for `secs` (not beyond the expiry of chain), so the repeat
+    // connections to the same peers skip the path building. 0 disables the cache. the default is one hour.
+    void setPeerVerifyCacheTimeout(float secs);
+    // the server staples the OCSP response of stapler to handshakes.
+    void setOcspStapler(QSharedPointer<SslOcspStapler> stapler);
     void setSendTlsExtHostName(bool sendTlsExtHostName);
     void setTlsExtHostNameCallback(QSharedPointer<ChooseTlsExtNameCallback> callback);
 public:
@@ -208,6 +253,33 @@ public:
     void setPeerVerifyName(const QString &peerVerifyName);
     void setTlsExtHostName(const QString &tlsExtHostName);
     QSharedPointer<SocketLike> backend() const;
+
+    // the serialized session can be passed to setSession() of a new client socket to the same server before
+    // handshake(), to resume the session and skip the certificate exchange. empty if the session is not resumable.
+    // with TLS 1.3, the session ticket is sent after the handshake, so fetch it after exchanging some data.
+    QByteArray session() const;
+    void setSession(const QByteArray &session);
+    // the session can not be resumed after this time, which is limited by the ticket lifetime of server.
+    // invalid if there is no session.
+    QDateTime sessionExpiration() const;
+    bool isSessionReused() const;
+    // true if the kernel both encrypts and decrypts the records. the kernel may take one direction only: a TLS 1.3
+    // client sends by the kernel and receives in userspace, and if the kernel takes the receiving keys but refuses the
+    // sending ones, the connection receives by the kernel and sends in userspace. it works either way.
+    bool isKernelTls() const;
+    bool isKernelTlsRx() const;  // the kernel decrypts the incoming records.
+    bool isKernelTlsTx() const;  // the kernel encrypts the outgoing records, sendfile() works without a copy.
+    // the DER encoded OCSP response stapled by server, empty if not stapled. with Ssl::VerifyPeer, the handshake fails
+    // if the stapled response is invalid or the certificate is revoked.
+    QByteArray ocspResponse() const;
+
+    // run the cpu-heavy handshake steps (the private key operations) in the thread pool instead of the event loop
+    // thread, so other connections are not blocked by a burst of handshakes. must be set before handshake().
+    // the OpenSSL callbacks of handshake (peer verification, OCSP stapling and session tickets) run in the pool
+    // threads, so the objects they use, such as SslOcspStapler, must be thread safe. if the handshake is killed or
+    // timed out, the socket is unusable and the SSL object is released after the pending step finished.
+    void setHandshakeThreadPool(QSharedPointer<ThreadPool> pool);
+    QSharedPointer<ThreadPool> handshakeThreadPool() const;
 public:
     Socket::SocketError error() const;
     QString errorString() const;
@@ -247,6 +319,8 @@ public:
     QByteArray recvall(qint32 size);
     qint32 send(const QByteArray &data);
     qint32 sendall(const QByteArray &data);
+    // small vectors are coalesced into full tls records instead of one record per vector.
+    qint32 sendv(const IoVector *vectors, int count);
 
     static SslSocket *createConnection(const HostAddress &host, quint16 port,
                                        const SslConfiguration &config = SslConfiguration(),
@@ -274,7 +348,8 @@ inline QSharedPointer<SocketLike> asSocketLike(SslSocket *s)
 
 QSharedPointer<SslSocket> convertSocketLikeToSslSocket(QSharedPointer<SocketLike> socket);
 
-// XXX we always assume the cipher is stream cipher
+// the cipher must be a stream cipher or an AEAD cipher (AES-GCM, ChaCha20Poly1305). with AEAD ciphers the data is
+// framed and authenticated, so tampering is detected. both peers must use the same kind of cipher.
 QSharedPointer<SocketLike> encrypted(QSharedPointer<Cipher> cipher, QSharedPointer<SocketLike> socket);
 
 QTNETWORKNG_NAMESPACE_END
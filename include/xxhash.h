@@ -0,0 +1,21 @@
+#ifndef QTNG_XXHASH_H
+#define QTNG_XXHASH_H
+
+#include <QtCore/qbytearray.h>
+#include <QtCore/qlist.h>
+#include "config.h"
+
+QTNETWORKNG_NAMESPACE_BEGIN
+
+// XXH64, a fast non-cryptographic hash for hash tables, cache keys and checksums of trusted data.
+// never use it where an attacker can choose the input to make collisions, use MessageDigest instead.
+quint64 xxhash64(const char *data, qint64 len, quint64 seed = 0);
+inline quint64 xxhash64(const QByteArray &data, quint64 seed = 0)
+{
+    return xxhash64(data.constData(), data.size(), seed);
+}
+QList<quint64> xxhash64Many(const QList<QByteArray> &data, quint64 seed = 0);
+
+QTNETWORKNG_NAMESPACE_END
+
+#endif  // QTNG_XXHASH_H
@@ -33,6 +33,9 @@ SOURCES += \
     $$PWD/src/websocket.cpp \
     $$PWD/src/random.cpp \
     $$PWD/src/hostaddress.cpp \
+    $$PWD/src/dns.cpp \
+    $$PWD/src/xxhash.cpp \
+    $$PWD/src/gzip.cpp \
     $$PWD/src/network_interface/network_interface.cpp \
     $$PWD/src/lmdb.cpp \
     $$PWD/src/liblmdb/midl.c \
@@ -75,13 +78,35 @@ HEADERS += \
     $$PWD/include/httpd.h \
     $$PWD/include/random.h \
     $$PWD/include/hostaddress.h \
+    $$PWD/include/dns.h \
+    $$PWD/include/xxhash.h \
+    $$PWD/include/gzip.h \
     $$PWD/include/network_interface.h \
     $$PWD/include/lmdb.h \
     $$PWD/src/eventloop_qt_p.h \
     $$PWD/src/liblmdb/midl.h \
     $$PWD/src/liblmdb/lmdb.h
 
-    
+
+# gzip and deflate use the zlib of Qt, zstd and brotli are optional codecs of http content encoding.
+DEFINES += "QTNG_HAVE_ZLIB=1"
+contains(QT_CONFIG, system-zlib) {
+    LIBS += -lz
+} else {
+    INCLUDEPATH += $$[QT_INSTALL_HEADERS]/QtZlib
+}
+unix {
+    CONFIG += link_pkgconfig
+    packagesExist(libzstd) {
+        DEFINES += "QTNG_HAVE_ZSTD=1"
+        PKGCONFIG += libzstd
+    }
+    packagesExist(libbrotlienc libbrotlidec) {
+        DEFINES += "QTNG_HAVE_BROTLI=1"
+        PKGCONFIG += libbrotlienc libbrotlidec
+    }
+}
+
 win32 {
     SOURCES += $$PWD/src/socket_win.cpp \
         $$PWD/src/eventloop_win.cpp \
@@ -120,6 +145,14 @@ win32 {
     DEFINES += "QTNETWOKRNG_USE_EV=1"
     SOURCES += $$PWD/src/ev/ev.c \
                $$PWD/src/eventloop_ev.cpp
+    linux {
+        # the io_uring eventloop needs IORING_ENTER_EXT_ARG (linux 5.11+) in the kernel headers.
+        QTNG_IO_URING_TEST = $$system("(echo '$${LITERAL_HASH}include <linux/io_uring.h>'; echo 'int main() { return IORING_ENTER_EXT_ARG; }') | $$QMAKE_CXX -x c++ -fsyntax-only - >/dev/null 2>&1 && echo yes")
+        equals(QTNG_IO_URING_TEST, yes) {
+            DEFINES += "QTNETWORKNG_USE_IO_URING=1"
+            SOURCES += $$PWD/src/eventloop_uring.cpp
+        }
+    }
     PRIVATE_HEADERS += $$PWD/src/ev/ev.h
 }
 
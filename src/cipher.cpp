@@ -33,6 +33,9 @@ const EVP_CIPHER *getOpenSSL_CIPHER(Cipher::Algorithm algo, Cipher::Mode mode)
         case Cipher::CTR:
             cipher = EVP_aes_128_ctr();
             break;
+        case Cipher::GCM:
+            cipher = EVP_aes_128_gcm();
+            break;
         default:
             Q_UNREACHABLE();
         }
@@ -54,6 +57,9 @@ const EVP_CIPHER *getOpenSSL_CIPHER(Cipher::Algorithm algo, Cipher::Mode mode)
         case Cipher::CTR:
             cipher = EVP_aes_192_ctr();
             break;
+        case Cipher::GCM:
+            cipher = EVP_aes_192_gcm();
+            break;
         default:
             Q_UNREACHABLE();
         }
@@ -75,6 +81,9 @@ const EVP_CIPHER *getOpenSSL_CIPHER(Cipher::Algorithm algo, Cipher::Mode mode)
         case Cipher::CTR:
             cipher = EVP_aes_256_ctr();
             break;
+        case Cipher::GCM:
+            cipher = EVP_aes_256_gcm();
+            break;
         default:
             Q_UNREACHABLE();
         }
@@ -177,9 +186,9 @@ const EVP_CIPHER *getOpenSSL_CIPHER(Cipher::Algorithm algo, Cipher::Mode mode)
     case Cipher::Chacha20:
         cipher = EVP_chacha20();
         break;
-        //    case Cipher::ChaCha20Poly1305:
-        //        cipher = EVP_chacha20_poly1305();
-        //        break;
+    case Cipher::ChaCha20Poly1305:
+        cipher = EVP_chacha20_poly1305();
+        break;
     default:
         break;
     }
@@ -202,7 +211,10 @@ public:
     bool setOpensslPassword(const QByteArray &password, const QByteArray &salt, const MessageDigest::Algorithm hashAlgo,
                             int i);
     bool init();
+    bool resetIv(const char *iv, int ivLen);
+    bool resetKey();
     bool setPadding(bool padding);
+    bool isAead() const;
 
     EVP_CIPHER_CTX *context;
     const EVP_CIPHER *cipher;
@@ -251,13 +263,27 @@ CipherPrivate::~CipherPrivate()
     cleanupOpenSSL();
 }
 
+bool CipherPrivate::isAead() const
+{
+    return cipher && (EVP_CIPHER_flags(cipher) & EVP_CIPH_FLAG_AEAD_CIPHER);
+}
+
 bool CipherPrivate::init()
 {
     if (inited || !context || !cipher || key.isEmpty() || iv.isEmpty() || hasError) {
         return false;
     }
-    int rvalue = EVP_CipherInit_ex(context, cipher, nullptr, reinterpret_cast<unsigned char *>(key.data()),
-                                   reinterpret_cast<unsigned char *>(iv.data()), operation == Cipher::Decrypt ? 0 : 1);
+    const int enc = operation == Cipher::Decrypt ? 0 : 1;
+    int rvalue;
+    if (isAead() && iv.size() != EVP_CIPHER_iv_length(cipher)) {
+        rvalue = EVP_CipherInit_ex(context, cipher, nullptr, nullptr, nullptr, enc)
+                && EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_AEAD_SET_IVLEN, iv.size(), nullptr)
+                && EVP_CipherInit_ex(context, nullptr, nullptr, reinterpret_cast<unsigned char *>(key.data()),
+                                     reinterpret_cast<unsigned char *>(iv.data()), enc);
+    } else {
+        rvalue = EVP_CipherInit_ex(context, cipher, nullptr, reinterpret_cast<unsigned char *>(key.data()),
+                                   reinterpret_cast<unsigned char *>(iv.data()), enc);
+    }
     if (rvalue) {
         inited = true;
         return true;
@@ -266,6 +292,45 @@ bool CipherPrivate::init()
     }
 }
 
+// start a new message with the same key.
+bool CipherPrivate::resetIv(const char *iv, int ivLen)
+{
+    if (!inited || !context || !cipher) {
+        return false;
+    }
+    if (isAead() && ivLen != EVP_CIPHER_CTX_iv_length(context)) {
+        if (!EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_AEAD_SET_IVLEN, ivLen, nullptr)) {
+            return false;
+        }
+    } else if (!isAead() && ivLen != EVP_CIPHER_iv_length(cipher)) {
+        return false;
+    }
+    if (!EVP_CipherInit_ex(context, nullptr, nullptr, nullptr, reinterpret_cast<const unsigned char *>(iv), -1)) {
+        hasError = true;
+        return false;
+    }
+    hasError = false;
+    return true;
+}
+
+// change the key of an inited context, the iv is kept.
+bool CipherPrivate::resetKey()
+{
+    if (!inited || !context || !cipher) {
+        return false;
+    }
+    if (key.size() != EVP_CIPHER_CTX_key_length(context)) {
+        return false;
+    }
+    if (!EVP_CipherInit_ex(context, nullptr, nullptr, reinterpret_cast<const unsigned char *>(key.constData()),
+                           nullptr, -1)) {
+        hasError = true;
+        return false;
+    }
+    hasError = false;
+    return true;
+}
+
 QPair<QByteArray, QByteArray> CipherPrivate::bytesToKey(const QByteArray &password, MessageDigest::Algorithm hashAlgo,
                                                         const QByteArray &salt, int i)
 {
@@ -463,6 +528,7 @@ bool Cipher::isStream() const
         case OFB:
         case CTR:
         case OPENPGP:
+        case GCM:
             return true;
         }
     case Null:
@@ -486,10 +552,145 @@ QByteArray Cipher::finalData()
     return d->finalData();
 }
 
+bool Cipher::isAead() const
+{
+    Q_D(const Cipher);
+    return d->isAead();
+}
+
+qint32 Cipher::update(const char *data, qint32 len, char *out)
+{
+    Q_D(Cipher);
+    if (!d->context || !d->inited || d->hasError) {
+        return -1;
+    }
+    int outl = 0;
+    if (!EVP_CipherUpdate(d->context, reinterpret_cast<unsigned char *>(out), &outl,
+                          reinterpret_cast<const unsigned char *>(data), len)) {
+        d->hasError = true;
+        return -1;
+    }
+    return outl;
+}
+
+qint32 Cipher::final(char *out)
+{
+    Q_D(Cipher);
+    if (!d->context || !d->inited || d->hasError) {
+        return -1;
+    }
+    int outl = 0;
+    if (!EVP_CipherFinal_ex(d->context, reinterpret_cast<unsigned char *>(out), &outl)) {
+        d->hasError = true;
+        return -1;
+    }
+    return outl;
+}
+
+bool Cipher::setAad(const char *data, int len)
+{
+    Q_D(Cipher);
+    if (!d->isAead() || !d->inited || d->hasError) {
+        return false;
+    }
+    if (len <= 0) {
+        return true;
+    }
+    int outl = 0;
+    return EVP_CipherUpdate(d->context, nullptr, &outl, reinterpret_cast<const unsigned char *>(data), len);
+}
+
+QByteArray Cipher::tag(int size) const
+{
+    Q_D(const Cipher);
+    if (!d->isAead() || !d->inited || d->operation != Encrypt || size <= 0 || size > 16) {
+        return QByteArray();
+    }
+    QByteArray buf(size, Qt::Uninitialized);
+    if (!EVP_CIPHER_CTX_ctrl(d->context, EVP_CTRL_AEAD_GET_TAG, size, buf.data())) {
+        return QByteArray();
+    }
+    return buf;
+}
+
+bool Cipher::setTag(const QByteArray &tag)
+{
+    Q_D(Cipher);
+    if (!d->isAead() || !d->inited || d->operation != Decrypt || tag.isEmpty() || tag.size() > 16) {
+        return false;
+    }
+    return EVP_CIPHER_CTX_ctrl(d->context, EVP_CTRL_AEAD_SET_TAG, tag.size(), const_cast<char *>(tag.constData()));
+}
+
+bool Cipher::seal(const char *iv, int ivLen, const char *aad, int aadLen, char *data, qint32 len, char *tag)
+{
+    Q_D(Cipher);
+    if (!d->isAead() || d->operation != Encrypt || !d->resetIv(iv, ivLen) || !setAad(aad, aadLen)) {
+        return false;
+    }
+    if (len > 0 && update(data, len, data) != len) {
+        return false;
+    }
+    char rest[EVP_MAX_BLOCK_LENGTH];
+    if (final(rest) != 0) {
+        return false;
+    }
+    return EVP_CIPHER_CTX_ctrl(d->context, EVP_CTRL_AEAD_GET_TAG, 16, tag);
+}
+
+bool Cipher::open(const char *iv, int ivLen, const char *aad, int aadLen, char *data, qint32 len, const char *tag)
+{
+    Q_D(Cipher);
+    if (!d->isAead() || d->operation != Decrypt || !d->resetIv(iv, ivLen) || !setAad(aad, aadLen)) {
+        return false;
+    }
+    if (len > 0 && update(data, len, data) != len) {
+        return false;
+    }
+    if (!EVP_CIPHER_CTX_ctrl(d->context, EVP_CTRL_AEAD_SET_TAG, 16, const_cast<char *>(tag))) {
+        return false;
+    }
+    char rest[EVP_MAX_BLOCK_LENGTH];
+    return final(rest) == 0;
+}
+
+QByteArray Cipher::seal(const QByteArray &iv, const QByteArray &data, const QByteArray &aad)
+{
+    QByteArray buf(data.size() + 16, Qt::Uninitialized);
+    memcpy(buf.data(), data.constData(), static_cast<size_t>(data.size()));
+    if (!seal(iv.constData(), iv.size(), aad.constData(), aad.size(), buf.data(), data.size(),
+              buf.data() + data.size())) {
+        return QByteArray();
+    }
+    return buf;
+}
+
+QByteArray Cipher::open(const QByteArray &iv, const QByteArray &sealed, const QByteArray &aad, bool *ok)
+{
+    if (ok) {
+        *ok = false;
+    }
+    if (sealed.size() < 16) {
+        return QByteArray();
+    }
+    QByteArray buf = sealed.left(sealed.size() - 16);
+    if (!open(iv.constData(), iv.size(), aad.constData(), aad.size(), buf.data(), buf.size(),
+              sealed.constData() + buf.size())) {
+        return QByteArray();
+    }
+    if (ok) {
+        *ok = true;
+    }
+    return buf;
+}
+
 bool Cipher::setInitialVector(const QByteArray &iv)
 {
     Q_D(Cipher);
     d->iv = iv;
+    if (d->inited) {
+        return d->resetIv(iv.constData(), iv.size());
+    }
     return d->init();
 }
 
@@ -497,6 +698,9 @@ bool Cipher::setKey(const QByteArray &key)
 {
     Q_D(Cipher);
     d->key = key;
+    if (d->inited) {
+        return d->resetKey();
+    }
     return d->init();
 }
 
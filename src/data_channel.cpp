@@ -1,8 +1,10 @@
 #include <QtCore/qmap.h>
+#include <QtCore/qqueue.h>
 #include <QtCore/qpointer.h>
 #include <QtCore/qsharedpointer.h>
 #include <QtCore/qendian.h>
 #include <QtCore/qdatetime.h>
+#include <QtCore/qvarlengtharray.h>
 #include "../include/locks.h"
 #include "../include/coroutine_utils.h"
 #include "../include/data_channel.h"
@@ -25,8 +27,13 @@ const quint8 DESTROY_CHANNEL_REQUEST = 3;
 const quint8 SLOW_DOWN_REQUEST = 4;
 const quint8 GO_THROUGH_REQUEST = 5;
 const quint8 KEEPALIVE_REQUEST = 6;
+const quint8 WINDOW_UPDATE_REQUEST = 7;
 const quint32 DefaultPacketSize = 1024 * 64;
 const quint32 DefaultPayloadSize = 1400;
+const quint32 DefaultBatchSize = 1024 * 256;
+const qint64 SchedulingQuantum = 1024 * 16;
+const int ReceivingBufferSize = 1024 * 64;
+const int MaxSendingBatchPackets = 1 << (SocketChannelStats::BatchSizeBuckets - 1);
 
 static QByteArray packMakeChannelRequest(quint32 channelNumber)
 {
@@ -52,6 +59,16 @@ static QByteArray packDestoryChannelRequest(quint32 channelNumber)
     return QByteArray(reinterpret_cast<char *>(buf), sizeof(buf));
 }
 
+// the limit is the number of data packets the peer may send since the channel was made, not an increment. so the
+// packets in flight before the first update are counted by the peer itself.
+static QByteArray packWindowUpdateRequest(quint32 limit)
+{
+    uchar buf[sizeof(quint8) + sizeof(quint32)];
+    qToBigEndian(WINDOW_UPDATE_REQUEST, buf);
+    qToBigEndian(limit, buf + sizeof(quint8));
+    return QByteArray(reinterpret_cast<char *>(buf), sizeof(buf));
+}
+
 static QByteArray packSlowDownRequest()
 {
     uchar buf[sizeof(quint8)];
@@ -82,7 +99,7 @@ static bool unpackCommand(QByteArray data, quint8 *command, quint32 *channelNumb
         *command = qFromBigEndian<quint8>(reinterpret_cast<const uchar *>(data.constData()));
 #endif
         if (*command != MAKE_CHANNEL_REQUEST && *command != CHANNEL_MADE_REQUEST
-            && *command != DESTROY_CHANNEL_REQUEST) {
+            && *command != DESTROY_CHANNEL_REQUEST && *command != WINDOW_UPDATE_REQUEST) {
             return false;
         }
 #if QT_VERSION >= QT_VERSION_CHECK(5, 7, 0)
@@ -106,6 +123,136 @@ static bool unpackCommand(QByteArray data, quint8 *command, quint32 *channelNumb
     }
 }
 
+// a large packet is read by the user while it is being received. the stream is fed by the receiving coroutine of the
+// link, which must not wait for one reader; a stream whose reader falls behind is dropped, and the link goes on.
+class ReceivingPacketStream : public FileLike
+{
+public:
+    explicit ReceivingPacketStream(qint64 size);
+    virtual qint32 read(char *data, qint32 size) override;
+    virtual qint32 write(const char *data, qint32 size) override;
+    virtual void close() override;
+    virtual qint64 size() override;
+public:
+    bool feed(const QByteArray &chunk);  // returns false if the stream is closed or dropped.
+    void abort();
+private:
+    Queue<QByteArray> chunks;
+    QByteArray current;
+    int currentPos;
+    qint64 total;
+    qint64 consumed;
+    bool closed;
+    bool dropped;
+};
+
+ReceivingPacketStream::ReceivingPacketStream(qint64 size)
+    : chunks(16)
+    , currentPos(0)
+    , total(size)
+    , consumed(0)
+    , closed(false)
+    , dropped(false)
+{
+}
+
+qint32 ReceivingPacketStream::read(char *data, qint32 size)
+{
+    if (closed || size <= 0) {
+        return -1;
+    }
+    if (consumed >= total) {
+        return 0;
+    }
+    while (currentPos >= current.size()) {
+        current = chunks.get();
+        currentPos = 0;
+        if (current.isNull()) {  // the channel is aborted.
+            closed = true;
+            return -1;
+        }
+    }
+    const qint32 len = qMin(size, current.size() - currentPos);
+    memcpy(data, current.constData() + currentPos, static_cast<size_t>(len));
+    currentPos += len;
+    consumed += len;
+    return len;
+}
+
+qint32 ReceivingPacketStream::write(const char *, qint32)
+{
+    return -1;
+}
+
+void ReceivingPacketStream::close()
+{
+    closed = true;
+    current.clear();
+    while (!chunks.isEmpty()) {
+        chunks.get();
+    }
+}
+
+qint64 ReceivingPacketStream::size()
+{
+    return total;
+}
+
+bool ReceivingPacketStream::feed(const QByteArray &chunk)
+{
+    if (closed || dropped) {
+        return false;
+    }
+    if (chunks.isFull()) {
+        // give a reader waiting in read() the chance to take a chunk.
+        Coroutine::sleep(0);
+        if (closed) {
+            return false;
+        }
+    }
+    if (chunks.isFull()) {
+        // the reader is not reading, the rest of packet is discarded instead of stopping the whole link.
+        abort();
+        return false;
+    }
+    chunks.put(chunk);
+    return true;
+}
+
+void ReceivingPacketStream::abort()
+{
+    dropped = true;
+    while (!chunks.isEmpty()) {
+        chunks.get();
+    }
+    chunks.putForcedly(QByteArray());
+}
+
+// an entry of the receiving queue, the invalid one wakes up the readers after the channel is aborted.
+class ReceivingPacket
+{
+public:
+    ReceivingPacket()
+        : valid(false)
+    {
+    }
+    ReceivingPacket(const QByteArray &packet)
+        : packet(packet)
+        , valid(true)
+    {
+    }
+    ReceivingPacket(QSharedPointer<ReceivingPacketStream> stream)
+        : stream(stream)
+        , valid(true)
+    {
+    }
+
+    QByteArray packet;  // may be empty.
+    QSharedPointer<ReceivingPacketStream> stream;  // a large packet being received.
+    bool valid;
+    inline bool isValid() const { return valid; }
+};
+
 class DataChannelPrivate
 {
 public:
@@ -119,6 +266,7 @@ public:
     QSharedPointer<VirtualChannel> takeChannel(quint32 channelNumber);
     QSharedPointer<VirtualChannel> peekChannel(quint32 channelNumber);
     QByteArray recvPacket();
+    QSharedPointer<FileLike> recvPacketStream();
     bool sendPacket(const QByteArray &packet);
     bool sendPacketAsync(const QByteArray &packet);
     QString toString() const;
@@ -134,19 +282,37 @@ public:
     virtual quint32 payloadSizeHint() const = 0;
     virtual quint32 headerSize() const = 0;
     virtual QSharedPointer<SocketLike> getBackend() const = 0;
+    virtual bool setSendingWeight(quint32 channelNumber, quint32 weight) = 0;
+    virtual quint32 sendingWeight(quint32 channelNumber) const = 0;
 
     // called by the subclasses.
     bool handleCommand(const QByteArray &packet);
+    void enableFlowControl();
+    void consumePacket();
     void notifyChannelClose(quint32 channelNumber);
     DataChannel::ChannelError handleIncomingPacket(quint32 channelNumber, const QByteArray &payload);
+    void enqueuePacket(const ReceivingPacket &packet);
+    DataChannel::ChannelError handleSubChannelPacket(quint32 channelNumber, quint32 subChannelNumber,
+                                                     const QByteArray &packet);
+    bool takePacket(QByteArray *packet, QSharedPointer<FileLike> *stream);
+    inline qint32 sendCredits() const { return static_cast<qint32>(sendLimit - sentPackets); }
+    void flushDeferredPackets();
 
     QString name;
     DataChannelPole pole;
     quint32 nextChannelNumber;
     QMap<quint32, QWeakPointer<VirtualChannel>> subChannels;
     Queue<QSharedPointer<VirtualChannel>> pendingChannels;
-    Queue<QByteArray> receivingQueue;
+    Queue<ReceivingPacket> receivingQueue;
     Gate goThrough;
+    Gate sendWindow;  // closed if the peer's receiving window is exhausted.
+    QQueue<QByteArray> deferredPackets;  // sent by sendPacketAsync() while the window is exhausted.
+    quint32 sendLimit;  // the counters wrap around, compare them by sendCredits().
+    quint32 sentPackets;
+    quint32 takenPackets;
+    quint32 announcedPackets;
+    bool flowControl;  // the receiving window is announced to the peer.
+    bool peerFlowControl;  // the peer announced its receiving window.
     DataChannel::ChannelError error;
 
     QSharedPointer<DataChannel> pluggedChannel;
@@ -181,9 +347,234 @@ public:
     QByteArray packet;
     QSharedPointer<ValueEvent<bool>> done;
     quint32 channelNumber;
-    bool isValid() { return !(channelNumber == 0 && packet.isNull() && done.isNull()); }
+    bool isValid() const { return !(channelNumber == 0 && packet.isNull() && done.isNull()); }
+};
+
+// the packets of command channel are sent first, and the other channels share the connection by deficit round
+// robin, so a bulk transfer can not starve the others. the capacity applies to the queue of each channel.
+class SendingScheduler
+{
+public:
+    explicit SendingScheduler(quint32 capacity);
+public:
+    bool put(const WritingPacket &packet);  // blocked until the queue of this channel is not full.
+    void putForcedly(const WritingPacket &packet);
+    WritingPacket get();  // blocked until not empty.
+    QList<WritingPacket> take(quint32 channelNumber, std::function<bool(const QByteArray &)> checkPacket);
+    QList<WritingPacket> takeAll();
+    void removeChannel(quint32 channelNumber);
+    void setWeight(quint32 channelNumber, quint32 weight);
+    quint32 weight(quint32 channelNumber) const;
+    void close();  // the packets put later are rejected.
+    inline bool isEmpty() const { return total == 0; }
+    inline quint32 size() const { return total; }
+private:
+    struct Flow
+    {
+        Flow()
+            : deficit(0)
+            , weight(1)
+            , credited(false)
+            , notFull(new Gate())
+        {
+        }
+        QQueue<WritingPacket> packets;
+        qint64 deficit;
+        quint32 weight;
+        bool credited;  // got the quantum of this round.
+        QSharedPointer<Gate> notFull;
+    };
+    void enqueue(const WritingPacket &packet);
+    void drained(quint32 channelNumber, Flow &flow);
+private:
+    QMap<quint32, Flow> flows;
+    QList<quint32> active;  // the channels with queued packets, except the command channel.
+    Event notEmpty;
+    quint32 capacity;
+    quint32 total;
+    bool closed;
 };
 
+SendingScheduler::SendingScheduler(quint32 capacity)
+    : capacity(capacity)
+    , total(0)
+    , closed(false)
+{
+}
+
+void SendingScheduler::enqueue(const WritingPacket &packet)
+{
+    Flow &flow = flows[packet.channelNumber];
+    flow.packets.enqueue(packet);
+    if (flow.packets.size() == 1 && packet.channelNumber != CommandChannelNumber) {
+        active.append(packet.channelNumber);
+    }
+    ++total;
+    notEmpty.set();
+}
+
+void SendingScheduler::drained(quint32 channelNumber, Flow &flow)
+{
+    flow.deficit = 0;
+    flow.credited = false;
+    active.removeOne(channelNumber);
+}
+
+bool SendingScheduler::put(const WritingPacket &packet)
+{
+    while (true) {
+        if (closed) {
+            return false;
+        }
+        Flow &flow = flows[packet.channelNumber];
+        if (static_cast<quint32>(flow.packets.size()) < capacity) {
+            enqueue(packet);
+            return true;
+        }
+        // the flow may be removed while waiting.
+        QSharedPointer<Gate> notFull = flow.notFull;
+        notFull->close();
+        if (!notFull->tryWait()) {
+            return false;
+        }
+    }
+}
+
+void SendingScheduler::putForcedly(const WritingPacket &packet)
+{
+    if (closed) {
+        if (!packet.done.isNull()) {
+            packet.done->send(false);
+        }
+        return;
+    }
+    enqueue(packet);
+}
+
+WritingPacket SendingScheduler::get()
+{
+    while (total == 0) {
+        if (closed || !notEmpty.tryWait()) {
+            return WritingPacket();
+        }
+    }
+    quint32 channelNumber = CommandChannelNumber;
+    QMap<quint32, Flow>::iterator itor = flows.find(CommandChannelNumber);
+    if (itor == flows.end() || itor.value().packets.isEmpty()) {
+        while (true) {
+            Q_ASSERT(!active.isEmpty());
+            channelNumber = active.first();
+            itor = flows.find(channelNumber);
+            Flow &flow = itor.value();
+            if (!flow.credited) {
+                flow.deficit += SchedulingQuantum * flow.weight;
+                flow.credited = true;
+            }
+            const qint64 size = flow.packets.head().packet.size() + static_cast<qint64>(sizeof(quint32) * 2);
+            if (size <= flow.deficit) {
+                flow.deficit -= size;
+                break;
+            }
+            flow.credited = false;
+            active.append(active.takeFirst());
+        }
+    }
+    Flow &flow = itor.value();
+    const WritingPacket packet = flow.packets.dequeue();
+    --total;
+    if (flow.packets.isEmpty()) {
+        drained(channelNumber, flow);
+    }
+    if (static_cast<quint32>(flow.packets.size()) < capacity) {
+        flow.notFull->open();
+    }
+    if (total == 0) {
+        notEmpty.clear();
+    }
+    return packet;
+}
+
+QList<WritingPacket> SendingScheduler::take(quint32 channelNumber,
+                                            std::function<bool(const QByteArray &)> checkPacket)
+{
+    QList<WritingPacket> taken;
+    QMap<quint32, Flow>::iterator itor = flows.find(channelNumber);
+    if (itor == flows.end()) {
+        return taken;
+    }
+    Flow &flow = itor.value();
+    QQueue<WritingPacket> reserved;
+    for (const WritingPacket &packet : flow.packets) {
+        if (checkPacket(packet.packet)) {
+            taken.append(packet);
+        } else {
+            reserved.enqueue(packet);
+        }
+    }
+    flow.packets = reserved;
+    total -= static_cast<quint32>(taken.size());
+    if (flow.packets.isEmpty()) {
+        drained(channelNumber, flow);
+    }
+    flow.notFull->open();
+    if (total == 0) {
+        notEmpty.clear();
+    }
+    return taken;
+}
+
+QList<WritingPacket> SendingScheduler::takeAll()
+{
+    QList<WritingPacket> taken;
+    for (QMap<quint32, Flow>::iterator itor = flows.begin(); itor != flows.end(); ++itor) {
+        Flow &flow = itor.value();
+        taken.append(flow.packets);
+        flow.packets.clear();
+        flow.deficit = 0;
+        flow.credited = false;
+        flow.notFull->open();
+    }
+    active.clear();
+    total = 0;
+    notEmpty.clear();
+    return taken;
+}
+
+void SendingScheduler::removeChannel(quint32 channelNumber)
+{
+    QMap<quint32, Flow>::iterator itor = flows.find(channelNumber);
+    if (itor == flows.end()) {
+        return;
+    }
+    Q_ASSERT(itor.value().packets.isEmpty());
+    itor.value().notFull->open();
+    active.removeOne(channelNumber);
+    flows.erase(itor);
+}
+
+void SendingScheduler::setWeight(quint32 channelNumber, quint32 weight)
+{
+    flows[channelNumber].weight = qMax<quint32>(weight, 1);
+}
+
+quint32 SendingScheduler::weight(quint32 channelNumber) const
+{
+    QMap<quint32, Flow>::const_iterator itor = flows.constFind(channelNumber);
+    if (itor == flows.constEnd()) {
+        return 1;
+    }
+    return itor.value().weight;
+}
+
+void SendingScheduler::close()
+{
+    closed = true;
+    for (QMap<quint32, Flow>::iterator itor = flows.begin(); itor != flows.end(); ++itor) {
+        itor.value().notFull->open();
+    }
+    notEmpty.set();
+}
+
 class SocketChannelPrivate : public DataChannelPrivate
 {
 public:
@@ -199,13 +590,21 @@ public:
     virtual quint32 payloadSizeHint() const override;
     virtual quint32 headerSize() const override;
     virtual QSharedPointer<SocketLike> getBackend() const override;
+    virtual bool setSendingWeight(quint32 channelNumber, quint32 weight) override;
+    virtual quint32 sendingWeight(quint32 channelNumber) const override;
     void doSend();
     void doReceive();
     void doKeepalive();
+    DataChannel::ChannelError dispatchPacket(quint32 channelNumber, const char *payload, quint32 payloadSize);
+    bool receiveStream(quint32 payloadSize, QByteArray &buf, int &begin, int end);
 
     const QSharedPointer<SocketLike> connection;
-    Queue<WritingPacket> sendingQueue;
+    SendingScheduler sendingQueue;
     CoroutineGroup *operations;
+    SocketChannelStats stats;
+    QSharedPointer<ReceivingPacketStream> currentStream;
+    qint64 maxBatchSize;
+    quint32 streamingThreshold;
     quint32 _maxPayloadSize;
     quint32 _payloadSizeHint;
     qint64 lastActiveTimestamp;
@@ -232,6 +631,8 @@ public:
     virtual quint32 payloadSizeHint() const override;
     virtual quint32 headerSize() const override;
     virtual QSharedPointer<SocketLike> getBackend() const override;
+    virtual bool setSendingWeight(quint32 channelNumber, quint32 weight) override;
+    virtual quint32 sendingWeight(quint32 channelNumber) const override;
 
     QPointer<DataChannel> parentChannel;
     quint32 channelNumber;
@@ -242,6 +643,12 @@ public:
 DataChannelPrivate::DataChannelPrivate(DataChannelPole pole, DataChannel *parent)
     : pole(pole)
     , receivingQueue(1024)  // may consume 1024 * maxPayloadSize bytes.
+    , sendLimit(0)
+    , sentPackets(0)
+    , takenPackets(0)
+    , announcedPackets(0)
+    , flowControl(false)
+    , peerFlowControl(false)
     , error(DataChannel::NoError)
     , q_ptr(parent)
 {
@@ -286,13 +693,16 @@ void DataChannelPrivate::abort(DataChannel::ChannelError reason)
         pluggedChannel.clear();
     }
 
+    // the streams in the queue are received completely, except the current one of SocketChannel.
     for (quint32 i = 0; i < receivingQueue.getting(); ++i) {
-        receivingQueue.put(QByteArray());
+        receivingQueue.put(ReceivingPacket());
     }
     for (quint32 i = 0; i < pendingChannels.getting(); ++i) {
         pendingChannels.put(QSharedPointer<VirtualChannel>());
     }
+    deferredPackets.clear();
     goThrough.open();
+    sendWindow.open();
     for (QMapIterator<quint32, QWeakPointer<VirtualChannel>> itor(subChannels); itor.hasNext();) {
         const QWeakPointer<VirtualChannel> &subChannel = itor.next().value();
         if (!subChannel.isNull()) {
@@ -310,15 +720,15 @@ DataChannel::ChannelError DataChannelPrivate::handleIncomingPacket(quint32 chann
         if (!getPrivateHelper(pluggedChannel)->sendPacketRaw(channelNumber, payload, false)) {
             return DataChannel::PluggedChannelError;
         } else {
+            if (channelNumber == DataChannelNumber) {
+                consumePacket();
+            }
             return DataChannel::NoError;
         }
     }
 
     if (channelNumber == DataChannelNumber) {
-        if (receivingQueue.size() == (receivingQueue.capacity() * 3 / 4)) {
-            sendPacketRaw(CommandChannelNumber, packSlowDownRequest(), false);
-        }
-        receivingQueue.putForcedly(payload);
+        enqueuePacket(ReceivingPacket(payload));
     } else if (channelNumber == CommandChannelNumber) {
         if (!handleCommand(payload)) {
             return DataChannel::InvalidCommand;
@@ -326,37 +736,19 @@ DataChannel::ChannelError DataChannelPrivate::handleIncomingPacket(quint32 chann
             return DataChannel::NoError;
         }
     } else if (subChannels.contains(channelNumber)) {
-        QSharedPointer<VirtualChannel> channel = subChannels.value(channelNumber).toStrongRef();
-        if (channel.isNull()) {
-#ifdef DEBUG_PROTOCOL
-            qtng_debug << "channel is destroyed and data is abandoned: " << channelNumber;
-#endif
-            subChannels.remove(channelNumber);
-        } else {
-            const int headerSize = sizeof(quint32);
-            if (payload.size() < headerSize) {
-#ifdef DEBUG_PROTOCOL
-                qtng_debug << "the sub channel got an too small packet: " << channelNumber << payload.size()
-                           << headerSize;
-#endif
-                return DataChannel::InvalidPacket;
+        const int headerSize = sizeof(quint32);
+        if (payload.size() < headerSize) {
+            if (subChannels.value(channelNumber).isNull()) {
+                subChannels.remove(channelNumber);
+                return DataChannel::NoError;
             }
-#if QT_VERSION >= QT_VERSION_CHECK(5, 7, 0)
-            quint32 channelNumber = qFromBigEndian<quint32>(payload.constData());
-#else
-            quint32 channelNumber = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(payload.constData()));
-#endif
-            const QByteArray &packet = payload.mid(headerSize);
-            DataChannel::ChannelError handlePacketResult =
-                    channel->d_func()->handleIncomingPacket(channelNumber, packet);
-            if (handlePacketResult != DataChannel::NoError) {
 #ifdef DEBUG_PROTOCOL
-                qtng_debug << "the sub channel got an too small packet: " << channelNumber << payload.size()
-                           << headerSize;
+            qtng_debug << "the sub channel got an too small packet: " << channelNumber << payload.size() << headerSize;
 #endif
-                getPrivateHelper(channel)->abort(handlePacketResult);
-            }
+            return DataChannel::InvalidPacket;
         }
+        quint32 subChannelNumber = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(payload.constData()));
+        return handleSubChannelPacket(channelNumber, subChannelNumber, payload.mid(headerSize));
     } else {
 #ifdef DEBUG_PROTOCOL
         qtng_debug << "channel is destroyed and data is abandoned: " << channelNumber;
@@ -365,6 +757,36 @@ DataChannel::ChannelError DataChannelPrivate::handleIncomingPacket(quint32 chann
     return DataChannel::NoError;
 }
 
+void DataChannelPrivate::enqueuePacket(const ReceivingPacket &packet)
+{
+    // the peer respects the receiving window, no need to slow it down.
+    if (!(flowControl && peerFlowControl) && receivingQueue.size() == (receivingQueue.capacity() * 3 / 4)) {
+        sendPacketRaw(CommandChannelNumber, packSlowDownRequest(), false);
+    }
+    receivingQueue.putForcedly(packet);
+}
+
+DataChannel::ChannelError DataChannelPrivate::handleSubChannelPacket(quint32 channelNumber, quint32 subChannelNumber,
+                                                                     const QByteArray &packet)
+{
+    QSharedPointer<VirtualChannel> channel = subChannels.value(channelNumber).toStrongRef();
+    if (channel.isNull()) {
+#ifdef DEBUG_PROTOCOL
+        qtng_debug << "channel is destroyed and data is abandoned: " << channelNumber;
+#endif
+        subChannels.remove(channelNumber);
+        return DataChannel::NoError;
+    }
+    DataChannel::ChannelError handlePacketResult = channel->d_func()->handleIncomingPacket(subChannelNumber, packet);
+    if (handlePacketResult != DataChannel::NoError) {
+#ifdef DEBUG_PROTOCOL
+        qtng_debug << "the sub channel can not handle packet: " << channelNumber << handlePacketResult;
+#endif
+        getPrivateHelper(channel)->abort(handlePacketResult);
+    }
+    return DataChannel::NoError;
+}
+
 QSharedPointer<VirtualChannel> DataChannelPrivate::makeChannelInternal(DataChannelPole pole, quint32 channelNumber)
 {
     Q_Q(DataChannel);
@@ -386,6 +808,9 @@ QSharedPointer<VirtualChannel> DataChannelPrivate::makeChannel()
     nextChannelNumber += this->pole;
     QSharedPointer<VirtualChannel> channel = makeChannelInternal(DataChannelPole::PositivePole, channelNumber);
     sendPacketRaw(CommandChannelNumber, packMakeChannelRequest(channelNumber), false);
+    if (flowControl) {
+        channel->d_func()->enableFlowControl();
+    }
     return channel;
 }
 
@@ -445,17 +870,50 @@ QSharedPointer<VirtualChannel> DataChannelPrivate::peekChannel(quint32 channelNu
 
 QByteArray DataChannelPrivate::recvPacket()
 {
-    if (receivingQueue.isEmpty() && error != DataChannel::NoError) {
+    QByteArray packet;
+    QSharedPointer<FileLike> stream;
+    if (!takePacket(&packet, &stream)) {
         return QByteArray();
     }
-    const QByteArray &packet = receivingQueue.get();
-    if (packet.isNull()) {
-        return QByteArray();
+    if (!stream.isNull()) {
+        bool ok = false;
+        packet = stream->readall(&ok);
+        if (!ok) {
+            return QByteArray();
+        }
     }
-    if (receivingQueue.size() == (receivingQueue.capacity() / 2)) {
+    return packet;
+}
+
+QSharedPointer<FileLike> DataChannelPrivate::recvPacketStream()
+{
+    QByteArray packet;
+    QSharedPointer<FileLike> stream;
+    if (!takePacket(&packet, &stream)) {
+        return QSharedPointer<FileLike>();
+    }
+    if (!stream.isNull()) {
+        return stream;
+    }
+    return FileLike::bytes(packet);
+}
+
+bool DataChannelPrivate::takePacket(QByteArray *packet, QSharedPointer<FileLike> *stream)
+{
+    if (receivingQueue.isEmpty() && error != DataChannel::NoError) {
+        return false;
+    }
+    const ReceivingPacket &received = receivingQueue.get();
+    if (!received.isValid()) {
+        return false;
+    }
+    *packet = received.packet;
+    *stream = received.stream;
+    consumePacket();
+    if (!(flowControl && peerFlowControl) && receivingQueue.size() == (receivingQueue.capacity() / 2)) {
         sendPacketRaw(CommandChannelNumber, packGoThroughRequest(), false);
     }
-    return packet;
+    return true;
 }
 
 bool DataChannelPrivate::sendPacket(const QByteArray &packet)
@@ -463,12 +921,74 @@ bool DataChannelPrivate::sendPacket(const QByteArray &packet)
     if (!goThrough.tryWait()) {
         return false;
     }
-    return sendPacketRaw(DataChannelNumber, packet, true);
+    if (peerFlowControl) {
+        while (sendCredits() <= 0) {
+            sendWindow.close();
+            if (!sendWindow.tryWait() || error != DataChannel::NoError) {
+                return false;
+            }
+        }
+    }
+    // the packets are counted even if the peer has not announced its window yet.
+    ++sentPackets;
+    if (!sendPacketRaw(DataChannelNumber, packet, true)) {
+        if (error == DataChannel::NoError) {
+            --sentPackets;  // rejected, not sent.
+        }
+        return false;
+    }
+    return true;
 }
 
 bool DataChannelPrivate::sendPacketAsync(const QByteArray &packet)
 {
-    return sendPacketRaw(DataChannelNumber, packet, false);
+    if (peerFlowControl && (sendCredits() <= 0 || !deferredPackets.isEmpty())) {
+        // never blocked, the packet is kept until the peer opens its window.
+        if (error != DataChannel::NoError || packet.isEmpty()
+            || static_cast<quint32>(packet.size()) > maxPayloadSize()) {
+            return false;
+        }
+        deferredPackets.enqueue(packet);
+        return true;
+    }
+    ++sentPackets;
+    if (!sendPacketRaw(DataChannelNumber, packet, false)) {
+        --sentPackets;
+        return false;
+    }
+    return true;
+}
+
+void DataChannelPrivate::flushDeferredPackets()
+{
+    while (!deferredPackets.isEmpty() && sendCredits() > 0 && error == DataChannel::NoError) {
+        ++sentPackets;
+        sendPacketRaw(DataChannelNumber, deferredPackets.dequeue(), false);
+    }
+}
+
+void DataChannelPrivate::enableFlowControl()
+{
+    if (flowControl || error != DataChannel::NoError) {
+        return;
+    }
+    flowControl = true;
+    // the packets in the queue and those in flight are all below the limit.
+    announcedPackets = takenPackets;
+    sendPacketRaw(CommandChannelNumber, packWindowUpdateRequest(takenPackets + receivingQueue.capacity()), false);
+}
+
+void DataChannelPrivate::consumePacket()
+{
+    ++takenPackets;
+    if (!flowControl) {
+        return;
+    }
+    if (takenPackets - announcedPackets >= qMax<quint32>(receivingQueue.capacity() / 4, 1)) {
+        announcedPackets = takenPackets;
+        sendPacketRaw(CommandChannelNumber, packWindowUpdateRequest(takenPackets + receivingQueue.capacity()),
+                      false);
+    }
 }
 
 bool DataChannelPrivate::handleCommand(const QByteArray &packet)
@@ -492,6 +1012,9 @@ bool DataChannelPrivate::handleCommand(const QByteArray &packet)
         }
         QSharedPointer<VirtualChannel> channel = makeChannelInternal(DataChannelPole::NegativePole, channelNumber);
         sendPacketRaw(CommandChannelNumber, packChannelMadeRequest(channelNumber), false);
+        if (flowControl) {
+            channel->d_func()->enableFlowControl();
+        }
         pendingChannels.put(channel);
         return true;
     } else if (command == CHANNEL_MADE_REQUEST) {
@@ -538,6 +1061,19 @@ bool DataChannelPrivate::handleCommand(const QByteArray &packet)
         return true;
     } else if (command == KEEPALIVE_REQUEST) {
         return true;
+    } else if (command == WINDOW_UPDATE_REQUEST) {
+        // the limits are increasing, but the update may be stale if the capacity is reduced.
+        const quint32 limit = channelNumber;
+        if (!peerFlowControl || static_cast<qint32>(limit - sendLimit) > 0) {
+            sendLimit = limit;
+        }
+        peerFlowControl = true;
+        flushDeferredPackets();
+        if (sendCredits() > 0) {
+            sendWindow.open();
+        }
+        enableFlowControl();
+        return true;
     } else if (command < 32) {
         // if command < 32, this command must be processed.
         qtng_warning << "unknown command.";
@@ -562,6 +1098,8 @@ SocketChannelPrivate::SocketChannelPrivate(QSharedPointer<SocketLike> connection
     , connection(connection)
     , sendingQueue(256)
     , operations(new CoroutineGroup())
+    , maxBatchSize(DefaultBatchSize)
+    , streamingThreshold(0)
     , _maxPayloadSize(DefaultPacketSize - sizeof(quint32) * 2)
     , _payloadSizeHint(DefaultPayloadSize)  // tcp fragment size.
     , lastActiveTimestamp(QDateTime::currentMSecsSinceEpoch())
@@ -595,7 +1133,9 @@ bool SocketChannelPrivate::sendPacketRaw(quint32 channelNumber, const QByteArray
     }
     if (blocking) {
         QSharedPointer<ValueEvent<bool>> done(new ValueEvent<bool>());
-        sendingQueue.put(WritingPacket(channelNumber, packet, done));
+        if (!sendingQueue.put(WritingPacket(channelNumber, packet, done)) || error != DataChannel::NoError) {
+            return false;
+        }
         bool success = done->tryWait();
         return success;
     } else {
@@ -607,6 +1147,10 @@ bool SocketChannelPrivate::sendPacketRaw(quint32 channelNumber, const QByteArray
 
 void SocketChannelPrivate::doSend()
 {
+    const int HeaderSize = sizeof(quint32) + sizeof(quint32);
+    QVarLengthArray<WritingPacket, MaxSendingBatchPackets> batch;
+    QVarLengthArray<uchar, MaxSendingBatchPackets * HeaderSize> headers;
+    QVarLengthArray<IoVector, MaxSendingBatchPackets * 2> vectors;
     while (true) {
         WritingPacket writingPacket;
         try {
@@ -621,27 +1165,49 @@ void SocketChannelPrivate::doSend()
             Q_ASSERT(error != DataChannel::NoError);
             return;
         }
+
+        // drain the queued packets up to the byte budget, and send them in one vectored write.
+        batch.clear();
+        batch.append(writingPacket);
+        qint64 dataSize = HeaderSize + writingPacket.packet.size();
+        bool exiting = false;
+        while (batch.size() < MaxSendingBatchPackets && dataSize < maxBatchSize && !sendingQueue.isEmpty()) {
+            const WritingPacket &next = sendingQueue.get();
+            if (!next.isValid()) {
+                exiting = true;
+                break;
+            }
+            batch.append(next);
+            dataSize += HeaderSize + next.packet.size();
+        }
+
         if (error != DataChannel::NoError) {
-            if (!writingPacket.done.isNull()) {
-                writingPacket.done->send(false);
+            for (const WritingPacket &packet : batch) {
+                if (!packet.done.isNull()) {
+                    packet.done->send(false);
+                }
             }
             return;
         }
 
-        uchar header[sizeof(quint32) + sizeof(quint32)];
-        qToBigEndian<quint32>(static_cast<quint32>(writingPacket.packet.size()), header);
-        qToBigEndian<quint32>(writingPacket.channelNumber, header + sizeof(quint32));
-        QByteArray data;
-        data.reserve(static_cast<int>(sizeof(header)) + writingPacket.packet.size());
-        data.append(reinterpret_cast<char *>(header), sizeof(header));
-        data.append(writingPacket.packet);
+        headers.resize(batch.size() * HeaderSize);
+        vectors.clear();
+        for (int i = 0; i < batch.size(); ++i) {
+            uchar *header = headers.data() + i * HeaderSize;
+            qToBigEndian<quint32>(static_cast<quint32>(batch[i].packet.size()), header);
+            qToBigEndian<quint32>(batch[i].channelNumber, header + sizeof(quint32));
+            vectors.append(IoVector(reinterpret_cast<char *>(header), HeaderSize));
+            vectors.append(IoVector(batch[i].packet));
+        }
 
         int sentBytes;
         try {
-            sentBytes = connection->sendall(data);
+            sentBytes = connection->sendv(vectors.constData(), vectors.size());
         } catch (CoroutineExitException) {
-            if (!writingPacket.done.isNull()) {
-                writingPacket.done->send(false);
+            for (const WritingPacket &packet : batch) {
+                if (!packet.done.isNull()) {
+                    packet.done->send(false);
+                }
             }
             Q_ASSERT(error != DataChannel::NoError);
             return;
@@ -652,41 +1218,45 @@ void SocketChannelPrivate::doSend()
             return abort(DataChannel::UnknownError);
         }
 
-        if (sentBytes == data.size()) {
-            if (!writingPacket.done.isNull()) {
-                writingPacket.done->send(true);
-            }
-            lastKeepaliveTimestamp = QDateTime::currentMSecsSinceEpoch();
-        } else {
-            if (writingPacket.done.isNull()) {
-                //                continue; // why do this?
-            } else {
-                writingPacket.done->send(false);
+        const bool success = sentBytes == dataSize;
+        for (const WritingPacket &packet : batch) {
+            if (!packet.done.isNull()) {
+                packet.done->send(success);
             }
+        }
+        if (!success) {
             return abort(DataChannel::SendingError);
         }
+        lastKeepaliveTimestamp = QDateTime::currentMSecsSinceEpoch();
+        stats.batches += 1;
+        stats.packets += static_cast<quint64>(batch.size());
+        stats.bytes += static_cast<quint64>(dataSize);
+        int bucket = 0;
+        while ((1 << bucket) < batch.size()) {
+            ++bucket;
+        }
+        stats.batchSizes[bucket] += 1;
+        if (exiting) {
+            Q_ASSERT(error != DataChannel::NoError);
+            return;
+        }
     }
 }
 
 void SocketChannelPrivate::doReceive()
 {
-    const size_t headerSize = sizeof(quint32) + sizeof(quint32);
-    quint32 payloadSize;
-    quint32 channelNumber;
-    QByteArray payload;
+    // frames are parsed from a reused buffer, so one recv() may produce many packets. a QByteArray can not share a
+    // part of another, so each packet is copied out of the buffer once. the frames larger than the buffer are received
+    // into the packet directly.
+    const int headerSize = sizeof(quint32) + sizeof(quint32);
+    QByteArray buf(ReceivingBufferSize, Qt::Uninitialized);
+    int begin = 0;
+    int end = 0;
     while (true) {
-        try {
-            const QByteArray &header = connection->recvall(headerSize);
-            if (header.size() != headerSize) {
-                return abort(DataChannel::ReceivingError);
-            }
-#if QT_VERSION >= QT_VERSION_CHECK(5, 7, 0)
-            payloadSize = qFromBigEndian<quint32>(header.data());
-            channelNumber = qFromBigEndian<quint32>(header.data() + sizeof(quint32));
-#else
-            payloadSize = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(header.data()));
-            channelNumber = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(header.data() + sizeof(quint32)));
-#endif
+        while (end - begin >= headerSize) {
+            const uchar *header = reinterpret_cast<const uchar *>(buf.constData() + begin);
+            const quint32 payloadSize = qFromBigEndian<quint32>(header);
+            const quint32 channelNumber = qFromBigEndian<quint32>(header + sizeof(quint32));
             if (payloadSize > _maxPayloadSize) {
 #ifdef DEBUG_PROTOCOL
                 qtng_debug
@@ -694,25 +1264,127 @@ void SocketChannelPrivate::doReceive()
 #endif
                 return abort(DataChannel::PakcetTooLarge);
             }
-            payload = connection->recvall(static_cast<qint32>(payloadSize));
-            if (payload.size() != static_cast<int>(payloadSize)) {
-                qtng_debug << "invalid packet does not fit packet size:" << payloadSize << payload.size();
-                return abort(DataChannel::InvalidPacket);
+            if (streamingThreshold > 0 && payloadSize > streamingThreshold && channelNumber == DataChannelNumber
+                && pluggedChannel.isNull()) {
+                begin += headerSize;
+                if (!receiveStream(payloadSize, buf, begin, end)) {
+                    return;
+                }
+                if (begin >= end) {
+                    begin = end = 0;
+                }
+                continue;
+            }
+            const qint64 frameSize = headerSize + static_cast<qint64>(payloadSize);
+            if (end - begin < frameSize) {
+                if (frameSize <= buf.size()) {
+                    break;  // wait for the rest of frame.
+                }
+                // the frame is larger than the buffer, receive the payload into the packet directly.
+                QByteArray payload(static_cast<int>(payloadSize), Qt::Uninitialized);
+                const int buffered = end - begin - headerSize;
+                memcpy(payload.data(), buf.constData() + begin + headerSize, static_cast<size_t>(buffered));
+                begin = end = 0;
+                try {
+                    const qint32 left = static_cast<qint32>(payloadSize) - buffered;
+                    if (connection->recvall(payload.data() + buffered, left) != left) {
+                        qtng_debug << "invalid packet does not fit packet size:" << payloadSize;
+                        return abort(DataChannel::InvalidPacket);
+                    }
+                } catch (CoroutineExitException) {
+                    Q_ASSERT(error != DataChannel::NoError);
+                    return;
+                } catch (...) {
+                    return abort(DataChannel::UnknownError);
+                }
+                lastActiveTimestamp = QDateTime::currentMSecsSinceEpoch();
+                DataChannel::ChannelError handlePacketResult = handleIncomingPacket(channelNumber, payload);
+                if (handlePacketResult != DataChannel::NoError) {
+                    return abort(handlePacketResult);
+                }
+                continue;
+            }
+            DataChannel::ChannelError handlePacketResult =
+                    dispatchPacket(channelNumber, buf.constData() + begin + headerSize, payloadSize);
+            if (handlePacketResult != DataChannel::NoError) {
+                return abort(handlePacketResult);
+            }
+            if (error != DataChannel::NoError) {
+                return;
+            }
+            begin += static_cast<int>(frameSize);
+        }
+        if (begin > 0) {
+            if (end > begin) {
+                memmove(buf.data(), buf.constData() + begin, static_cast<size_t>(end - begin));
             }
+            end -= begin;
+            begin = 0;
+        }
+        qint32 len;
+        try {
+            len = connection->recv(buf.data() + end, buf.size() - end);
         } catch (CoroutineExitException) {
             Q_ASSERT(error != DataChannel::NoError);
             return;
         } catch (...) {
             return abort(DataChannel::UnknownError);
         }
-        DataChannel::ChannelError handlePacketResult = handleIncomingPacket(channelNumber, payload);
-        if (handlePacketResult != DataChannel::NoError) {
-            return abort(handlePacketResult);
+        if (len <= 0) {
+            return abort(DataChannel::ReceivingError);
         }
+        end += len;
         lastActiveTimestamp = QDateTime::currentMSecsSinceEpoch();
     }
 }
 
+DataChannel::ChannelError SocketChannelPrivate::dispatchPacket(quint32 channelNumber, const char *payload,
+                                                               quint32 payloadSize)
+{
+    const quint32 subHeaderSize = sizeof(quint32);
+    if (pluggedChannel.isNull() && channelNumber != DataChannelNumber && channelNumber != CommandChannelNumber
+        && payloadSize >= subHeaderSize && subChannels.contains(channelNumber)) {
+        // strip the header of virtual channel here, instead of copying the payload again.
+        const quint32 subChannelNumber = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(payload));
+        const QByteArray packet(payload + subHeaderSize, static_cast<int>(payloadSize - subHeaderSize));
+        return handleSubChannelPacket(channelNumber, subChannelNumber, packet);
+    }
+    return handleIncomingPacket(channelNumber, QByteArray(payload, static_cast<int>(payloadSize)));
+}
+
+bool SocketChannelPrivate::receiveStream(quint32 payloadSize, QByteArray &buf, int &begin, int end)
+{
+    currentStream.reset(new ReceivingPacketStream(payloadSize));
+    enqueuePacket(ReceivingPacket(currentStream));
+    qint64 left = payloadSize;
+    const int buffered = static_cast<int>(qMin<qint64>(end - begin, left));
+    try {
+        if (buffered > 0) {
+            currentStream->feed(QByteArray(buf.constData() + begin, buffered));
+            begin += buffered;
+            left -= buffered;
+        }
+        while (left > 0) {
+            const QByteArray &chunk = connection->recv(static_cast<qint32>(qMin<qint64>(left, ReceivingBufferSize)));
+            if (chunk.isEmpty()) {
+                abort(DataChannel::ReceivingError);
+                return false;
+            }
+            left -= chunk.size();
+            lastActiveTimestamp = QDateTime::currentMSecsSinceEpoch();
+            currentStream->feed(chunk);  // the rest of packet is discarded if the stream is closed or dropped.
+        }
+    } catch (CoroutineExitException) {
+        Q_ASSERT(error != DataChannel::NoError);
+        return false;
+    } catch (...) {
+        abort(DataChannel::UnknownError);
+        return false;
+    }
+    currentStream.clear();
+    return true;
+}
+
 void SocketChannelPrivate::doKeepalive()
 {
     while (true) {
@@ -751,13 +1423,17 @@ void SocketChannelPrivate::abort(DataChannel::ChannelError reason)
 #endif
     Coroutine *current = Coroutine::current();
     connection->abort();
+    if (!currentStream.isNull()) {
+        currentStream->abort();
+        currentStream.clear();
+    }
 
-    while (!sendingQueue.isEmpty()) {
-        const WritingPacket &writingPacket = sendingQueue.get();
+    for (const WritingPacket &writingPacket : sendingQueue.takeAll()) {
         if (!writingPacket.done.isNull()) {
             writingPacket.done->send(false);
         }
     }
+    sendingQueue.close();
     if (operations->get(QString::fromLatin1("receiving")).data() != current) {
         operations->kill(QString::fromLatin1("receiving"));
     }
@@ -790,25 +1466,17 @@ void SocketChannelPrivate::cleanChannel(quint32 channelNumber, bool sendDestroyP
         notifyChannelClose(channelNumber);
     }
     cleanSendingPacket(channelNumber, alwayTrue);
+    sendingQueue.removeChannel(channelNumber);
 }
 
 void SocketChannelPrivate::cleanSendingPacket(quint32 subChannelNumber,
                                               std::function<bool(const QByteArray &)> subCheckPacket)
 {
-    QList<WritingPacket> reserved;
-    while (!sendingQueue.isEmpty()) {
-        const WritingPacket &writingPacket = sendingQueue.get();
-        if (writingPacket.channelNumber == subChannelNumber && subCheckPacket(writingPacket.packet)) {
-            if (!writingPacket.done.isNull()) {
-                writingPacket.done.data()->send(false);
-            }
-        } else {
-            reserved.append(writingPacket);
+    for (const WritingPacket &writingPacket : sendingQueue.take(subChannelNumber, subCheckPacket)) {
+        if (!writingPacket.done.isNull()) {
+            writingPacket.done.data()->send(false);
         }
     }
-    for (const WritingPacket &writingPacket : reserved) {
-        sendingQueue.putForcedly(writingPacket);
-    }
 }
 
 quint32 SocketChannelPrivate::maxPayloadSize() const
@@ -831,6 +1499,20 @@ QSharedPointer<SocketLike> SocketChannelPrivate::getBackend() const
     return connection;
 }
 
+bool SocketChannelPrivate::setSendingWeight(quint32 channelNumber, quint32 weight)
+{
+    if (channelNumber == CommandChannelNumber) {
+        return false;
+    }
+    sendingQueue.setWeight(channelNumber, weight);
+    return true;
+}
+
+quint32 SocketChannelPrivate::sendingWeight(quint32 channelNumber) const
+{
+    return sendingQueue.weight(channelNumber);
+}
+
 VirtualChannelPrivate::VirtualChannelPrivate(DataChannel *parentChannel, DataChannelPole pole, quint32 channelNumber,
                                              VirtualChannel *parent)
     : DataChannelPrivate(pole, parent)
@@ -950,6 +1632,23 @@ quint32 VirtualChannelPrivate::headerSize() const
     return sizeof(quint32);
 }
 
+bool VirtualChannelPrivate::setSendingWeight(quint32 channelNumber, quint32 weight)
+{
+    // the sub channels share the sending queue of this channel.
+    if (channelNumber != DataChannelNumber || error != DataChannel::NoError || parentChannel.isNull()) {
+        return false;
+    }
+    return getPrivateHelper(parentChannel)->setSendingWeight(this->channelNumber, weight);
+}
+
+quint32 VirtualChannelPrivate::sendingWeight(quint32 channelNumber) const
+{
+    if (channelNumber != DataChannelNumber || error != DataChannel::NoError || parentChannel.isNull()) {
+        return 1;
+    }
+    return getPrivateHelper(parentChannel)->sendingWeight(this->channelNumber);
+}
+
 QSharedPointer<SocketLike> VirtualChannelPrivate::getBackend() const
 {
     if (error != DataChannel::NoError || parentChannel.isNull()) {
@@ -1043,6 +1742,36 @@ quint32 SocketChannel::sendingQueueSize() const
     return d->sendingQueue.size();
 }
 
+void SocketChannel::setMaxBatchSize(quint32 size)
+{
+    Q_D(SocketChannel);
+    d->maxBatchSize = size == 0 ? DefaultBatchSize : size;
+}
+
+quint32 SocketChannel::maxBatchSize() const
+{
+    Q_D(const SocketChannel);
+    return static_cast<quint32>(d->maxBatchSize);
+}
+
+void SocketChannel::setStreamingThreshold(quint32 size)
+{
+    Q_D(SocketChannel);
+    d->streamingThreshold = size;
+}
+
+quint32 SocketChannel::streamingThreshold() const
+{
+    Q_D(const SocketChannel);
+    return d->streamingThreshold;
+}
+
+SocketChannelStats SocketChannel::stats() const
+{
+    Q_D(const SocketChannel);
+    return d->stats;
+}
+
 QSharedPointer<SocketLike> SocketChannel::connection() const
 {
     Q_D(const SocketChannel);
@@ -1094,6 +1823,12 @@ QByteArray DataChannel::recvPacket()
     return d->recvPacket();
 }
 
+QSharedPointer<FileLike> DataChannel::recvPacketStream()
+{
+    Q_D(DataChannel);
+    return d->recvPacketStream();
+}
+
 void DataChannel::abort()
 {
     Q_D(DataChannel);
@@ -1191,6 +1926,30 @@ void DataChannel::setCapacity(quint32 capacity)
     //    }
 }
 
+bool DataChannel::setSendingWeight(quint32 weight)
+{
+    Q_D(DataChannel);
+    return d->setSendingWeight(DataChannelNumber, weight);
+}
+
+quint32 DataChannel::sendingWeight() const
+{
+    Q_D(const DataChannel);
+    return d->sendingWeight(DataChannelNumber);
+}
+
+void DataChannel::enableFlowControl()
+{
+    Q_D(DataChannel);
+    d->enableFlowControl();
+}
+
+bool DataChannel::isFlowControlEnabled() const
+{
+    Q_D(const DataChannel);
+    return d->flowControl && d->peerFlowControl;
+}
+
 quint32 DataChannel::capacity() const
 {
     Q_D(const DataChannel);
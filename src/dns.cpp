@@ -0,0 +1,622 @@
+#include <QtCore/qfile.h>
+#include <QtCore/qmap.h>
+#include <QtCore/qurl.h>
+#include <QtCore/qrandom.h>
+#include "../include/dns.h"
+#include "../include/socket.h"
+#include "../include/coroutine_utils.h"
+#include "debugger.h"
+
+QTNG_LOGGER("qtng.dns");
+
+QTNETWORKNG_NAMESPACE_BEGIN
+
+// see RFC 1035
+const int DnsHeaderSize = 12;
+const int DnsMaxUdpSize = 4096;
+const int DnsMaxCnameHops = 8;
+const quint16 DnsTypeA = 1;
+const quint16 DnsTypeCname = 5;
+const quint16 DnsTypeAAAA = 28;
+const quint16 DnsClassIN = 1;
+const int DnsNoError = 0;
+const int DnsNameError = 3;  // NXDOMAIN
+
+struct DnsRecord
+{
+    QByteArray name;
+    QByteArray data;  // the target name of CNAME, or the raw address.
+    quint32 ttl;
+    quint16 type;
+};
+
+struct DnsResponse
+{
+    QList<DnsRecord> answers;
+    int rcode;
+};
+
+static inline quint16 unpackUInt16(const char *p)
+{
+    const uchar *u = reinterpret_cast<const uchar *>(p);
+    return static_cast<quint16>((u[0] << 8) | u[1]);
+}
+
+static inline quint32 unpackUInt32(const char *p)
+{
+    const uchar *u = reinterpret_cast<const uchar *>(p);
+    return (static_cast<quint32>(u[0]) << 24) | (static_cast<quint32>(u[1]) << 16)
+            | (static_cast<quint32>(u[2]) << 8) | u[3];
+}
+
+static inline void packUInt16(QByteArray &packet, quint16 value)
+{
+    packet.append(static_cast<char>(value >> 8));
+    packet.append(static_cast<char>(value & 0xff));
+}
+
+static QByteArray makeQuery(quint16 id, const QByteArray &name, quint16 type)
+{
+    QByteArray packet;
+    packet.reserve(DnsHeaderSize + name.size() + 6);
+    packUInt16(packet, id);
+    packUInt16(packet, 0x0100);  // RD
+    packUInt16(packet, 1);  // QDCOUNT
+    packUInt16(packet, 0);
+    packUInt16(packet, 0);
+    packUInt16(packet, 0);
+    for (const QByteArray &label : name.split('.')) {
+        if (label.isEmpty() || label.size() > 63) {
+            return QByteArray();
+        }
+        packet.append(static_cast<char>(label.size()));
+        packet.append(label);
+    }
+    packet.append('\0');
+    packUInt16(packet, type);
+    packUInt16(packet, DnsClassIN);
+    return packet;
+}
+
+// read a (possibly compressed) name at `offset`, and move `offset` to the end of the name.
+static bool readName(const QByteArray &packet, int *offset, QByteArray *name)
+{
+    const int size = packet.size();
+    const uchar *p = reinterpret_cast<const uchar *>(packet.constData());
+    int pos = *offset;
+    int jumps = 0;
+    bool jumped = false;
+    name->clear();
+    while (true) {
+        if (pos >= size) {
+            return false;
+        }
+        const quint8 len = p[pos];
+        if ((len & 0xc0) == 0xc0) {
+            if (pos + 1 >= size || ++jumps > DnsMaxCnameHops * 2) {
+                return false;
+            }
+            if (!jumped) {
+                *offset = pos + 2;
+                jumped = true;
+            }
+            pos = ((len & 0x3f) << 8) | p[pos + 1];
+        } else if (len & 0xc0) {
+            return false;
+        } else if (len == 0) {
+            if (!jumped) {
+                *offset = pos + 1;
+            }
+            *name = name->toLower();
+            return true;
+        } else {
+            if (pos + 1 + len > size) {
+                return false;
+            }
+            if (!name->isEmpty()) {
+                name->append('.');
+            }
+            name->append(reinterpret_cast<const char *>(p + pos + 1), len);
+            if (name->size() > 255) {
+                return false;
+            }
+            pos += 1 + len;
+        }
+    }
+}
+
+static bool parseResponse(const QByteArray &packet, quint16 id, const QByteArray &name, quint16 type,
+                          DnsResponse *response)
+{
+    if (packet.size() < DnsHeaderSize || unpackUInt16(packet.constData()) != id) {
+        return false;
+    }
+    const char *p = packet.constData();
+    const quint16 flags = unpackUInt16(p + 2);
+    if (!(flags & 0x8000)) {  // QR
+        return false;
+    }
+    response->rcode = flags & 0x000f;
+    if (unpackUInt16(p + 4) != 1) {
+        return false;
+    }
+    const int answerCount = unpackUInt16(p + 6);
+
+    // the question must be echoed back, or it is a response to another query.
+    int offset = DnsHeaderSize;
+    QByteArray questionName;
+    if (!readName(packet, &offset, &questionName) || offset + 4 > packet.size()) {
+        return false;
+    }
+    if (questionName != name.toLower() || unpackUInt16(p + offset) != type
+        || unpackUInt16(p + offset + 2) != DnsClassIN) {
+        return false;
+    }
+    offset += 4;
+
+    for (int i = 0; i < answerCount; ++i) {
+        DnsRecord record;
+        if (!readName(packet, &offset, &record.name) || offset + 10 > packet.size()) {
+            return false;
+        }
+        record.type = unpackUInt16(p + offset);
+        const quint16 klass = unpackUInt16(p + offset + 2);
+        record.ttl = unpackUInt32(p + offset + 4);
+        if (record.ttl > 0x7fffffff) {  // RFC 2181, section 8
+            record.ttl = 0;
+        }
+        const int rdlength = unpackUInt16(p + offset + 8);
+        offset += 10;
+        if (offset + rdlength > packet.size()) {
+            return false;
+        }
+        if (klass == DnsClassIN) {
+            if (record.type == DnsTypeCname) {
+                int rdataOffset = offset;
+                if (!readName(packet, &rdataOffset, &record.data)) {
+                    return false;
+                }
+                response->answers.append(record);
+            } else if (record.type == type) {
+                record.data = packet.mid(offset, rdlength);
+                response->answers.append(record);
+            }
+        }
+        offset += rdlength;
+    }
+    return true;
+}
+
+// follow the CNAME chain from `name`, and collect the addresses of the final name.
+static void collectAddresses(const DnsResponse &response, const QByteArray &name, quint16 type,
+                             QList<HostAddress> *addresses, quint32 *ttl)
+{
+    QByteArray target = name.toLower();
+    quint32 minTtl = 0xffffffff;
+    for (int hops = 0; hops < DnsMaxCnameHops; ++hops) {
+        bool found = false;
+        for (const DnsRecord &record : response.answers) {
+            if (record.type == DnsTypeCname && record.name == target) {
+                target = record.data;
+                minTtl = qMin(minTtl, record.ttl);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            break;
+        }
+    }
+    for (const DnsRecord &record : response.answers) {
+        if (record.type != type || record.name != target) {
+            continue;
+        }
+        if (type == DnsTypeA && record.data.size() == 4) {
+            addresses->append(HostAddress(unpackUInt32(record.data.constData())));
+        } else if (type == DnsTypeAAAA && record.data.size() == 16) {
+            addresses->append(HostAddress(reinterpret_cast<const quint8 *>(record.data.constData())));
+        } else {
+            continue;
+        }
+        minTtl = qMin(minTtl, record.ttl);
+    }
+    if (ttl && !addresses->isEmpty()) {
+        *ttl = minTtl;
+    }
+}
+
+static QList<HostAddress> filterAddresses(const QList<HostAddress> &addresses, int allowProtocol)
+{
+    QList<HostAddress> result;
+    for (const HostAddress &addr : addresses) {
+        if (addr.protocol() & allowProtocol) {
+            result.append(addr);
+        }
+    }
+    return result;
+}
+
+class DnsResolverPrivate
+{
+public:
+    DnsResolverPrivate()
+        : ndots(1)
+        , timeout(5.0)
+        , attempts(2)
+    {
+    }
+    QStringList candidateNames(const QString &hostName) const;
+    QByteArray exchange(const QPair<HostAddress, quint16> &server, const QByteArray &request, quint16 id);
+    static quint16 nextId();
+public:
+    QList<QPair<HostAddress, quint16>> nameServers;
+    QStringList searchDomains;
+    QMap<QString, QList<HostAddress>> hosts;
+    int ndots;
+    float timeout;
+    int attempts;
+};
+
+quint16 DnsResolverPrivate::nextId()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    return static_cast<quint16>(QRandomGenerator::global()->bounded(0x10000));
+#else
+    return static_cast<quint16>(qrand() & 0xffff);
+#endif
+}
+
+// the same rules as the glibc resolver: names with enough dots are tried as is before the search domains.
+QStringList DnsResolverPrivate::candidateNames(const QString &hostName) const
+{
+    QStringList names;
+    if (hostName.endsWith(QLatin1Char('.'))) {
+        names.append(hostName.left(hostName.size() - 1));
+        return names;
+    }
+    const bool absoluteFirst = hostName.count(QLatin1Char('.')) >= ndots;
+    if (absoluteFirst) {
+        names.append(hostName);
+    }
+    for (const QString &domain : searchDomains) {
+        names.append(hostName + QLatin1Char('.') + domain);
+    }
+    if (!absoluteFirst) {
+        names.append(hostName);
+    }
+    return names;
+}
+
+QByteArray DnsResolverPrivate::exchange(const QPair<HostAddress, quint16> &server, const QByteArray &request,
+                                        quint16 id)
+{
+    const HostAddress::NetworkLayerProtocol protocol =
+            server.first.isIPv4() ? HostAddress::IPv4Protocol : HostAddress::IPv6Protocol;
+    QByteArray response;
+    try {
+        Timeout timeout(this->timeout);
+        Socket socket(protocol, Socket::UdpSocket);
+        if (socket.sendto(request, server.first, server.second) != request.size()) {
+            return QByteArray();
+        }
+        while (true) {
+            HostAddress addr;
+            quint16 port = 0;
+            response = socket.recvfrom(DnsMaxUdpSize, &addr, &port);
+            if (response.isEmpty()) {
+                return QByteArray();
+            }
+            // drop the spoofed packets and the late responses of former queries.
+            if (port == server.second && addr.isEqual(server.first) && response.size() >= DnsHeaderSize
+                && unpackUInt16(response.constData()) == id) {
+                break;
+            }
+        }
+    } catch (TimeoutException &) {
+        return QByteArray();
+    }
+
+    if (!(response.at(2) & 0x02)) {  // TC
+        return response;
+    }
+
+    // the response is truncated, retry over tcp.
+    try {
+        Timeout timeout(this->timeout);
+        Socket socket(protocol, Socket::TcpSocket);
+        if (!socket.connect(server.first, server.second)) {
+            return QByteArray();
+        }
+        QByteArray packet;
+        packUInt16(packet, static_cast<quint16>(request.size()));
+        packet.append(request);
+        if (socket.sendall(packet) != packet.size()) {
+            return QByteArray();
+        }
+        const QByteArray header = socket.recvall(2);
+        if (header.size() != 2) {
+            return QByteArray();
+        }
+        const int len = unpackUInt16(header.constData());
+        response = socket.recvall(len);
+        if (response.size() != len || len < DnsHeaderSize) {
+            return QByteArray();
+        }
+        return response;
+    } catch (TimeoutException &) {
+        return QByteArray();
+    }
+}
+
+DnsResolver::DnsResolver(bool loadSystemConfig)
+    : d_ptr(new DnsResolverPrivate())
+{
+#ifndef Q_OS_WIN
+    if (loadSystemConfig) {
+        loadResolvConf();
+        loadHosts();
+    }
+#else
+    Q_UNUSED(loadSystemConfig);
+#endif
+}
+
+DnsResolver::~DnsResolver()
+{
+    delete d_ptr;
+}
+
+QList<HostAddress> DnsResolver::resolve(const QString &hostName, int allowProtocol, quint32 *ttl)
+{
+    Q_D(DnsResolver);
+    HostAddress tmp;
+    if (tmp.setAddress(hostName)) {
+        QList<HostAddress> result;
+        result.append(tmp);
+        return filterAddresses(result, allowProtocol);
+    }
+
+    QString key = hostName.toLower();
+    if (key.endsWith(QLatin1Char('.'))) {
+        key.chop(1);
+    }
+    if (d->hosts.contains(key)) {
+        const QList<HostAddress> &result = filterAddresses(d->hosts.value(key), allowProtocol);
+        if (!result.isEmpty()) {
+            return result;
+        }
+    }
+
+    if (d->nameServers.isEmpty()) {
+        return filterAddresses(Socket::resolve(hostName), allowProtocol);
+    }
+
+    for (const QString &name : d->candidateNames(hostName)) {
+        QList<HostAddress> ipv4, ipv6;
+        quint32 ttl4 = 0xffffffff, ttl6 = 0xffffffff;
+        CoroutineGroup operations;
+        if (allowProtocol & HostAddress::IPv6Protocol) {
+            operations.spawn([this, name, &ipv6, &ttl6] { query(name, HostAddress::IPv6Protocol, &ipv6, &ttl6); });
+        }
+        if (allowProtocol & HostAddress::IPv4Protocol) {
+            query(name, HostAddress::IPv4Protocol, &ipv4, &ttl4);
+        }
+        operations.joinall();
+        if (!ipv6.isEmpty() || !ipv4.isEmpty()) {
+            if (ttl) {
+                *ttl = qMin(ttl4, ttl6);
+            }
+            return ipv6 + ipv4;
+        }
+    }
+    return QList<HostAddress>();
+}
+
+bool DnsResolver::query(const QString &fullName, HostAddress::NetworkLayerProtocol protocol,
+                        QList<HostAddress> *addresses, quint32 *ttl)
+{
+    Q_D(DnsResolver);
+    QByteArray name = QUrl::toAce(fullName);
+    if (name.endsWith('.')) {
+        name.chop(1);
+    }
+    if (name.isEmpty() || name.size() > 253) {
+        return false;
+    }
+    const quint16 type = protocol == HostAddress::IPv6Protocol ? DnsTypeAAAA : DnsTypeA;
+    // copy the list, it may be changed while we are waiting for responses.
+    const QList<QPair<HostAddress, quint16>> nameServers = d->nameServers;
+    for (int attempt = 0; attempt < d->attempts; ++attempt) {
+        for (const QPair<HostAddress, quint16> &server : nameServers) {
+            const quint16 id = DnsResolverPrivate::nextId();
+            const QByteArray &request = makeQuery(id, name, type);
+            if (request.isEmpty()) {
+                return false;
+            }
+            const QByteArray &packet = d->exchange(server, request, id);
+            if (packet.isEmpty()) {
+                continue;
+            }
+            DnsResponse response;
+            if (!parseResponse(packet, id, name, type, &response)) {
+                qtng_debug << "got invalid dns response from" << server.first;
+                continue;
+            }
+            if (response.rcode == DnsNameError) {
+                return false;
+            }
+            if (response.rcode != DnsNoError) {  // SERVFAIL, REFUSED, ... try next server.
+                continue;
+            }
+            collectAddresses(response, name, type, addresses, ttl);
+            return true;
+        }
+    }
+    return false;
+}
+
+QList<QPair<HostAddress, quint16>> DnsResolver::nameServers() const
+{
+    Q_D(const DnsResolver);
+    return d->nameServers;
+}
+
+void DnsResolver::setNameServers(const QList<QPair<HostAddress, quint16>> &nameServers)
+{
+    Q_D(DnsResolver);
+    d->nameServers = nameServers;
+}
+
+void DnsResolver::addNameServer(const HostAddress &addr, quint16 port)
+{
+    Q_D(DnsResolver);
+    d->nameServers.append(qMakePair(addr, port));
+}
+
+QStringList DnsResolver::searchDomains() const
+{
+    Q_D(const DnsResolver);
+    return d->searchDomains;
+}
+
+void DnsResolver::setSearchDomains(const QStringList &searchDomains)
+{
+    Q_D(DnsResolver);
+    d->searchDomains = searchDomains;
+}
+
+int DnsResolver::ndots() const
+{
+    Q_D(const DnsResolver);
+    return d->ndots;
+}
+
+void DnsResolver::setNdots(int ndots)
+{
+    Q_D(DnsResolver);
+    d->ndots = qMax(0, ndots);
+}
+
+float DnsResolver::timeout() const
+{
+    Q_D(const DnsResolver);
+    return d->timeout;
+}
+
+void DnsResolver::setTimeout(float secs)
+{
+    Q_D(DnsResolver);
+    d->timeout = secs;
+}
+
+int DnsResolver::attempts() const
+{
+    Q_D(const DnsResolver);
+    return d->attempts;
+}
+
+void DnsResolver::setAttempts(int attempts)
+{
+    Q_D(DnsResolver);
+    d->attempts = qMax(1, attempts);
+}
+
+void DnsResolver::addHost(const QString &hostName, const HostAddress &addr)
+{
+    Q_D(DnsResolver);
+    QList<HostAddress> &addresses = d->hosts[hostName.toLower()];
+    if (!addresses.contains(addr)) {
+        addresses.append(addr);
+    }
+}
+
+bool DnsResolver::loadResolvConf(const QString &filePath)
+{
+    Q_D(DnsResolver);
+    QFile f(filePath);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QList<QPair<HostAddress, quint16>> nameServers;
+    QStringList searchDomains;
+    while (!f.atEnd()) {
+        QByteArray line = f.readLine();
+        int comment = line.indexOf('#');
+        if (comment < 0) {
+            comment = line.indexOf(';');
+        }
+        if (comment >= 0) {
+            line.truncate(comment);
+        }
+        const QList<QByteArray> &parts = line.simplified().split(' ');
+        if (parts.size() < 2) {
+            continue;
+        }
+        const QByteArray &keyword = parts.at(0);
+        if (keyword == "nameserver") {
+            HostAddress addr;
+            if (addr.setAddress(QString::fromLatin1(parts.at(1)))) {
+                nameServers.append(qMakePair(addr, static_cast<quint16>(53)));
+            }
+        } else if (keyword == "domain" || keyword == "search") {
+            // the last one wins.
+            searchDomains.clear();
+            for (int i = 1; i < parts.size(); ++i) {
+                searchDomains.append(QString::fromLatin1(parts.at(i)));
+            }
+        } else if (keyword == "options") {
+            for (int i = 1; i < parts.size(); ++i) {
+                const QByteArray &option = parts.at(i);
+                bool ok;
+                if (option.startsWith("ndots:")) {
+                    int n = option.mid(6).toInt(&ok);
+                    if (ok) {
+                        d->ndots = qBound(0, n, 15);
+                    }
+                } else if (option.startsWith("timeout:")) {
+                    int n = option.mid(8).toInt(&ok);
+                    if (ok) {
+                        d->timeout = qBound(1, n, 30);
+                    }
+                } else if (option.startsWith("attempts:")) {
+                    int n = option.mid(9).toInt(&ok);
+                    if (ok) {
+                        d->attempts = qBound(1, n, 5);
+                    }
+                }
+            }
+        }
+    }
+    d->nameServers = nameServers;
+    d->searchDomains = searchDomains;
+    return true;
+}
+
+bool DnsResolver::loadHosts(const QString &filePath)
+{
+    QFile f(filePath);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    while (!f.atEnd()) {
+        QByteArray line = f.readLine();
+        int comment = line.indexOf('#');
+        if (comment >= 0) {
+            line.truncate(comment);
+        }
+        const QList<QByteArray> &parts = line.simplified().split(' ');
+        if (parts.size() < 2) {
+            continue;
+        }
+        HostAddress addr;
+        if (!addr.setAddress(QString::fromLatin1(parts.at(0)))) {
+            continue;
+        }
+        for (int i = 1; i < parts.size(); ++i) {
+            addHost(QString::fromLatin1(parts.at(i)), addr);
+        }
+    }
+    return true;
+}
+
+QTNETWORKNG_NAMESPACE_END
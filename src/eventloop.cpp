@@ -12,6 +12,7 @@ QTNETWORKNG_NAMESPACE_BEGIN
 
 Q_GLOBAL_STATIC(CurrentLoopStorage, currentLoopStorage)
 Q_GLOBAL_STATIC(QAtomicInteger<int>, preferLibevFlag);
+Q_GLOBAL_STATIC(QAtomicInteger<int>, preferIoUringFlag);
 
 CurrentLoopStorage *currentLoop()
 {
@@ -51,6 +52,11 @@ void Coroutine::preferLibev()
     preferLibevFlag->storeRelease(true);
 }
 
+void Coroutine::preferIoUring()
+{
+    preferIoUringFlag->storeRelease(true);
+}
+
 Functor::~Functor() { }
 
 bool DoNothingFunctor::operator()()
@@ -84,6 +90,11 @@ EventLoopCoroutinePrivate::EventLoopCoroutinePrivate(EventLoopCoroutine *q)
 
 EventLoopCoroutinePrivate::~EventLoopCoroutinePrivate() { }
 
+bool EventLoopCoroutinePrivate::doIo(EventLoopCoroutine::IoOperation, qintptr, char *, qint32, int, qint32 *)
+{
+    return false;
+}
+
 EventLoopCoroutine::EventLoopCoroutine(EventLoopCoroutinePrivate *d, size_t stackSize)
     : BaseCoroutine(BaseCoroutine::current(), stackSize)
     , dd_ptr(d)
@@ -136,6 +147,12 @@ void EventLoopCoroutine::triggerIoWatchers(qintptr fd)
     return d->triggerIoWatchers(fd);
 }
 
+bool EventLoopCoroutine::doIo(IoOperation operation, qintptr fd, char *data, qint32 size, int flags, qint32 *result)
+{
+    Q_D(EventLoopCoroutine);
+    return d->doIo(operation, fd, data, size, flags, result);
+}
+
 int EventLoopCoroutine::callLater(quint32 msecs, Functor *callback)
 {
     Q_D(EventLoopCoroutine);
@@ -189,6 +206,14 @@ QSharedPointer<EventLoopCoroutine> CurrentLoopStorage::getOrCreate()
         eventLoop = storage.localData();
     }
     if (eventLoop.isNull()) {
+#ifdef QTNETWORKNG_USE_IO_URING
+        if (preferIoUringFlag->loadAcquire() && IoUringEventLoopCoroutine::isSupported()) {
+            eventLoop.reset(new IoUringEventLoopCoroutine());
+            eventLoop->setObjectName(QString::fromLatin1("io_uring_eventloop_coroutine"));
+            storage.setLocalData(eventLoop);
+            return eventLoop;
+        }
+#endif
 #ifdef QTNETWOKRNG_USE_EV
         if (preferLibevFlag->loadAcquire()) {
             eventLoop.reset(new EvEventLoopCoroutine());
@@ -0,0 +1,857 @@
+#include <QtCore/qmap.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qqueue.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qscopedpointer.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qvarlengtharray.h>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "../include/private/eventloop_p.h"
+#include "debugger.h"
+
+QTNG_LOGGER("qtng.eventloop_uring");
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+
+QTNETWORKNG_NAMESPACE_BEGIN
+
+namespace {
+
+const unsigned RingEntries = 256;
+// the user_data of completions. the io watchers use (generation << 32 | watcherId), watcherId starts from 1. the io
+// requests use watcherId only.
+const quint64 WakeupUserData = 0;
+const quint64 IgnoredUserData = Q_UINT64_C(0xffffffffffffffff);
+
+inline int sys_io_uring_setup(unsigned entries, struct io_uring_params *params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+inline int sys_io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, const void *arg,
+                              size_t argSize)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+}
+
+// a minimal io_uring without liburing. there is no SQPOLL, so the kernel reads the submission queue only in
+// io_uring_enter(), and the sqe can be filled after it is published.
+struct IoUring
+{
+    IoUring();
+    ~IoUring();
+    bool setup(unsigned entries);
+    struct io_uring_sqe *getSqe();
+    int enter(qint64 timeoutMsecs);  // timeoutMsecs < 0 waits forever.
+    template<typename Container>
+    void reap(Container &completions);
+public:
+    void *sqRing;
+    size_t sqRingSize;
+    void *cqRing;
+    size_t cqRingSize;
+    struct io_uring_sqe *sqes;
+    size_t sqesSize;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqArray;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned sqeTail;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    struct io_uring_cqe *cqes;
+    unsigned cqMask;
+    unsigned features;
+    int fd;
+};
+
+IoUring::IoUring()
+    : sqRing(nullptr)
+    , sqRingSize(0)
+    , cqRing(nullptr)
+    , cqRingSize(0)
+    , sqes(nullptr)
+    , sqesSize(0)
+    , sqHead(nullptr)
+    , sqTail(nullptr)
+    , sqArray(nullptr)
+    , sqMask(0)
+    , sqEntries(0)
+    , sqeTail(0)
+    , cqHead(nullptr)
+    , cqTail(nullptr)
+    , cqes(nullptr)
+    , cqMask(0)
+    , features(0)
+    , fd(-1)
+{
+}
+
+IoUring::~IoUring()
+{
+    if (sqes) {
+        munmap(sqes, sqesSize);
+    }
+    if (cqRing && cqRing != sqRing) {
+        munmap(cqRing, cqRingSize);
+    }
+    if (sqRing) {
+        munmap(sqRing, sqRingSize);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+bool IoUring::setup(unsigned entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    // the poll requests of idle sockets stay in the ring, make the completion queue bigger than submission queue.
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+    fd = sys_io_uring_setup(entries, &params);
+    if (fd < 0) {
+        return false;
+    }
+    features = params.features;
+    // IORING_ENTER_EXT_ARG is used for the timeout of io_uring_enter(), which is available since linux 5.11
+    if (!(features & IORING_FEAT_EXT_ARG) || !(features & IORING_FEAT_NODROP)) {
+        return false;
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (features & IORING_FEAT_SINGLE_MMAP) {
+        sqRingSize = cqRingSize = qMax(sqRingSize, cqRingSize);
+    }
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        sqRing = nullptr;
+        return false;
+    }
+    if (features & IORING_FEAT_SINGLE_MMAP) {
+        cqRing = sqRing;
+    } else {
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            cqRing = nullptr;
+            return false;
+        }
+    }
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *p = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    sqes = static_cast<struct io_uring_sqe *>(p);
+
+    char *sq = static_cast<char *>(sqRing);
+    sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqEntries = params.sq_entries;
+    sqeTail = *sqTail;
+
+    char *cq = static_cast<char *>(cqRing);
+    cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+    return true;
+}
+
+struct io_uring_sqe *IoUring::getSqe()
+{
+    if (sqeTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+        // the submission queue is full, submit them without waiting.
+        int rt;
+        do {
+            rt = sys_io_uring_enter(fd, sqeTail - *sqHead, 0, 0, nullptr, 0);
+        } while (rt < 0 && errno == EINTR);
+        if (sqeTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+            return nullptr;
+        }
+    }
+    const unsigned index = sqeTail & sqMask;
+    struct io_uring_sqe *sqe = &sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqArray[index] = index;
+    ++sqeTail;
+    __atomic_store_n(sqTail, sqeTail, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+int IoUring::enter(qint64 timeoutMsecs)
+{
+    const unsigned toSubmit = sqeTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    unsigned flags = IORING_ENTER_GETEVENTS;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    const void *argp = nullptr;
+    size_t argSize = 0;
+    if (timeoutMsecs >= 0) {
+        ts.tv_sec = timeoutMsecs / 1000;
+        ts.tv_nsec = (timeoutMsecs % 1000) * 1000000;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = reinterpret_cast<quint64>(&ts);
+        flags |= IORING_ENTER_EXT_ARG;
+        argp = &arg;
+        argSize = sizeof(arg);
+    }
+    // the completions are reaped without any syscall if they are ready already.
+    if (toSubmit == 0 && __atomic_load_n(cqTail, __ATOMIC_ACQUIRE) != *cqHead) {
+        return 0;
+    }
+    int rt = sys_io_uring_enter(fd, toSubmit, 1, flags, argp, argSize);
+    if (rt < 0 && (errno == ETIME || errno == EINTR || errno == EBUSY)) {
+        return 0;
+    }
+    return rt;
+}
+
+template<typename Container>
+void IoUring::reap(Container &completions)
+{
+    unsigned head = *cqHead;
+    const unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        const struct io_uring_cqe &cqe = cqes[head & cqMask];
+        completions.append(qMakePair(static_cast<quint64>(cqe.user_data), static_cast<qint32>(cqe.res)));
+        ++head;
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+}
+
+struct UringWatcher
+{
+    virtual ~UringWatcher();
+};
+
+struct IoWatcher : public UringWatcher
+{
+    IoWatcher(EventLoopCoroutine::EventType event, qintptr fd, Functor *callback);
+    virtual ~IoWatcher() override;
+
+    Functor *callback;
+    qintptr fd;
+    quint32 pollMask;
+    quint32 generation;
+    int watcherId;
+    bool active;
+    bool armed;
+};
+
+// a recv/send/accept request in the ring, the coroutine waits for its completion.
+struct CompletionWatcher : public UringWatcher
+{
+    CompletionWatcher(qintptr fd);
+
+    QPointer<BaseCoroutine> coroutine;
+    qintptr fd;
+    int watcherId;
+    qint32 result;
+    bool done;
+    bool cancelled;
+};
+
+struct TimerWatcher : public UringWatcher
+{
+    TimerWatcher(quint32 interval, bool repeat, Functor *callback);
+    virtual ~TimerWatcher() override;
+
+    Functor *callback;
+    qint64 deadline;
+    quint32 interval;
+    bool repeat;
+};
+
+UringWatcher::~UringWatcher() { }
+
+IoWatcher::IoWatcher(EventLoopCoroutine::EventType event, qintptr fd, Functor *callback)
+    : callback(callback)
+    , fd(fd)
+    , pollMask(0)
+    , generation(0)
+    , watcherId(0)
+    , active(false)
+    , armed(false)
+{
+    if (event & EventLoopCoroutine::EventType::Read) {
+        pollMask |= POLLIN;
+    }
+    if (event & EventLoopCoroutine::EventType::Write) {
+        pollMask |= POLLOUT;
+    }
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    pollMask = (pollMask << 16) | (pollMask >> 16);
+#endif
+}
+
+IoWatcher::~IoWatcher()
+{
+    delete callback;
+}
+
+CompletionWatcher::CompletionWatcher(qintptr fd)
+    : coroutine(BaseCoroutine::current())
+    , fd(fd)
+    , watcherId(0)
+    , result(0)
+    , done(false)
+    , cancelled(false)
+{
+}
+
+TimerWatcher::TimerWatcher(quint32 interval, bool repeat, Functor *callback)
+    : callback(callback)
+    , deadline(0)
+    , interval(interval)
+    , repeat(repeat)
+{
+}
+
+TimerWatcher::~TimerWatcher()
+{
+    delete callback;
+}
+
+}  // namespace
+
+// this eventloop does recv/send/accept of plain tcp sockets by io_uring, and polls the readiness of other sockets.
+//   1. Socket::recv(char *, qint32) reads into the buffer of caller. if the coroutine is killed while the request is in
+//      the ring, the request is cancelled and its completion is reaped before the exception goes on, so the kernel
+//      never writes into a buffer which is returned. closing the socket cancels its requests too.
+//   2. udp sockets, connect(), sendfile(), sendv() and recvv() are still polled, so are SslSocket and KcpSocket which
+//      retry their non-blocking syscalls after the watcher fires.
+//   3. registered buffers and multishot recv (provided buffer rings, linux 5.19+) give buffers owned by the ring, so
+//      the data is copied to the caller anyway. they are not used.
+// the io requests, the poll requests and the timer wait of one round are submitted by one syscall.
+class IoUringEventLoopCoroutinePrivate : public EventLoopCoroutinePrivate
+{
+public:
+    IoUringEventLoopCoroutinePrivate(EventLoopCoroutine *parent);
+    virtual ~IoUringEventLoopCoroutinePrivate() override;
+public:
+    virtual void run() override;
+    virtual int createWatcher(EventLoopCoroutine::EventType event, qintptr fd, Functor *callback) override;
+    virtual void startWatcher(int watcherId) override;
+    virtual void stopWatcher(int watcherId) override;
+    virtual void removeWatcher(int watcherId) override;
+    virtual void triggerIoWatchers(qintptr fd) override;
+    virtual bool doIo(EventLoopCoroutine::IoOperation operation, qintptr fd, char *data, qint32 size, int flags,
+                      qint32 *result) override;
+    virtual int callLater(quint32 msecs, Functor *callback) override;
+    virtual int callRepeat(quint32 msecs, Functor *callback) override;
+    virtual void callLaterThreadSafe(quint32 msecs, Functor *callback) override;
+    virtual void cancelCall(int callbackId) override;
+    virtual int exitCode() override;
+    virtual bool runUntil(BaseCoroutine *coroutine) override;
+public:
+    void loop();
+    void breakLoop();
+    void runOnce();
+    void dispatch(quint64 userData, qint32 result);
+    void processTimers();
+    void arm(IoWatcher *watcher);
+    void disarm(IoWatcher *watcher);
+    void cancel(CompletionWatcher *watcher);
+    void armWakeup();
+    void doCallLater();
+public:
+    IoUring ring;
+    QElapsedTimer clock;
+    QMap<int, UringWatcher *> watchers;
+    QMultiMap<qint64, int> timers;
+    QList<UringWatcher *> uselessWatchers;
+    QList<bool *> breakFlags;  // one for each depth of loop()
+    QMutex mqMutex;
+    QQueue<QPair<quint32, Functor *>> callLaterQueue;
+    quint64 wakeupBuf;
+    int wakeupFd;
+    int nextWatcherId;
+    Q_DECLARE_PUBLIC(EventLoopCoroutine)
+};
+
+IoUringEventLoopCoroutinePrivate::IoUringEventLoopCoroutinePrivate(EventLoopCoroutine *parent)
+    : EventLoopCoroutinePrivate(parent)
+    , wakeupBuf(0)
+    , wakeupFd(-1)
+    , nextWatcherId(1)
+{
+    if (!ring.setup(RingEntries)) {
+        qtng_warning << "can not setup io_uring:" << strerror(errno);
+    }
+    clock.start();
+    wakeupFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    armWakeup();
+}
+
+IoUringEventLoopCoroutinePrivate::~IoUringEventLoopCoroutinePrivate()
+{
+    mqMutex.lock();
+    while (!callLaterQueue.isEmpty()) {
+        QPair<quint32, Functor *> item = callLaterQueue.dequeue();
+        delete item.second;
+    }
+    mqMutex.unlock();
+    breakLoop();
+    QMapIterator<int, UringWatcher *> itor(watchers);
+    while (itor.hasNext()) {
+        itor.next();
+        delete itor.value();
+    }
+    for (UringWatcher *watcher : uselessWatchers) {
+        delete watcher;
+    }
+    // the pending requests are cancelled by closing the ring in ~IoUring(), which releases the wakeupBuf too.
+    if (wakeupFd >= 0) {
+        ::close(wakeupFd);
+    }
+}
+
+void IoUringEventLoopCoroutinePrivate::run()
+{
+    try {
+        loop();
+    } catch (...) {
+        qtng_warning << "io_uring eventloop got exception.";
+    }
+}
+
+void IoUringEventLoopCoroutinePrivate::loop()
+{
+    bool exiting = false;
+    breakFlags.append(&exiting);
+    while (!exiting) {
+        runOnce();
+    }
+    breakFlags.removeOne(&exiting);
+}
+
+void IoUringEventLoopCoroutinePrivate::breakLoop()
+{
+    if (!breakFlags.isEmpty()) {
+        *breakFlags.last() = true;
+    }
+}
+
+void IoUringEventLoopCoroutinePrivate::runOnce()
+{
+    while (!uselessWatchers.isEmpty()) {
+        delete uselessWatchers.takeFirst();
+    }
+
+    qint64 timeout = -1;
+    if (!timers.isEmpty()) {
+        timeout = qMax<qint64>(0, timers.firstKey() - clock.elapsed());
+    }
+    // submit the requests queued by the last round, and wait for completions in one syscall.
+    if (ring.enter(timeout) < 0) {
+        qtng_warning << "can not enter io_uring:" << strerror(errno);
+    }
+
+    QVarLengthArray<QPair<quint64, qint32>, 64> completions;
+    ring.reap(completions);
+    for (const QPair<quint64, qint32> &completion : completions) {
+        dispatch(completion.first, completion.second);
+    }
+    processTimers();
+}
+
+void IoUringEventLoopCoroutinePrivate::dispatch(quint64 userData, qint32 result)
+{
+    if (userData == IgnoredUserData) {
+        return;
+    }
+    if (userData == WakeupUserData) {
+        doCallLater();
+        armWakeup();
+        return;
+    }
+    const int watcherId = static_cast<int>(userData & 0x7fffffff);
+    const quint32 generation = static_cast<quint32>(userData >> 32);
+    UringWatcher *found = watchers.value(watcherId);
+    CompletionWatcher *request = dynamic_cast<CompletionWatcher *>(found);
+    if (request) {
+        if (request->done) {
+            return;
+        }
+        request->result = result;
+        request->done = true;
+        if (!request->coroutine.isNull()) {
+            try {
+                request->coroutine->yield();
+            } catch (CoroutineException &e) {
+                qtng_debug << "do not send exception to event loop:" << e.what();
+            }
+        }
+        return;
+    }
+    IoWatcher *watcher = dynamic_cast<IoWatcher *>(found);
+    // the completion of a poll request which is stopped and cancelled already.
+    if (!watcher || !watcher->armed || watcher->generation != generation) {
+        return;
+    }
+    watcher->armed = false;
+    if (result == -ECANCELED || !watcher->active) {
+        return;
+    }
+    if (result < 0) {
+        // such as -EBADF. polling it again fails at once, so the watcher is stopped instead of busy looping.
+        qtng_debug << "can not poll file descriptor" << watcher->fd << ":" << strerror(-result);
+        watcher->active = false;
+        return;
+    }
+    (*watcher->callback)();
+    // poll requests are one shot. emulate the level triggered watchers of libev by polling again.
+    // the callback may stop or remove the watcher, even delete it in a nested loop.
+    if (watchers.value(watcherId) == watcher && watcher->active && !watcher->armed) {
+        arm(watcher);
+    }
+}
+
+void IoUringEventLoopCoroutinePrivate::processTimers()
+{
+    if (timers.isEmpty()) {
+        return;
+    }
+    const qint64 now = clock.elapsed();
+    QVarLengthArray<int, 16> expired;
+    QMultiMap<qint64, int>::iterator itor = timers.begin();
+    while (itor != timers.end() && itor.key() <= now) {
+        expired.append(itor.value());
+        itor = timers.erase(itor);
+    }
+    for (int timerId : expired) {
+        // the timer may be cancelled by the callbacks of other timers.
+        TimerWatcher *watcher = dynamic_cast<TimerWatcher *>(watchers.value(timerId));
+        if (!watcher) {
+            continue;
+        }
+        if (watcher->repeat) {
+            watcher->deadline = qMax(watcher->deadline + watcher->interval, now);
+            timers.insert(watcher->deadline, timerId);
+        } else {
+            watchers.remove(timerId);
+            uselessWatchers.append(watcher);
+        }
+        (*watcher->callback)();
+    }
+}
+
+void IoUringEventLoopCoroutinePrivate::arm(IoWatcher *watcher)
+{
+    struct io_uring_sqe *sqe = ring.getSqe();
+    if (!sqe) {
+        qtng_warning << "io_uring submission queue is full.";
+        return;
+    }
+    ++watcher->generation;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = static_cast<int>(watcher->fd);
+    sqe->poll32_events = watcher->pollMask;
+    sqe->user_data = (static_cast<quint64>(watcher->generation) << 32) | static_cast<quint64>(watcher->watcherId);
+    watcher->armed = true;
+}
+
+void IoUringEventLoopCoroutinePrivate::disarm(IoWatcher *watcher)
+{
+    if (!watcher->armed) {
+        return;
+    }
+    watcher->armed = false;
+    // the poll request holds a reference of the file, remove it so that closing the socket really closes it.
+    struct io_uring_sqe *sqe = ring.getSqe();
+    if (!sqe) {
+        qtng_warning << "io_uring submission queue is full.";
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = (static_cast<quint64>(watcher->generation) << 32) | static_cast<quint64>(watcher->watcherId);
+    sqe->user_data = IgnoredUserData;
+}
+
+void IoUringEventLoopCoroutinePrivate::cancel(CompletionWatcher *watcher)
+{
+    if (watcher->done || watcher->cancelled) {
+        return;
+    }
+    struct io_uring_sqe *sqe = ring.getSqe();
+    if (!sqe) {
+        qtng_warning << "io_uring submission queue is full.";
+        return;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = static_cast<quint64>(watcher->watcherId);
+    sqe->user_data = IgnoredUserData;
+    watcher->cancelled = true;
+}
+
+void IoUringEventLoopCoroutinePrivate::armWakeup()
+{
+    if (wakeupFd < 0 || ring.fd < 0) {
+        return;
+    }
+    struct io_uring_sqe *sqe = ring.getSqe();
+    if (!sqe) {
+        qtng_warning << "io_uring submission queue is full.";
+        return;
+    }
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wakeupFd;
+    sqe->addr = reinterpret_cast<quint64>(&wakeupBuf);
+    sqe->len = sizeof(wakeupBuf);
+    sqe->user_data = WakeupUserData;
+}
+
+int IoUringEventLoopCoroutinePrivate::createWatcher(EventLoopCoroutine::EventType event, qintptr fd,
+                                                    Functor *callback)
+{
+    IoWatcher *watcher = new IoWatcher(event, fd, callback);
+    watcher->watcherId = nextWatcherId;
+    watchers.insert(nextWatcherId, watcher);
+    return nextWatcherId++;
+}
+
+void IoUringEventLoopCoroutinePrivate::startWatcher(int watcherId)
+{
+    IoWatcher *watcher = dynamic_cast<IoWatcher *>(watchers.value(watcherId));
+    if (watcher && !watcher->active) {
+        watcher->active = true;
+        if (!watcher->armed) {
+            arm(watcher);
+        }
+    }
+}
+
+void IoUringEventLoopCoroutinePrivate::stopWatcher(int watcherId)
+{
+    IoWatcher *watcher = dynamic_cast<IoWatcher *>(watchers.value(watcherId));
+    if (watcher) {
+        watcher->active = false;
+        disarm(watcher);
+    }
+}
+
+void IoUringEventLoopCoroutinePrivate::removeWatcher(int watcherId)
+{
+    IoWatcher *watcher = dynamic_cast<IoWatcher *>(watchers.take(watcherId));
+    if (watcher) {
+        watcher->active = false;
+        disarm(watcher);
+        uselessWatchers.append(watcher);
+    }
+}
+
+namespace {
+
+struct TriggerIoWatchersFunctor : public Functor
+{
+    TriggerIoWatchersFunctor(int watcherId, IoUringEventLoopCoroutinePrivate *eventloop)
+        : eventloop(eventloop)
+        , watcherId(watcherId)
+    {
+    }
+    IoUringEventLoopCoroutinePrivate *eventloop;
+    int watcherId;
+    virtual bool operator()() override
+    {
+        IoWatcher *watcher = dynamic_cast<IoWatcher *>(eventloop->watchers.value(watcherId));
+        if (watcher) {
+            return (*watcher->callback)();
+        }
+        return false;
+    }
+};
+
+}  // namespace
+
+void IoUringEventLoopCoroutinePrivate::triggerIoWatchers(qintptr fd)
+{
+    for (QMap<int, UringWatcher *>::const_iterator itor = watchers.constBegin(); itor != watchers.constEnd();
+         ++itor) {
+        IoWatcher *watcher = dynamic_cast<IoWatcher *>(itor.value());
+        if (watcher && watcher->fd == fd) {
+            watcher->active = false;
+            disarm(watcher);
+            callLater(0, new TriggerIoWatchersFunctor(itor.key(), this));
+            continue;
+        }
+        // the request holds a reference of the file, closing the socket does not finish it.
+        CompletionWatcher *request = dynamic_cast<CompletionWatcher *>(itor.value());
+        if (request && request->fd == fd) {
+            cancel(request);
+        }
+    }
+}
+
+bool IoUringEventLoopCoroutinePrivate::doIo(EventLoopCoroutine::IoOperation operation, qintptr fd, char *data,
+                                            qint32 size, int flags, qint32 *result)
+{
+    Q_Q(EventLoopCoroutine);
+    // the eventloop itself can not wait for a completion.
+    BaseCoroutine *current = BaseCoroutine::current();
+    if (ring.fd < 0 || current == q || current == loopCoroutine.data()) {
+        return false;
+    }
+    struct io_uring_sqe *sqe = ring.getSqe();
+    if (!sqe) {
+        return false;  // fall back to poll the readiness.
+    }
+    CompletionWatcher *watcher = new CompletionWatcher(fd);
+    watcher->watcherId = nextWatcherId++;
+    switch (operation) {
+    case EventLoopCoroutine::RecvOperation:
+        sqe->opcode = IORING_OP_RECV;
+        sqe->addr = reinterpret_cast<quint64>(data);
+        sqe->len = static_cast<quint32>(size);
+        sqe->msg_flags = static_cast<quint32>(flags);
+        break;
+    case EventLoopCoroutine::SendOperation:
+        sqe->opcode = IORING_OP_SEND;
+        sqe->addr = reinterpret_cast<quint64>(data);
+        sqe->len = static_cast<quint32>(size);
+        sqe->msg_flags = static_cast<quint32>(flags);
+        break;
+    case EventLoopCoroutine::AcceptOperation:
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->accept_flags = static_cast<quint32>(flags);
+        break;
+    }
+    sqe->fd = static_cast<int>(fd);
+    sqe->user_data = static_cast<quint64>(watcher->watcherId);
+    watchers.insert(watcher->watcherId, watcher);
+
+    QScopedPointer<CoroutineException> exception;
+    while (!watcher->done) {
+        try {
+            q->yield();
+        } catch (CoroutineException &e) {
+            // the kernel may write into the buffer until the request completes, cancel it and wait for the completion.
+            if (exception.isNull()) {
+                exception.reset(e.clone());
+            }
+            cancel(watcher);
+        }
+    }
+    watchers.remove(watcher->watcherId);
+    uselessWatchers.append(watcher);
+    if (!exception.isNull()) {
+        if (operation == EventLoopCoroutine::AcceptOperation && watcher->result >= 0) {
+            ::close(watcher->result);
+        }
+        exception->raise();
+    }
+    *result = watcher->result;
+    return true;
+}
+
+int IoUringEventLoopCoroutinePrivate::callLater(quint32 msecs, Functor *callback)
+{
+    TimerWatcher *watcher = new TimerWatcher(msecs, false, callback);
+    watcher->deadline = clock.elapsed() + msecs;
+    watchers.insert(nextWatcherId, watcher);
+    timers.insert(watcher->deadline, nextWatcherId);
+    return nextWatcherId++;
+}
+
+int IoUringEventLoopCoroutinePrivate::callRepeat(quint32 msecs, Functor *callback)
+{
+    TimerWatcher *watcher = new TimerWatcher(msecs, true, callback);
+    watcher->deadline = clock.elapsed() + msecs;
+    watchers.insert(nextWatcherId, watcher);
+    timers.insert(watcher->deadline, nextWatcherId);
+    return nextWatcherId++;
+}
+
+void IoUringEventLoopCoroutinePrivate::doCallLater()
+{
+    QMutexLocker locker(&mqMutex);
+    while (!callLaterQueue.isEmpty()) {
+        QPair<quint32, Functor *> item = callLaterQueue.dequeue();
+        callLater(item.first, item.second);
+    }
+}
+
+void IoUringEventLoopCoroutinePrivate::callLaterThreadSafe(quint32 msecs, Functor *callback)
+{
+    QMutexLocker locker(&mqMutex);
+    const bool wasEmpty = callLaterQueue.isEmpty();
+    callLaterQueue.enqueue(qMakePair(msecs, callback));
+    if (wasEmpty && wakeupFd >= 0) {
+        quint64 one = 1;
+        ssize_t rt = ::write(wakeupFd, &one, sizeof(one));
+        Q_UNUSED(rt);
+    }
+}
+
+void IoUringEventLoopCoroutinePrivate::cancelCall(int callbackId)
+{
+    TimerWatcher *watcher = dynamic_cast<TimerWatcher *>(watchers.take(callbackId));
+    if (watcher) {
+        timers.remove(watcher->deadline, callbackId);
+        uselessWatchers.append(watcher);
+    }
+}
+
+int IoUringEventLoopCoroutinePrivate::exitCode()
+{
+    return 0;
+}
+
+bool IoUringEventLoopCoroutinePrivate::runUntil(BaseCoroutine *coroutine)
+{
+    QPointer<BaseCoroutine> current = BaseCoroutine::current();
+    if (!loopCoroutine.isNull() && loopCoroutine != current) {
+        Deferred<BaseCoroutine *>::Callback here = [current](BaseCoroutine *) {
+            if (!current.isNull()) {
+                current->yield();
+            }
+        };
+        int callbackId = coroutine->finished.addCallback(here);
+        loopCoroutine->yield();
+        coroutine->finished.remove(callbackId);
+    } else {
+        QPointer<BaseCoroutine> old = loopCoroutine;
+        loopCoroutine = current;
+        Deferred<BaseCoroutine *>::Callback exitOneDepth = [this](BaseCoroutine *) { breakLoop(); };
+        int callbackId = coroutine->finished.addCallback(exitOneDepth);
+        loop();
+        loopCoroutine = old;
+        coroutine->finished.remove(callbackId);
+    }
+    return true;
+}
+
+IoUringEventLoopCoroutine::IoUringEventLoopCoroutine()
+    : EventLoopCoroutine(new IoUringEventLoopCoroutinePrivate(this))
+{
+}
+
+bool IoUringEventLoopCoroutine::isSupported()
+{
+    static const bool supported = [] {
+        IoUring ring;
+        return ring.setup(4);
+    }();
+    return supported;
+}
+
+QTNETWORKNG_NAMESPACE_END
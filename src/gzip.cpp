@@ -1,12 +1,74 @@
+#include <QtCore/qmap.h>
 #include "../include/gzip.h"
 extern "C" {
 #include <zlib.h>
+#ifdef QTNG_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef QTNG_HAVE_BROTLI
+#include <brotli/encode.h>
+#include <brotli/decode.h>
+#endif
 }
 
 #define GZIP_WINDOWS_BIT (MAX_WBITS + 32)
 
 QTNETWORKNG_NAMESPACE_BEGIN
 
+// the output of codecs. it is consumed from the front and filled at the back, the unread bytes are moved to the
+// front only if there is no room at the back, so the memory is reused and no QByteArray::remove() is needed.
+class CodecBuffer
+{
+public:
+    CodecBuffer()
+        : start(0)
+        , end(0)
+    {
+    }
+public:
+    qint32 size() const { return end - start; }
+    const char *constData() const { return buf.constData() + start; }
+    char *prepare(qint32 bytes);
+    void commit(qint32 bytes) { end += bytes; }
+    qint32 take(char *data, qint32 bytes);
+    void clear() { start = end = 0; }
+private:
+    QByteArray buf;
+    qint32 start;
+    qint32 end;
+};
+
+char *CodecBuffer::prepare(qint32 bytes)
+{
+    if (buf.size() - end < bytes) {
+        if (start > 0) {
+            memmove(buf.data(), buf.constData() + start, static_cast<size_t>(end - start));
+            end -= start;
+            start = 0;
+        }
+        if (buf.size() - end < bytes) {
+            buf.resize(end + bytes);
+        }
+    }
+    return buf.data() + end;
+}
+
+qint32 CodecBuffer::take(char *data, qint32 bytes)
+{
+    bytes = qMin(bytes, size());
+    if (bytes > 0) {
+        memcpy(data, buf.constData() + start, static_cast<size_t>(bytes));
+        start += bytes;
+    }
+    if (start == end) {
+        start = end = 0;
+    }
+    return bytes;
+}
+
+const int OutputBufferSize = 1024 * 32;
+const int InputBufferSize = 1024 * 8;
+
 class GzipCompressFilePrivate
 {
 public:
@@ -19,7 +81,8 @@ public:
     }
 public:
     QSharedPointer<FileLike> backend;
-    QByteArray buf;
+    CodecBuffer buf;
+    QByteArray inBuf;
     z_stream zstream;
     int level;
     bool hasError;
@@ -39,7 +102,8 @@ public:
     }
 public:
     QSharedPointer<FileLike> backend;
-    QByteArray buf;
+    CodecBuffer buf;
+    QByteArray inBuf;
     z_stream zstream;
     bool hasError;
     bool inited;
@@ -76,43 +140,35 @@ qint32 GzipCompressFile::read(char *data, qint32 size)
         return -1;
     }
 
-    const int OutputBufferSize = 1024 * 32;
-    const int InputBufferSize = 1024 * 8;
+    if (d->inBuf.isEmpty()) {
+        d->inBuf.resize(InputBufferSize);
+    }
     while (d->buf.size() < size && !d->eof) {
-        QByteArray inBuf(InputBufferSize, Qt::Uninitialized);
-        QByteArray outBuf(OutputBufferSize, Qt::Uninitialized);
-
-        qint32 readBytes = d->backend->read(inBuf.data(), inBuf.size());
+        qint32 readBytes = d->backend->read(d->inBuf.data(), d->inBuf.size());
         if (readBytes < 0) {
             d->hasError = true;
             return -1;
         } else if (readBytes == 0) {
             d->eof = true;
         }
-        d->zstream.next_in = reinterpret_cast<Bytef *>(inBuf.data());
+        d->zstream.next_in = reinterpret_cast<Bytef *>(d->inBuf.data());
         d->zstream.avail_in = static_cast<uint>(readBytes);
         do {
-            d->zstream.next_out = reinterpret_cast<Bytef *>(outBuf.data());
-            d->zstream.avail_out = static_cast<uint>(outBuf.size());
+            d->zstream.next_out = reinterpret_cast<Bytef *>(d->buf.prepare(OutputBufferSize));
+            d->zstream.avail_out = static_cast<uint>(OutputBufferSize);
             int ret = deflate(&d->zstream, readBytes > 0 ? Z_NO_FLUSH : Z_FINISH);
             if (ret < 0 || ret == Z_NEED_DICT) {
                 d->hasError = true;
                 return -1;
             }
-            if (Q_UNLIKELY(d->zstream.avail_out > static_cast<uint>(outBuf.size()))) {  // is this possible?
+            if (Q_UNLIKELY(d->zstream.avail_out > static_cast<uint>(OutputBufferSize))) {  // is this possible?
                 d->hasError = true;
                 return -1;
             }
-            int have = outBuf.size() - static_cast<int>(d->zstream.avail_out);
-            if (have > 0) {
-                d->buf.append(outBuf.data(), static_cast<qint32>(have));
-            }
+            d->buf.commit(OutputBufferSize - static_cast<int>(d->zstream.avail_out));
         } while (d->zstream.avail_out == 0 || d->zstream.avail_in > 0);
     }
-    qint32 bytesToRead = qMin(size, d->buf.size());
-    memcpy(data, d->buf.data(), bytesToRead);
-    d->buf.remove(0, bytesToRead);
-    return bytesToRead;
+    return d->buf.take(data, size);
 }
 
 qint32 GzipCompressFile::write(const char *data, qint32 size)
@@ -125,27 +181,21 @@ qint32 GzipCompressFile::write(const char *data, qint32 size)
         return 0;
     }
 
-    const int OutputBufferSize = 1024 * 32;
-    QByteArray outBuf(OutputBufferSize, Qt::Uninitialized);
-
     d->zstream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
     d->zstream.avail_in = static_cast<uint>(size);
     do {
-        d->zstream.next_out = reinterpret_cast<Bytef *>(outBuf.data());
-        d->zstream.avail_out = static_cast<uint>(outBuf.size());
+        d->zstream.next_out = reinterpret_cast<Bytef *>(d->buf.prepare(OutputBufferSize));
+        d->zstream.avail_out = static_cast<uint>(OutputBufferSize);
         int ret = deflate(&d->zstream, size > 0 ? Z_NO_FLUSH : Z_FINISH);
         if (ret < 0 || ret == Z_NEED_DICT) {
             d->hasError = true;
             return -1;
         }
-        if (Q_UNLIKELY(d->zstream.avail_out > static_cast<uint>(outBuf.size()))) {  // is this possible?
+        if (Q_UNLIKELY(d->zstream.avail_out > static_cast<uint>(OutputBufferSize))) {  // is this possible?
             d->hasError = true;
             return -1;
         }
-        int have = outBuf.size() - static_cast<int>(d->zstream.avail_out);
-        if (have > 0) {
-            d->buf.append(outBuf.data(), static_cast<qint32>(have));
-        }
+        d->buf.commit(OutputBufferSize - static_cast<int>(d->zstream.avail_out));
     } while (d->zstream.avail_out == 0 || d->zstream.avail_in > 0);
 
     qint32 bytesWritten = d->backend->write(d->buf.constData(), d->buf.size());
@@ -186,23 +236,21 @@ qint32 GzipDecompressFile::read(char *data, qint32 size)
     if (d->hasError || !d->inited) {
         return -1;
     }
-    const int OutputBufferSize = 1024 * 32;
-    const int InputBufferSize = 1024 * 8;
-    QByteArray inBuf(InputBufferSize, Qt::Uninitialized);
-    QByteArray outBuf(OutputBufferSize, Qt::Uninitialized);
-
+    if (d->inBuf.isEmpty()) {
+        d->inBuf.resize(InputBufferSize);
+    }
     while (d->buf.size() < size && !d->eof) {
-        qint32 readBytes = d->backend->read(inBuf.data(), inBuf.size());
+        qint32 readBytes = d->backend->read(d->inBuf.data(), d->inBuf.size());
         if (readBytes < 0) {
             return false;
         } else if (readBytes == 0) {
             d->eof = true;
         }
-        d->zstream.next_in = reinterpret_cast<Bytef *>(inBuf.data());
+        d->zstream.next_in = reinterpret_cast<Bytef *>(d->inBuf.data());
         d->zstream.avail_in = static_cast<uint>(readBytes);
         do {
-            d->zstream.next_out = reinterpret_cast<Bytef *>(outBuf.data());
-            d->zstream.avail_out = static_cast<uint>(outBuf.size());
+            d->zstream.next_out = reinterpret_cast<Bytef *>(d->buf.prepare(OutputBufferSize));
+            d->zstream.avail_out = static_cast<uint>(OutputBufferSize);
             int ret = inflate(&d->zstream, readBytes > 0 ? Z_FULL_FLUSH : Z_FINISH);
             if (ret == Z_DATA_ERROR && !d->triedRawDeflate) {
                 d->triedRawDeflate = true;
@@ -217,7 +265,7 @@ qint32 GzipDecompressFile::read(char *data, qint32 size)
                     d->inited = false;
                     return -1;
                 } else {
-                    d->zstream.next_in = reinterpret_cast<Bytef *>(inBuf.data());
+                    d->zstream.next_in = reinterpret_cast<Bytef *>(d->inBuf.data());
                     d->zstream.avail_in = static_cast<uint>(readBytes);
                     continue;
                 }
@@ -225,15 +273,12 @@ qint32 GzipDecompressFile::read(char *data, qint32 size)
                 d->hasError = true;
                 return -1;
             }
-            if (Q_UNLIKELY(d->zstream.avail_out > static_cast<uint>(outBuf.size()))) {  // is this possible?
+            if (Q_UNLIKELY(d->zstream.avail_out > static_cast<uint>(OutputBufferSize))) {  // is this possible?
                 d->hasError = true;
                 return -1;
             }
             d->triedRawDeflate = true;
-            int have = outBuf.size() - static_cast<int>(d->zstream.avail_out);
-            if (have > 0) {
-                d->buf.append(outBuf.data(), have);
-            }
+            d->buf.commit(OutputBufferSize - static_cast<int>(d->zstream.avail_out));
             if (ret == Z_STREAM_END) {
                 d->eof = true;
                 break;
@@ -243,10 +288,7 @@ qint32 GzipDecompressFile::read(char *data, qint32 size)
             }
         } while (d->zstream.avail_out == 0);
     }
-    qint32 bytesToRead = qMin(size, d->buf.size());
-    memcpy(data, d->buf.data(), bytesToRead);
-    d->buf.remove(0, bytesToRead);
-    return bytesToRead;
+    return d->buf.take(data, size);
 }
 
 qint32 GzipDecompressFile::write(const char *data, qint32 size)
@@ -259,14 +301,11 @@ qint32 GzipDecompressFile::write(const char *data, qint32 size)
         return 0;
     }
 
-    const int OutputBufferSize = 1024 * 32;
-    QByteArray outBuf(OutputBufferSize, Qt::Uninitialized);
-
     d->zstream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
     d->zstream.avail_in = static_cast<uint>(size);
     do {
-        d->zstream.next_out = reinterpret_cast<Bytef *>(outBuf.data());
-        d->zstream.avail_out = static_cast<uint>(outBuf.size());
+        d->zstream.next_out = reinterpret_cast<Bytef *>(d->buf.prepare(OutputBufferSize));
+        d->zstream.avail_out = static_cast<uint>(OutputBufferSize);
         int ret = inflate(&d->zstream, size > 0 ? Z_FULL_FLUSH : Z_FINISH);
         if (ret == Z_DATA_ERROR && !d->triedRawDeflate) {
             d->triedRawDeflate = true;
@@ -289,15 +328,12 @@ qint32 GzipDecompressFile::write(const char *data, qint32 size)
             d->hasError = true;
             return -1;
         }
-        if (Q_UNLIKELY(d->zstream.avail_out > static_cast<uint>(outBuf.size()))) {  // is this possible?
+        if (Q_UNLIKELY(d->zstream.avail_out > static_cast<uint>(OutputBufferSize))) {  // is this possible?
             d->hasError = true;
             return -1;
         }
         d->triedRawDeflate = true;
-        int have = outBuf.size() - static_cast<int>(d->zstream.avail_out);
-        if (have > 0) {
-            d->buf.append(outBuf.data(), have);
-        }
+        d->buf.commit(OutputBufferSize - static_cast<int>(d->zstream.avail_out));
     } while (d->zstream.avail_out == 0 || d->zstream.avail_in > 0);
 
     qint32 bytesWritten = d->backend->write(d->buf.constData(), d->buf.size());
@@ -310,15 +346,653 @@ qint32 GzipDecompressFile::write(const char *data, qint32 size)
     }
 }
 
+// the streaming codecs behind CompressFile and DecompressFile. process() consumes the input and fills the output,
+// both pointers and sizes are advanced. `end` means there is no more input, the encoders must finish the stream.
+class StreamCodec
+{
+public:
+    virtual ~StreamCodec() { }
+    virtual bool isValid() const = 0;
+    virtual bool process(const char **in, size_t *inSize, char **out, size_t *outSize, bool end, bool *finished) = 0;
+};
+
+class ZlibEncoder : public StreamCodec
+{
+public:
+    ZlibEncoder(int windowBits, int level)
+    {
+        zstream.zalloc = nullptr;
+        zstream.zfree = nullptr;
+        zstream.opaque = nullptr;
+        zstream.avail_in = 0;
+        zstream.next_in = nullptr;
+        inited = deflateInit2(&zstream, qMax(-1, qMin(9, level)), Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY)
+                == Z_OK;
+    }
+    virtual ~ZlibEncoder() override
+    {
+        if (inited) {
+            deflateEnd(&zstream);
+        }
+    }
+    virtual bool isValid() const override { return inited; }
+    virtual bool process(const char **in, size_t *inSize, char **out, size_t *outSize, bool end,
+                         bool *finished) override
+    {
+        zstream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(*in));
+        zstream.avail_in = static_cast<uint>(*inSize);
+        zstream.next_out = reinterpret_cast<Bytef *>(*out);
+        zstream.avail_out = static_cast<uint>(*outSize);
+        int ret = deflate(&zstream, end ? Z_FINISH : Z_NO_FLUSH);
+        if ((ret < 0 && ret != Z_BUF_ERROR) || ret == Z_NEED_DICT) {
+            return false;
+        }
+        *in = reinterpret_cast<const char *>(zstream.next_in);
+        *inSize = zstream.avail_in;
+        *out = reinterpret_cast<char *>(zstream.next_out);
+        *outSize = zstream.avail_out;
+        *finished = (ret == Z_STREAM_END);
+        return true;
+    }
+private:
+    z_stream zstream;
+    bool inited;
+};
+
+class ZlibDecoder : public StreamCodec
+{
+public:
+    ZlibDecoder()
+        : triedRawDeflate(false)
+    {
+        inited = init(GZIP_WINDOWS_BIT);
+    }
+    virtual ~ZlibDecoder() override
+    {
+        if (inited) {
+            inflateEnd(&zstream);
+        }
+    }
+    virtual bool isValid() const override { return inited; }
+    virtual bool process(const char **in, size_t *inSize, char **out, size_t *outSize, bool end,
+                         bool *finished) override
+    {
+        Q_UNUSED(end);
+        zstream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(*in));
+        zstream.avail_in = static_cast<uint>(*inSize);
+        zstream.next_out = reinterpret_cast<Bytef *>(*out);
+        zstream.avail_out = static_cast<uint>(*outSize);
+        int ret = inflate(&zstream, Z_NO_FLUSH);
+        if (ret == Z_DATA_ERROR && !triedRawDeflate) {
+            // some servers send raw deflate stream without zlib header.
+            triedRawDeflate = true;
+            inflateEnd(&zstream);
+            inited = init(-MAX_WBITS);
+            if (!inited) {
+                return false;
+            }
+            return process(in, inSize, out, outSize, end, finished);
+        } else if ((ret < 0 && ret != Z_BUF_ERROR) || ret == Z_NEED_DICT) {
+            return false;
+        }
+        triedRawDeflate = true;
+        *in = reinterpret_cast<const char *>(zstream.next_in);
+        *inSize = zstream.avail_in;
+        *out = reinterpret_cast<char *>(zstream.next_out);
+        *outSize = zstream.avail_out;
+        *finished = (ret == Z_STREAM_END);
+        return true;
+    }
+private:
+    bool init(int windowBits)
+    {
+        zstream.zalloc = nullptr;
+        zstream.zfree = nullptr;
+        zstream.opaque = nullptr;
+        zstream.avail_in = 0;
+        zstream.next_in = nullptr;
+        return inflateInit2(&zstream, windowBits) == Z_OK;
+    }
+private:
+    z_stream zstream;
+    bool inited;
+    bool triedRawDeflate;
+};
+
+#ifdef QTNG_HAVE_ZSTD
+class ZstdEncoder : public StreamCodec
+{
+public:
+    ZstdEncoder(int level)
+        : cctx(ZSTD_createCCtx())
+    {
+        if (level < 0) {
+            level = ZSTD_CLEVEL_DEFAULT;
+        }
+        if (cctx) {
+            ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, qMax(1, qMin(ZSTD_maxCLevel(), level)));
+        }
+    }
+    virtual ~ZstdEncoder() override { ZSTD_freeCCtx(cctx); }
+    virtual bool isValid() const override { return cctx != nullptr; }
+    virtual bool process(const char **in, size_t *inSize, char **out, size_t *outSize, bool end,
+                         bool *finished) override
+    {
+        ZSTD_inBuffer input = { *in, *inSize, 0 };
+        ZSTD_outBuffer output = { *out, *outSize, 0 };
+        size_t remaining = ZSTD_compressStream2(cctx, &output, &input, end ? ZSTD_e_end : ZSTD_e_continue);
+        if (ZSTD_isError(remaining)) {
+            return false;
+        }
+        *in += input.pos;
+        *inSize -= input.pos;
+        *out += output.pos;
+        *outSize -= output.pos;
+        *finished = end && *inSize == 0 && remaining == 0;
+        return true;
+    }
+private:
+    ZSTD_CCtx *cctx;
+};
+
+class ZstdDecoder : public StreamCodec
+{
+public:
+    ZstdDecoder()
+        : dctx(ZSTD_createDCtx())
+        , frameDone(false)
+    {
+    }
+    virtual ~ZstdDecoder() override { ZSTD_freeDCtx(dctx); }
+    virtual bool isValid() const override { return dctx != nullptr; }
+    virtual bool process(const char **in, size_t *inSize, char **out, size_t *outSize, bool end,
+                         bool *finished) override
+    {
+        ZSTD_inBuffer input = { *in, *inSize, 0 };
+        ZSTD_outBuffer output = { *out, *outSize, 0 };
+        size_t ret = ZSTD_decompressStream(dctx, &output, &input);
+        if (ZSTD_isError(ret)) {
+            return false;
+        }
+        if (input.pos > 0 || output.pos > 0) {
+            frameDone = (ret == 0);
+        }
+        *in += input.pos;
+        *inSize -= input.pos;
+        *out += output.pos;
+        *outSize -= output.pos;
+        // the stream may have more frames, it is finished only if the input is exhausted at the end of a frame.
+        *finished = end && frameDone && *inSize == 0;
+        return true;
+    }
+private:
+    ZSTD_DCtx *dctx;
+    bool frameDone;
+};
+#endif
+
+#ifdef QTNG_HAVE_BROTLI
+class BrotliEncoder : public StreamCodec
+{
+public:
+    BrotliEncoder(int level)
+        : state(BrotliEncoderCreateInstance(nullptr, nullptr, nullptr))
+    {
+        // the default quality 11 is too slow for dynamic contents.
+        if (level < 0) {
+            level = 5;
+        }
+        if (state) {
+            BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY,
+                                      static_cast<quint32>(qMin(BROTLI_MAX_QUALITY, level)));
+        }
+    }
+    virtual ~BrotliEncoder() override
+    {
+        if (state) {
+            BrotliEncoderDestroyInstance(state);
+        }
+    }
+    virtual bool isValid() const override { return state != nullptr; }
+    virtual bool process(const char **in, size_t *inSize, char **out, size_t *outSize, bool end,
+                         bool *finished) override
+    {
+        const uint8_t *nextIn = reinterpret_cast<const uint8_t *>(*in);
+        uint8_t *nextOut = reinterpret_cast<uint8_t *>(*out);
+        if (!BrotliEncoderCompressStream(state, end ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS, inSize,
+                                         &nextIn, outSize, &nextOut, nullptr)) {
+            return false;
+        }
+        *in = reinterpret_cast<const char *>(nextIn);
+        *out = reinterpret_cast<char *>(nextOut);
+        *finished = BrotliEncoderIsFinished(state);
+        return true;
+    }
+private:
+    BrotliEncoderState *state;
+};
+
+class BrotliDecoder : public StreamCodec
+{
+public:
+    BrotliDecoder()
+        : state(BrotliDecoderCreateInstance(nullptr, nullptr, nullptr))
+    {
+    }
+    virtual ~BrotliDecoder() override
+    {
+        if (state) {
+            BrotliDecoderDestroyInstance(state);
+        }
+    }
+    virtual bool isValid() const override { return state != nullptr; }
+    virtual bool process(const char **in, size_t *inSize, char **out, size_t *outSize, bool end,
+                         bool *finished) override
+    {
+        Q_UNUSED(end);
+        const uint8_t *nextIn = reinterpret_cast<const uint8_t *>(*in);
+        uint8_t *nextOut = reinterpret_cast<uint8_t *>(*out);
+        BrotliDecoderResult ret = BrotliDecoderDecompressStream(state, inSize, &nextIn, outSize, &nextOut, nullptr);
+        if (ret == BROTLI_DECODER_RESULT_ERROR) {
+            return false;
+        }
+        *in = reinterpret_cast<const char *>(nextIn);
+        *out = reinterpret_cast<char *>(nextOut);
+        *finished = (ret == BROTLI_DECODER_RESULT_SUCCESS);
+        return true;
+    }
+private:
+    BrotliDecoderState *state;
+};
+#endif
+
+// drives a StreamCodec as a FileLike. the input buffer and output buffer are allocated once and reused.
+class CodecFile
+{
+public:
+    CodecFile(StreamCodec *codec, QSharedPointer<FileLike> backend)
+        : codec(codec)
+        , backend(backend)
+        , inPos(0)
+        , inEnd(0)
+        , hasError(codec == nullptr || !codec->isValid())
+        , eof(false)
+        , finished(false)
+        , written(false)
+    {
+    }
+public:
+    qint32 read(char *data, qint32 size);
+    qint32 write(const char *data, qint32 size);
+    void close();
+private:
+    bool process(const char **in, size_t *inSize, bool end);
+    bool flush();
+public:
+    QScopedPointer<StreamCodec> codec;
+    QSharedPointer<FileLike> backend;
+    CodecBuffer buf;
+    QByteArray inBuf;
+    qint32 inPos;
+    qint32 inEnd;
+    bool hasError;
+    bool eof;
+    bool finished;
+    bool written;
+};
+
+// returns false on error. the produced bytes are appended to buf.
+bool CodecFile::process(const char **in, size_t *inSize, bool end)
+{
+    char *out = buf.prepare(OutputBufferSize);
+    size_t outSize = static_cast<size_t>(OutputBufferSize);
+    if (!codec->process(in, inSize, &out, &outSize, end, &finished)) {
+        hasError = true;
+        return false;
+    }
+    buf.commit(OutputBufferSize - static_cast<qint32>(outSize));
+    return true;
+}
+
+qint32 CodecFile::read(char *data, qint32 size)
+{
+    if (hasError) {
+        return -1;
+    }
+    if (inBuf.isEmpty()) {
+        inBuf.resize(InputBufferSize);
+    }
+    while (buf.size() < size && !finished) {
+        if (inPos == inEnd && !eof) {
+            qint32 readBytes = backend->read(inBuf.data(), inBuf.size());
+            if (readBytes < 0) {
+                hasError = true;
+                return -1;
+            } else if (readBytes == 0) {
+                eof = true;
+            }
+            inPos = 0;
+            inEnd = readBytes;
+        }
+        const char *in = inBuf.constData() + inPos;
+        size_t inSize = static_cast<size_t>(inEnd - inPos);
+        const qint32 before = buf.size();
+        if (!process(&in, &inSize, eof)) {
+            return -1;
+        }
+        const qint32 consumed = inEnd - inPos - static_cast<qint32>(inSize);
+        inPos += consumed;
+        if (eof && !finished && consumed == 0 && buf.size() == before) {
+            // the input is truncated.
+            hasError = true;
+            if (buf.size() == 0) {
+                return -1;
+            }
+            break;
+        }
+    }
+    return buf.take(data, size);
+}
+
+bool CodecFile::flush()
+{
+    qint32 bytesWritten = backend->write(buf.constData(), buf.size());
+    bool success = (bytesWritten == buf.size());
+    buf.clear();
+    if (!success) {
+        hasError = true;
+    }
+    return success;
+}
+
+qint32 CodecFile::write(const char *data, qint32 size)
+{
+    if (hasError) {
+        return -1;
+    }
+    if (Q_UNLIKELY(size == 0)) {
+        return 0;
+    }
+    written = true;
+    const char *in = data;
+    size_t inSize = static_cast<size_t>(size);
+    while (inSize > 0 && !finished) {
+        if (!process(&in, &inSize, false)) {
+            return -1;
+        }
+        if (buf.size() >= OutputBufferSize && !flush()) {
+            return -1;
+        }
+    }
+    if (buf.size() > 0 && !flush()) {
+        return -1;
+    }
+    return size;
+}
+
+void CodecFile::close()
+{
+    if (hasError || !written) {
+        return;
+    }
+    written = false;
+    // the encoders write their trailer here.
+    while (!finished) {
+        const char *in = nullptr;
+        size_t inSize = 0;
+        const qint32 before = buf.size();
+        if (!process(&in, &inSize, true)) {
+            return;
+        }
+        if (buf.size() == before && !finished) {
+            hasError = true;
+            return;
+        }
+    }
+    flush();
+}
+
+static StreamCodec *createEncoder(CompressFile::Method method, int level)
+{
+    switch (method) {
+    case CompressFile::Gzip:
+        return new ZlibEncoder(MAX_WBITS + 16, level);
+    case CompressFile::Deflate:
+        return new ZlibEncoder(MAX_WBITS, level);
+#ifdef QTNG_HAVE_ZSTD
+    case CompressFile::Zstd:
+        return new ZstdEncoder(level);
+#endif
+#ifdef QTNG_HAVE_BROTLI
+    case CompressFile::Brotli:
+        return new BrotliEncoder(level);
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+static StreamCodec *createDecoder(CompressFile::Method method)
+{
+    switch (method) {
+    case CompressFile::Gzip:
+    case CompressFile::Deflate:
+        return new ZlibDecoder();
+#ifdef QTNG_HAVE_ZSTD
+    case CompressFile::Zstd:
+        return new ZstdDecoder();
+#endif
+#ifdef QTNG_HAVE_BROTLI
+    case CompressFile::Brotli:
+        return new BrotliDecoder();
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+class CompressFilePrivate : public CodecFile
+{
+public:
+    CompressFilePrivate(CompressFile::Method method, QSharedPointer<FileLike> backend, int level)
+        : CodecFile(createEncoder(method, level), backend)
+    {
+    }
+};
+
+class DecompressFilePrivate : public CodecFile
+{
+public:
+    DecompressFilePrivate(CompressFile::Method method, QSharedPointer<FileLike> backend)
+        : CodecFile(createDecoder(method), backend)
+    {
+    }
+};
+
+CompressFile::CompressFile(Method method, QSharedPointer<FileLike> backend, int level)
+    : d_ptr(new CompressFilePrivate(method, backend, level))
+{
+}
+
+CompressFile::~CompressFile()
+{
+    delete d_ptr;
+}
+
+qint32 CompressFile::read(char *data, qint32 size)
+{
+    Q_D(CompressFile);
+    return d->read(data, size);
+}
+
+qint32 CompressFile::write(const char *data, qint32 size)
+{
+    Q_D(CompressFile);
+    return d->write(data, size);
+}
+
+void CompressFile::close()
+{
+    Q_D(CompressFile);
+    d->close();
+}
+
+bool CompressFile::isValid() const
+{
+    Q_D(const CompressFile);
+    return !d->hasError;
+}
+
+bool CompressFile::isSupported(Method method)
+{
+    switch (method) {
+    case Gzip:
+    case Deflate:
+        return true;
+#ifdef QTNG_HAVE_ZSTD
+    case Zstd:
+        return true;
+#endif
+#ifdef QTNG_HAVE_BROTLI
+    case Brotli:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+QByteArray CompressFile::encodingName(Method method)
+{
+    switch (method) {
+    case Gzip:
+        return QByteArray("gzip");
+    case Deflate:
+        return QByteArray("deflate");
+    case Zstd:
+        return QByteArray("zstd");
+    case Brotli:
+        return QByteArray("br");
+    }
+    return QByteArray();
+}
+
+bool CompressFile::fromEncodingName(const QByteArray &name, Method *method)
+{
+    const QByteArray &n = name.trimmed().toLower();
+    if (n == "gzip" || n == "x-gzip") {
+        *method = Gzip;
+    } else if (n == "deflate") {
+        *method = Deflate;
+    } else if (n == "zstd") {
+        *method = Zstd;
+    } else if (n == "br") {
+        *method = Brotli;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+DecompressFile::DecompressFile(CompressFile::Method method, QSharedPointer<FileLike> backend)
+    : d_ptr(new DecompressFilePrivate(method, backend))
+{
+}
+
+DecompressFile::~DecompressFile()
+{
+    delete d_ptr;
+}
+
+qint32 DecompressFile::read(char *data, qint32 size)
+{
+    Q_D(DecompressFile);
+    return d->read(data, size);
+}
+
+qint32 DecompressFile::write(const char *data, qint32 size)
+{
+    Q_D(DecompressFile);
+    return d->write(data, size);
+}
+
+void DecompressFile::close()
+{
+    Q_D(DecompressFile);
+    d->close();
+}
+
+bool DecompressFile::isValid() const
+{
+    Q_D(const DecompressFile);
+    return !d->hasError;
+}
+
+QList<QByteArray> supportedContentEncodings()
+{
+    QList<QByteArray> encodings;
+    const CompressFile::Method methods[] = { CompressFile::Brotli, CompressFile::Zstd, CompressFile::Gzip,
+                                             CompressFile::Deflate };
+    for (CompressFile::Method method : methods) {
+        if (CompressFile::isSupported(method)) {
+            encodings.append(CompressFile::encodingName(method));
+        }
+    }
+    return encodings;
+}
+
+QByteArray negotiateContentEncoding(const QByteArray &acceptEncoding, bool *identityAcceptable)
+{
+    // Accept-Encoding: br;q=1.0, gzip;q=0.8, *;q=0.1
+    QMap<QByteArray, float> qualities;
+    float wildcard = -1.0f;
+    for (const QByteArray &part : acceptEncoding.split(',')) {
+        const QList<QByteArray> &params = part.split(';');
+        const QByteArray &name = params.first().trimmed().toLower();
+        if (name.isEmpty()) {
+            continue;
+        }
+        float q = 1.0f;
+        for (int i = 1; i < params.size(); ++i) {
+            const QByteArray &param = params.at(i).trimmed();
+            if (param.startsWith("q=") || param.startsWith("Q=")) {
+                bool ok;
+                q = param.mid(2).toFloat(&ok);
+                if (!ok) {
+                    q = 0.0f;
+                }
+            }
+        }
+        if (name == "*") {
+            wildcard = q;
+        } else {
+            qualities.insert(name == "x-gzip" ? QByteArray("gzip") : name, q);
+        }
+    }
+    if (identityAcceptable) {
+        // identity is acceptable unless it is refused by q=0. the wildcard applies only if identity is not listed.
+        const float identity = qualities.value(QByteArray("identity"), wildcard);
+        *identityAcceptable = identity != 0.0f;
+    }
+    QByteArray best;
+    float bestQ = 0.0f;
+    // the supported encodings are in the order of preference, the first one wins if the qualities are equal.
+    for (const QByteArray &encoding : supportedContentEncodings()) {
+        float q = qualities.value(encoding, wildcard);
+        if (q > bestQ) {
+            best = encoding;
+            bestQ = q;
+        }
+    }
+    return best;
+}
+
 bool qGzipCompress(QSharedPointer<FileLike> input, QSharedPointer<FileLike> output, int level)
 {
     if (input.isNull() || output.isNull()) {
         return false;
     }
 
-    const int OutputBufferSize = 1024 * 32;
-    const int InputBufferSize = 1024 * 8;
-
     level = qMax(-1, qMin(9, level));
     z_stream zstream;
     zstream.zalloc = nullptr;
@@ -370,9 +1044,6 @@ bool qGzipDecompress(QSharedPointer<FileLike> input, QSharedPointer<FileLike> ou
     if (input.isNull() || output.isNull()) {
         return false;
     }
-    const int OutputBufferSize = 1024 * 32;
-    const int InputBufferSize = 1024 * 8;
-
     z_stream zstream;
     zstream.zalloc = nullptr;
     zstream.zfree = nullptr;
@@ -593,14 +593,14 @@ QSharedPointer<FileLike> HttpResponse::bodyAsFile(bool processEncoding)
         const QByteArray &contentEncodingHeader = header(QString::fromLatin1("Content-Encoding"));
         const QByteArray &transferEncodingHeader = header(QString::fromLatin1("Transfer-Encoding"));
 #ifdef QTNG_HAVE_ZLIB
-        if (contentEncodingHeader.toLower() == QByteArray("gzip")
-            || contentEncodingHeader.toLower() == QByteArray("deflate")) {
+        CompressFile::Method method;
+        if (CompressFile::fromEncodingName(contentEncodingHeader, &method) && CompressFile::isSupported(method)) {
             removeHeader(QString::fromLatin1("Content-Encoding"));
-            bodyFile = QSharedPointer<GzipDecompressFile>::create(bodyFile);
-        } else if (transferEncodingHeader.toLower() == QByteArray("gzip")
-                   || transferEncodingHeader.toLower() == QByteArray("deflate")) {
+            bodyFile = QSharedPointer<DecompressFile>::create(method, bodyFile);
+        } else if (CompressFile::fromEncodingName(transferEncodingHeader, &method)
+                   && CompressFile::isSupported(method)) {
             removeHeader(QString::fromLatin1("Transfer-Encoding"));
-            bodyFile = QSharedPointer<GzipDecompressFile>::create(bodyFile);
+            bodyFile = QSharedPointer<DecompressFile>::create(method, bodyFile);
         } else
 #endif
                 if (!contentEncodingHeader.isEmpty() || !transferEncodingHeader.isEmpty()) {
@@ -623,7 +623,7 @@ QByteArray HttpResponse::body()
     const QByteArray &data = bodyFile->readall(&ok);
     if (!ok) {
 #ifdef QTNG_HAVE_ZLIB
-        if (bodyFile.dynamicCast<GzipDecompressFile>()) {
+        if (bodyFile.dynamicCast<DecompressFile>()) {
             setError(new ContentDecodingError());
         } else
 #endif
@@ -787,8 +787,43 @@ void ConnectionPool::recycle(const QUrl &url, QSharedPointer<SocketLike> connect
     if (item.connections.size() < maxConnectionsPerServer) {
         item.connections.append(connection);
     }
+#ifndef QTNG_NO_CRYPTO
+    // TLS 1.3 servers send session tickets after the handshake, so update the session here.
+    QSharedPointer<SslSocket> ssl = convertSocketLikeToSslSocket(connection);
+    if (!ssl.isNull()) {
+        saveSslSession(hostOnly(url), ssl);
+    }
+#endif
+}
+
+#ifndef QTNG_NO_CRYPTO
+QByteArray ConnectionPool::findSslSession(const QUrl &h)
+{
+    SslSessionCacheItem *item = sslSessions.object(h);
+    if (!item) {
+        return QByteArray();
+    }
+    if (item->expiration.isValid() && item->expiration <= QDateTime::currentDateTimeUtc()) {
+        sslSessions.remove(h);
+        return QByteArray();
+    }
+    return item->session;
 }
 
+void ConnectionPool::saveSslSession(const QUrl &h, QSharedPointer<SslSocket> ssl)
+{
+    const QByteArray &session = ssl->session();
+    if (session.isEmpty()) {
+        return;
+    }
+    SslSessionCacheItem *item = new SslSessionCacheItem();
+    item->session = session;
+    item->expiration = ssl->sessionExpiration();
+    sslSessions.setMaxCost(qMax(1, items.size()));
+    sslSessions.insert(h, item);
+}
+#endif
+
 QSharedPointer<SocketLike> ConnectionPool::oldConnectionForUrl(const QUrl &url)
 {
     ConnectionPoolItem &item = getItem(url);
@@ -854,10 +889,14 @@ QSharedPointer<SocketLike> ConnectionPool::newConnectionForUrl(const QUrl &url,
     if (url.scheme() == QString::fromLatin1("https") || url.scheme() == QString::fromLatin1("wss")) {
 #ifndef QTNG_NO_CRYPTO
         QSharedPointer<SslSocket> ssl(new SslSocket(connection, sslConfig));
+        const QUrl &h = hostOnly(url);
+        ssl->setSession(findSslSession(h));
         if (!ssl->handshake(false, url.host())) {
+            sslSessions.remove(h);
             *error = new ConnectionError();
             return QSharedPointer<SocketLike>();
         }
+        saveSslSession(h, ssl);
         connection = asSocketLike(ssl);
 #else
         *error = new ConnectionError();
@@ -884,6 +923,9 @@ void ConnectionPool::removeUnusedConnections()
             }
         }
         items = newItems;
+#ifndef QTNG_NO_CRYPTO
+        sslSessions.setMaxCost(qMax(1, items.size()));
+#endif
     }
 }
 
@@ -1315,7 +1357,14 @@ QList<HttpHeader> HttpSessionPrivate::makeHeaders(HttpRequest &request, const QU
     }
     if (!request.hasHeader(QString::fromLatin1("Accept-Encoding"))) {
 #ifdef QTNG_HAVE_ZLIB
-        allHeaders.append(HttpHeader(QString::fromLatin1("Accept-Encoding"), QByteArray("gzip, deflate")));
+        QByteArray acceptEncoding;
+        for (const QByteArray &encoding : supportedContentEncodings()) {
+            if (!acceptEncoding.isEmpty()) {
+                acceptEncoding.append(", ");
+            }
+            acceptEncoding.append(encoding);
+        }
+        allHeaders.append(HttpHeader(QString::fromLatin1("Accept-Encoding"), acceptEncoding));
 #else
         allHeaders.append(HttpHeader(QString::fromLatin1("Accept-Encoding"), QByteArray("identity")));
 #endif
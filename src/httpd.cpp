@@ -1,5 +1,6 @@
 #include <QtCore/qmimedatabase.h>
 #include <QtCore/qcryptographichash.h>
+#include <QtCore/qvarlengtharray.h>
 #include <stdio.h>
 #include "../include/httpd.h"
 #ifdef QTNG_HAVE_ZLIB
@@ -34,6 +35,8 @@ BaseHttpRequestHandler::BaseHttpRequestHandler()
     , serverVersion(Http1_1)
     , requestTimeout(60 * 60)
     , maxBodySize(1024 * 1024 * 32)
+    , enableCompression(false)
+    , minCompressionSize(1024)
     , closeConnection(Maybe)
 {
 }
@@ -192,12 +195,7 @@ void BaseHttpRequestHandler::doGET()
         sendHeader("Content-Type", "text/html");
         sendHeader("Content-Length", QByteArray::number(body.size()));
     }
-    if (!endHeader()) {
-        return;
-    }
-    if (!body.isEmpty()) {
-        request->sendall(body);
-    }
+    endHeader(body);
 }
 
 void BaseHttpRequestHandler::doPOST()
@@ -262,13 +260,10 @@ bool BaseHttpRequestHandler::sendError(HttpStatus status, const QString &message
         sendHeader("Content-Length", QByteArray::number(body.size()));
         sendHeader("Content-Type", errorMessageContentType().toUtf8());
     }
-    if (!endHeader()) {
-        return false;
-    }
-    if (method.toUpper() != QLatin1String("HEAD") && !body.isEmpty()) {
-        return request->sendall(body) == body.size();
+    if (method.toUpper() == QLatin1String("HEAD")) {
+        body.clear();
     }
-    return true;
+    return endHeader(body);
 }
 
 bool BaseHttpRequestHandler::sendResponse(HttpStatus status, const QString &message)
@@ -326,33 +321,72 @@ void BaseHttpRequestHandler::sendHeader(const QByteArray &name, const QByteArray
     }
 }
 
-#if QT_VERSION >= QT_VERSION_CHECK(5, 4, 0)
-inline static QByteArray join(const QByteArrayList &lines)
-{
-    return lines.join();
-}
-#else
-inline static QByteArray join(const QList<QByteArray> &lines)
+bool BaseHttpRequestHandler::endHeader()
 {
-    QByteArray buf;
-    buf.reserve(1024 * 4 - 1);
-    for (const QByteArray &line : lines) {
-        buf.append(line);
-    }
-    return buf;
+    return endHeader(QByteArray());
 }
-#endif
 
-bool BaseHttpRequestHandler::endHeader()
+bool BaseHttpRequestHandler::endHeader(const QByteArray &body)
 {
     if (closeConnection == Maybe) {
         closeConnection = No;
         headerCache.append(QByteArray("Connection: keep-alive\r\n"));
     }
     headerCache.append("\r\n");
-    const QByteArray &data = join(headerCache);
+    QVarLengthArray<IoVector, 32> vectors;
+    qint32 total = 0;
+    for (const QByteArray &line : headerCache) {
+        vectors.append(IoVector(line));
+        total += line.size();
+    }
+    if (!body.isEmpty()) {
+        vectors.append(IoVector(body));
+        total += body.size();
+    }
+    bool success = request->sendv(vectors.constData(), vectors.size()) == total;
     headerCache.clear();
-    return request->sendall(data) == data.size();
+    return success;
+}
+
+bool BaseHttpRequestHandler::endHeaderCompressed(const QByteArray &body)
+{
+#ifdef QTNG_HAVE_ZLIB
+    if (enableCompression) {
+        // the response depends on Accept-Encoding even if it is not compressed this time.
+        sendHeader(QByteArray("Vary"), QByteArray("Accept-Encoding"));
+        bool identityAcceptable = true;
+        const QByteArray &encoding = chooseContentEncoding(&identityAcceptable);
+        CompressFile::Method method;
+        if ((body.size() >= minCompressionSize || !identityAcceptable) && !encoding.isEmpty()
+            && CompressFile::fromEncodingName(encoding, &method)) {
+            QSharedPointer<CompressFile> f(new CompressFile(method, FileLike::bytes(body)));
+            bool ok;
+            const QByteArray &compressed = f->readall(&ok);
+            if (ok && (compressed.size() < body.size() || !identityAcceptable)) {
+                sendHeader(ContentEncodingHeader, encoding);
+                sendHeader(ContentLengthHeader, QByteArray::number(compressed.size()));
+                return endHeader(compressed);
+            }
+        }
+        // if identity is refused and no supported encoding is acceptable, the status is decided already, so send the
+        // body as is, which disregards Accept-Encoding as RFC 9110 allows.
+    }
+#endif
+    sendHeader(ContentLengthHeader, QByteArray::number(body.size()));
+    return endHeader(body);
+}
+
+QByteArray BaseHttpRequestHandler::chooseContentEncoding(bool *identityAcceptable)
+{
+    if (identityAcceptable) {
+        *identityAcceptable = true;
+    }
+#ifdef QTNG_HAVE_ZLIB
+    if (enableCompression) {
+        return negotiateContentEncoding(header(AcceptEncodingHeader), identityAcceptable);
+    }
+#endif
+    return QByteArray();
 }
 
 QSharedPointer<FileLike> BaseHttpRequestHandler::bodyAsFile(bool processEncoding)
@@ -393,14 +427,14 @@ QSharedPointer<FileLike> BaseHttpRequestHandler::bodyAsFile(bool processEncoding
         const QByteArray &contentEncodingHeader = header(QString::fromLatin1("Content-Encoding"));
         const QByteArray &transferEncodingHeader = header(QString::fromLatin1("Transfer-Encoding"));
 #ifdef QTNG_HAVE_ZLIB
-        if (contentEncodingHeader.toLower() == QByteArray("gzip")
-            || contentEncodingHeader.toLower() == QByteArray("deflate")) {
+        CompressFile::Method method;
+        if (CompressFile::fromEncodingName(contentEncodingHeader, &method) && CompressFile::isSupported(method)) {
             removeHeader(QString::fromLatin1("Content-Encoding"));
-            bodyFile = QSharedPointer<GzipDecompressFile>::create(bodyFile);
-        } else if (transferEncodingHeader.toLower() == QByteArray("gzip")
-                   || transferEncodingHeader.toLower() == QByteArray("deflate")) {
+            bodyFile = QSharedPointer<DecompressFile>::create(method, bodyFile);
+        } else if (CompressFile::fromEncodingName(transferEncodingHeader, &method)
+                   && CompressFile::isSupported(method)) {
             removeHeader(QString::fromLatin1("Transfer-Encoding"));
-            bodyFile = QSharedPointer<GzipDecompressFile>::create(bodyFile);
+            bodyFile = QSharedPointer<DecompressFile>::create(method, bodyFile);
         } else if (transferEncodingHeader.toLower() == QByteArray("qt")) {
             bool ok;
             const QByteArray &compBody = bodyFile->readall(&ok);
@@ -511,6 +545,17 @@ void BaseHttpRequestHandler::logError(HttpStatus status, const QString &shortMes
 
 Q_GLOBAL_STATIC(QMimeDatabase, mimeDatabase);
 
+#ifdef QTNG_HAVE_ZLIB
+static bool isCompressible(const QString &contentType)
+{
+    const QString &t = contentType.toLower();
+    return t.startsWith(QLatin1String("text/")) || t.startsWith(QLatin1String("application/javascript"))
+            || t.startsWith(QLatin1String("application/json")) || t.startsWith(QLatin1String("application/xml"))
+            || t.startsWith(QLatin1String("image/svg+xml")) || t.contains(QLatin1String("+json"))
+            || t.contains(QLatin1String("+xml"));
+}
+#endif
+
 QSharedPointer<FileLike> StaticHttpRequestHandler::serveStaticFiles(const QDir &dir, const QString &subPath)
 {
     QUrl url = QUrl::fromEncoded(subPath.toLatin1());
@@ -568,19 +613,43 @@ QSharedPointer<FileLike> StaticHttpRequestHandler::serveStaticFiles(const QDir &
         contentType = ctype.name();
     }
 #endif
-    QSharedPointer<QFile> f(new QFile(fileInfo.filePath()));
-    if (!f->open(QIODevice::ReadOnly)) {
-        sendError(HttpStatus::NotFound, QString::fromLatin1("File not found"));
-        return QSharedPointer<FileLike>();
+    // read the file in thread pool to not block other requests while the disk is slow. the qt resources can not
+    // be opened by the os, fallback to QFile.
+    QSharedPointer<FileLike> f = AsyncFile::open(fileInfo.filePath());
+    if (f.isNull()) {
+        QSharedPointer<QFile> qf(new QFile(fileInfo.filePath()));
+        if (!qf->open(QIODevice::ReadOnly)) {
+            sendError(HttpStatus::NotFound, QString::fromLatin1("File not found"));
+            return QSharedPointer<FileLike>();
+        }
+        f = FileLike::rawFile(qf);
     }
     sendResponse(HttpStatus::OK);
     sendHeader(QByteArray("Content-Type"), contentType.toUtf8());
-    sendHeader(QByteArray("Content-Length"), QByteArray::number(f->size()));
     sendHeader(QByteArray("Last-Modified"), fileInfo.lastModified().toString(Qt::RFC2822Date).toUtf8());
+#ifdef QTNG_HAVE_ZLIB
+    if (enableCompression && isCompressible(contentType)) {
+        sendHeader(QByteArray("Vary"), QByteArray("Accept-Encoding"));
+        bool identityAcceptable = true;
+        const QByteArray &encoding = chooseContentEncoding(&identityAcceptable);
+        CompressFile::Method method;
+        if ((f->size() >= minCompressionSize || !identityAcceptable) && !encoding.isEmpty()
+            && CompressFile::fromEncodingName(encoding, &method)) {
+            // the compressed size is unknown before sending, so the body ends with the connection.
+            sendHeader(ContentEncodingHeader, encoding);
+            sendHeader(QByteArray("Connection"), QByteArray("close"));
+            if (!endHeader()) {
+                return QSharedPointer<FileLike>();
+            }
+            return QSharedPointer<CompressFile>::create(method, f);
+        }
+    }
+#endif
+    sendHeader(QByteArray("Content-Length"), QByteArray::number(f->size()));
     if (!endHeader()) {
         return QSharedPointer<FileLike>();
     }
-    return FileLike::rawFile(f);
+    return f;
 }
 
 QSharedPointer<FileLike> StaticHttpRequestHandler::listDirectory(const QDir &dir, const QString &displayDir)
@@ -637,11 +706,49 @@ QFileInfo StaticHttpRequestHandler::getIndexFile(const QDir &dir)
     }
 }
 
+// the regular file is sent by the kernel without copying it through userspace, if the connection is a plain tcp socket
+// or a ssl socket whose records are encrypted by the kernel. returns false if nothing is sent, `ok` tells whether the
+// whole file is sent otherwise.
+static bool sendFileByKernel(QSharedPointer<FileLike> f, QSharedPointer<SocketLike> connection, bool *ok)
+{
+    QSharedPointer<AsyncFile> file = f.dynamicCast<AsyncFile>();
+    if (file.isNull() || file->fileno() < 0 || file->size() < 0) {
+        return false;
+    }
+    QSharedPointer<Socket> socket = convertSocketLikeToSocket(connection);
+#ifndef QTNG_NO_CRYPTO
+    if (socket.isNull()) {
+        QSharedPointer<SslSocket> sslSocket = convertSocketLikeToSslSocket(connection);
+        if (!sslSocket.isNull() && sslSocket->isKernelTlsTx()) {
+            socket = convertSocketLikeToSocket(sslSocket->backend());
+        }
+    }
+#endif
+    if (socket.isNull()) {
+        return false;
+    }
+    const qint64 size = file->size() - file->pos();
+    if (size <= 0) {
+        *ok = true;
+        return true;
+    }
+    const qint64 sent = socket->sendfile(file->fileno(), file->pos(), size);
+    if (sent < 0) {
+        return false;
+    }
+    *ok = sent == size;
+    return true;
+}
+
 void SimpleHttpRequestHandler::doGET()
 {
     QSharedPointer<FileLike> f = serveStaticFiles(rootDir, path);
     if (!f.isNull()) {
-        if (!sendfile(f, request)) {
+        bool ok = false;
+        if (!sendFileByKernel(f, request, &ok)) {
+            ok = sendfile(f, request);
+        }
+        if (!ok) {
             request->close();
         }
         f->close();
@@ -1,12 +1,13 @@
 #include <QtCore/qdir.h>
 #include <QtCore/qdatetime.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qthreadstorage.h>
 #ifdef Q_OS_UNIX
 #include <unistd.h>
 #include <fcntl.h>
-#ifdef Q_OS_ANDROID
+#include <sys/stat.h>
 #include <errno.h>
 #endif
-#endif
 #include "../include/io_utils.h"
 #include "../include/coroutine_utils.h"
 #include "debugger.h"
@@ -183,9 +184,8 @@ static inline bool isTheMode(const QString &mode, const QString &essential)
     return t == essential;
 }
 
-QSharedPointer<RawFile> RawFile::open(const QString &filepath, const QString &mode)
+static bool toOpenMode(const QString &mode, QIODevice::OpenMode *result)
 {
-    QSharedPointer<QFile> f(new QFile(filepath));
     QIODevice::OpenMode flags = QIODevice::NotOpen;
     if (mode == QString() || isTheMode(mode, QString::fromUtf8("r"))) {
         flags |= QIODevice::ReadOnly;
@@ -213,8 +213,19 @@ QSharedPointer<RawFile> RawFile::open(const QString &filepath, const QString &mo
 #endif
     } else {
         qtng_warning << "unknown file mode:" << mode;
+        return false;
+    }
+    *result = flags;
+    return true;
+}
+
+QSharedPointer<RawFile> RawFile::open(const QString &filepath, const QString &mode)
+{
+    QIODevice::OpenMode flags;
+    if (!toOpenMode(mode, &flags)) {
         return QSharedPointer<RawFile>();
     }
+    QSharedPointer<QFile> f(new QFile(filepath));
     if (!f->open(flags)) {
         return QSharedPointer<RawFile>();
     } else {
@@ -267,6 +278,379 @@ QSharedPointer<FileLike> FileLike::open(const QString &filepath, const QString &
     return RawFile::open(filepath, mode).staticCast<FileLike>();
 }
 
+// the handle is shared with the jobs in thread pool, and closed after the last job finished. so the coroutine can be
+// killed while its job is running.
+class AsyncFileHandle
+{
+public:
+    AsyncFileHandle();
+    ~AsyncFileHandle();
+public:
+    bool open(const QString &filepath, QIODevice::OpenMode mode);
+    qint32 read(char *data, qint32 size, qint64 offset);
+    qint32 write(const char *data, qint32 size, qint64 offset);
+    qint64 size();
+    void willNeed(qint64 offset, qint64 length);
+public:
+#ifdef Q_OS_UNIX
+    int fd;
+#else
+    QFile f;
+    QMutex mutex;
+#endif
+    bool sequential;
+};
+
+AsyncFileHandle::AsyncFileHandle()
+#ifdef Q_OS_UNIX
+    : fd(-1)
+    , sequential(false)
+#else
+    : sequential(false)
+#endif
+{
+}
+
+AsyncFileHandle::~AsyncFileHandle()
+{
+#ifdef Q_OS_UNIX
+    if (fd >= 0) {
+        ::close(fd);
+    }
+#endif
+}
+
+bool AsyncFileHandle::open(const QString &filepath, QIODevice::OpenMode mode)
+{
+#ifdef Q_OS_UNIX
+    int flags = O_CLOEXEC;
+    if ((mode & QIODevice::ReadWrite) == QIODevice::ReadWrite) {
+        flags |= O_RDWR;
+    } else if (mode & QIODevice::WriteOnly) {
+        flags |= O_WRONLY;
+    } else {
+        flags |= O_RDONLY;
+    }
+    if (mode & QIODevice::WriteOnly) {
+        flags |= O_CREAT;
+        // the same as QFile, WriteOnly implies Truncate unless combined with ReadOnly or Append.
+        if ((mode & QIODevice::Truncate)
+            || !(mode & (QIODevice::ReadOnly | QIODevice::Append))) {
+            flags |= O_TRUNC;
+        }
+        if (mode & QIODevice::Append) {
+            flags |= O_APPEND;
+        }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+        if (mode & QIODevice::NewOnly) {
+            flags |= O_EXCL;
+        }
+#endif
+    }
+    const QByteArray &path = QFile::encodeName(filepath);
+    do {
+        fd = ::open(path.constData(), flags, 0666);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    sequential = ::fstat(fd, &st) == 0 && !S_ISREG(st.st_mode) && !S_ISBLK(st.st_mode);
+#ifdef Q_OS_LINUX
+    if (!sequential) {
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+    return true;
+#else
+    f.setFileName(filepath);
+    if (!f.open(mode)) {
+        return false;
+    }
+    sequential = f.isSequential();
+    return true;
+#endif
+}
+
+qint32 AsyncFileHandle::read(char *data, qint32 size, qint64 offset)
+{
+#ifdef Q_OS_UNIX
+    ssize_t r;
+    do {
+        if (sequential) {
+            r = ::read(fd, data, static_cast<size_t>(size));
+        } else {
+            r = ::pread(fd, data, static_cast<size_t>(size), offset);
+        }
+    } while (r < 0 && errno == EINTR);
+    return r < 0 ? -1 : static_cast<qint32>(r);
+#else
+    QMutexLocker locker(&mutex);
+    if (!sequential && !f.seek(offset)) {
+        return -1;
+    }
+    return static_cast<qint32>(f.read(data, size));
+#endif
+}
+
+qint32 AsyncFileHandle::write(const char *data, qint32 size, qint64 offset)
+{
+#ifdef Q_OS_UNIX
+    qint32 total = 0;
+    while (total < size) {
+        ssize_t r;
+        if (sequential) {
+            r = ::write(fd, data + total, static_cast<size_t>(size - total));
+        } else {
+            r = ::pwrite(fd, data + total, static_cast<size_t>(size - total), offset + total);
+        }
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return total > 0 ? total : -1;
+        } else if (r == 0) {
+            break;
+        }
+        total += static_cast<qint32>(r);
+    }
+    return total;
+#else
+    QMutexLocker locker(&mutex);
+    if (!sequential && !f.seek(offset)) {
+        return -1;
+    }
+    return static_cast<qint32>(f.write(data, size));
+#endif
+}
+
+qint64 AsyncFileHandle::size()
+{
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        return -1;
+    }
+    return st.st_size;
+#else
+    QMutexLocker locker(&mutex);
+    return f.size();
+#endif
+}
+
+void AsyncFileHandle::willNeed(qint64 offset, qint64 length)
+{
+#ifdef Q_OS_LINUX
+    if (!sequential) {
+        ::posix_fadvise(fd, offset, length, POSIX_FADV_WILLNEED);
+    }
+#else
+    Q_UNUSED(offset);
+    Q_UNUSED(length);
+#endif
+}
+
+class AsyncFilePrivate
+{
+public:
+    AsyncFilePrivate(QSharedPointer<AsyncFileHandle> handle, QSharedPointer<ThreadPool> pool,
+                     const QString &fileName)
+        : handle(handle)
+        , pool(pool)
+        , fileName(fileName)
+        , pos(0)
+        , readahead(1024 * 256)
+    {
+    }
+public:
+    QSharedPointer<AsyncFileHandle> handle;
+    QSharedPointer<ThreadPool> pool;
+    QString fileName;
+    qint64 pos;
+    qint64 readahead;
+};
+
+Q_GLOBAL_STATIC(QThreadStorage<QSharedPointer<ThreadPool>>, asyncFileThreadPools)
+
+QSharedPointer<ThreadPool> AsyncFile::defaultThreadPool()
+{
+    QThreadStorage<QSharedPointer<ThreadPool>> *pools = asyncFileThreadPools();
+    if (!pools->hasLocalData()) {
+        // the disk is slow for many concurrent requests, a few threads are enough.
+        pools->setLocalData(QSharedPointer<ThreadPool>::create(4));
+    }
+    return pools->localData();
+}
+
+AsyncFile::AsyncFile(AsyncFilePrivate *d)
+    : d_ptr(d)
+{
+}
+
+AsyncFile::~AsyncFile()
+{
+    delete d_ptr;
+}
+
+qint32 AsyncFile::readAt(qint64 offset, char *data, qint32 size)
+{
+    Q_D(AsyncFile);
+    if (d->handle.isNull() || size < 0) {
+        return -1;
+    }
+    if (size == 0) {
+        return 0;
+    }
+    // the job writes to its own buffer, because the caller may be killed before the job finished.
+    QSharedPointer<AsyncFileHandle> handle = d->handle;
+    QSharedPointer<QByteArray> buf(new QByteArray(size, Qt::Uninitialized));
+    QSharedPointer<qint32> result(new qint32(-1));
+    const qint64 readahead = d->readahead;
+    d->pool->call([handle, buf, result, offset, readahead] {
+        *result = handle->read(buf->data(), buf->size(), offset);
+        if (*result > 0 && readahead > 0) {
+            handle->willNeed(offset + *result, readahead);
+        }
+    });
+    if (*result > 0) {
+        memcpy(data, buf->constData(), static_cast<size_t>(*result));
+    }
+    return *result;
+}
+
+qint32 AsyncFile::writeAt(qint64 offset, const char *data, qint32 size)
+{
+    Q_D(AsyncFile);
+    if (d->handle.isNull() || size < 0) {
+        return -1;
+    }
+    if (size == 0) {
+        return 0;
+    }
+    QSharedPointer<AsyncFileHandle> handle = d->handle;
+    const QByteArray buf(data, size);
+    QSharedPointer<qint32> result(new qint32(-1));
+    d->pool->call([handle, buf, result, offset] { *result = handle->write(buf.constData(), buf.size(), offset); });
+    return *result;
+}
+
+qint32 AsyncFile::read(char *data, qint32 size)
+{
+    Q_D(AsyncFile);
+    qint32 r = readAt(d->pos, data, size);
+    if (r > 0) {
+        d->pos += r;
+    }
+    return r;
+}
+
+qint32 AsyncFile::write(const char *data, qint32 size)
+{
+    Q_D(AsyncFile);
+    qint32 r = writeAt(d->pos, data, size);
+    if (r > 0) {
+        d->pos += r;
+    }
+    return r;
+}
+
+void AsyncFile::close()
+{
+    Q_D(AsyncFile);
+    d->handle.clear();
+}
+
+qint64 AsyncFile::size()
+{
+    Q_D(AsyncFile);
+    // the size of pipes is unknown.
+    if (d->handle.isNull() || d->handle->sequential) {
+        return -1;
+    }
+    return d->handle->size();
+}
+
+bool AsyncFile::seek(qint64 pos)
+{
+    Q_D(AsyncFile);
+    if (d->handle.isNull() || d->handle->sequential || pos < 0) {
+        return false;
+    }
+    d->pos = pos;
+    return true;
+}
+
+qint64 AsyncFile::pos() const
+{
+    Q_D(const AsyncFile);
+    return d->pos;
+}
+
+qintptr AsyncFile::fileno() const
+{
+    Q_D(const AsyncFile);
+#ifdef Q_OS_UNIX
+    if (d->handle.isNull() || d->handle->sequential) {
+        return -1;
+    }
+    return d->handle->fd;
+#else
+    return -1;
+#endif
+}
+
+void AsyncFile::setReadahead(qint64 bytes)
+{
+    Q_D(AsyncFile);
+    d->readahead = qMax<qint64>(0, bytes);
+}
+
+qint64 AsyncFile::readahead() const
+{
+    Q_D(const AsyncFile);
+    return d->readahead;
+}
+
+QString AsyncFile::fileName() const
+{
+    Q_D(const AsyncFile);
+    return d->fileName;
+}
+
+QSharedPointer<AsyncFile> AsyncFile::open(const QString &filepath, const QString &mode,
+                                          QSharedPointer<ThreadPool> pool)
+{
+    QIODevice::OpenMode flags;
+    if (!toOpenMode(mode, &flags)) {
+        return QSharedPointer<AsyncFile>();
+    }
+    return open(filepath, flags, pool);
+}
+
+QSharedPointer<AsyncFile> AsyncFile::open(const QString &filepath, QIODevice::OpenMode mode,
+                                          QSharedPointer<ThreadPool> pool)
+{
+    if (pool.isNull()) {
+        pool = defaultThreadPool();
+    }
+    // open() may be blocked by slow disks or network file systems too.
+    QSharedPointer<AsyncFileHandle> handle(new AsyncFileHandle());
+    QSharedPointer<qint64> fileSize(new qint64(-1));
+    pool->call([handle, filepath, mode, fileSize] {
+        if (handle->open(filepath, mode)) {
+            *fileSize = handle->sequential ? 0 : handle->size();
+        }
+    });
+    if (*fileSize < 0) {
+        return QSharedPointer<AsyncFile>();
+    }
+    AsyncFilePrivate *d = new AsyncFilePrivate(handle, pool, filepath);
+    if (mode & QIODevice::Append) {
+        d->pos = *fileSize;
+    }
+    return QSharedPointer<AsyncFile>(new AsyncFile(d));
+}
+
 class BytesIOPrivate
 {
 public:
@@ -1,8 +1,14 @@
+#include <algorithm>
 #include <QtCore/qloggingcategory.h>
+#include <QtCore/qatomic.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qthreadstorage.h>
 #include "../include/config.h"
 #define MDB_IDL_LOGN 20  // can handle very large transaction.
 #include "../include/lmdb.h"
 #include "./liblmdb/lmdb.h"
+#include "../include/locks.h"
+#include "../include/coroutine_utils.h"
 #include "./debugger.h"
 
 QTNETWORKNG_NAMESPACE_BEGIN
@@ -31,8 +37,9 @@ public:
 class DatabasePrivate
 {
 public:
-    DatabasePrivate(MDB_txn *txn, MDB_dbi dbi, bool readOnly)
-        : txn(txn)
+    DatabasePrivate(MDB_txn *txn, MDB_dbi dbi, bool readOnly, QSharedPointer<LmdbSnapshot> snapshot)
+        : snapshot(snapshot)
+        , txn(txn)
         , dbi(dbi)
         , readOnly(readOnly)
     {
@@ -41,17 +48,35 @@ public:
     MDB_cursor *makeCursor();
     MDB_cursor *setCursor(const QByteArray &key, MDB_val &mdbKey, MDB_val &mdbData, MDB_cursor_op op = MDB_SET);
     LmdbIteratorPrivate *end(MDB_cursor *cursor = nullptr);
+    qint64 scan(const QByteArray &from, const QByteArray &to, const QByteArray &prefix,
+                const Database::Visitor &visitor);
+    inline LmdbValueView view(const MDB_val &mdbData) const
+    {
+        LmdbValueView v;
+        if (snapshot.isNull()) {
+            v.m_bytes = QByteArray(static_cast<const char *>(mdbData.mv_data), mdbData.mv_size);
+        } else {
+            v.m_bytes = QByteArray::fromRawData(static_cast<const char *>(mdbData.mv_data), mdbData.mv_size);
+            v.m_snapshot = snapshot;
+        }
+        return v;
+    }
 public:
+    QSharedPointer<LmdbSnapshot> snapshot;  // null if the transaction is not a top-level read-only one.
     MDB_txn * const txn;
     MDB_dbi dbi;
     bool readOnly;
 };
 
+class LmdbPrivate;
 class TransactionPrivate
 {
 public:
-    TransactionPrivate(MDB_env *env, MDB_txn *txn, bool readOnly)
-        : env(env)
+    TransactionPrivate(LmdbPrivate *lmdb, MDB_env *env, MDB_txn *txn, bool readOnly,
+                       TransactionPrivate *parent = nullptr)
+        : lmdb(lmdb)
+        , parent(parent)
+        , env(env)
         , txn(txn)
         , finished(false)
         , readOnly(readOnly)
@@ -59,20 +84,328 @@ public:
     }
 public:
     Database &open(const QString &name);
+    bool findDbi(const QString &name, MDB_dbi *dbi) const;
+    bool finish(bool commit);
 public:
     QMap<QString, QSharedPointer<Database>> dbs;
+    // the dbi handles opened by this transaction. they are valid for other transactions only after commit.
+    QMap<QString, MDB_dbi> newDbis;
+    QSharedPointer<Lock> writeLock;
+    QSharedPointer<LmdbSnapshot> snapshot;
+    LmdbPrivate * const lmdb;
+    TransactionPrivate * const parent;
     MDB_env * const env;
-    MDB_txn * const txn;
+    MDB_txn *txn;
     bool finished;
     bool readOnly;
 };
 
+struct LmdbSubmission
+{
+    std::function<bool(Transaction &)> func;
+    ValueEvent<bool> done;
+};
+
+class LmdbCommitter
+{
+public:
+    LmdbCommitter()
+        : writing(false)
+    {
+    }
+public:
+    QList<QSharedPointer<LmdbSubmission>> pending;
+    CoroutineGroup operations;
+    bool writing;
+};
+
+struct LmdbThreadData
+{
+    // mdb_txn_begin() blocks the whole thread for the writer mutex of lmdb, which deadlocks if another coroutine
+    // of this thread holds a write transaction. so the coroutines queue at this lock before the writer mutex.
+    QSharedPointer<Lock> writeLock;
+    QSharedPointer<LmdbCommitter> committer;
+};
+
+// a QThreadStorage member would not delete the data of other threads when it is destroyed, so the data of every Lmdb
+// is kept in one static storage. they are keyed by serial numbers, because the address of a new Lmdb may be reused.
+typedef QMap<quint32, LmdbThreadData> LmdbThreadDataMap;
+Q_GLOBAL_STATIC(QThreadStorage<LmdbThreadDataMap>, lmdbThreadData)
+static QAtomicInteger<quint32> lmdbSerialNumber;
+
 class LmdbPrivate
 {
+public:
+    LmdbPrivate()
+        : env(nullptr)
+        , maxIdleReaders(0)
+        , serialNumber(++lmdbSerialNumber)
+        , ref(1)
+    {
+    }
+    ~LmdbPrivate();
+public:
+    MDB_txn *takeReader();
+    void releaseReader(MDB_txn *txn);
+    LmdbThreadData &threadData();
+    QSharedPointer<Lock> writeLock();
+    QSharedPointer<Transaction> beginWrite();
+    QSharedPointer<LmdbCommitter> committer();
+    void groupCommit(LmdbCommitter *committer);
+    bool cachedDbi(const QString &name, MDB_dbi *dbi);
+    void cacheDbis(const QMap<QString, MDB_dbi> &newDbis);
 public:
     MDB_env *env;
+    QMutex mutex;
+    // the read transactions are reset but not aborted, so they keep their reader slots, and
+    // mdb_txn_renew() reuses them without allocation. MDB_NOTLS allows renewing them in any thread.
+    QList<MDB_txn *> idleReaders;
+    int maxIdleReaders;
+    QMap<QString, MDB_dbi> dbis;
+    const quint32 serialNumber;
+    QAtomicInt ref;  // the Lmdb, the running writer coroutines and the read snapshots.
+};
+
+// the read-only transaction is shared by its Transaction and the value views, and is reset after all of them are gone.
+class LmdbSnapshot
+{
+public:
+    LmdbSnapshot(LmdbPrivate *lmdb, MDB_txn *txn);
+    ~LmdbSnapshot();
+public:
+    QMap<QString, MDB_dbi> newDbis;
+    LmdbPrivate * const lmdb;
+    MDB_txn * const txn;
 };
 
+struct LmdbReference
+{
+    explicit LmdbReference(LmdbPrivate *d)
+        : d(d)
+    {
+    }
+    ~LmdbReference()
+    {
+        if (!d->ref.deref()) {
+            delete d;
+        }
+    }
+    LmdbPrivate * const d;
+};
+
+LmdbPrivate::~LmdbPrivate()
+{
+    // the data of other threads are deleted when they exit.
+    if (!lmdbThreadData.isDestroyed() && lmdbThreadData()->hasLocalData()) {
+        lmdbThreadData()->localData().remove(serialNumber);
+    }
+    for (MDB_txn *txn : idleReaders) {
+        mdb_txn_abort(txn);
+    }
+    idleReaders.clear();
+    if (env) {
+        mdb_env_close(env);
+    }
+}
+
+MDB_txn *LmdbPrivate::takeReader()
+{
+    MDB_txn *txn = nullptr;
+    {
+        QMutexLocker locker(&mutex);
+        if (!idleReaders.isEmpty()) {
+            txn = idleReaders.takeLast();
+        }
+    }
+    if (txn) {
+        int rt = mdb_txn_renew(txn);
+        if (rt == MDB_SUCCESS) {
+            return txn;
+        }
+#if QTLMDB_DEBUG
+        qtng_warning << "can not renew lmdb transaction:" << mdb_strerror(rt);
+#endif
+        mdb_txn_abort(txn);
+    }
+
+    unsigned int flags = MDB_RDONLY;
+    int rt = mdb_txn_begin(env, NULL, flags, &txn);
+    if (rt) {
+#if QTLMDB_DEBUG
+        qtng_warning << "can not begin lmdb transaction:" << mdb_strerror(rt);
+#endif
+        return nullptr;
+    }
+    return txn;
+}
+
+void LmdbPrivate::releaseReader(MDB_txn *txn)
+{
+    mdb_txn_reset(txn);
+    {
+        QMutexLocker locker(&mutex);
+        if (idleReaders.size() < maxIdleReaders) {
+            idleReaders.append(txn);
+            return;
+        }
+    }
+    mdb_txn_abort(txn);
+}
+
+LmdbThreadData &LmdbPrivate::threadData()
+{
+    return lmdbThreadData()->localData()[serialNumber];
+}
+
+QSharedPointer<Lock> LmdbPrivate::writeLock()
+{
+    LmdbThreadData &data = threadData();
+    if (data.writeLock.isNull()) {
+        data.writeLock = QSharedPointer<Lock>::create();
+    }
+    return data.writeLock;
+}
+
+QSharedPointer<Transaction> LmdbPrivate::beginWrite()
+{
+    QSharedPointer<Lock> lock = writeLock();
+    if (!lock->tryAcquire()) {
+        return QSharedPointer<Transaction>();
+    }
+    MDB_txn *txn;
+    unsigned int flags = 0;
+    int rt = mdb_txn_begin(env, NULL, flags, &txn);
+    if (rt) {
+#if QTLMDB_DEBUG
+        qtng_warning << "can not begin lmdb transaction:" << mdb_strerror(rt);
+#endif
+        lock->release();
+        return QSharedPointer<Transaction>();
+    }
+    TransactionPrivate *d = new TransactionPrivate(this, env, txn, false);
+    d->writeLock = lock;
+    return QSharedPointer<Transaction>(new Transaction(d));
+}
+
+QSharedPointer<LmdbCommitter> LmdbPrivate::committer()
+{
+    LmdbThreadData &data = threadData();
+    if (data.committer.isNull()) {
+        data.committer = QSharedPointer<LmdbCommitter>::create();
+    }
+    return data.committer;
+}
+
+void LmdbPrivate::groupCommit(LmdbCommitter *committer)
+{
+    unsigned int envFlags = 0;
+    mdb_env_get_flags(env, &envFlags);
+    // nested transactions are not supported with MDB_WRITEMAP. so the changes of a failed function can not be rolled
+    // back alone, the whole transaction is aborted, and the other functions run again in a new transaction.
+    const bool nested = !(envFlags & MDB_WRITEMAP);
+
+    while (!committer->pending.isEmpty()) {
+        QList<QSharedPointer<LmdbSubmission>> batch;
+        batch.swap(committer->pending);
+
+        // other coroutines may submit while we are waiting for the write lock. they join this batch.
+        QSharedPointer<Transaction> txn = beginWrite();
+        batch.append(committer->pending);
+        committer->pending.clear();
+        if (txn.isNull()) {
+            for (QSharedPointer<LmdbSubmission> submission : batch) {
+                submission->done.send(false);
+            }
+            continue;
+        }
+
+        QList<bool> results;
+        results.reserve(batch.size());
+        int failed = -1;
+        for (int i = 0; i < batch.size(); ++i) {
+            QSharedPointer<LmdbSubmission> submission = batch.at(i);
+            bool ok;
+            if (nested) {
+                QSharedPointer<Transaction> child = txn->sub();
+                if (child.isNull()) {
+                    ok = false;
+                } else if (submission->func(*child)) {
+                    ok = child->commit();
+                } else {
+                    child->abort();
+                    ok = false;
+                }
+            } else if (!submission->func(*txn)) {
+                failed = i;
+                break;
+            } else {
+                ok = true;
+            }
+            results.append(ok);
+        }
+        if (failed >= 0) {
+            txn->abort();
+            batch.takeAt(failed)->done.send(false);
+            batch.append(committer->pending);
+            committer->pending = batch;
+            continue;
+        }
+
+        bool committed = txn->commit();
+        for (int i = 0; i < batch.size(); ++i) {
+            batch.at(i)->done.send(committed && results.at(i));
+        }
+    }
+    committer->writing = false;
+}
+
+LmdbSnapshot::LmdbSnapshot(LmdbPrivate *lmdb, MDB_txn *txn)
+    : lmdb(lmdb)
+    , txn(txn)
+{
+    lmdb->ref.ref();
+}
+
+LmdbSnapshot::~LmdbSnapshot()
+{
+    if (newDbis.isEmpty()) {
+        lmdb->releaseReader(txn);
+    } else {
+        // the dbi handles opened by a read transaction are closed by mdb_txn_reset(), only commit keeps them.
+        // this transaction is freed by mdb_txn_commit(), and can not be returned to the pool.
+        int rt = mdb_txn_commit(txn);
+        if (rt == MDB_SUCCESS) {
+            lmdb->cacheDbis(newDbis);
+        } else {
+#if QTLMDB_DEBUG
+            qtng_warning << "can not commit lmdb transaction:" << mdb_strerror(rt);
+#endif
+        }
+    }
+    if (!lmdb->ref.deref()) {
+        delete lmdb;
+    }
+}
+
+bool LmdbPrivate::cachedDbi(const QString &name, MDB_dbi *dbi)
+{
+    QMutexLocker locker(&mutex);
+    QMap<QString, MDB_dbi>::const_iterator itor = dbis.constFind(name);
+    if (itor == dbis.constEnd()) {
+        return false;
+    }
+    *dbi = itor.value();
+    return true;
+}
+
+void LmdbPrivate::cacheDbis(const QMap<QString, MDB_dbi> &newDbis)
+{
+    QMutexLocker locker(&mutex);
+    for (QMap<QString, MDB_dbi>::const_iterator itor = newDbis.constBegin(); itor != newDbis.constEnd(); ++itor) {
+        dbis.insert(itor.key(), itor.value());
+    }
+}
+
 void LmdbIteratorPrivate::load(MDB_cursor_op op)
 {
     Q_ASSERT(cursor);
@@ -133,6 +466,54 @@ MDB_cursor *DatabasePrivate::setCursor(const QByteArray &key, MDB_val &mdbKey, M
     return cursor;
 }
 
+qint64 DatabasePrivate::scan(const QByteArray &from, const QByteArray &to, const QByteArray &prefix,
+                             const Database::Visitor &visitor)
+{
+    MDB_cursor *cursor = makeCursor();
+    if (!cursor) {
+        return -1;
+    }
+
+    MDB_val mdbKey, mdbData;
+    memset(&mdbData, 0, sizeof(MDB_val));
+    int rt;
+    if (from.isEmpty()) {
+        memset(&mdbKey, 0, sizeof(MDB_val));
+        rt = mdb_cursor_get(cursor, &mdbKey, &mdbData, MDB_FIRST);
+    } else {
+        mdbKey.mv_size = from.size();
+        mdbKey.mv_data = const_cast<char *>(from.constData());
+        rt = mdb_cursor_get(cursor, &mdbKey, &mdbData, MDB_SET_RANGE);
+    }
+
+    qint64 count = 0;
+    while (rt == MDB_SUCCESS) {
+        const QByteArray &key = QByteArray::fromRawData(static_cast<const char *>(mdbKey.mv_data), mdbKey.mv_size);
+        // the default comparison of lmdb is the same as QByteArray.
+        if (!to.isEmpty() && !(key < to)) {
+            break;
+        }
+        if (!prefix.isEmpty() && !key.startsWith(prefix)) {
+            break;
+        }
+        ++count;
+        const QByteArray &value =
+                QByteArray::fromRawData(static_cast<const char *>(mdbData.mv_data), mdbData.mv_size);
+        if (!visitor(key, value)) {
+            break;
+        }
+        rt = mdb_cursor_get(cursor, &mdbKey, &mdbData, MDB_NEXT);
+    }
+    mdb_cursor_close(cursor);
+
+    if (rt && rt != MDB_NOTFOUND) {
+#if QTLMDB_DEBUG
+        qtng_warning << "can not iterate lmdb cursor:" << mdb_strerror(rt);
+#endif
+    }
+    return count;
+}
+
 ConstLmdbIterator::~ConstLmdbIterator()
 {
     if (!d_ptr) {
@@ -357,6 +738,13 @@ qint64 Database::insert(const Database &other)
         return -1;
     }
 
+    // the items of other database are sorted, so they can be appended to an empty database.
+    unsigned int flags = 0;
+    MDB_stat stat;
+    if (mdb_stat(d_ptr->txn, d_ptr->dbi, &stat) == MDB_SUCCESS && stat.ms_entries == 0) {
+        flags = MDB_APPEND;
+    }
+
     qint64 count = 0;
     for (const_iterator itor = other.begin(); itor != other.end(); ++itor) {
         QByteArray &key = itor.d_ptr->key;
@@ -365,7 +753,7 @@ qint64 Database::insert(const Database &other)
         mdbKey.mv_size = key.size();
         mdbKey.mv_data = key.data();
 
-        int rt = mdb_cursor_put(cursor, &mdbKey, &itor.d_ptr->mdbValue, 0);
+        int rt = mdb_cursor_put(cursor, &mdbKey, &itor.d_ptr->mdbValue, flags);
         if (rt) {
 #if QTLMDB_DEBUG
             qtng_warning << "can not put lmdb value:" << mdb_strerror(rt);
@@ -379,6 +767,111 @@ qint64 Database::insert(const Database &other)
     return count;
 }
 
+LmdbValueView Database::valueView(const QByteArray &key) const
+{
+    if (isNull()) {
+        return LmdbValueView();
+    }
+
+    MDB_val mdbKey, mdbData;
+    mdbKey.mv_size = key.size();
+    mdbKey.mv_data = const_cast<char *>(key.constData());
+    int rt = mdb_get(d_ptr->txn, d_ptr->dbi, &mdbKey, &mdbData);
+    if (rt) {
+#if QTLMDB_DEBUG
+        if (rt != MDB_NOTFOUND) {
+            qtng_warning << "can not get lmdb value:" << mdb_strerror(rt);
+        }
+#endif
+        return LmdbValueView();
+    }
+    return d_ptr->view(mdbData);
+}
+
+QMap<QByteArray, LmdbValueView> Database::getMany(QList<QByteArray> keys) const
+{
+    QMap<QByteArray, LmdbValueView> result;
+    if (isNull()) {
+        return result;
+    }
+
+    MDB_cursor *cursor = d_ptr->makeCursor();
+    if (!cursor) {
+        return result;
+    }
+
+    // lmdb searches the current page of cursor first, so sorted keys mostly skip the descent from root.
+    std::sort(keys.begin(), keys.end());
+    for (const QByteArray &key : keys) {
+        if (key.isEmpty()) {
+            continue;
+        }
+        MDB_val mdbKey, mdbData;
+        mdbKey.mv_size = key.size();
+        mdbKey.mv_data = const_cast<char *>(key.constData());
+        int rt = mdb_cursor_get(cursor, &mdbKey, &mdbData, MDB_SET);
+        if (rt == MDB_SUCCESS) {
+            result.insert(key, d_ptr->view(mdbData));
+        } else if (rt != MDB_NOTFOUND) {
+#if QTLMDB_DEBUG
+            qtng_warning << "can not iterate lmdb cursor:" << mdb_strerror(rt);
+#endif
+            break;
+        }
+    }
+    mdb_cursor_close(cursor);
+    return result;
+}
+
+qint64 Database::forEach(const QByteArray &from, const QByteArray &to, const Visitor &visitor) const
+{
+    if (isNull()) {
+        return -1;
+    }
+    return d_ptr->scan(from, to, QByteArray(), visitor);
+}
+
+qint64 Database::forEachPrefix(const QByteArray &prefix, const Visitor &visitor) const
+{
+    if (isNull()) {
+        return -1;
+    }
+    return d_ptr->scan(prefix, QByteArray(), prefix, visitor);
+}
+
+qint64 Database::append(const QList<QPair<QByteArray, QByteArray>> &sortedItems)
+{
+    if (isNull() || d_ptr->readOnly) {
+        return -1;
+    }
+
+    MDB_cursor *cursor = d_ptr->makeCursor();
+    if (!cursor) {
+        return -1;
+    }
+
+    qint64 count = 0;
+    for (const QPair<QByteArray, QByteArray> &item : sortedItems) {
+        MDB_val mdbKey, mdbData;
+        mdbKey.mv_size = item.first.size();
+        mdbKey.mv_data = const_cast<char *>(item.first.constData());
+        mdbData.mv_size = item.second.size();
+        mdbData.mv_data = const_cast<char *>(item.second.constData());
+        int rt = mdb_cursor_put(cursor, &mdbKey, &mdbData, MDB_APPEND);
+        if (rt) {
+#if QTLMDB_DEBUG
+            // MDB_KEYEXIST if the items are not sorted.
+            qtng_warning << "can not append lmdb value:" << mdb_strerror(rt) << item.first;
+#endif
+            mdb_cursor_close(cursor);
+            return -1;
+        }
+        ++count;
+    }
+    mdb_cursor_close(cursor);
+    return count;
+}
+
 void Database::clear()
 {
     if (isNull() || d_ptr->readOnly) {
@@ -712,13 +1205,29 @@ Database::iterator Database::upperBound(const QByteArray &key)
     return itor;
 }
 
+bool TransactionPrivate::findDbi(const QString &name, MDB_dbi *dbi) const
+{
+    for (const TransactionPrivate *t = this; t; t = t->parent) {
+        QMap<QString, MDB_dbi>::const_iterator itor = t->newDbis.constFind(name);
+        if (itor != t->newDbis.constEnd()) {
+            *dbi = itor.value();
+            return true;
+        }
+    }
+    return lmdb->cachedDbi(name, dbi);
+}
+
 Database &TransactionPrivate::open(const QString &name)
 {
     static Database empty(nullptr);
 
     if (finished) {
-        if (readOnly) {
-            mdb_txn_renew(txn);
+        if (readOnly && !parent) {
+            txn = lmdb->takeReader();
+            if (!txn) {
+                return empty;
+            }
+            snapshot.reset(new LmdbSnapshot(lmdb, txn));
             finished = false;
         } else {
             return empty;
@@ -731,17 +1240,63 @@ Database &TransactionPrivate::open(const QString &name)
     }
 
     MDB_dbi dbi;
-    unsigned int flags = readOnly ? 0 : MDB_CREATE;
-    int rt = mdb_dbi_open(txn, name.toUtf8(), flags, &dbi);
-    if (rt < 0) {
-        return empty;
+    if (!findDbi(name, &dbi)) {
+        unsigned int flags = readOnly ? 0 : MDB_CREATE;
+        int rt = mdb_dbi_open(txn, name.toUtf8(), flags, &dbi);
+        if (rt) {
+            return empty;
+        }
+        newDbis.insert(name, dbi);
     }
-    QScopedPointer<DatabasePrivate> d(new DatabasePrivate(txn, dbi, readOnly));
+    QScopedPointer<DatabasePrivate> d(new DatabasePrivate(txn, dbi, readOnly, snapshot));
     QSharedPointer<Database> db(new Database(d.take()));
     dbs.insert(name, db);
     return *db;
 }
 
+bool TransactionPrivate::finish(bool commit)
+{
+    if (finished) {
+        return false;
+    }
+    dbs.clear();
+    finished = true;
+
+    int rt = MDB_SUCCESS;
+    if (readOnly && !parent) {
+        // the value views may still refer to this transaction.
+        snapshot->newDbis = newDbis;
+        snapshot.clear();
+    } else if (commit) {
+        rt = mdb_txn_commit(txn);
+        if (rt == MDB_SUCCESS) {
+            if (parent) {
+                for (QMap<QString, MDB_dbi>::const_iterator itor = newDbis.constBegin();
+                     itor != newDbis.constEnd(); ++itor) {
+                    parent->newDbis.insert(itor.key(), itor.value());
+                }
+            } else {
+                lmdb->cacheDbis(newDbis);
+            }
+        }
+    } else {
+        mdb_txn_abort(txn);
+    }
+    txn = nullptr;
+    newDbis.clear();
+    if (!writeLock.isNull()) {
+        writeLock->release();
+        writeLock.clear();
+    }
+    if (rt) {
+#if QTLMDB_DEBUG
+        qtng_warning << "can not commit lmdb transaction:" << mdb_strerror(rt);
+#endif
+        return false;
+    }
+    return true;
+}
+
 Transaction::~Transaction()
 {
     if (!d_ptr->finished) {
@@ -793,7 +1348,7 @@ QSharedPointer<Transaction> Transaction::sub()
 #endif
         return QSharedPointer<Transaction>();
     }
-    TransactionPrivate *d = new TransactionPrivate(d_ptr->env, child_txn, false);
+    TransactionPrivate *d = new TransactionPrivate(d_ptr->lmdb, d_ptr->env, child_txn, false, d_ptr);
     return QSharedPointer<Transaction>(new Transaction(d));
 }
 
@@ -811,65 +1366,79 @@ QSharedPointer<const Transaction> Transaction::sub() const
 #endif
         return QSharedPointer<const Transaction>();
     }
-    TransactionPrivate *d = new TransactionPrivate(d_ptr->env, child_txn, true);
+    TransactionPrivate *d = new TransactionPrivate(d_ptr->lmdb, d_ptr->env, child_txn, true, d_ptr);
     return QSharedPointer<Transaction>(new Transaction(d));
 }
 
 bool Transaction::commit()
 {
-    int rt = mdb_txn_commit(d_ptr->txn);
-    d_ptr->dbs.clear();
-    d_ptr->finished = true;
-    if (rt < 0) {
-#if QTLMDB_DEBUG
-        qtng_warning << "can not commit lmdb transaction:" << mdb_strerror(rt);
-#endif
-        return false;
-    }
-    return true;
+    return d_ptr->finish(true);
 }
 
 void Transaction::abort()
 {
-    mdb_txn_abort(d_ptr->txn);
-    d_ptr->dbs.clear();
-    d_ptr->finished = true;
+    d_ptr->finish(false);
 }
 
 Lmdb::~Lmdb()
 {
-    mdb_env_close(d_ptr->env);
-    delete d_ptr;
+    if (!d_ptr->ref.deref()) {
+        delete d_ptr;
+    }
 }
 
 QSharedPointer<const Transaction> Lmdb::toRead()
 {
-    MDB_txn *txn;
-    unsigned int flags = MDB_RDONLY;
-    int rt = mdb_txn_begin(d_ptr->env, NULL, flags, &txn);
-    if (rt) {
-#if QTLMDB_DEBUG
-        qtng_warning << "can not begin lmdb transaction:" << mdb_strerror(rt);
-#endif
+    MDB_txn *txn = d_ptr->takeReader();
+    if (!txn) {
         return QSharedPointer<const Transaction>();
     }
-    TransactionPrivate *d = new TransactionPrivate(d_ptr->env, txn, true);
+    TransactionPrivate *d = new TransactionPrivate(d_ptr, d_ptr->env, txn, true);
+    d->snapshot.reset(new LmdbSnapshot(d_ptr, txn));
     return QSharedPointer<const Transaction>(new Transaction(d));
 }
 
 QSharedPointer<Transaction> Lmdb::toWrite()
 {
-    MDB_txn *txn;
-    unsigned int flags = 0;
-    int rt = mdb_txn_begin(d_ptr->env, NULL, flags, &txn);
-    if (rt) {
-#if QTLMDB_DEBUG
-        qtng_warning << "can not begin lmdb transaction:" << mdb_strerror(rt);
-#endif
-        return QSharedPointer<Transaction>();
+    return d_ptr->beginWrite();
+}
+
+bool Lmdb::submit(const std::function<bool(Transaction &)> &func)
+{
+    QSharedPointer<LmdbSubmission> submission(new LmdbSubmission());
+    submission->func = func;
+    QSharedPointer<LmdbCommitter> committer = d_ptr->committer();
+    committer->pending.append(submission);
+    if (!committer->writing) {
+        committer->writing = true;
+        // the submitters may delete the Lmdb after they are done, while the writer is finishing.
+        LmdbPrivate *d = d_ptr;
+        d->ref.ref();
+        committer->operations.spawn([d, committer] {
+            LmdbReference reference(d);
+            d->groupCommit(committer.data());
+        });
     }
-    TransactionPrivate *d = new TransactionPrivate(d_ptr->env, txn, false);
-    return QSharedPointer<Transaction>(new Transaction(d));
+    return submission->done.tryWait();
+}
+
+bool Lmdb::submit(const QString &dbName, const QMap<QByteArray, QByteArray> &items)
+{
+    return submit([dbName, items](Transaction &txn) -> bool {
+        Database &db = txn.db(dbName);
+        if (db.isNull()) {
+            return false;
+        }
+        for (QMap<QByteArray, QByteArray>::const_iterator itor = items.constBegin(); itor != items.constEnd();
+             ++itor) {
+            if (itor.value().isNull()) {
+                db.remove(itor.key());
+            } else if (db.insert(itor.key(), itor.value()).isEnd() && !itor.value().isEmpty()) {
+                return false;
+            }
+        }
+        return true;
+    });
 }
 
 QString Lmdb::version() const
@@ -940,8 +1509,10 @@ QSharedPointer<Lmdb> LmdbBuilder::create()
 {
     Q_ASSERT(!m_dirPath.isEmpty());
     QScopedPointer<LmdbPrivate> d(new LmdbPrivate());
+    d->maxIdleReaders = qMax(1, m_maxReaders / 2);
     int rt = mdb_env_create(&d->env);
     if (rt) {
+        d->env = nullptr;
 #if QTLMDB_DEBUG
         qtng_warning << "can not create lmdb env:" << mdb_strerror(rt);
 #endif
@@ -1,3 +1,4 @@
+#include <QtCore/qvector.h>
 #include "../include/md.h"
 #include "../include/private/crypto_p.h"
 
@@ -46,20 +47,26 @@ public:
     MessageDigestPrivate(MessageDigest::Algorithm algo);
     ~MessageDigestPrivate();
     void addData(const char *buf, int len);
+    bool finish();
     QByteArray result();
+    void reset();
     EVP_MD_CTX *context;
-    QByteArray finalData;
+    const EVP_MD *md;
+    unsigned char finalData[EVP_MAX_MD_SIZE];  // kept in place, so result(char *) does not allocate.
+    int finalSize;  // -1 if not finished.
     MessageDigest::Algorithm algo;
     bool hasError;
 };
 
 MessageDigestPrivate::MessageDigestPrivate(MessageDigest::Algorithm algo)
     : context(nullptr)
+    , md(nullptr)
+    , finalSize(-1)
     , algo(algo)
     , hasError(false)
 {
     initOpenSSL();
-    const EVP_MD *md = getOpenSSL_MD(algo);
+    md = getOpenSSL_MD(algo);
 
     if (!md) {
         hasError = true;
@@ -96,25 +103,39 @@ void MessageDigestPrivate::addData(const char *buf, int len)
     hasError = !rvalue;
 }
 
-QByteArray MessageDigestPrivate::result()
+bool MessageDigestPrivate::finish()
 {
     if (hasError) {
-        return QByteArray();
+        return false;
     }
-    if (!finalData.isEmpty()) {
-        return finalData;
+    if (finalSize >= 0) {
+        return true;
     }
     unsigned int len;
-    finalData.resize(EVP_MAX_MD_SIZE);
-    int rvalue = EVP_DigestFinal_ex(context, reinterpret_cast<unsigned char *>(finalData.data()), &len);
-    if (!rvalue) {
+    if (!EVP_DigestFinal_ex(context, finalData, &len)) {
         hasError = true;
-        finalData.clear();
-    } else {
-        finalData.resize(static_cast<int>(len));
+        return false;
     }
+    finalSize = static_cast<int>(len);
+    return true;
+}
 
-    return finalData;
+QByteArray MessageDigestPrivate::result()
+{
+    if (!finish()) {
+        return QByteArray();
+    }
+    return QByteArray(reinterpret_cast<const char *>(finalData), finalSize);
+}
+
+void MessageDigestPrivate::reset()
+{
+    finalSize = -1;
+    if (!context || !md) {
+        return;
+    }
+    // the context is reused if the digest is not changed.
+    hasError = !EVP_DigestInit_ex(context, md, nullptr);
 }
 
 MessageDigest::MessageDigest(MessageDigest::Algorithm algo)
@@ -139,6 +160,87 @@ QByteArray MessageDigest::result()
     return d->result();
 }
 
+void MessageDigest::reset()
+{
+    Q_D(MessageDigest);
+    d->reset();
+}
+
+int MessageDigest::digestSize() const
+{
+    Q_D(const MessageDigest);
+    return d->md ? EVP_MD_size(d->md) : 0;
+}
+
+bool MessageDigest::result(char *out)
+{
+    Q_D(MessageDigest);
+    if (!d->finish()) {
+        return false;
+    }
+    memcpy(out, d->finalData, static_cast<size_t>(d->finalSize));
+    return true;
+}
+
+bool MessageDigest::digestMany(const char * const *data, const int *lens, int count, Algorithm algo, char *out)
+{
+    // LibreSSL does not provide the multi-buffer (SIMD) hash functions, hash them one by one with one context.
+    initOpenSSL();
+    const EVP_MD *md = getOpenSSL_MD(algo);
+    EVP_MD_CTX *context = md ? EVP_MD_CTX_new() : nullptr;
+    if (!context) {
+        cleanupOpenSSL();
+        return false;
+    }
+    const int size = EVP_MD_size(md);
+    bool ok = true;
+    for (int i = 0; i < count && ok; ++i) {
+        unsigned int len;
+        ok = EVP_DigestInit_ex(context, md, nullptr) && EVP_DigestUpdate(context, data[i], static_cast<size_t>(lens[i]))
+                && EVP_DigestFinal_ex(context, reinterpret_cast<unsigned char *>(out) + i * size, &len);
+    }
+    EVP_MD_CTX_free(context);
+    cleanupOpenSSL();
+    return ok;
+}
+
+QList<QByteArray> MessageDigest::digestMany(const QList<QByteArray> &data, Algorithm algo)
+{
+    QList<QByteArray> result;
+    if (data.isEmpty()) {
+        return result;
+    }
+    QVector<const char *> pointers(data.size());
+    QVector<int> lens(data.size());
+    for (int i = 0; i < data.size(); ++i) {
+        pointers[i] = data.at(i).constData();
+        lens[i] = data.at(i).size();
+    }
+    const EVP_MD *md = getOpenSSL_MD(algo);
+    if (!md) {
+        return result;
+    }
+    const int size = EVP_MD_size(md);
+    QByteArray out(size * data.size(), Qt::Uninitialized);
+    if (!digestMany(pointers.constData(), lens.constData(), data.size(), algo, out.data())) {
+        return result;
+    }
+    result.reserve(data.size());
+    for (int i = 0; i < data.size(); ++i) {
+        result.append(out.mid(i * size, size));
+    }
+    return result;
+}
+
+QList<QByteArray> MessageDigest::hashMany(const QList<QByteArray> &data, Algorithm algo)
+{
+    QList<QByteArray> result = digestMany(data, algo);
+    for (int i = 0; i < result.size(); ++i) {
+        result[i] = result.at(i).toHex();
+    }
+    return result;
+}
+
 QByteArray PBKDF2_HMAC(int keylen, const QByteArray &password, const QByteArray &salt,
                        const MessageDigest::Algorithm hashAlgo, int i)
 {
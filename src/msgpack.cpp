@@ -1,12 +1,14 @@
 #include <QtCore/qbuffer.h>
 #include <QtCore/qdebug.h>
+#include <QtCore/qqueue.h>
 #include "../include/msgpack.h"
+#include "../include/socket_utils.h"
 
 #undef CHECK_STREAM_PRECOND
 #ifndef QT_NO_DEBUG
 #  define CHECK_STREAM_PRECOND(retVal)              \
     Q_D(MsgPackStream);                             \
-    if (!d->dev) {                                  \
+    if (!d->hasTarget()) {                          \
       qWarning("msgpack::Stream: No device");       \
       return retVal;                                \
     }                                               \
@@ -17,7 +19,7 @@
 #else
 #  define CHECK_STREAM_PRECOND(retVal) \
     Q_D(MsgPackStream);                \
-    if (!d->dev) {                     \
+    if (!d->hasTarget()) {             \
       return retVal;                   \
     }                                  \
     if (d->status != Ok) {             \
@@ -76,11 +78,18 @@ public:
     MsgPackStreamPrivate(const QByteArray &a);
     ~MsgPackStreamPrivate();
 public:
+    // a stream without device reads from or writes to the byte array directly.
+    enum Mode { DeviceMode, ReadBufferMode, WriteBufferMode };
+    bool hasTarget() const { return dev || mode != DeviceMode; }
     bool readBytes(char *data, qint64 len);
     inline bool readBytes(quint8 *data, int len);
     bool readArrayHeader(quint32 &len);
     bool readMapHeader(quint32 &len);
     bool readExtHeader(quint32 &len, quint8 &msgpackType);
+    bool readStringHeader(quint32 &len);
+    bool skipBytes(qint64 len);
+    bool skipHeader(quint64 *values);
+    bool skip();
     bool writeBytes(const char *data, qint64 len);
     inline bool writeBytes(const quint8 *data, int len);
     bool writeArrayHeader(quint32 len);
@@ -93,6 +102,12 @@ public:
 public:
     QMap<intptr_t, MsgPackExtUserData *> userData;
     QIODevice *dev;
+    QByteArray readData;  // keep the data of readPos alive.
+    const char *readPos;
+    const char *readEnd;
+    QByteArray *writeData;
+    int writePos;
+    Mode mode;
     MsgPackStream::Status status;
     quint32 limit;
     int version;
@@ -102,6 +117,11 @@ public:
 
 MsgPackStreamPrivate::MsgPackStreamPrivate()
     : dev(nullptr)
+    , readPos(nullptr)
+    , readEnd(nullptr)
+    , writeData(nullptr)
+    , writePos(0)
+    , mode(DeviceMode)
     , status(MsgPackStream::Ok)
     , limit(std::numeric_limits<quint32>::max())
     , version(0)
@@ -112,6 +132,11 @@ MsgPackStreamPrivate::MsgPackStreamPrivate()
 
 MsgPackStreamPrivate::MsgPackStreamPrivate(QIODevice *d)
     : dev(d)
+    , readPos(nullptr)
+    , readEnd(nullptr)
+    , writeData(nullptr)
+    , writePos(0)
+    , mode(DeviceMode)
     , status(MsgPackStream::Ok)
     , limit(std::numeric_limits<quint32>::max())
     , version(0)
@@ -121,32 +146,56 @@ MsgPackStreamPrivate::MsgPackStreamPrivate(QIODevice *d)
 }
 
 MsgPackStreamPrivate::MsgPackStreamPrivate(QByteArray *a, QIODevice::OpenMode mode)
-    : status(MsgPackStream::Ok)
+    : dev(nullptr)
+    , readPos(nullptr)
+    , readEnd(nullptr)
+    , writeData(nullptr)
+    , writePos(0)
+    , status(MsgPackStream::Ok)
     , version(0)
-    , owndev(true)
+    , owndev(false)
     , flushWrites(false)
 {
-    QBuffer *buf = new QBuffer(a);
-    buf->open(mode);
-    dev = buf;
-    if (mode == QIODevice::ReadOnly) {
+    // the same as QBuffer: Truncate clears the array, Append starts from the end, otherwise starts from the beginning.
+    if ((mode & QIODevice::ReadWrite) == QIODevice::ReadOnly && !(mode & (QIODevice::Append | QIODevice::Truncate))) {
+        this->mode = ReadBufferMode;
+        readData = *a;
+        readPos = readData.constData();
+        readEnd = readPos + readData.size();
         limit = a->size();
+    } else if (!(mode & QIODevice::ReadOnly)) {
+        this->mode = WriteBufferMode;
+        writeData = a;
+        if (mode & QIODevice::Truncate) {
+            a->clear();
+        }
+        writePos = (mode & QIODevice::Append) ? a->size() : 0;
+        limit = std::numeric_limits<quint32>::max();
     } else {
+        // reading and writing share one position, leave it to QBuffer.
+        this->mode = DeviceMode;
+        QBuffer *buf = new QBuffer(a);
+        buf->open(mode);
+        dev = buf;
+        owndev = true;
         limit = std::numeric_limits<quint32>::max();
     }
 }
 
 MsgPackStreamPrivate::MsgPackStreamPrivate(const QByteArray &a)
-    : status(MsgPackStream::Ok)
+    : dev(nullptr)
+    , readData(a)
+    , readPos(readData.constData())
+    , readEnd(readData.constData() + readData.size())
+    , writeData(nullptr)
+    , writePos(0)
+    , mode(ReadBufferMode)
+    , status(MsgPackStream::Ok)
     , limit(a.size())
     , version(0)
-    , owndev(true)
+    , owndev(false)
     , flushWrites(false)
 {
-    QBuffer *buf = new QBuffer();
-    buf->setData(a);
-    buf->open(QIODevice::ReadOnly);
-    dev = buf;
 }
 
 MsgPackStreamPrivate::~MsgPackStreamPrivate()
@@ -166,11 +215,20 @@ bool MsgPackStreamPrivate::readBytes(char *data, qint64 len)
     if (status != MsgPackStream::Ok) {
         return false;
     }
-    if (!dev) {
-        status = MsgPackStream::ReadPastEnd;
+    if (len > limit) {
         return false;
     }
-    if (len > limit) {
+    if (mode == ReadBufferMode) {
+        if (len > readEnd - readPos) {
+            status = MsgPackStream::ReadPastEnd;
+            return false;
+        }
+        memcpy(data, readPos, static_cast<size_t>(len));
+        readPos += len;
+        return true;
+    }
+    if (!dev) {
+        status = MsgPackStream::ReadPastEnd;
         return false;
     }
     qint64 total = 0;
@@ -235,7 +293,7 @@ bool MsgPackStreamPrivate::readMapHeader(quint32 &len)
 
 bool MsgPackStreamPrivate::readExtHeader(quint32 &len, quint8 &msgpackType)
 {
-    if (!dev || status != MsgPackStream::Ok) {
+    if (!hasTarget() || status != MsgPackStream::Ok) {
         return false;
     }
     quint8 p[6];
@@ -419,14 +477,14 @@ bool MsgPackStreamPrivate::unpack_ulonglong(quint64 &u64)
     return true;
 }
 
-bool MsgPackStreamPrivate::unpackString(QString &s)
+bool MsgPackStreamPrivate::readStringHeader(quint32 &len)
 {
     quint8 p[5];
     if (!readBytes(p, 1)) {
         return false;
     }
 
-    quint32 len = 0;
+    len = 0;
     if (p[0] >= FirstByte::FIXSTR && p[0] <= (FirstByte::FIXSTR + 0x1f)) {  // fixstr
         len = p[0] - FirstByte::FIXSTR;
     } else if (p[0] == FirstByte::STR8) {
@@ -457,6 +515,133 @@ bool MsgPackStreamPrivate::unpackString(QString &s)
         status = MsgPackStream::ReadCorruptData;
         return false;
     }
+    return true;
+}
+
+bool MsgPackStreamPrivate::skipBytes(qint64 len)
+{
+    if (status != MsgPackStream::Ok) {
+        return false;
+    }
+    if (len > limit) {
+        status = MsgPackStream::ReadCorruptData;
+        return false;
+    }
+    if (mode == ReadBufferMode) {
+        if (len > readEnd - readPos) {
+            status = MsgPackStream::ReadPastEnd;
+            return false;
+        }
+        readPos += len;
+        return true;
+    }
+    char buf[1024 * 4];
+    while (len > 0) {
+        qint64 bs = qMin<qint64>(len, sizeof(buf));
+        if (!readBytes(buf, bs)) {
+            return false;
+        }
+        len -= bs;
+    }
+    return true;
+}
+
+// skip the header and the payload of one value, `values` is set to the number of nested values following it.
+bool MsgPackStreamPrivate::skipHeader(quint64 *values)
+{
+    quint8 p[5];
+    if (!readBytes(p, 1)) {
+        return false;
+    }
+    const quint8 b = p[0];
+    qint64 bytes = 0;
+    *values = 0;
+    if (b <= FirstByte::POSITIVE_FIXINT || b >= FirstByte::NEGATIVE_FIXINT) {
+    } else if (b < FirstByte::FIXARRAY) {
+        *values = (b & 0xf) * 2;
+    } else if (b < FirstByte::FIXSTR) {
+        *values = b & 0xf;
+    } else if (b < FirstByte::NIL) {
+        bytes = b - FirstByte::FIXSTR;
+    } else if (b == FirstByte::NIL || b == FirstByte::MFALSE || b == FirstByte::MTRUE) {
+    } else if (b == FirstByte::NEVER_USED) {
+        status = MsgPackStream::ReadCorruptData;
+        return false;
+    } else if (b == FirstByte::BIN8 || b == FirstByte::STR8) {
+        if (!readBytes(p + 1, 1)) {
+            return false;
+        }
+        bytes = p[1];
+    } else if (b == FirstByte::BIN16 || b == FirstByte::STR16) {
+        if (!readBytes(p + 1, 2)) {
+            return false;
+        }
+        bytes = _msgpack_load16(p + 1);
+    } else if (b == FirstByte::BIN32 || b == FirstByte::STR32) {
+        if (!readBytes(p + 1, 4)) {
+            return false;
+        }
+        bytes = _msgpack_load32(p + 1);
+    } else if (b == FirstByte::EXT8) {
+        if (!readBytes(p + 1, 1)) {
+            return false;
+        }
+        bytes = p[1] + 1;
+    } else if (b == FirstByte::EXT16) {
+        if (!readBytes(p + 1, 2)) {
+            return false;
+        }
+        bytes = _msgpack_load16(p + 1) + 1;
+    } else if (b == FirstByte::EXT32) {
+        if (!readBytes(p + 1, 4)) {
+            return false;
+        }
+        bytes = static_cast<qint64>(_msgpack_load32(p + 1)) + 1;
+    } else if (b == FirstByte::FLOAT32 || b == FirstByte::UINT32 || b == FirstByte::INT32) {
+        bytes = 4;
+    } else if (b == FirstByte::FLOAT64 || b == FirstByte::UINT64 || b == FirstByte::INT64) {
+        bytes = 8;
+    } else if (b == FirstByte::UINT8 || b == FirstByte::INT8) {
+        bytes = 1;
+    } else if (b == FirstByte::UINT16 || b == FirstByte::INT16) {
+        bytes = 2;
+    } else if (b >= FirstByte::FIXEXT1 && b <= FirstByte::FIXEX16) {
+        bytes = 1 + (1 << (b - FirstByte::FIXEXT1));
+    } else if (b == FirstByte::ARRAY16 || b == FirstByte::MAP16) {
+        if (!readBytes(p + 1, 2)) {
+            return false;
+        }
+        *values = _msgpack_load16(p + 1) * (b == FirstByte::MAP16 ? 2 : 1);
+    } else {  // ARRAY32 and MAP32
+        if (!readBytes(p + 1, 4)) {
+            return false;
+        }
+        *values = static_cast<quint64>(_msgpack_load32(p + 1)) * (b == FirstByte::MAP32 ? 2 : 1);
+    }
+    return bytes <= 0 || skipBytes(bytes);
+}
+
+// iterate instead of recursion, so the deeply nested data can not overflow the stack.
+bool MsgPackStreamPrivate::skip()
+{
+    quint64 pending = 1;
+    while (pending > 0) {
+        --pending;
+        quint64 values;
+        if (!skipHeader(&values)) {
+            return false;
+        }
+        pending += values;
+    }
+    return true;
+}
+
+bool MsgPackStreamPrivate::unpackString(QString &s)
+{
+    quint32 len = 0;
+    if (!readStringHeader(len)) {
+        return false;
+    }
     QByteArray buf;
     if (len > 0) {
         buf.resize(static_cast<int>(len));
@@ -515,8 +700,11 @@ bool MsgPackStreamPrivate::unpack(QVariant &v)
             }
         }
         v = QString::fromUtf8(bs);
-    } else if (p[0] == FirstByte::NIL || p[0] == FirstByte::NEVER_USED) {
+    } else if (p[0] == FirstByte::NIL) {
         v.clear();
+    } else if (p[0] == FirstByte::NEVER_USED) {
+        status = MsgPackStream::ReadCorruptData;
+        return false;
     } else if (p[0] == FirstByte::MFALSE) {
         v = false;
     } else if (p[0] == FirstByte::MTRUE) {
@@ -885,6 +1073,23 @@ bool MsgPackStreamPrivate::writeBytes(const char *data, qint64 len)
     if (status != MsgPackStream::Ok) {
         return false;
     }
+    if (mode == WriteBufferMode) {
+        if (len > std::numeric_limits<int>::max() - writePos) {
+            status = MsgPackStream::WriteFailed;
+            return false;
+        }
+        const int n = static_cast<int>(len);
+        if (writePos == writeData->size()) {
+            writeData->append(data, n);  // amortized growth.
+        } else {
+            if (writePos + n > writeData->size()) {
+                writeData->resize(writePos + n);
+            }
+            memcpy(writeData->data() + writePos, data, static_cast<size_t>(n));
+        }
+        writePos += n;
+        return true;
+    }
     if (!dev) {
         status = MsgPackStream::WriteFailed;
         return false;
@@ -960,7 +1165,7 @@ bool MsgPackStreamPrivate::writeExtHeader(quint32 len, quint8 msgpackType)
     if (status != MsgPackStream::Ok) {
         return false;
     }
-    if (!dev) {
+    if (!hasTarget()) {
         status = MsgPackStream::WriteFailed;
         return false;
     }
@@ -1037,6 +1242,10 @@ void MsgPackStream::setDevice(QIODevice *dev)
     }
     d->dev = dev;
     d->owndev = false;
+    d->mode = MsgPackStreamPrivate::DeviceMode;
+    d->readData.clear();
+    d->readPos = d->readEnd = nullptr;
+    d->writeData = nullptr;
 }
 
 QIODevice *MsgPackStream::device() const
@@ -1048,6 +1257,9 @@ QIODevice *MsgPackStream::device() const
 bool MsgPackStream::atEnd() const
 {
     Q_D(const MsgPackStream);
+    if (d->mode == MsgPackStreamPrivate::ReadBufferMode) {
+        return d->readPos >= d->readEnd;
+    }
     return d->dev ? d->dev->atEnd() : true;
 }
 
@@ -1396,6 +1608,18 @@ bool MsgPackStream::readExtHeader(quint32 &len, quint8 msgpackType)
     return d->readExtHeader(len, msgpackType);
 }
 
+bool MsgPackStream::readStringHeader(quint32 &len)
+{
+    Q_D(MsgPackStream);
+    return d->readStringHeader(len);
+}
+
+bool MsgPackStream::skip()
+{
+    Q_D(MsgPackStream);
+    return d->skip();
+}
+
 MsgPackStream &MsgPackStream::operator<<(bool b)
 {
     CHECK_STREAM_PRECOND(*this);
@@ -1726,4 +1950,672 @@ bool MsgPackStream::writeExtHeader(quint32 len, quint8 msgpackType)
     return d->writeExtHeader(len, msgpackType);
 }
 
+namespace {
+
+struct MsgPackHeader
+{
+    MsgPackView::Type type;
+    int size;  // the bytes of header, including the type byte of extension.
+    quint64 count;  // the elements of array and map.
+    quint64 bytes;  // the bytes of payload.
+};
+
+// parse the header without checking the payload.
+bool readHeader(const uchar *p, qint64 avail, MsgPackHeader &h)
+{
+    if (avail < 1) {
+        return false;
+    }
+    const quint8 b = p[0];
+    h.size = 1;
+    h.count = 0;
+    h.bytes = 0;
+    if (b <= FirstByte::POSITIVE_FIXINT || b >= FirstByte::NEGATIVE_FIXINT) {
+        h.type = MsgPackView::Integer;
+    } else if (b < FirstByte::FIXARRAY) {
+        h.type = MsgPackView::Map;
+        h.count = b & 0xf;
+    } else if (b < FirstByte::FIXSTR) {
+        h.type = MsgPackView::Array;
+        h.count = b & 0xf;
+    } else if (b < FirstByte::NIL) {
+        h.type = MsgPackView::String;
+        h.bytes = b - FirstByte::FIXSTR;
+    } else if (b == FirstByte::NIL) {
+        h.type = MsgPackView::Nil;
+    } else if (b == FirstByte::NEVER_USED) {
+        h.type = MsgPackView::Invalid;  // complete but corrupted.
+    } else if (b == FirstByte::MFALSE || b == FirstByte::MTRUE) {
+        h.type = MsgPackView::Boolean;
+    } else if (b == FirstByte::FLOAT32 || b == FirstByte::FLOAT64) {
+        h.type = MsgPackView::Float;
+        h.bytes = b == FirstByte::FLOAT32 ? 4 : 8;
+    } else if (b >= FirstByte::UINT8 && b <= FirstByte::INT64) {
+        h.type = MsgPackView::Integer;
+        h.bytes = 1 << ((b - FirstByte::UINT8) & 0x3);
+    } else if (b >= FirstByte::FIXEXT1 && b <= FirstByte::FIXEX16) {
+        h.type = MsgPackView::Extension;
+        h.size = 2;
+        h.bytes = 1 << (b - FirstByte::FIXEXT1);
+        if (avail < h.size) {
+            return false;
+        }
+    } else {
+        int lenSize;
+        if (b == FirstByte::BIN8 || b == FirstByte::STR8 || b == FirstByte::EXT8) {
+            lenSize = 1;
+        } else if (b == FirstByte::BIN16 || b == FirstByte::STR16 || b == FirstByte::EXT16 || b == FirstByte::ARRAY16
+                   || b == FirstByte::MAP16) {
+            lenSize = 2;
+        } else {
+            lenSize = 4;
+        }
+        if (b >= FirstByte::BIN8 && b <= FirstByte::BIN32) {
+            h.type = MsgPackView::Binary;
+        } else if (b >= FirstByte::EXT8 && b <= FirstByte::EXT32) {
+            h.type = MsgPackView::Extension;
+        } else if (b >= FirstByte::STR8 && b <= FirstByte::STR32) {
+            h.type = MsgPackView::String;
+        } else if (b == FirstByte::ARRAY16 || b == FirstByte::ARRAY32) {
+            h.type = MsgPackView::Array;
+        } else {
+            h.type = MsgPackView::Map;
+        }
+        h.size = 1 + lenSize + (h.type == MsgPackView::Extension ? 1 : 0);
+        if (avail < h.size) {
+            return false;
+        }
+        quint64 len = lenSize == 1 ? p[1] : (lenSize == 2 ? _msgpack_load16(p + 1) : _msgpack_load32(p + 1));
+        if (h.type == MsgPackView::Array || h.type == MsgPackView::Map) {
+            h.count = len;
+        } else {
+            h.bytes = len;
+        }
+    }
+    return true;
+}
+
+bool parseHeader(const uchar *p, qint64 avail, MsgPackHeader &h)
+{
+    if (!readHeader(p, avail, h) || h.type == MsgPackView::Invalid) {
+        return false;
+    }
+    if (avail < h.size || static_cast<quint64>(avail - h.size) < h.bytes) {
+        return false;
+    }
+    return true;
+}
+
+// returns the encoded length of the value at `p`, or -1 if the data is truncated.
+qint64 valueLength(const uchar *p, qint64 avail)
+{
+    qint64 pos = 0;
+    quint64 pending = 1;
+    while (pending > 0) {
+        --pending;
+        MsgPackHeader h;
+        if (!parseHeader(p + pos, avail - pos, h)) {
+            return -1;
+        }
+        pos += h.size + static_cast<qint64>(h.bytes);
+        pending += h.type == MsgPackView::Map ? h.count * 2 : h.count;
+    }
+    return pos;
+}
+
+inline const uchar *viewData(const QByteArray &buf, int pos)
+{
+    return reinterpret_cast<const uchar *>(buf.constData()) + pos;
+}
+
+}  // anonymous namespace
+
+MsgPackView::MsgPackView()
+    : pos(-1)
+{
+}
+
+MsgPackView::MsgPackView(const QByteArray &data)
+    : buf(data)
+    , pos(0)
+{
+}
+
+MsgPackView::MsgPackView(const QByteArray &buf, int pos)
+    : buf(buf)
+    , pos(pos)
+{
+}
+
+MsgPackView::Type MsgPackView::type() const
+{
+    MsgPackHeader h;
+    if (pos < 0 || !parseHeader(viewData(buf, pos), buf.size() - pos, h)) {
+        return Invalid;
+    }
+    return h.type;
+}
+
+quint32 MsgPackView::size() const
+{
+    MsgPackHeader h;
+    if (pos < 0 || !parseHeader(viewData(buf, pos), buf.size() - pos, h)) {
+        return 0;
+    }
+    return static_cast<quint32>(h.type == Array || h.type == Map ? h.count : h.bytes);
+}
+
+MsgPackView MsgPackView::at(quint32 i) const
+{
+    MsgPackHeader h;
+    if (pos < 0 || !parseHeader(viewData(buf, pos), buf.size() - pos, h) || h.type != Array || i >= h.count) {
+        return MsgPackView();
+    }
+    int p = pos + h.size;
+    for (quint32 j = 0; j < i; ++j) {
+        qint64 len = valueLength(viewData(buf, p), buf.size() - p);
+        if (len < 0) {
+            return MsgPackView();
+        }
+        p += static_cast<int>(len);
+    }
+    return MsgPackView(buf, p);
+}
+
+MsgPackView MsgPackView::value(const char *key, int len) const
+{
+    MsgPackHeader h;
+    if (pos < 0 || !parseHeader(viewData(buf, pos), buf.size() - pos, h) || h.type != Map) {
+        return MsgPackView();
+    }
+    int p = pos + h.size;
+    for (quint64 i = 0; i < h.count; ++i) {
+        MsgPackHeader kh;
+        const uchar *k = viewData(buf, p);
+        qint64 keyLen = valueLength(k, buf.size() - p);
+        if (keyLen < 0 || !parseHeader(k, keyLen, kh)) {
+            return MsgPackView();
+        }
+        p += static_cast<int>(keyLen);
+        if ((kh.type == String || kh.type == Binary) && kh.bytes == static_cast<quint64>(len)
+            && memcmp(k + kh.size, key, static_cast<size_t>(len)) == 0) {
+            return MsgPackView(buf, p);
+        }
+        qint64 valueLen = valueLength(viewData(buf, p), buf.size() - p);
+        if (valueLen < 0) {
+            return MsgPackView();
+        }
+        p += static_cast<int>(valueLen);
+    }
+    return MsgPackView();
+}
+
+MsgPackView::const_iterator MsgPackView::begin() const
+{
+    MsgPackHeader h;
+    if (pos < 0 || !parseHeader(viewData(buf, pos), buf.size() - pos, h) || (h.type != Array && h.type != Map)
+        || h.count == 0) {
+        return end();
+    }
+    int p = pos + h.size;
+    if (h.type == Array) {
+        return const_iterator(this, -1, p, static_cast<quint32>(h.count));
+    }
+    qint64 keyLen = valueLength(viewData(buf, p), buf.size() - p);
+    if (keyLen < 0) {
+        return end();
+    }
+    return const_iterator(this, p, p + static_cast<int>(keyLen), static_cast<quint32>(h.count));
+}
+
+MsgPackView::const_iterator MsgPackView::end() const
+{
+    return const_iterator(this, -1, -1, 0);
+}
+
+MsgPackView::const_iterator::const_iterator(const MsgPackView *view, int keyPos, int valuePos, quint32 remaining)
+    : view(view)
+    , keyPos(remaining > 0 ? keyPos : -1)
+    , valuePos(remaining > 0 ? valuePos : -1)
+    , remaining(remaining)
+{
+}
+
+bool MsgPackView::const_iterator::operator==(const const_iterator &other) const
+{
+    return view == other.view && keyPos == other.keyPos && valuePos == other.valuePos
+            && remaining == other.remaining;
+}
+
+MsgPackView MsgPackView::const_iterator::key() const
+{
+    if (remaining == 0 || keyPos < 0) {
+        return MsgPackView();
+    }
+    return MsgPackView(view->buf, keyPos);
+}
+
+MsgPackView MsgPackView::const_iterator::value() const
+{
+    if (remaining == 0) {
+        return MsgPackView();
+    }
+    return MsgPackView(view->buf, valuePos);
+}
+
+MsgPackView::const_iterator &MsgPackView::const_iterator::operator++()
+{
+    if (remaining == 0) {
+        return *this;
+    }
+    --remaining;
+    if (remaining == 0) {
+        keyPos = valuePos = -1;
+        return *this;
+    }
+    const QByteArray &buf = view->buf;
+    qint64 len = valueLength(viewData(buf, valuePos), buf.size() - valuePos);
+    if (len < 0) {
+        keyPos = valuePos = -1;
+        remaining = 0;
+        return *this;
+    }
+    int p = valuePos + static_cast<int>(len);
+    if (keyPos < 0) {
+        valuePos = p;
+        return *this;
+    }
+    len = valueLength(viewData(buf, p), buf.size() - p);
+    if (len < 0) {
+        keyPos = valuePos = -1;
+        remaining = 0;
+        return *this;
+    }
+    keyPos = p;
+    valuePos = p + static_cast<int>(len);
+    return *this;
+}
+
+bool MsgPackView::toBool(bool defaultValue) const
+{
+    if (pos < 0 || pos >= buf.size()) {
+        return defaultValue;
+    }
+    const quint8 b = *viewData(buf, pos);
+    if (b == FirstByte::MTRUE) {
+        return true;
+    } else if (b == FirstByte::MFALSE) {
+        return false;
+    }
+    return defaultValue;
+}
+
+qint64 MsgPackView::toInt64(bool *ok) const
+{
+    MsgPackHeader h;
+    if (ok) {
+        *ok = false;
+    }
+    if (pos < 0) {
+        return 0;
+    }
+    const uchar *p = viewData(buf, pos);
+    if (!parseHeader(p, buf.size() - pos, h) || h.type != Integer) {
+        return 0;
+    }
+    const quint8 b = p[0];
+    qint64 i64;
+    if (b <= FirstByte::POSITIVE_FIXINT) {
+        i64 = b;
+    } else if (b >= FirstByte::NEGATIVE_FIXINT) {
+        i64 = static_cast<qint8>(b);
+    } else if (b == FirstByte::UINT8) {
+        i64 = p[1];
+    } else if (b == FirstByte::UINT16) {
+        i64 = _msgpack_load16(p + 1);
+    } else if (b == FirstByte::UINT32) {
+        i64 = _msgpack_load32(p + 1);
+    } else if (b == FirstByte::UINT64) {
+        quint64 u64 = _msgpack_load64(p + 1);
+        if (u64 > static_cast<quint64>(std::numeric_limits<qint64>::max())) {
+            return 0;
+        }
+        i64 = static_cast<qint64>(u64);
+    } else if (b == FirstByte::INT8) {
+        i64 = static_cast<qint8>(p[1]);
+    } else if (b == FirstByte::INT16) {
+        i64 = static_cast<qint16>(_msgpack_load16(p + 1));
+    } else if (b == FirstByte::INT32) {
+        i64 = static_cast<qint32>(_msgpack_load32(p + 1));
+    } else {
+        i64 = static_cast<qint64>(_msgpack_load64(p + 1));
+    }
+    if (ok) {
+        *ok = true;
+    }
+    return i64;
+}
+
+quint64 MsgPackView::toUInt64(bool *ok) const
+{
+    if (ok) {
+        *ok = false;
+    }
+    if (pos >= 0 && pos < buf.size() && *viewData(buf, pos) == FirstByte::UINT64) {
+        MsgPackHeader h;
+        const uchar *p = viewData(buf, pos);
+        if (!parseHeader(p, buf.size() - pos, h)) {
+            return 0;
+        }
+        if (ok) {
+            *ok = true;
+        }
+        return _msgpack_load64(p + 1);
+    }
+    bool valid;
+    qint64 i64 = toInt64(&valid);
+    if (!valid || i64 < 0) {
+        return 0;
+    }
+    if (ok) {
+        *ok = true;
+    }
+    return static_cast<quint64>(i64);
+}
+
+int MsgPackView::toInt(bool *ok) const
+{
+    bool valid;
+    qint64 i64 = toInt64(&valid);
+    if (!valid || i64 < std::numeric_limits<int>::min() || i64 > std::numeric_limits<int>::max()) {
+        if (ok) {
+            *ok = false;
+        }
+        return 0;
+    }
+    if (ok) {
+        *ok = true;
+    }
+    return static_cast<int>(i64);
+}
+
+double MsgPackView::toDouble(bool *ok) const
+{
+    MsgPackHeader h;
+    if (ok) {
+        *ok = false;
+    }
+    if (pos < 0) {
+        return 0.0;
+    }
+    const uchar *p = viewData(buf, pos);
+    if (!parseHeader(p, buf.size() - pos, h)) {
+        return 0.0;
+    }
+    if (h.type == Integer) {
+        if (p[0] == FirstByte::UINT64) {
+            return static_cast<double>(toUInt64(ok));
+        }
+        return static_cast<double>(toInt64(ok));
+    } else if (h.type != Float) {
+        return 0.0;
+    }
+    if (ok) {
+        *ok = true;
+    }
+    if (p[0] == FirstByte::FLOAT32) {
+        quint32 u32 = _msgpack_load32(p + 1);
+        float f;
+        memcpy(&f, &u32, sizeof(f));
+        return f;
+    } else {
+        quint64 u64 = _msgpack_load64(p + 1);
+        double d;
+        memcpy(&d, &u64, sizeof(d));
+        return d;
+    }
+}
+
+QByteArray MsgPackView::toByteArray() const
+{
+    MsgPackHeader h;
+    if (pos < 0 || !parseHeader(viewData(buf, pos), buf.size() - pos, h)
+        || (h.type != String && h.type != Binary && h.type != Extension)) {
+        return QByteArray();
+    }
+    return QByteArray::fromRawData(buf.constData() + pos + h.size, static_cast<int>(h.bytes));
+}
+
+QString MsgPackView::toString() const
+{
+    if (type() != String) {
+        return QString();
+    }
+    return QString::fromUtf8(toByteArray());
+}
+
+quint8 MsgPackView::extType() const
+{
+    MsgPackHeader h;
+    if (pos < 0 || !parseHeader(viewData(buf, pos), buf.size() - pos, h) || h.type != Extension) {
+        return 0;
+    }
+    return *viewData(buf, pos + h.size - 1);
+}
+
+QVariant MsgPackView::toVariant() const
+{
+    const QByteArray bs = raw();
+    if (bs.isEmpty()) {
+        return QVariant();
+    }
+    MsgPackStream s(bs);
+    QVariant v;
+    s >> v;
+    if (s.status() != MsgPackStream::Ok) {
+        return QVariant();
+    }
+    return v;
+}
+
+QByteArray MsgPackView::raw() const
+{
+    if (pos < 0) {
+        return QByteArray();
+    }
+    qint64 len = valueLength(viewData(buf, pos), buf.size() - pos);
+    if (len < 0) {
+        return QByteArray();
+    }
+    return QByteArray::fromRawData(buf.constData() + pos, static_cast<int>(len));
+}
+
+class MsgPackDecoderPrivate
+{
+public:
+    MsgPackDecoderPrivate();
+    bool scan();
+public:
+    QByteArray buf;  // starts with the incomplete object.
+    QQueue<QByteArray> packets;
+    qint64 scanPos;  // the next header of the incomplete object, may be beyond the buffer while waiting for payload.
+    quint64 pending;  // the values still missing from the incomplete object.
+    quint32 limit;
+    MsgPackStream::Status status;
+};
+
+MsgPackDecoderPrivate::MsgPackDecoderPrivate()
+    : scanPos(0)
+    , pending(0)
+    , limit(std::numeric_limits<quint32>::max())
+    , status(MsgPackStream::Ok)
+{
+}
+
+bool MsgPackDecoderPrivate::scan()
+{
+    const uchar *p = reinterpret_cast<const uchar *>(buf.constData());
+    qint64 objectStart = 0;
+    while (status == MsgPackStream::Ok) {
+        if (pending == 0) {
+            if (scanPos >= buf.size()) {
+                break;
+            }
+            pending = 1;
+        }
+        while (pending > 0 && scanPos < buf.size()) {
+            MsgPackHeader h;
+            if (!readHeader(p + scanPos, buf.size() - scanPos, h)) {
+                break;  // the header is not complete.
+            }
+            if (h.type == MsgPackView::Invalid || h.bytes > limit || h.count > limit) {
+                status = MsgPackStream::ReadCorruptData;
+                break;
+            }
+            --pending;
+            pending += h.type == MsgPackView::Map ? h.count * 2 : h.count;
+            scanPos += h.size + static_cast<qint64>(h.bytes);
+            if (scanPos - objectStart > limit) {
+                status = MsgPackStream::ReadCorruptData;
+                break;
+            }
+        }
+        if (status != MsgPackStream::Ok || pending > 0 || scanPos > buf.size()) {
+            break;
+        }
+        if (objectStart == 0 && scanPos == buf.size()) {
+            packets.enqueue(buf);
+        } else {
+            packets.enqueue(buf.mid(static_cast<int>(objectStart), static_cast<int>(scanPos - objectStart)));
+        }
+        objectStart = scanPos;
+    }
+    if (status != MsgPackStream::Ok) {
+        buf.clear();
+        scanPos = 0;
+        pending = 0;
+        return false;
+    }
+    if (objectStart >= buf.size()) {
+        buf.clear();
+    } else if (objectStart > 0) {
+        buf.remove(0, static_cast<int>(objectStart));
+    }
+    scanPos -= objectStart;
+    return true;
+}
+
+MsgPackDecoder::MsgPackDecoder()
+    : d_ptr(new MsgPackDecoderPrivate())
+{
+}
+
+MsgPackDecoder::~MsgPackDecoder()
+{
+    delete d_ptr;
+}
+
+bool MsgPackDecoder::feed(const QByteArray &data)
+{
+    Q_D(MsgPackDecoder);
+    if (d->status != MsgPackStream::Ok) {
+        return false;
+    }
+    if (data.isEmpty()) {
+        return true;
+    }
+    if (d->buf.isEmpty()) {
+        d->buf = data;
+    } else {
+        d->buf.append(data);
+    }
+    return d->scan();
+}
+
+bool MsgPackDecoder::feed(const char *data, qint32 size)
+{
+    Q_D(MsgPackDecoder);
+    if (d->status != MsgPackStream::Ok) {
+        return false;
+    }
+    if (size <= 0) {
+        return true;
+    }
+    d->buf.append(data, size);
+    return d->scan();
+}
+
+bool MsgPackDecoder::receive(QSharedPointer<SocketLike> socket, qint32 size)
+{
+    Q_D(MsgPackDecoder);
+    while (d->packets.isEmpty()) {
+        if (d->status != MsgPackStream::Ok) {
+            return false;
+        }
+        const QByteArray data = socket->recv(size);
+        if (data.isEmpty()) {
+            return false;
+        }
+        if (!feed(data)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MsgPackDecoder::hasPacket() const
+{
+    Q_D(const MsgPackDecoder);
+    return !d->packets.isEmpty();
+}
+
+int MsgPackDecoder::packetCount() const
+{
+    Q_D(const MsgPackDecoder);
+    return d->packets.size();
+}
+
+QByteArray MsgPackDecoder::nextPacket()
+{
+    Q_D(MsgPackDecoder);
+    if (d->packets.isEmpty()) {
+        return QByteArray();
+    }
+    return d->packets.dequeue();
+}
+
+qint64 MsgPackDecoder::bufferedSize() const
+{
+    Q_D(const MsgPackDecoder);
+    return d->buf.size();
+}
+
+void MsgPackDecoder::setLengthLimit(quint32 limit)
+{
+    Q_D(MsgPackDecoder);
+    d->limit = limit;
+}
+
+quint32 MsgPackDecoder::lengthLimit() const
+{
+    Q_D(const MsgPackDecoder);
+    return d->limit;
+}
+
+MsgPackStream::Status MsgPackDecoder::status() const
+{
+    Q_D(const MsgPackDecoder);
+    return d->status;
+}
+
+void MsgPackDecoder::reset()
+{
+    Q_D(MsgPackDecoder);
+    d->buf.clear();
+    d->packets.clear();
+    d->scanPos = 0;
+    d->pending = 0;
+    d->status = MsgPackStream::Ok;
+}
+
 QTNETWORKNG_NAMESPACE_END
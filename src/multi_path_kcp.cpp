@@ -1,5 +1,6 @@
 #include <QtCore/qobject.h>
 #include <QtCore/qscopeguard.h>
+#include <QtCore/qvarlengtharray.h>
 #include "kcp_base_p.h"
 #include "../include/multi_path_kcp.h"
 #include "../include/private/socket_p.h"
@@ -12,9 +13,60 @@ const char PACKET_TYPE_UNCOMPRESSED_DATA_WITH_TOKEN = 0x05;
 #define TOKEN_SIZE 256
 #define INVALIDE_SINCE_TIME 15  // 15s
 #define ReceiveQueueSize 10
+#define PATH_INACTIVE_TIME (30 * 1000)  // 30s
+#define PATH_PROBE_INTERVAL 1000  // 1s
+#define MAX_INFLIGHT_SEGMENTS 8192
+
+// see kcp/ikcp.c
+#define KCP_CMD_PUSH 81
+#define KCP_CMD_ACK 82
+#define KCP_OVERHEAD 24
 
 int multi_path_kcp_client_callback(const char *buf, int len, ikcpcb *kcp, void *user);
 
+// estimate rtt, loss and throughput of every path by watching kcp segments pass through the link.
+// a push segment is attributed to the path it is sent through, and the ack (or una) for it is a sample of that path.
+class MultiPathStatistics
+{
+public:
+    MultiPathStatistics();
+public:
+    int addPath(const HostAddress &addr, quint16 port);
+    int indexOf(const HostAddress &addr, quint16 port) const;
+    // parse the outgoing packet, and choose paths to send it through.
+    int schedule(const char *packet, qint32 size, int *duplicate);
+    void sent(int path, qint32 size, bool primary);
+    void received(int path, const char *packet, qint32 size);
+    void setValid(int path, bool valid);
+public:
+    QVector<MultiPathKcpPathStats> paths;
+    QSharedPointer<MultiPathKcpScheduler> scheduler;
+private:
+    struct Transmission
+    {
+        int path;
+        qint32 size;
+        quint64 timestamp;
+        bool retransmitted;
+    };
+    struct Segment
+    {
+        quint32 sn;
+        qint32 size;
+    };
+    struct PathWindow
+    {
+        quint64 start;
+        quint64 bytes;
+        bool valid;
+    };
+    void delivered(const Transmission &transmission, quint64 now, bool sample);
+    void lost(int path);
+    QMap<quint32, Transmission> inflight;
+    QVector<PathWindow> windows;
+    QVarLengthArray<Segment, 16> pendingSegments;
+};
+
 class MultiPathUdpLinkClient
 {
 public:
@@ -49,6 +101,7 @@ public:
     };
     QList<RemoteHost> remoteHosts;
     QList<QSharedPointer<Socket>> rawSockets;
+    MultiPathStatistics stats;
     QByteArray token;  // size == TOKEN_SIZE
 
     QByteArray unhandleData;
@@ -57,12 +110,6 @@ public:
     Condition unhandleDataEmpty;
 
     int receiver;
-
-    // todo:
-    // at first n*remoteHostPorts.size() packet priority sent to unsent address.
-    // after that, priority sent to remote that can receive data
-    int lastSend;
-    int nextSend();  // make sure choose one remote to sent
 };
 typedef KcpBase<MultiPathUdpLinkClient> MultiPathKcpClient;
 
@@ -77,16 +124,15 @@ public:
         quint16 port;
         QSharedPointer<Socket> rawSocket;
 
-        quint64 lastActiveTimestamp;
         QString toString() const { return QString::fromLatin1("%1:%2").arg(addr.toString(), QString::number(port)); }
     };
     QList<QSharedPointer<RemoteHost>> remoteHosts;
+    MultiPathStatistics stats;
 
-    int lastSend;
     quint32 connectionId;
     quint64 connectedTime;
-    int nextSend();  // average sent to slave. if is not active, choose next
     qint32 send(const char *data, qint32 len);
+    void received(QSharedPointer<RemoteHost> remoteHost, const char *data, qint32 len);
 
     QSharedPointer<RemoteHost> append(const HostAddress &addr, quint16 port, QSharedPointer<Socket> rawSocket);
 };
@@ -129,7 +175,7 @@ public:
 
     QMap<QByteArray, QSharedPointer<MultiPathUdpLinkSlaveInfo>> tokenToSlave;
     QMap<quint32, QByteArray> connectionIdToToken;
-
+    std::function<QSharedPointer<MultiPathKcpScheduler>()> schedulerFactory;
 
     Queue<QByteArray> buffers; // pool for doReceive
 
@@ -143,6 +189,410 @@ public:
     int receiver;
 };
 
+MultiPathKcpScheduler::~MultiPathKcpScheduler() { }
+
+class RoundRobinScheduler : public MultiPathKcpScheduler
+{
+public:
+    RoundRobinScheduler()
+        : lastSend(-1)
+    {
+    }
+public:
+    virtual int schedule(const QVector<MultiPathKcpPathStats> &paths, bool urgent, int *duplicate) override;
+private:
+    int lastSend;
+};
+
+int RoundRobinScheduler::schedule(const QVector<MultiPathKcpPathStats> &paths, bool, int *)
+{
+    // average sent to paths. if is not active, choose next
+    for (int i = 0; i < paths.size(); ++i) {
+        lastSend = (lastSend + 1) % paths.size();
+        if (paths.at(lastSend).active) {
+            return lastSend;
+        }
+    }
+    lastSend = (lastSend + 1) % paths.size();
+    return lastSend;
+}
+
+class MinRttScheduler : public MultiPathKcpScheduler
+{
+public:
+    virtual int schedule(const QVector<MultiPathKcpPathStats> &paths, bool urgent, int *duplicate) override;
+protected:
+    int best(const QVector<MultiPathKcpPathStats> &paths, int except) const;
+    RoundRobinScheduler fallback;
+};
+
+// the time to deliver a new packet through the path: a lossy path costs retransmissions, which is much slower than
+// the rtt itself, and the packet waits for the bytes in flight to drain at the measured throughput.
+static inline float expectedDelay(const MultiPathKcpPathStats &path, float rtt)
+{
+    float delivery = qMax(1.0f - path.lossRate, 0.1f);
+    float delay = rtt / (delivery * delivery);
+    if (path.throughput > 0.0f) {
+        delay += static_cast<float>(path.inflightBytes) * 1000.0f / path.throughput;
+    }
+    return delay;
+}
+
+int MinRttScheduler::best(const QVector<MultiPathKcpPathStats> &paths, int except) const
+{
+    int result = -1;
+    for (int i = 0; i < paths.size(); ++i) {
+        const MultiPathKcpPathStats &path = paths.at(i);
+        if (i == except || !path.active || path.srtt <= 0.0f) {
+            continue;
+        }
+        if (result < 0 || expectedDelay(path, path.srtt) < expectedDelay(paths.at(result), paths.at(result).srtt)) {
+            result = i;
+        }
+    }
+    return result;
+}
+
+int MinRttScheduler::schedule(const QVector<MultiPathKcpPathStats> &paths, bool urgent, int *duplicate)
+{
+    // probe the paths not used recently, so their estimations are kept fresh and the peer knows they are alive.
+    quint64 now = static_cast<quint64>(QDateTime::currentMSecsSinceEpoch());
+    for (int i = 0; i < paths.size(); ++i) {
+        const MultiPathKcpPathStats &path = paths.at(i);
+        if (path.active && now > path.lastSendTimestamp + PATH_PROBE_INTERVAL) {
+            return i;
+        }
+    }
+    int result = best(paths, -1);
+    if (result < 0) {
+        return fallback.schedule(paths, urgent, duplicate);
+    }
+    return result;
+}
+
+class RedundantScheduler : public MinRttScheduler
+{
+public:
+    virtual int schedule(const QVector<MultiPathKcpPathStats> &paths, bool urgent, int *duplicate) override;
+};
+
+int RedundantScheduler::schedule(const QVector<MultiPathKcpPathStats> &paths, bool urgent, int *duplicate)
+{
+    int result = MinRttScheduler::schedule(paths, urgent, duplicate);
+    if (urgent) {
+        *duplicate = best(paths, result);
+        if (*duplicate < 0) {
+            for (int i = 0; i < paths.size(); ++i) {
+                if (i != result && paths.at(i).active) {
+                    *duplicate = i;
+                    break;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+// smooth weighted round-robin. the weight of path is inversely proportional to its expected delay, which is the rtt
+// plus the time to drain its bytes in flight at the measured throughput. so the bandwidth of asymmetric paths is
+// aggregated, and a path is given less packets once it can not keep up with them.
+class WeightedScheduler : public MultiPathKcpScheduler
+{
+public:
+    virtual int schedule(const QVector<MultiPathKcpPathStats> &paths, bool urgent, int *duplicate) override;
+private:
+    QVector<float> currentWeights;
+    RoundRobinScheduler fallback;
+};
+
+int WeightedScheduler::schedule(const QVector<MultiPathKcpPathStats> &paths, bool urgent, int *duplicate)
+{
+    if (currentWeights.size() != paths.size()) {
+        currentWeights.resize(paths.size());
+    }
+    float sumOfRtt = 0.0f;
+    int samples = 0;
+    for (const MultiPathKcpPathStats &path : paths) {
+        if (path.active && path.srtt > 0.0f) {
+            sumOfRtt += path.srtt;
+            ++samples;
+        }
+    }
+    // the path without rtt sample is treated as an average one.
+    const float defaultRtt = samples > 0 ? sumOfRtt / samples : 100.0f;
+    float total = 0.0f;
+    int result = -1;
+    for (int i = 0; i < paths.size(); ++i) {
+        const MultiPathKcpPathStats &path = paths.at(i);
+        if (!path.active) {
+            continue;
+        }
+        // never drop to zero, so the lossy path is still probed.
+        float weight = 1000.0f / qMax(expectedDelay(path, path.srtt > 0.0f ? path.srtt : defaultRtt), 1.0f);
+        currentWeights[i] += weight;
+        total += weight;
+        if (result < 0 || currentWeights[i] > currentWeights[result]) {
+            result = i;
+        }
+    }
+    if (result < 0) {
+        return fallback.schedule(paths, urgent, duplicate);
+    }
+    currentWeights[result] -= total;
+    return result;
+}
+
+QSharedPointer<MultiPathKcpScheduler> createMultiPathKcpScheduler(MultiPathKcpSchedule schedule)
+{
+    switch (schedule) {
+    case RoundRobinSchedule:
+        return QSharedPointer<MultiPathKcpScheduler>(new RoundRobinScheduler());
+    case MinRttSchedule:
+        return QSharedPointer<MultiPathKcpScheduler>(new MinRttScheduler());
+    case RedundantSchedule:
+        return QSharedPointer<MultiPathKcpScheduler>(new RedundantScheduler());
+    case WeightedSchedule:
+    default:
+        return QSharedPointer<MultiPathKcpScheduler>(new WeightedScheduler());
+    }
+}
+
+static inline quint32 readKcpUInt32(const char *p)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 7, 0)
+    return qFromLittleEndian<quint32>(p);
+#else
+    return qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(p));
+#endif
+}
+
+// returns the offset of kcp segments in packet, or -1 if the packet is not a data packet.
+static inline qint32 kcpSegmentsOffset(const char *packet, qint32 size)
+{
+    if (size < 1) {
+        return -1;
+    }
+    if (packet[0] == PACKET_TYPE_UNCOMPRESSED_DATA) {
+        return 1;
+    } else if (packet[0] == PACKET_TYPE_UNCOMPRESSED_DATA_WITH_TOKEN) {
+        return 1 + TOKEN_SIZE;
+    }
+    return -1;
+}
+
+MultiPathStatistics::MultiPathStatistics()
+    : scheduler(createMultiPathKcpScheduler(WeightedSchedule))
+{
+}
+
+int MultiPathStatistics::addPath(const HostAddress &addr, quint16 port)
+{
+    quint64 now = static_cast<quint64>(QDateTime::currentMSecsSinceEpoch());
+    MultiPathKcpPathStats path;
+    path.addr = addr;
+    path.port = port;
+    path.active = true;
+    path.srtt = 0.0f;
+    path.rttvar = 0.0f;
+    path.lossRate = 0.0f;
+    path.throughput = 0.0f;
+    path.inflightBytes = 0;
+    path.sentPackets = 0;
+    path.sentBytes = 0;
+    path.ackedBytes = 0;
+    path.receivedBytes = 0;
+    path.lastSendTimestamp = 0;
+    path.lastActiveTimestamp = now;
+    paths.append(path);
+    PathWindow window;
+    window.start = now;
+    window.bytes = 0;
+    window.valid = true;
+    windows.append(window);
+    return paths.size() - 1;
+}
+
+int MultiPathStatistics::indexOf(const HostAddress &addr, quint16 port) const
+{
+    for (int i = 0; i < paths.size(); ++i) {
+        if (paths.at(i).port == port && paths.at(i).addr == addr) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void MultiPathStatistics::setValid(int path, bool valid)
+{
+    windows[path].valid = valid;
+}
+
+int MultiPathStatistics::schedule(const char *packet, qint32 size, int *duplicate)
+{
+    *duplicate = -1;
+    if (paths.isEmpty()) {
+        return -1;
+    }
+    pendingSegments.clear();
+    bool urgent = true;
+    qint32 offset = kcpSegmentsOffset(packet, size);
+    if (offset >= 0) {
+        const char *p = packet + offset;
+        qint32 left = size - offset;
+        while (left >= KCP_OVERHEAD) {
+            quint32 len = readKcpUInt32(p + 20);
+            if (len > static_cast<quint32>(left - KCP_OVERHEAD)) {
+                break;
+            }
+            if (static_cast<quint8>(p[4]) == KCP_CMD_PUSH) {
+                Segment segment;
+                segment.sn = readKcpUInt32(p + 12);
+                segment.size = KCP_OVERHEAD + static_cast<qint32>(len);
+                pendingSegments.append(segment);
+                if (!inflight.contains(segment.sn)) {
+                    urgent = false;
+                }
+            }
+            p += KCP_OVERHEAD + len;
+            left -= KCP_OVERHEAD + static_cast<qint32>(len);
+        }
+    }
+
+    quint64 now = static_cast<quint64>(QDateTime::currentMSecsSinceEpoch());
+    for (int i = 0; i < paths.size(); ++i) {
+        MultiPathKcpPathStats &path = paths[i];
+        path.active = windows.at(i).valid && now <= path.lastActiveTimestamp + PATH_INACTIVE_TIME;
+    }
+    if (paths.size() == 1) {
+        return 0;
+    }
+    int result = scheduler->schedule(paths, urgent, duplicate);
+    if (result < 0 || result >= paths.size()) {
+        result = 0;
+    }
+    if (*duplicate == result || *duplicate >= paths.size()) {
+        *duplicate = -1;
+    }
+    return result;
+}
+
+void MultiPathStatistics::sent(int path, qint32 size, bool primary)
+{
+    quint64 now = static_cast<quint64>(QDateTime::currentMSecsSinceEpoch());
+    MultiPathKcpPathStats &stats = paths[path];
+    ++stats.sentPackets;
+    stats.sentBytes += static_cast<quint64>(size);
+    stats.lastSendTimestamp = now;
+    if (!primary) {
+        return;
+    }
+    for (const Segment &segment : pendingSegments) {
+        QMap<quint32, Transmission>::iterator itor = inflight.find(segment.sn);
+        if (itor != inflight.end()) {
+            // kcp retransmits the segment, the last transmission is presumed lost.
+            lost(itor->path);
+            paths[itor->path].inflightBytes -= static_cast<quint64>(itor->size);
+            stats.inflightBytes += static_cast<quint64>(segment.size);
+            itor->path = path;
+            itor->size = segment.size;
+            itor->timestamp = now;
+            itor->retransmitted = true;
+            continue;
+        }
+        if (inflight.size() >= MAX_INFLIGHT_SEGMENTS) {
+            lost(inflight.begin()->path);
+            paths[inflight.begin()->path].inflightBytes -= static_cast<quint64>(inflight.begin()->size);
+            inflight.erase(inflight.begin());
+        }
+        Transmission transmission;
+        transmission.path = path;
+        transmission.size = segment.size;
+        transmission.timestamp = now;
+        transmission.retransmitted = false;
+        inflight.insert(segment.sn, transmission);
+        stats.inflightBytes += static_cast<quint64>(segment.size);
+    }
+    pendingSegments.clear();
+}
+
+void MultiPathStatistics::received(int path, const char *packet, qint32 size)
+{
+    if (path < 0 || path >= paths.size()) {
+        return;
+    }
+    quint64 now = static_cast<quint64>(QDateTime::currentMSecsSinceEpoch());
+    MultiPathKcpPathStats &stats = paths[path];
+    stats.lastActiveTimestamp = now;
+    stats.receivedBytes += static_cast<quint64>(size);
+
+    qint32 offset = kcpSegmentsOffset(packet, size);
+    if (offset < 0 || inflight.isEmpty()) {
+        return;
+    }
+    const char *p = packet + offset;
+    qint32 left = size - offset;
+    bool hasUna = false;
+    quint32 una = 0;
+    while (left >= KCP_OVERHEAD) {
+        quint32 len = readKcpUInt32(p + 20);
+        if (len > static_cast<quint32>(left - KCP_OVERHEAD)) {
+            break;
+        }
+        if (static_cast<quint8>(p[4]) == KCP_CMD_ACK) {
+            QMap<quint32, Transmission>::iterator itor = inflight.find(readKcpUInt32(p + 12));
+            if (itor != inflight.end()) {
+                // Karn's algorithm, the ack of retransmitted segment is ambiguous.
+                delivered(*itor, now, !itor->retransmitted);
+                inflight.erase(itor);
+            }
+        }
+        una = readKcpUInt32(p + 16);
+        hasUna = true;
+        p += KCP_OVERHEAD + len;
+        left -= KCP_OVERHEAD + static_cast<qint32>(len);
+    }
+    if (hasUna) {
+        // every segment before una is received by peer.
+        while (!inflight.isEmpty() && static_cast<qint32>(inflight.firstKey() - una) < 0) {
+            delivered(inflight.first(), now, false);
+            inflight.erase(inflight.begin());
+        }
+    }
+}
+
+void MultiPathStatistics::delivered(const Transmission &transmission, quint64 now, bool sample)
+{
+    MultiPathKcpPathStats &stats = paths[transmission.path];
+    if (sample && now >= transmission.timestamp) {
+        float rtt = static_cast<float>(now - transmission.timestamp);
+        if (stats.srtt <= 0.0f) {
+            stats.srtt = qMax(rtt, 1.0f);
+            stats.rttvar = rtt / 2;
+        } else {
+            stats.rttvar = 0.75f * stats.rttvar + 0.25f * qAbs(stats.srtt - rtt);
+            stats.srtt = qMax(0.875f * stats.srtt + 0.125f * rtt, 1.0f);
+        }
+    }
+    stats.lossRate = 0.95f * stats.lossRate;
+    stats.ackedBytes += static_cast<quint64>(transmission.size);
+    stats.inflightBytes -= static_cast<quint64>(transmission.size);
+
+    PathWindow &window = windows[transmission.path];
+    window.bytes += static_cast<quint64>(transmission.size);
+    if (now >= window.start + 1000) {
+        float rate = static_cast<float>(window.bytes) * 1000.0f / static_cast<float>(now - window.start);
+        stats.throughput = stats.throughput <= 0.0f ? rate : 0.8f * stats.throughput + 0.2f * rate;
+        window.start = now;
+        window.bytes = 0;
+    }
+}
+
+void MultiPathStatistics::lost(int path)
+{
+    MultiPathKcpPathStats &stats = paths[path];
+    stats.lossRate = 0.95f * stats.lossRate + 0.05f;
+}
+
 QByteArray makeMultiPathDataPacket(const QByteArray &token, const char *data, qint32 size)
 {
     QByteArray packet(size + 1 + token.size(), Qt::Uninitialized);
@@ -191,7 +641,6 @@ int multi_path_kcp_client_callback(const char *buf, int len, ikcpcb *kcp, void *
 MultiPathUdpLinkClient::MultiPathUdpLinkClient()
     : token(randomBytes(TOKEN_SIZE))
     , unhandleDataSize(0)
-    , lastSend(-1)
     , receiver(0)
 {
 }
@@ -233,6 +682,7 @@ bool MultiPathUdpLinkClient::connect(const QList<QPair<HostAddress, quint16>> &r
             remote.rawSocket = ipv6;
         }
         this->remoteHosts.append(remote);
+        stats.addPath(remote.addr, remote.port);
     }
     return !this->remoteHosts.isEmpty();
 }
@@ -243,7 +693,13 @@ qint32 MultiPathUdpLinkClient::recvfrom(char *data, qint32 size, QByteArray &)
         return -1;
     }
     if (rawSockets.size() == 1) {
-        return rawSockets.at(0)->recvfrom(data, size, nullptr, nullptr);
+        HostAddress addr;
+        quint16 port = 0;
+        qint32 len = rawSockets.at(0)->recvfrom(data, size, &addr, &port);
+        if (len > 0) {
+            stats.received(stats.indexOf(addr, port), data, len);
+        }
+        return len;
     }
     if (!unhandleDataNotEmpty.tryWait()) {
         return -1;
@@ -262,12 +718,41 @@ qint32 MultiPathUdpLinkClient::recvfrom(char *data, qint32 size, QByteArray &)
 
 qint32 MultiPathUdpLinkClient::sendto(const char *data, qint32 size, const QByteArray &)
 {
-    const RemoteHost &remote = remoteHosts.at(nextSend());
-    QSharedPointer<Socket> rawSocket = remote.rawSocket;
+    if (remoteHosts.size() > 1 && size > 0 && data[0] == PACKET_TYPE_KEEPALIVE) {
+        // keep every path alive, so the peer can send packets through all of them.
+        qint32 result = -1;
+        for (int i = 0; i < remoteHosts.size(); ++i) {
+            const RemoteHost &remote = remoteHosts.at(i);
+            if (remote.rawSocket->sendto(data, size, remote.addr, remote.port) == size) {
+                stats.sent(i, size, false);
+                result = size;
+            }
+        }
+        return result;
+    }
+    for (int i = 0; i < remoteHosts.size(); ++i) {
+        stats.setValid(i, remoteHosts.at(i).rawSocket->isValid());
+    }
+    int duplicate;
+    int index = stats.schedule(data, size, &duplicate);
+    if (index < 0) {
+        return -1;
+    }
+    const RemoteHost &remote = remoteHosts.at(index);
 #ifdef DEBUG_PROTOCOL
     qtng_debug << "send udp packet" << size << "to:" << remote.toString() << (int) (data[0]);
 #endif
-    return rawSocket->sendto(data, size, remote.addr, remote.port);
+    qint32 result = remote.rawSocket->sendto(data, size, remote.addr, remote.port);
+    if (result == size) {
+        stats.sent(index, size, true);
+    }
+    if (duplicate >= 0) {
+        const RemoteHost &redundant = remoteHosts.at(duplicate);
+        if (redundant.rawSocket->sendto(data, size, redundant.addr, redundant.port) == size) {
+            stats.sent(duplicate, size, false);
+        }
+    }
+    return result;
 }
 
 bool MultiPathUdpLinkClient::filter(char *data, qint32 *size, QByteArray *who)
@@ -309,8 +794,10 @@ void MultiPathUdpLinkClient::doReceive(QSharedPointer<Socket> rawSocket)
     });
     ++receiver;
     QByteArray buf(1024 * 64, Qt::Uninitialized);
+    HostAddress addr;
+    quint16 port = 0;
     while (true) {
-        qint32 len = rawSocket->recvfrom(buf.data(), buf.size(), nullptr, nullptr);
+        qint32 len = rawSocket->recvfrom(buf.data(), buf.size(), &addr, &port);
         if (len <= 0) {
 #ifdef DEBUG_PROTOCOL
             qtng_debug << "multi path client can not receive udp packet. remote:" << rawSocket->localAddressURI()
@@ -318,6 +805,7 @@ void MultiPathUdpLinkClient::doReceive(QSharedPointer<Socket> rawSocket)
 #endif
             return;
         }
+        stats.received(stats.indexOf(addr, port), buf.constData(), len);
         while (true) {
             if (unhandleDataSize == 0) {
                 break;
@@ -349,44 +837,44 @@ void MultiPathUdpLinkClient::startReceive(CoroutineGroup *operations)
     }
 }
 
-int MultiPathUdpLinkClient::nextSend()
-{
-    if ((++lastSend) < remoteHosts.size()) {
-        return lastSend;
-    }
-    lastSend = 0;
-    return lastSend;
-}
-
-int MultiPathUdpLinkSlaveInfo::nextSend()
+qint32 MultiPathUdpLinkSlaveInfo::send(const char *data, qint32 len)
 {
-    quint64 now = QDateTime::currentSecsSinceEpoch();
-    int last = lastSend++;
-    for (; lastSend < remoteHosts.size(); ++lastSend) {
-        QSharedPointer<RemoteHost> remoteHost = remoteHosts.at(lastSend);
-        if (!remoteHost->rawSocket->isValid()) {
-            continue;
-        }
-        if (now <= remoteHost->lastActiveTimestamp + 30) {
-            return lastSend;
+    if (remoteHosts.size() > 1 && len > 0 && data[0] == PACKET_TYPE_KEEPALIVE) {
+        qint32 result = -1;
+        for (int i = 0; i < remoteHosts.size(); ++i) {
+            QSharedPointer<RemoteHost> remote = remoteHosts.at(i);
+            if (remote->rawSocket->isValid() && remote->rawSocket->sendto(data, len, remote->addr, remote->port) == len) {
+                stats.sent(i, len, false);
+                result = len;
+            }
         }
+        return result;
     }
-    for (lastSend = 0; lastSend < last; ++lastSend) {
-        QSharedPointer<RemoteHost> remoteHost = remoteHosts.at(lastSend);
-        if (!remoteHost->rawSocket->isValid()) {
-            continue;
-        }
-        if (now <= remoteHost->lastActiveTimestamp + 30) {
-            return lastSend;
+    for (int i = 0; i < remoteHosts.size(); ++i) {
+        stats.setValid(i, remoteHosts.at(i)->rawSocket->isValid());
+    }
+    int duplicate;
+    int index = stats.schedule(data, len, &duplicate);
+    if (index < 0) {
+        return -1;
+    }
+    QSharedPointer<RemoteHost> remote = remoteHosts.at(index);
+    qint32 result = remote->rawSocket->sendto(data, len, remote->addr, remote->port);
+    if (result == len) {
+        stats.sent(index, len, true);
+    }
+    if (duplicate >= 0) {
+        QSharedPointer<RemoteHost> redundant = remoteHosts.at(duplicate);
+        if (redundant->rawSocket->sendto(data, len, redundant->addr, redundant->port) == len) {
+            stats.sent(duplicate, len, false);
         }
     }
-    return 0;
+    return result;
 }
 
-qint32 MultiPathUdpLinkSlaveInfo::send(const char *data, qint32 len)
+void MultiPathUdpLinkSlaveInfo::received(QSharedPointer<RemoteHost> remoteHost, const char *data, qint32 len)
 {
-    QSharedPointer<RemoteHost> remote = remoteHosts.at(nextSend());
-    return remote->rawSocket->sendto(data, len, remote->addr, remote->port);
+    stats.received(remoteHosts.indexOf(remoteHost), data, len);
 }
 
 QSharedPointer<MultiPathUdpLinkSlaveOnePath> MultiPathUdpLinkSlaveInfo::append(const HostAddress &addr, quint16 port,
@@ -396,14 +884,13 @@ QSharedPointer<MultiPathUdpLinkSlaveOnePath> MultiPathUdpLinkSlaveInfo::append(c
     remote->addr = addr;
     remote->port = port;
     remote->rawSocket = rawSocket;
-    remote->lastActiveTimestamp = QDateTime::currentSecsSinceEpoch();
     remoteHosts.append(remote);
+    stats.addPath(addr, port);
     return remote;
 }
 
 MultiPathUdpLinkSlaveInfo::MultiPathUdpLinkSlaveInfo(quint32 connectionId)
-    : lastSend(-1)
-    , connectionId(connectionId)
+    : connectionId(connectionId)
     , connectedTime(QDateTime::currentSecsSinceEpoch())
 {
 }
@@ -588,12 +1075,15 @@ void MultiPathUdpLinkServer::doReceive(QSharedPointer<Path> rawPath)
 
                     onePath = slave->append(addr, port, rawSocket);
                     tokenToOnePath.insert(token, onePath);
-                } else {
-                    onePath->lastActiveTimestamp = QDateTime::currentSecsSinceEpoch();
                 }
             }
         }
 
+        QSharedPointer<MultiPathUdpLinkSlaveInfo> slave = tokenToSlave.value(token);
+        if (!slave.isNull()) {
+            slave->received(tokenToOnePath.value(token), data, len);
+        }
+
         UnhandleData unhandle;
         unhandle.who = token;
         unhandle.buf = buf;
@@ -694,7 +1184,6 @@ bool MultiPathUdpLinkServer::accpetConnection(
 #endif
             return false;
         }
-        onePath->lastActiveTimestamp = QDateTime::currentSecsSinceEpoch();
     } else {
         slave = tokenToSlave.value(token);
         if (!slave.isNull()) {
@@ -704,6 +1193,12 @@ bool MultiPathUdpLinkServer::accpetConnection(
             return false;
         }
         slave.reset(new MultiPathUdpLinkSlaveInfo(0));
+        if (schedulerFactory) {
+            QSharedPointer<MultiPathKcpScheduler> scheduler = schedulerFactory();
+            if (!scheduler.isNull()) {
+                slave->stats.scheduler = scheduler;
+            }
+        }
         tokenToSlave.insert(token, slave);
 
         onePath = slave->append(addr, port, rawSocket);
@@ -889,6 +1384,89 @@ bool MultiPathKcpServerSocketLikeHelper::rebind(const QList<QPair<HostAddress, q
     return false;
 }
 
+static MultiPathStatistics *statisticsOf(SocketLike *socket)
+{
+    MultiPathKcpClientSocketLike *client = dynamic_cast<MultiPathKcpClientSocketLike *>(socket);
+    if (client) {
+        MasterKcpBase<MultiPathUdpLinkClient> *master =
+                dynamic_cast<MasterKcpBase<MultiPathUdpLinkClient> *>(client->kcpBase);
+        return master ? &master->link->stats : nullptr;
+    }
+    MultiPathKcpServerSocketLike *server = dynamic_cast<MultiPathKcpServerSocketLike *>(socket);
+    if (server) {
+        SlaveKcpBase<MultiPathUdpLinkServer> *slave =
+                dynamic_cast<SlaveKcpBase<MultiPathUdpLinkServer> *>(server->kcpBase);
+        if (!slave || slave->parent.isNull()) {
+            return nullptr;
+        }
+        QSharedPointer<MultiPathUdpLinkSlaveInfo> info = slave->parent->link->tokenToSlave.value(slave->remoteId);
+        return info.isNull() ? nullptr : &info->stats;
+    }
+    return nullptr;
+}
+
+MultiPathKcpSocketLikeHelper::MultiPathKcpSocketLikeHelper(QSharedPointer<SocketLike> socket /*= nullptr*/)
+    : socket(socket)
+{
+}
+
+bool MultiPathKcpSocketLikeHelper::isValid() const
+{
+    return dynamic_cast<MultiPathKcpClientSocketLike *>(socket.data())
+            || dynamic_cast<MultiPathKcpServerSocketLike *>(socket.data());
+}
+
+void MultiPathKcpSocketLikeHelper::setSocket(QSharedPointer<SocketLike> socket)
+{
+    this->socket = socket;
+}
+
+bool MultiPathKcpSocketLikeHelper::setSchedule(MultiPathKcpSchedule schedule)
+{
+    return setScheduler([schedule] { return createMultiPathKcpScheduler(schedule); });
+}
+
+bool MultiPathKcpSocketLikeHelper::setScheduler(std::function<QSharedPointer<MultiPathKcpScheduler>()> factory)
+{
+    if (!factory) {
+        return false;
+    }
+    MultiPathKcpServerSocketLike *server = dynamic_cast<MultiPathKcpServerSocketLike *>(socket.data());
+    if (server) {
+        MasterKcpBase<MultiPathUdpLinkServer> *master =
+                dynamic_cast<MasterKcpBase<MultiPathUdpLinkServer> *>(server->kcpBase);
+        if (master) {
+            master->link->schedulerFactory = factory;
+            for (QSharedPointer<MultiPathUdpLinkSlaveInfo> slave : master->link->tokenToSlave) {
+                QSharedPointer<MultiPathKcpScheduler> scheduler = factory();
+                if (!scheduler.isNull()) {
+                    slave->stats.scheduler = scheduler;
+                }
+            }
+            return true;
+        }
+    }
+    MultiPathStatistics *stats = statisticsOf(socket.data());
+    if (!stats) {
+        return false;
+    }
+    QSharedPointer<MultiPathKcpScheduler> scheduler = factory();
+    if (scheduler.isNull()) {
+        return false;
+    }
+    stats->scheduler = scheduler;
+    return true;
+}
+
+QVector<MultiPathKcpPathStats> MultiPathKcpSocketLikeHelper::pathStats() const
+{
+    MultiPathStatistics *stats = statisticsOf(socket.data());
+    if (!stats) {
+        return QVector<MultiPathKcpPathStats>();
+    }
+    return stats->paths;
+}
+
 QSharedPointer<SocketLike> createMultiPathKcpConnection(const QList<QPair<HostAddress, quint16>> &remoteHosts,
                                                         Socket::SocketError *error, int allowProtocol, KcpMode mode)
 {
@@ -6,6 +6,7 @@
 #include <QtCore/qdatetime.h>
 #include "../include/private/socket_p.h"
 #include "../include/coroutine_utils.h"
+#include "../include/dns.h"
 #include "debugger.h"
 
 QTNG_LOGGER("qtng.socket");
@@ -539,6 +540,43 @@ qint32 Socket::sendto(const char *data, qint32 size, const HostAddress &addr, qu
     return d->sendto(data, size, addr, port);
 }
 
+qint32 Socket::sendv(const IoVector *vectors, int count)
+{
+    Q_D(Socket);
+    ScopedLock<Lock> lock(d->writeLock);
+    if (!lock.isSuccess()) {
+        return -1;
+    }
+    return d->sendv(vectors, count);
+}
+
+qint64 Socket::sendfile(qintptr fileDescriptor, qint64 offset, qint64 size)
+{
+#ifdef Q_OS_LINUX
+    Q_D(Socket);
+    ScopedLock<Lock> lock(d->writeLock);
+    if (!lock.isSuccess()) {
+        return -1;
+    }
+    return d->sendfile(fileDescriptor, offset, size);
+#else
+    Q_UNUSED(fileDescriptor);
+    Q_UNUSED(offset);
+    Q_UNUSED(size);
+    return -1;
+#endif
+}
+
+qint32 Socket::recvv(IoVector *vectors, int count)
+{
+    Q_D(Socket);
+    ScopedLock<Lock> lock(d->readLock);
+    if (!lock.isSuccess()) {
+        return -1;
+    }
+    return d->recvv(vectors, count);
+}
+
 QByteArray Socket::recv(qint32 size)
 {
     Q_D(Socket);
@@ -657,6 +695,90 @@ Socket *Socket::createServer(const HostAddress &host, quint16 port, int backlog)
     return QTNETWORKNG_NAMESPACE::createServer<Socket>(host, port, backlog, MakeSocketType<Socket>);
 }
 
+static QAtomicInt connectionAttemptDelayMsecs(250);
+
+void Socket::setConnectionAttemptDelay(float secs)
+{
+    connectionAttemptDelayMsecs.storeRelease(secs > 0 ? static_cast<int>(secs * 1000) : 0);
+}
+
+float Socket::connectionAttemptDelay()
+{
+    return connectionAttemptDelayMsecs.loadAcquire() / 1000.0f;
+}
+
+QList<HostAddress> interleaveAddresses(const QList<HostAddress> &addresses, int allowProtocol)
+{
+    QList<HostAddress> ipv4, ipv6;
+    for (const HostAddress &addr : addresses) {
+        if (addr.isIPv4()) {
+            if (allowProtocol & HostAddress::IPv4Protocol) {
+                ipv4.append(addr);
+            }
+        } else if (allowProtocol & HostAddress::IPv6Protocol) {
+            ipv6.append(addr);
+        }
+    }
+    if (ipv4.isEmpty()) {
+        return ipv6;
+    } else if (ipv6.isEmpty()) {
+        return ipv4;
+    }
+    const QList<HostAddress> &first = addresses.first().isIPv4() ? ipv4 : ipv6;
+    const QList<HostAddress> &second = addresses.first().isIPv4() ? ipv6 : ipv4;
+    QList<HostAddress> result;
+    for (int i = 0; i < qMax(first.size(), second.size()); ++i) {
+        if (i < first.size()) {
+            result.append(first.at(i));
+        }
+        if (i < second.size()) {
+            result.append(second.at(i));
+        }
+    }
+    return result;
+}
+
+int staggeredConnect(int count, std::function<bool(int)> connectTo)
+{
+    const int delay = connectionAttemptDelayMsecs.loadAcquire();
+    if (count <= 1 || delay <= 0) {
+        for (int i = 0; i < count; ++i) {
+            if (connectTo(i)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    CoroutineGroup operations;
+    Event changed;
+    int winner = -1;
+    int failed = 0;
+    for (int i = 0; i < count && winner < 0; ++i) {
+        changed.clear();
+        operations.spawn([&, i] {
+            if (connectTo(i)) {
+                if (winner < 0) {
+                    winner = i;
+                }
+            } else {
+                ++failed;
+            }
+            changed.set();
+        });
+        if (i + 1 < count) {
+            // a failure starts the next attempt immediately.
+            changed.tryWait(static_cast<quint32>(delay));
+        }
+    }
+    while (winner < 0 && failed < count) {
+        changed.clear();
+        changed.tryWait();
+    }
+    operations.killall();
+    return winner;
+}
+
 class PollPrivate
 {
 public:
@@ -797,7 +919,7 @@ QSharedPointer<Socket> Poll::wait(float secs)
 struct SocketDnsCacheCacheItem
 {
     QList<HostAddress> addresses;
-    quint64 firstSeen;
+    quint64 expireAt;  // 0 means never expire.
 };
 
 class SocketDnsCachePrivate
@@ -810,6 +932,7 @@ public:
     }
     quint64 timeToLive;  // in msecs
     QCache<QString, SocketDnsCacheCacheItem> cache;
+    QSharedPointer<DnsResolver> resolver;
 };
 
 SocketDnsCache::SocketDnsCache()
@@ -828,16 +951,26 @@ QList<HostAddress> SocketDnsCache::resolve(const QString &hostName)
     quint64 now = QDateTime::currentMSecsSinceEpoch();
     if (d->cache.contains(hostName)) {
         SocketDnsCacheCacheItem *item = d->cache.object(hostName);
-        if (now > item->firstSeen || (now - item->firstSeen < d->timeToLive)) {
+        if (item->expireAt == 0 || now < item->expireAt) {
             return item->addresses;
         }
     }
-    const QList<HostAddress> &addresses = Socket::resolve(hostName);
+    QList<HostAddress> addresses;
+    quint64 timeToLive = d->timeToLive;
+    if (d->resolver.isNull()) {
+        addresses = Socket::resolve(hostName);
+    } else {
+        // keep `resolver` alive, it may be replaced while resolving.
+        QSharedPointer<DnsResolver> resolver = d->resolver;
+        quint32 ttl = 0xffffffff;
+        addresses = resolver->resolve(hostName, HostAddress::IPv4Protocol | HostAddress::IPv6Protocol, &ttl);
+        timeToLive = qMin<quint64>(timeToLive, static_cast<quint64>(ttl) * 1000);
+    }
     if (addresses.isEmpty()) {
         return QList<HostAddress>();
     } else {
         SocketDnsCacheCacheItem *item = new SocketDnsCacheCacheItem();
-        item->firstSeen = now;
+        item->expireAt = QDateTime::currentMSecsSinceEpoch() + timeToLive;
         item->addresses = addresses;
         d->cache.insert(hostName, item);
         return addresses;
@@ -854,7 +987,7 @@ void SocketDnsCache::addHost(const QString &hostName, const QList<HostAddress> &
 {
     Q_D(SocketDnsCache);
     SocketDnsCacheCacheItem *item = new SocketDnsCacheCacheItem();
-    item->firstSeen = QDateTime::currentMSecsSinceEpoch();
+    item->expireAt = 0;
     item->addresses = addresses;
     d->cache.insert(hostName, item);
 }
@@ -863,7 +996,7 @@ void SocketDnsCache::addHost(const QString &hostName, const HostAddress &addr)
 {
     Q_D(SocketDnsCache);
     SocketDnsCacheCacheItem *item = new SocketDnsCacheCacheItem();
-    item->firstSeen = QDateTime::currentMSecsSinceEpoch();
+    item->expireAt = 0;
     QList<HostAddress> addresses;
     addresses.append(addr);
     item->addresses = addresses;
@@ -882,4 +1015,16 @@ void SocketDnsCache::setTimeToLive(quint64 msecs)
     d->timeToLive = msecs;
 }
 
+QSharedPointer<DnsResolver> SocketDnsCache::resolver() const
+{
+    Q_D(const SocketDnsCache);
+    return d->resolver;
+}
+
+void SocketDnsCache::setResolver(QSharedPointer<DnsResolver> resolver)
+{
+    Q_D(SocketDnsCache);
+    d->resolver = resolver;
+}
+
 QTNETWORKNG_NAMESPACE_END
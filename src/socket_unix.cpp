@@ -8,9 +8,14 @@
 #endif
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <limits.h>
 #include <net/if.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#ifdef Q_OS_LINUX
+#include <sys/sendfile.h>
+#endif
 
 #ifndef SOCK_NONBLOCK
 #  define SOCK_NONBLOCK O_NONBLOCK
@@ -43,6 +48,11 @@
 #  define MSG_NOSIGNAL 0
 #endif
 
+#ifndef IOV_MAX
+#  define IOV_MAX 16
+#endif
+
+#include <QtCore/qvarlengtharray.h>
 #include "debugger.h"
 
 QTNG_LOGGER("qtng.socket_unix");
@@ -551,6 +561,18 @@ qint32 SocketPrivate::peek(char *data, qint32 size)
     return 0;
 }
 
+#ifdef QTNETWORKNG_USE_IO_URING
+// the io_uring eventloop returns -errno instead of setting errno.
+static inline int completeIo(qint32 result)
+{
+    if (result < 0) {
+        errno = -result;
+        return -1;
+    }
+    return result;
+}
+#endif
+
 qint32 SocketPrivate::recv(char *data, qint32 size, bool all)
 {
     if (!checkState()) {
@@ -563,6 +585,17 @@ qint32 SocketPrivate::recv(char *data, qint32 size, bool all)
             return total == 0 ? -1 : total;
         }
         ssize_t r = 0;
+#ifdef QTNETWORKNG_USE_IO_URING
+        qint32 completed;
+        if (type == Socket::TcpSocket
+            && EventLoopCoroutine::get()->doIo(EventLoopCoroutine::RecvOperation, fd, data + total, size - total, 0,
+                                               &completed)) {
+            if (completed == -ECANCELED) {
+                continue;  // the socket is closed.
+            }
+            r = completeIo(completed);
+        } else
+#endif
         do {
             r = ::recv(fd, data + total, static_cast<size_t>(size - total), 0);
         } while (r < 0 && errno == EINTR);
@@ -631,9 +664,20 @@ qint32 SocketPrivate::send(const char *data, qint32 size, bool all)
             return sent;
         }
         ssize_t w;
+        const int flags = all && ((size - sent) > 1024 * 4) ? (MSG_MORE | MSG_NOSIGNAL) : MSG_NOSIGNAL;
+#ifdef QTNETWORKNG_USE_IO_URING
+        qint32 completed;
+        if (type == Socket::TcpSocket
+            && EventLoopCoroutine::get()->doIo(EventLoopCoroutine::SendOperation, fd,
+                                               const_cast<char *>(data + sent), size - sent, flags, &completed)) {
+            if (completed == -ECANCELED) {
+                continue;  // the socket is closed.
+            }
+            w = completeIo(completed);
+        } else
+#endif
         do {
-            w = ::send(fd, data + sent, static_cast<size_t>(size - sent),
-                       all && ((size - sent) > 1024 * 4) ? (MSG_MORE | MSG_NOSIGNAL) : MSG_NOSIGNAL);
+            w = ::send(fd, data + sent, static_cast<size_t>(size - sent), flags);
         } while (w < 0 && errno == EINTR);
         if (w > 0) {
             if (!all) {
@@ -700,6 +744,224 @@ qint32 SocketPrivate::send(const char *data, qint32 size, bool all)
     return sent;
 }
 
+qint32 SocketPrivate::sendv(const IoVector *vectors, int count)
+{
+    if (!checkState() || count <= 0) {
+        return -1;
+    }
+    QVarLengthArray<struct iovec, 16> iov;
+    qint64 size = 0;
+    for (int i = 0; i < count; ++i) {
+        if (vectors[i].size <= 0) {
+            continue;
+        }
+        struct iovec vec;
+        vec.iov_base = vectors[i].data;
+        vec.iov_len = static_cast<size_t>(vectors[i].size);
+        iov.append(vec);
+        size += vectors[i].size;
+    }
+    if (size <= 0 || size > INT_MAX) {
+        return -1;
+    }
+
+    qint32 sent = 0;
+    int first = 0;  // the first vector not sent completely.
+    ScopedIoWatcher watcher(EventLoopCoroutine::Write, fd);
+    while (first < iov.size()) {
+        if (!checkState()) {
+            return sent;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov.data() + first;
+        msg.msg_iovlen = qMin(iov.size() - first, IOV_MAX);
+        ssize_t w;
+        do {
+            w = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+        } while (w < 0 && errno == EINTR);
+        if (w > 0) {
+            sent += static_cast<qint32>(w);
+            // skip the vectors sent, and move the start of the partly sent one.
+            size_t left = static_cast<size_t>(w);
+            while (left > 0 && first < iov.size()) {
+                struct iovec &vec = iov[first];
+                if (left >= vec.iov_len) {
+                    left -= vec.iov_len;
+                    ++first;
+                } else {
+                    vec.iov_base = static_cast<char *>(vec.iov_base) + left;
+                    vec.iov_len -= left;
+                    left = 0;
+                }
+            }
+            continue;
+        } else if (w == 0 && type == Socket::TcpSocket) {
+            setError(Socket::RemoteHostClosedError, RemoteHostClosedErrorString);
+            return sent;
+        } else {
+            int e = errno;
+            switch (e) {
+#if EWOULDBLOCK - 0 && EWOULDBLOCK != EAGAIN
+            case EWOULDBLOCK:
+#endif
+            case EAGAIN:
+                break;
+            case EACCES:
+                setError(Socket::SocketAccessError, AccessErrorString);
+                abort();
+                return -1;
+            case EBADF:
+            case EFAULT:
+            case EINVAL:
+            case ENOTCONN:
+            case ENOTSOCK:
+                setError(Socket::UnsupportedSocketOperationError, InvalidSocketErrorString);
+                abort();
+                return -1;
+            case EMSGSIZE:
+            case ENOBUFS:
+                setError(Socket::DatagramTooLargeError, DatagramTooLargeErrorString);
+                return -1;
+            case ENOMEM:
+                setError(Socket::OutOfMemoryError, OutOfMemoryErrorString);
+                abort();
+                return -1;
+            case EPIPE:
+            case ECONNRESET:
+                setError(Socket::RemoteHostClosedError, RemoteHostClosedErrorString);
+                return -1;
+            default:
+                setError(Socket::UnknownSocketError, UnknownSocketErrorString);
+                abort();
+                return -1;
+            }
+        }
+        if (!watcher.start()) {
+            setError(Socket::UnknownSocketError, UnknownSocketErrorString);
+            abort();
+            return -1;
+        }
+    }
+    return sent;
+}
+
+#ifdef Q_OS_LINUX
+qint64 SocketPrivate::sendfile(qintptr fileDescriptor, qint64 offset, qint64 size)
+{
+    if (!checkState() || type != Socket::TcpSocket || offset < 0 || size <= 0) {
+        return -1;
+    }
+    ScopedIoWatcher watcher(EventLoopCoroutine::Write, fd);
+    off_t pos = static_cast<off_t>(offset);
+    qint64 sent = 0;
+    while (sent < size) {
+        if (!checkState()) {
+            return sent;
+        }
+        // linux sends 0x7ffff000 bytes at most in one call.
+        const size_t bytes = static_cast<size_t>(qMin<qint64>(size - sent, 0x7ffff000));
+        ssize_t w;
+        do {
+            w = ::sendfile(fd, static_cast<int>(fileDescriptor), &pos, bytes);
+        } while (w < 0 && errno == EINTR);
+        if (w > 0) {
+            sent += w;
+            continue;
+        } else if (w == 0) {
+            return sent;  // the file is shorter than `size`.
+        }
+        const int e = errno;
+        if (e != EAGAIN && e != EWOULDBLOCK) {
+            if (sent == 0 && (e == EINVAL || e == ENOSYS || e == EOPNOTSUPP)) {
+                return -1;  // the file does not support sendfile(), nothing is sent.
+            }
+            setError(Socket::NetworkError, InvalidSocketErrorString);
+            abort();
+            return sent > 0 ? sent : -1;
+        }
+        if (!watcher.start()) {
+            setError(Socket::UnknownSocketError, UnknownSocketErrorString);
+            abort();
+            return sent > 0 ? sent : -1;
+        }
+    }
+    return sent;
+}
+#endif
+
+qint32 SocketPrivate::recvv(IoVector *vectors, int count)
+{
+    if (!checkState() || count <= 0) {
+        return -1;
+    }
+    QVarLengthArray<struct iovec, 16> iov;
+    for (int i = 0; i < count && iov.size() < IOV_MAX; ++i) {
+        if (vectors[i].size <= 0) {
+            continue;
+        }
+        struct iovec vec;
+        vec.iov_base = vectors[i].data;
+        vec.iov_len = static_cast<size_t>(vectors[i].size);
+        iov.append(vec);
+    }
+    if (iov.isEmpty()) {
+        return -1;
+    }
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov.data();
+    msg.msg_iovlen = iov.size();
+
+    ScopedIoWatcher watcher(EventLoopCoroutine::Read, fd);
+    while (true) {
+        if (!checkState()) {
+            return -1;
+        }
+        ssize_t r;
+        do {
+            r = ::recvmsg(fd, &msg, 0);
+        } while (r < 0 && errno == EINTR);
+
+        if (r < 0) {
+            int e = errno;
+            switch (e) {
+#if EWOULDBLOCK - 0 && EWOULDBLOCK != EAGAIN
+            case EWOULDBLOCK:
+#endif
+            case EAGAIN:
+                break;
+            case ECONNRESET:
+#if defined(Q_OS_VXWORKS)
+            case ESHUTDOWN:
+#endif
+                if (type == Socket::TcpSocket) {
+                    setError(Socket::RemoteHostClosedError, RemoteHostClosedErrorString);
+                }
+                return 0;
+            case EBADF:
+            case EINVAL:
+            case EIO:
+            default:
+                setError(Socket::NetworkError, InvalidSocketErrorString);
+                abort();
+                return -1;
+            }
+        } else if (r == 0 && type == Socket::TcpSocket) {
+            setError(Socket::RemoteHostClosedError, RemoteHostClosedErrorString);
+            abort();
+            return 0;
+        } else {
+            return static_cast<qint32>(r);
+        }
+        if (!watcher.start()) {
+            setError(Socket::NetworkError, InvalidSocketErrorString);
+            abort();
+            return -1;
+        }
+    }
+}
+
 qint32 SocketPrivate::recvfrom(char *data, qint32 maxSize, HostAddress *addr, quint16 *port)
 {
     if (!checkState()) {
@@ -1308,7 +1570,18 @@ Socket *SocketPrivate::accept()
         if (!checkState() || state != Socket::ListeningState) {
             return nullptr;
         }
-        int acceptedDescriptor = qt_safe_accept(fd, nullptr, nullptr);
+        int acceptedDescriptor;
+#ifdef QTNETWORKNG_USE_IO_URING
+        qint32 completed;
+        if (EventLoopCoroutine::get()->doIo(EventLoopCoroutine::AcceptOperation, fd, nullptr, 0, SOCK_CLOEXEC,
+                                            &completed)) {
+            if (completed == -ECANCELED) {
+                continue;  // the socket is closed.
+            }
+            acceptedDescriptor = completeIo(completed);
+        } else
+#endif
+        acceptedDescriptor = qt_safe_accept(fd, nullptr, nullptr);
         if (acceptedDescriptor == -1) {
             int e = errno;
             switch (e) {
@@ -1,6 +1,14 @@
 #include <string.h>
+#include <limits.h>
+#include <QtCore/qscopeguard.h>
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
 #include "../include/coroutine_utils.h"
 #include "../include/socket_utils.h"
+#include "../include/private/eventloop_p.h"
 
 QTNETWORKNG_NAMESPACE_BEGIN
 
@@ -23,6 +31,44 @@ qint64 SocketLike::size()
     return -1;
 }
 
+qint32 SocketLike::sendv(const IoVector *vectors, int count)
+{
+    qint64 size = 0;
+    int last = -1;
+    int nonEmpty = 0;
+    for (int i = 0; i < count; ++i) {
+        if (vectors[i].size > 0) {
+            size += vectors[i].size;
+            last = i;
+            ++nonEmpty;
+        }
+    }
+    if (size <= 0 || size > INT_MAX) {
+        return -1;
+    }
+    if (nonEmpty == 1) {
+        return sendall(vectors[last].data, vectors[last].size);
+    }
+    QByteArray buf;
+    buf.reserve(static_cast<int>(size));
+    for (int i = 0; i < count; ++i) {
+        if (vectors[i].size > 0) {
+            buf.append(vectors[i].data, vectors[i].size);
+        }
+    }
+    return sendall(buf);
+}
+
+qint32 SocketLike::recvv(IoVector *vectors, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        if (vectors[i].size > 0) {
+            return recv(vectors[i].data, vectors[i].size);
+        }
+    }
+    return -1;
+}
+
 namespace {
 class SocketLikeImpl : public SocketLike
 {
@@ -67,6 +113,8 @@ public:
     virtual QByteArray recvall(qint32 size) override;
     virtual qint32 send(const QByteArray &data) override;
     virtual qint32 sendall(const QByteArray &data) override;
+    virtual qint32 sendv(const IoVector *vectors, int count) override;
+    virtual qint32 recvv(IoVector *vectors, int count) override;
 public:
     QSharedPointer<Socket> s;
 };
@@ -256,6 +304,16 @@ qint32 SocketLikeImpl::sendall(const QByteArray &data)
     return s->sendall(data);
 }
 
+qint32 SocketLikeImpl::sendv(const IoVector *vectors, int count)
+{
+    return s->sendv(vectors, count);
+}
+
+qint32 SocketLikeImpl::recvv(IoVector *vectors, int count)
+{
+    return s->recvv(vectors, count);
+}
+
 }  // anonymous namespace
 
 QSharedPointer<SocketLike> asSocketLike(QSharedPointer<Socket> s)
@@ -283,18 +341,18 @@ public:
                      float timeout);
     ~ExchangerPrivate();
 public:
-    void receiveOutgoing();
-    void receiveIncoming();
-    void sendOutgoing();
-    void sendIncoming();
     void in2out();
     void out2in();
+#ifdef Q_OS_LINUX
+    bool splice(QSharedPointer<Socket> from, QSharedPointer<Socket> to);
+    void spliceIn2out();
+    void spliceOut2in();
+#endif
 public:
     QSharedPointer<SocketLike> request;
     QSharedPointer<SocketLike> forward;
     CoroutineGroup *operations;
-    Queue<QByteArray> incoming;
-    Queue<QByteArray> outgoing;
+    quint32 maxBufferSize;
     float timeout;
 };
 
@@ -305,8 +363,7 @@ ExchangerPrivate::ExchangerPrivate(QSharedPointer<SocketLike> request, QSharedPo
     : request(request)
     , forward(forward)
     , operations(new CoroutineGroup)
-    , incoming(maxBufferSize / EXCHANGER_PACKET_SIZE)
-    , outgoing(maxBufferSize / EXCHANGER_PACKET_SIZE)
+    , maxBufferSize(maxBufferSize)
     , timeout(timeout)
 {
 }
@@ -316,88 +373,6 @@ ExchangerPrivate::~ExchangerPrivate()
     delete operations;
 }
 
-void ExchangerPrivate::receiveOutgoing()
-{
-    QByteArray buf(EXCHANGER_PACKET_SIZE, Qt::Uninitialized);
-    while (true) {
-        qint32 len = forward->recv(buf.data(), buf.size());
-        if (len <= 0) {
-            operations->kill(QString::fromLatin1("receive_incoming"), false);
-            operations->kill(QString::fromLatin1("send_outgoing"), false);
-            incoming.put(QByteArray());
-            return;
-        }
-        incoming.put(QByteArray(buf.constData(), len));
-    }
-}
-
-void ExchangerPrivate::receiveIncoming()
-{
-    QByteArray buf(EXCHANGER_PACKET_SIZE, Qt::Uninitialized);
-    while (true) {
-        qint32 len = request->recv(buf.data(), buf.size());
-        if (len <= 0) {
-            operations->kill(QString::fromLatin1("receive_outgoing"), false);
-            operations->kill(QString::fromLatin1("sending_incoming"), false);
-            outgoing.put(QByteArray());
-            return;
-        }
-        outgoing.put(QByteArray(buf.constData(), len));
-    }
-}
-
-void ExchangerPrivate::sendOutgoing()
-{
-    while (true) {
-        QByteArray buf = outgoing.get();
-        if (buf.isEmpty()) {
-            return;
-        } else {
-            while (!outgoing.isEmpty()) {
-                buf.append(outgoing.get());
-            }
-        }
-        qint32 len;
-        try {
-            Timeout timeout(this->timeout);
-            Q_UNUSED(timeout);
-            len = forward->sendall(buf);
-        } catch (TimeoutException &) {
-            len = -1;
-        }
-        if (len != buf.size()) {
-            operations->killall(false);
-            return;
-        }
-    }
-}
-
-void ExchangerPrivate::sendIncoming()
-{
-    while (true) {
-        QByteArray buf = incoming.get();
-        if (buf.isEmpty()) {
-            return;
-        } else {
-            while (!incoming.isEmpty()) {
-                buf.append(incoming.get());
-            }
-        }
-        qint32 len;
-        try {
-            Timeout timeout(this->timeout);
-            Q_UNUSED(timeout);
-            len = request->sendall(buf);
-        } catch (TimeoutException &) {
-            len = -1;
-        }
-        if (len != buf.size()) {
-            operations->killall(false);
-            return;
-        }
-    }
-}
-
 void ExchangerPrivate::in2out()
 {
     QByteArray buf(EXCHANGER_PACKET_SIZE, Qt::Uninitialized);
@@ -450,6 +425,92 @@ void ExchangerPrivate::out2in()
     }
 }
 
+#ifdef Q_OS_LINUX
+// move data from kernel to kernel through a pipe, the data is never copied to user space.
+// returns false if the pipe can not be created, and nothing is read from `from`.
+bool ExchangerPrivate::splice(QSharedPointer<Socket> from, QSharedPointer<Socket> to)
+{
+    int pipefd[2];
+    if (::pipe2(pipefd, O_NONBLOCK | O_CLOEXEC) < 0) {
+        return false;
+    }
+    auto cleanup = qScopeGuard([&pipefd] {
+        ::close(pipefd[0]);
+        ::close(pipefd[1]);
+    });
+    int pipeSize = ::fcntl(pipefd[1], F_SETPIPE_SZ, static_cast<int>(maxBufferSize));
+    if (pipeSize <= 0) {
+        pipeSize = ::fcntl(pipefd[1], F_GETPIPE_SZ);
+        if (pipeSize <= 0) {
+            pipeSize = 1024 * 64;
+        }
+    }
+
+    const int fromFd = static_cast<int>(from->fileno());
+    const int toFd = static_cast<int>(to->fileno());
+    ScopedIoWatcher readWatcher(EventLoopCoroutine::Read, fromFd);
+    ScopedIoWatcher writeWatcher(EventLoopCoroutine::Write, toFd);
+    while (from->isValid() && to->isValid()) {
+        ssize_t inPipe;
+        do {
+            inPipe = ::splice(fromFd, nullptr, pipefd[1], nullptr, static_cast<size_t>(pipeSize),
+                              SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE);
+        } while (inPipe < 0 && errno == EINTR);
+        if (inPipe == 0) {
+            return true;
+        } else if (inPipe < 0) {
+            // the pipe is empty, so EAGAIN can only be caused by the socket.
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && readWatcher.start()) {
+                continue;
+            }
+            return true;
+        }
+        try {
+            Timeout timeout(this->timeout);
+            Q_UNUSED(timeout);
+            while (inPipe > 0) {
+                ssize_t sentBytes;
+                do {
+                    sentBytes = ::splice(pipefd[0], nullptr, toFd, nullptr, static_cast<size_t>(inPipe),
+                                         SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                } while (sentBytes < 0 && errno == EINTR);
+                if (sentBytes > 0) {
+                    inPipe -= sentBytes;
+                } else if (sentBytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && to->isValid()
+                           && writeWatcher.start()) {
+                    continue;
+                } else {
+                    return true;
+                }
+            }
+        } catch (TimeoutException &) {
+            return true;
+        }
+    }
+    return true;
+}
+
+void ExchangerPrivate::spliceIn2out()
+{
+    if (!splice(convertSocketLikeToSocket(request), convertSocketLikeToSocket(forward))) {
+        in2out();
+        return;
+    }
+    forward->abort();
+    operations->kill(QString::fromLatin1("out2in"));
+}
+
+void ExchangerPrivate::spliceOut2in()
+{
+    if (!splice(convertSocketLikeToSocket(forward), convertSocketLikeToSocket(request))) {
+        out2in();
+        return;
+    }
+    request->abort();
+    operations->kill(QString::fromLatin1("in2out"));
+}
+#endif
+
 Exchanger::Exchanger(QSharedPointer<SocketLike> request, QSharedPointer<SocketLike> forward, quint32 maxBufferSize,
                      float timeout)
     : d_ptr(new ExchangerPrivate(request, forward, maxBufferSize, timeout))
@@ -464,10 +525,17 @@ Exchanger::~Exchanger()
 void Exchanger::exchange()
 {
     Q_D(Exchanger);
-    //    d->operations->spawnWithName("receive_outgoing", [d] { d->receiveOutgoing(); });
-    //    d->operations->spawnWithName("receive_incoming", [d] { d->receiveIncoming(); });
-    //    d->operations->spawnWithName("send_outgoing", [d] { d->sendOutgoing(); });
-    //    d->operations->spawnWithName("send_incoming", [d] { d->sendIncoming(); });
+#ifdef Q_OS_LINUX
+    QSharedPointer<Socket> requestSocket = convertSocketLikeToSocket(d->request);
+    QSharedPointer<Socket> forwardSocket = convertSocketLikeToSocket(d->forward);
+    if (!requestSocket.isNull() && !forwardSocket.isNull() && requestSocket->type() == Socket::TcpSocket
+        && forwardSocket->type() == Socket::TcpSocket) {
+        d->operations->spawnWithName(QString::fromLatin1("in2out"), [d] { d->spliceIn2out(); });
+        d->operations->spawnWithName(QString::fromLatin1("out2in"), [d] { d->spliceOut2in(); });
+        d->operations->joinall();
+        return;
+    }
+#endif
     d->operations->spawnWithName(QString::fromLatin1("in2out"), [d] { d->in2out(); });
     d->operations->spawnWithName(QString::fromLatin1("out2in"), [d] { d->out2in(); });
     d->operations->joinall();
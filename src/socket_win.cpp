@@ -3,6 +3,8 @@
 #include <ws2tcpip.h>
 #include <mswsock.h>
 #include <QtCore/qbytearray.h>
+#include <QtCore/qvarlengtharray.h>
+#include <limits.h>
 #if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
 #include <QtCore/qoperatingsystemversion.h>
 #else
@@ -1011,6 +1013,179 @@ qint32 SocketPrivate::send(const char *data, qint32 size, bool all)
 }
 
 
+// windows has no IOV_MAX, but keep the WSABUF array of one call small like unix.
+#define MAX_WSABUF_COUNT 1024
+
+qint32 SocketPrivate::sendv(const IoVector *vectors, int count)
+{
+    if (!checkState() || count <= 0) {
+        return -1;
+    }
+    QVarLengthArray<WSABUF, 16> bufs;
+    qint64 size = 0;
+    for (int i = 0; i < count; ++i) {
+        if (vectors[i].size <= 0) {
+            continue;
+        }
+        WSABUF buf;
+        buf.buf = vectors[i].data;
+        buf.len = static_cast<u_long>(vectors[i].size);
+        bufs.append(buf);
+        size += vectors[i].size;
+    }
+    if (size <= 0 || size > INT_MAX) {
+        return -1;
+    }
+
+    qint32 sent = 0;
+    int first = 0;  // the first buffer not sent completely.
+    ScopedIoWatcher watcher(EventLoopCoroutine::Write, fd);
+    while (first < bufs.size()) {
+        if (!checkState()) {
+            return sent == 0 ? -1 : sent;
+        }
+        DWORD bytesWritten = 0;
+        const DWORD bufCount = static_cast<DWORD>(qMin(bufs.size() - first, MAX_WSABUF_COUNT));
+        int socketRet = ::WSASend(static_cast<SOCKET>(fd), bufs.data() + first, bufCount, &bytesWritten, 0, nullptr,
+                                  nullptr);
+        if (bytesWritten > 0) {
+            sent += static_cast<qint32>(bytesWritten);
+            // skip the buffers sent, and move the start of the partly sent one.
+            DWORD left = bytesWritten;
+            while (left > 0 && first < bufs.size()) {
+                WSABUF &buf = bufs[first];
+                if (left >= buf.len) {
+                    left -= buf.len;
+                    ++first;
+                } else {
+                    buf.buf += left;
+                    buf.len -= left;
+                    left = 0;
+                }
+            }
+        }
+        if (socketRet != SOCKET_ERROR) {
+            continue;
+        }
+        int err = WSAGetLastError();
+        WS_ERROR_DEBUG(err);
+        switch (err) {
+        case WSAEWOULDBLOCK:
+        case WSAEINPROGRESS:
+        case WSAENOBUFS:
+            break;
+        case WSANOTINITIALISED:
+        case WSAEACCES:
+        case WSAEADDRNOTAVAIL:
+        case WSAEAFNOSUPPORT:
+        case WSAENOTSOCK:
+            setError(Socket::SocketAccessError, AccessErrorString);
+            return sent == 0 ? -1 : sent;
+        case WSAESHUTDOWN:
+            setError(Socket::UnsupportedSocketOperationError, OperationUnsupportedErrorString);
+            close();
+            return sent == 0 ? -1 : sent;
+        case WSAEMSGSIZE:
+            setError(Socket::DatagramTooLargeError, DatagramTooLargeErrorString);
+            return sent == 0 ? -1 : sent;
+        case WSAECONNRESET:
+        case WSAECONNABORTED:
+        case WSAENOTCONN:
+            setError(Socket::NetworkError, WriteErrorString);
+            return sent == 0 ? -1 : sent;
+        case WSAEHOSTUNREACH:
+            setError(Socket::NetworkError, HostUnreachableErrorString);
+            close();
+            return sent == 0 ? -1 : sent;
+        case WSAENETDOWN:
+            setError(Socket::NetworkError, NetworkDroppedConnectionErrorString);
+            close();
+            return sent == 0 ? -1 : sent;
+        case WSAENETRESET:
+            setError(Socket::NetworkError, ConnectionResetErrorString);
+            close();
+            return sent == 0 ? -1 : sent;
+        case WSAENETUNREACH:
+            setError(Socket::NetworkError, NetworkUnreachableErrorString);
+            close();
+            return sent == 0 ? -1 : sent;
+        case WSAEFAULT:
+        case WSAEINTR:
+        case WSAEINVAL:
+        default:
+            setError(Socket::UnknownSocketError, UnknownSocketErrorString);
+            close();
+            return sent == 0 ? -1 : sent;
+        }
+        if (!watcher.start()) {
+            setError(Socket::UnknownSocketError, UnknownSocketErrorString);
+            close();
+            return sent == 0 ? -1 : sent;
+        }
+    }
+    return sent;
+}
+
+qint32 SocketPrivate::recvv(IoVector *vectors, int count)
+{
+    if (!checkState() || count <= 0) {
+        return -1;
+    }
+    QVarLengthArray<WSABUF, 16> bufs;
+    for (int i = 0; i < count && bufs.size() < MAX_WSABUF_COUNT; ++i) {
+        if (vectors[i].size <= 0) {
+            continue;
+        }
+        WSABUF buf;
+        buf.buf = vectors[i].data;
+        buf.len = static_cast<u_long>(vectors[i].size);
+        bufs.append(buf);
+    }
+    if (bufs.isEmpty()) {
+        return -1;
+    }
+    ScopedIoWatcher watcher(EventLoopCoroutine::Read, fd);
+    while (true) {
+        if (!checkState()) {
+            return -1;
+        }
+        DWORD flags = 0;
+        DWORD bytesRead = 0;
+        if (::WSARecv(static_cast<SOCKET>(fd), bufs.data(), static_cast<DWORD>(bufs.size()), &bytesRead, &flags,
+                      nullptr, nullptr)
+            == SOCKET_ERROR) {
+            int err = WSAGetLastError();
+            WS_ERROR_DEBUG(err);
+            switch (err) {
+            case WSAEWOULDBLOCK:
+                break;
+            case WSAECONNRESET:
+            case WSAECONNABORTED:
+                if (type == Socket::TcpSocket) {
+                    setError(Socket::RemoteHostClosedError, RemoteHostClosedErrorString);
+                }
+                return 0;
+            case WSAEBADF:
+            case WSAEINVAL:
+            default:
+                setError(Socket::NetworkError, ConnectionResetErrorString);
+                close();
+                return -1;
+            }
+        } else if (bytesRead == 0 && type == Socket::TcpSocket) {
+            setError(Socket::RemoteHostClosedError, RemoteHostClosedErrorString);
+            return 0;
+        } else {
+            return static_cast<qint32>(bytesRead);
+        }
+        if (!watcher.start()) {
+            setError(Socket::UnknownSocketError, UnknownSocketErrorString);
+            close();
+            return -1;
+        }
+    }
+}
+
 qint32 SocketPrivate::recvfrom(char *data, qint32 size, HostAddress *addr, quint16 *port)
 {
     if (!checkState() || size < 0) {
@@ -1,14 +1,39 @@
 #include <QtCore/qfile.h>
 #include <QtCore/qdatetime.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qendian.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
+#include <openssl/rand.h>
+#include <openssl/hmac.h>
+#include <openssl/ocsp.h>
+#include <openssl/x509v3.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(LIBRESSL_VERSION_NUMBER)
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#define QTNG_HAVE_EVP_MAC_TICKET
+#endif
 #include "../include/locks.h"
 #include "../include/ssl.h"
 #include "../include/socket.h"
 #include "../include/private/socket_p.h"
 #include "../include/socket_utils.h"
+#include "../include/coroutine_utils.h"
+#include "../include/http.h"
 #include "../include/private/crypto_p.h"
 #include "debugger.h"
+#ifdef Q_OS_LINUX
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+#include <errno.h>
+#if defined(TLS_TX) && defined(TLS_1_3_VERSION) && !defined(LIBRESSL_VERSION_NUMBER) \
+        && OPENSSL_VERSION_NUMBER >= 0x10101000L
+// the kernel tls of TLS 1.3 needs the traffic secrets, which are logged by OpenSSL 1.1.1+ but not libressl.
+#define QTNG_KERNEL_TLS13
+#endif
+#endif
 
 QTNG_LOGGER("qtng.ssl");
 
@@ -213,14 +238,555 @@ QDebug operator<<(QDebug debug, const SslCipher &cipher)
     return debug;
 }
 
+// session tickets are encrypted by a key which is replaced every hour. tickets encrypted by
+// the previous key are still accepted, and renewed by the current key.
+struct SslTicketKey
+{
+    unsigned char name[16];
+    unsigned char aesKey[32];
+    unsigned char hmacKey[32];
+    qint64 created;
+};
+
+class SslTicketKeys
+{
+public:
+    SslTicketKeys();
+    bool current(SslTicketKey *key);
+    bool find(const unsigned char *name, SslTicketKey *key, bool *renew);
+#ifdef QTNG_HAVE_EVP_MAC_TICKET
+    static int callback(SSL *ssl, unsigned char *keyName, unsigned char *iv, EVP_CIPHER_CTX *cipherContext,
+                        EVP_MAC_CTX *macContext, int enc);
+#else
+    static int callback(SSL *ssl, unsigned char *keyName, unsigned char *iv, EVP_CIPHER_CTX *cipherContext,
+                        HMAC_CTX *hmacContext, int enc);
+#endif
+    static int exDataIndex();
+private:
+    static int initCipher(SSL *ssl, unsigned char *keyName, unsigned char *iv, EVP_CIPHER_CTX *cipherContext,
+                          int enc, SslTicketKey *key);
+    bool rotate(qint64 now);
+    QMutex lock;
+    SslTicketKey keys[2];  // the current one and the previous one.
+    int count;
+};
+
+const qint64 SslTicketKeyLifetime = 1000 * 60 * 60;
+
+SslTicketKeys::SslTicketKeys()
+    : count(0)
+{
+}
+
+bool SslTicketKeys::rotate(qint64 now)
+{
+    SslTicketKey key;
+    if (RAND_bytes(key.name, sizeof(key.name)) <= 0 || RAND_bytes(key.aesKey, sizeof(key.aesKey)) <= 0
+        || RAND_bytes(key.hmacKey, sizeof(key.hmacKey)) <= 0) {
+        return false;
+    }
+    key.created = now;
+    keys[1] = keys[0];
+    keys[0] = key;
+    count = qMin(count + 1, 2);
+    return true;
+}
+
+bool SslTicketKeys::current(SslTicketKey *key)
+{
+    QMutexLocker locker(&lock);
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (count == 0 || now - keys[0].created > SslTicketKeyLifetime) {
+        if (!rotate(now)) {
+            return false;
+        }
+    }
+    *key = keys[0];
+    return true;
+}
+
+bool SslTicketKeys::find(const unsigned char *name, SslTicketKey *key, bool *renew)
+{
+    QMutexLocker locker(&lock);
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (int i = 0; i < count; ++i) {
+        if (memcmp(keys[i].name, name, sizeof(keys[i].name)) == 0
+            && now - keys[i].created <= SslTicketKeyLifetime * (i + 1)) {
+            *key = keys[i];
+            *renew = i > 0 || now - keys[i].created > SslTicketKeyLifetime;
+            return true;
+        }
+    }
+    return false;
+}
+
+int SslTicketKeys::exDataIndex()
+{
+    static int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+// picks the key and initializes the cipher. returns -1 on error, 0 if the ticket key is unknown, 2 if the ticket
+// should be renewed, or 1.
+int SslTicketKeys::initCipher(SSL *ssl, unsigned char *keyName, unsigned char *iv, EVP_CIPHER_CTX *cipherContext,
+                              int enc, SslTicketKey *key)
+{
+    SslTicketKeys *keys = static_cast<SslTicketKeys *>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), exDataIndex()));
+    if (!keys) {
+        return -1;
+    }
+    if (enc) {
+        if (!keys->current(key) || RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) <= 0) {
+            return -1;
+        }
+        memcpy(keyName, key->name, sizeof(key->name));
+        if (!EVP_EncryptInit_ex(cipherContext, EVP_aes_256_cbc(), nullptr, key->aesKey, iv)) {
+            return -1;
+        }
+        return 1;
+    } else {
+        bool renew = false;
+        if (!keys->find(keyName, key, &renew)) {
+            return 0;  // do a full handshake.
+        }
+        if (!EVP_DecryptInit_ex(cipherContext, EVP_aes_256_cbc(), nullptr, key->aesKey, iv)) {
+            return -1;
+        }
+        return renew ? 2 : 1;
+    }
+}
+
+#ifdef QTNG_HAVE_EVP_MAC_TICKET
+// see SSL_CTX_set_tlsext_ticket_key_evp_cb(3). openssl 3 deprecates the HMAC_CTX version.
+int SslTicketKeys::callback(SSL *ssl, unsigned char *keyName, unsigned char *iv, EVP_CIPHER_CTX *cipherContext,
+                            EVP_MAC_CTX *macContext, int enc)
+{
+    SslTicketKey key;
+    int result = initCipher(ssl, keyName, iv, cipherContext, enc, &key);
+    if (result <= 0) {
+        return result;
+    }
+    char digestName[] = "SHA256";
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digestName, 0),
+        OSSL_PARAM_construct_end(),
+    };
+    if (!EVP_MAC_init(macContext, key.hmacKey, sizeof(key.hmacKey), params)) {
+        return -1;
+    }
+    return result;
+}
+#else
+// see SSL_CTX_set_tlsext_ticket_key_cb(3). libressl has no EVP_MAC.
+int SslTicketKeys::callback(SSL *ssl, unsigned char *keyName, unsigned char *iv, EVP_CIPHER_CTX *cipherContext,
+                            HMAC_CTX *hmacContext, int enc)
+{
+    SslTicketKey key;
+    int result = initCipher(ssl, keyName, iv, cipherContext, enc, &key);
+    if (result <= 0) {
+        return result;
+    }
+    if (!HMAC_Init_ex(hmacContext, key.hmacKey, sizeof(key.hmacKey), EVP_sha256(), nullptr)) {
+        return -1;
+    }
+    return result;
+}
+#endif
+
+// remembers the chains verified, keyed on the fingerprint of leaf (the same as Certificate::digest()) and the host name
+// checked, so the repeat connections to the same peers skip the path building. the private key of leaf is still proved
+// by handshake. the cache belongs to SSL_CTX, so it is dropped if the CA store is changed.
+class SslVerifiedChains
+{
+public:
+    explicit SslVerifiedChains(float timeout);
+    static int verify(X509_STORE_CTX *storeContext, void *arg);
+    // the host name (or ip address) to check on client side. it is a part of the cache key.
+    static bool setHostName(SSL *ssl, const QString &hostName);
+private:
+    typedef QSharedPointer<STACK_OF(X509)> Chain;
+    struct Entry
+    {
+        Chain chain;
+        qint64 expiry;
+    };
+    static int hostNameIndex();
+    Chain find(const QByteArray &key, qint64 now);
+    void insert(const QByteArray &key, STACK_OF(X509) *chain, qint64 expiry);
+    QMutex lock;
+    QMap<QByteArray, Entry> entries;
+    const qint64 timeout;  // in msecs.
+};
+
+const int SslVerifiedChainsMaxSize = 1024;
+
+SslVerifiedChains::SslVerifiedChains(float timeout)
+    : timeout(static_cast<qint64>(timeout * 1000))
+{
+}
+
+static void freeHostName(void *, void *ptr, CRYPTO_EX_DATA *, int, long, void *)
+{
+    delete static_cast<QByteArray *>(ptr);
+}
+
+int SslVerifiedChains::hostNameIndex()
+{
+    static int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, freeHostName);
+    return index;
+}
+
+bool SslVerifiedChains::setHostName(SSL *ssl, const QString &hostName)
+{
+    const QByteArray &name = hostName.toUtf8();
+    X509_VERIFY_PARAM *param = SSL_get0_param(ssl);
+    if (HostAddress(hostName).isNull()) {
+        X509_VERIFY_PARAM_set_hostflags(param, X509_CHECK_FLAG_NO_PARTIAL_WILDCARDS);
+        if (!SSL_set1_host(ssl, name.constData())) {
+            return false;
+        }
+    } else if (!X509_VERIFY_PARAM_set1_ip_asc(param, name.constData())) {
+        return false;
+    }
+    QByteArray *old = static_cast<QByteArray *>(SSL_get_ex_data(ssl, hostNameIndex()));
+    if (!SSL_set_ex_data(ssl, hostNameIndex(), new QByteArray(name))) {
+        return false;
+    }
+    delete old;
+    return true;
+}
+
+SslVerifiedChains::Chain SslVerifiedChains::find(const QByteArray &key, qint64 now)
+{
+    QMutexLocker locker(&lock);
+    QMap<QByteArray, Entry>::iterator itor = entries.find(key);
+    if (itor == entries.end()) {
+        return Chain();
+    }
+    if (itor.value().expiry <= now) {
+        entries.erase(itor);
+        return Chain();
+    }
+    return itor.value().chain;
+}
+
+void SslVerifiedChains::insert(const QByteArray &key, STACK_OF(X509) *chain, qint64 expiry)
+{
+    QMutexLocker locker(&lock);
+    if (entries.size() >= SslVerifiedChainsMaxSize) {
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+        for (QMap<QByteArray, Entry>::iterator itor = entries.begin(); itor != entries.end();) {
+            if (itor.value().expiry <= now) {
+                itor = entries.erase(itor);
+            } else {
+                ++itor;
+            }
+        }
+        if (entries.size() >= SslVerifiedChainsMaxSize) {
+            entries.clear();
+        }
+    }
+    Entry entry;
+    entry.chain = Chain(X509_chain_up_ref(chain), [](STACK_OF(X509) *chain) { sk_X509_pop_free(chain, X509_free); });
+    entry.expiry = expiry;
+    entries.insert(key, entry);
+}
+
+// see SSL_CTX_set_cert_verify_callback(3)
+int SslVerifiedChains::verify(X509_STORE_CTX *storeContext, void *arg)
+{
+    SslVerifiedChains *chains = static_cast<SslVerifiedChains *>(arg);
+    X509 *leaf = X509_STORE_CTX_get0_cert(storeContext);
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int mdLen = 0;
+    QByteArray key;
+    if (chains->timeout > 0 && leaf && X509_digest(leaf, EVP_sha256(), md, &mdLen)) {
+        key = QByteArray(reinterpret_cast<const char *>(md), static_cast<int>(mdLen));
+        SSL *ssl = static_cast<SSL *>(
+                X509_STORE_CTX_get_ex_data(storeContext, SSL_get_ex_data_X509_STORE_CTX_idx()));
+        const QByteArray *hostName = ssl ? static_cast<QByteArray *>(SSL_get_ex_data(ssl, hostNameIndex())) : nullptr;
+        if (hostName) {
+            key.append('\0');
+            key.append(*hostName);
+        }
+    }
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (!key.isEmpty()) {
+        const Chain &chain = chains->find(key, now);
+        if (!chain.isNull()) {
+            // the same as X509_verify_cert() succeeded, SSL_get0_verified_chain() returns the cached chain.
+            X509_STORE_CTX_set0_verified_chain(storeContext, X509_chain_up_ref(chain.data()));
+            X509_STORE_CTX_set_error(storeContext, X509_V_OK);
+            return 1;
+        }
+    }
+    int ok = X509_verify_cert(storeContext);
+    STACK_OF(X509) *chain = X509_STORE_CTX_get0_chain(storeContext);
+    if (ok > 0 && !key.isEmpty() && chain) {
+        // the result expires with the first certificate of chain.
+        qint64 expiry = now + chains->timeout;
+        for (int i = 0; i < sk_X509_num(chain); ++i) {
+            int days, secs;
+            if (ASN1_TIME_diff(&days, &secs, nullptr, X509_get0_notAfter(sk_X509_value(chain, i)))) {
+                expiry = qMin(expiry, now + (days * 86400LL + secs) * 1000);
+            }
+        }
+        if (expiry > now) {
+            chains->insert(key, chain, expiry);
+        }
+    }
+    return ok;
+}
+
+// see SSL_CTX_set_tlsext_status_cb(3)
+static int sslServerStatusCallback(SSL *ssl, void *arg)
+{
+    SslOcspStapler *stapler = static_cast<SslOcspStapler *>(arg);
+    const QByteArray &response = stapler->response();
+    if (response.isEmpty()) {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+    // owned by ssl.
+    unsigned char *buf = static_cast<unsigned char *>(OPENSSL_malloc(response.size()));
+    if (!buf) {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+    memcpy(buf, response.constData(), static_cast<size_t>(response.size()));
+    SSL_set_tlsext_status_ocsp_resp(ssl, buf, response.size());
+    return SSL_TLSEXT_ERR_OK;
+}
+
+// a missing or unsuccessful response is ignored, but a bad response or a revoked certificate fails the handshake.
+static int sslClientStatusCallback(SSL *ssl, void *)
+{
+    const unsigned char *p = nullptr;
+    long len = SSL_get_tlsext_status_ocsp_resp(ssl, &p);
+    if (len <= 0 || !p) {
+        return 1;
+    }
+    OCSP_RESPONSE *response = d2i_OCSP_RESPONSE(nullptr, &p, len);
+    if (!response) {
+        SSL_set_verify_result(ssl, X509_V_ERR_UNSPECIFIED);
+        return 0;
+    }
+    if (OCSP_response_status(response) != OCSP_RESPONSE_STATUS_SUCCESSFUL) {
+        OCSP_RESPONSE_free(response);
+        return 1;
+    }
+    int ok = 1;
+    STACK_OF(X509) *chain = SSL_get_peer_cert_chain(ssl);
+    if (chain && sk_X509_num(chain) >= 2) {
+        ok = 0;
+        X509_STORE *store = SSL_CTX_get_cert_store(SSL_get_SSL_CTX(ssl));
+        OCSP_BASICRESP *basic = OCSP_response_get1_basic(response);
+        OCSP_CERTID *id = OCSP_cert_to_id(nullptr, sk_X509_value(chain, 0), sk_X509_value(chain, 1));
+        int status, reason;
+        ASN1_GENERALIZEDTIME *revokedAt, *thisUpdate, *nextUpdate;
+        if (basic && id && OCSP_basic_verify(basic, chain, store, 0) > 0
+            && OCSP_resp_find_status(basic, id, &status, &reason, &revokedAt, &thisUpdate, &nextUpdate)
+            && OCSP_check_validity(thisUpdate, nextUpdate, 300, -1)) {
+            if (status == V_OCSP_CERTSTATUS_REVOKED) {
+                SSL_set_verify_result(ssl, X509_V_ERR_CERT_REVOKED);
+            } else {
+                ok = 1;
+            }
+        } else {
+            SSL_set_verify_result(ssl, X509_V_ERR_UNSPECIFIED);
+        }
+        OCSP_CERTID_free(id);
+        OCSP_BASICRESP_free(basic);
+    }
+    OCSP_RESPONSE_free(response);
+    return ok;
+}
+
+class SslOcspStaplerPrivate
+{
+public:
+    SslOcspStaplerPrivate(const Certificate &certificate, const Certificate &issuer, const QUrl &responderUrl);
+    bool refresh(qint64 *nextUpdate);
+    void serve(float interval);
+
+    Certificate certificate;
+    Certificate issuer;
+    QUrl responderUrl;
+    mutable QMutex lock;  // the response is read by handshakes in the thread pool.
+    QByteArray response;
+    CoroutineGroup operations;
+};
+
+static QUrl ocspResponderUrl(const Certificate &certificate)
+{
+    QUrl url;
+    X509 *x = static_cast<X509 *>(certificate.handle());
+    STACK_OF(OPENSSL_STRING) *urls = x ? X509_get1_ocsp(x) : nullptr;
+    if (urls) {
+        if (sk_OPENSSL_STRING_num(urls) > 0) {
+            url = QUrl(QString::fromLatin1(sk_OPENSSL_STRING_value(urls, 0)));
+        }
+        X509_email_free(urls);
+    }
+    return url;
+}
+
+SslOcspStaplerPrivate::SslOcspStaplerPrivate(const Certificate &certificate, const Certificate &issuer,
+                                             const QUrl &responderUrl)
+    : certificate(certificate)
+    , issuer(issuer)
+    , responderUrl(responderUrl.isValid() ? responderUrl : ocspResponderUrl(certificate))
+{
+}
+
+bool SslOcspStaplerPrivate::refresh(qint64 *nextUpdate)
+{
+    X509 *subjectX509 = static_cast<X509 *>(certificate.handle());
+    X509 *issuerX509 = static_cast<X509 *>(issuer.handle());
+    if (!responderUrl.isValid() || !subjectX509 || !issuerX509) {
+        qtng_debug << "can not refresh ocsp response without certificate, issuer and responder url.";
+        return false;
+    }
+    OCSP_CERTID *id = OCSP_cert_to_id(nullptr, subjectX509, issuerX509);
+    if (!id) {
+        return false;
+    }
+    QByteArray requestData;
+    OCSP_REQUEST *request = OCSP_REQUEST_new();
+    if (request && OCSP_request_add0_id(request, OCSP_CERTID_dup(id))) {
+        int len = i2d_OCSP_REQUEST(request, nullptr);
+        if (len > 0) {
+            requestData.resize(len);
+            unsigned char *p = reinterpret_cast<unsigned char *>(requestData.data());
+            i2d_OCSP_REQUEST(request, &p);
+        }
+    }
+    OCSP_REQUEST_free(request);
+    if (requestData.isEmpty()) {
+        OCSP_CERTID_free(id);
+        return false;
+    }
+
+    HttpSession session;
+    QMap<QString, QByteArray> headers;
+    headers.insert(QString::fromLatin1("Content-Type"), "application/ocsp-request");
+    HttpResponse httpResponse = session.post(responderUrl, requestData, headers);
+    bool ok = false;
+    if (httpResponse.isOk()) {
+        const QByteArray &body = httpResponse.body();
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(body.constData());
+        OCSP_RESPONSE *ocspResponse = d2i_OCSP_RESPONSE(nullptr, &p, body.size());
+        if (ocspResponse && OCSP_response_status(ocspResponse) == OCSP_RESPONSE_STATUS_SUCCESSFUL) {
+            OCSP_BASICRESP *basic = OCSP_response_get1_basic(ocspResponse);
+            int status, reason;
+            ASN1_GENERALIZEDTIME *revokedAt, *thisUpdate, *next;
+            if (basic && OCSP_resp_find_status(basic, id, &status, &reason, &revokedAt, &thisUpdate, &next)
+                && OCSP_check_validity(thisUpdate, next, 300, -1)) {
+                ok = true;
+                int days, secs;
+                if (next && ASN1_TIME_diff(&days, &secs, nullptr, next)) {
+                    *nextUpdate = QDateTime::currentMSecsSinceEpoch() + (days * 86400LL + secs) * 1000;
+                }
+            }
+            OCSP_BASICRESP_free(basic);
+        }
+        OCSP_RESPONSE_free(ocspResponse);
+        if (ok) {
+            QMutexLocker locker(&lock);
+            response = body;
+        } else {
+            qtng_debug << "got invalid ocsp response from" << responderUrl;
+        }
+    } else {
+        qtng_debug << "can not fetch ocsp response from" << responderUrl << httpResponse.statusCode();
+    }
+    OCSP_CERTID_free(id);
+    return ok;
+}
+
+void SslOcspStaplerPrivate::serve(float interval)
+{
+    while (true) {
+        qint64 nextUpdate = 0;
+        float secs;
+        if (refresh(&nextUpdate)) {
+            secs = interval;
+            if (nextUpdate > 0) {
+                // refresh at the half way to the next update of responder.
+                float remain = (nextUpdate - QDateTime::currentMSecsSinceEpoch()) / 2000.0f;
+                secs = qMin(interval, qMax(60.0f, remain));
+            }
+        } else {
+            secs = qMin(interval, 60.0f);
+        }
+        Coroutine::sleep(secs);
+    }
+}
+
+SslOcspStapler::SslOcspStapler(const Certificate &certificate, const Certificate &issuer, const QUrl &responderUrl)
+    : d_ptr(new SslOcspStaplerPrivate(certificate, issuer, responderUrl))
+{
+}
+
+SslOcspStapler::~SslOcspStapler()
+{
+    delete d_ptr;
+}
+
+QByteArray SslOcspStapler::response() const
+{
+    Q_D(const SslOcspStapler);
+    QMutexLocker locker(&d->lock);
+    return d->response;
+}
+
+void SslOcspStapler::setResponse(const QByteArray &response)
+{
+    Q_D(SslOcspStapler);
+    QMutexLocker locker(&d->lock);
+    d->response = response;
+}
+
+QUrl SslOcspStapler::responderUrl() const
+{
+    Q_D(const SslOcspStapler);
+    return d->responderUrl;
+}
+
+void SslOcspStapler::setResponderUrl(const QUrl &responderUrl)
+{
+    Q_D(SslOcspStapler);
+    d->responderUrl = responderUrl;
+}
+
+bool SslOcspStapler::refresh()
+{
+    Q_D(SslOcspStapler);
+    qint64 nextUpdate = 0;
+    return d->refresh(&nextUpdate);
+}
+
+void SslOcspStapler::start(float interval)
+{
+    Q_D(SslOcspStapler);
+    d->operations.spawnWithName(QString::fromLatin1("refresh"), [d, interval] { d->serve(interval); }, true);
+}
+
+void SslOcspStapler::stop()
+{
+    Q_D(SslOcspStapler);
+    d->operations.kill(QString::fromLatin1("refresh"));
+}
+
 class SslConfigurationPrivate : public QSharedData
 {
 public:
     SslConfigurationPrivate();
-    SslConfigurationPrivate(const SslConfigurationPrivate &) = default;
+    SslConfigurationPrivate(const SslConfigurationPrivate &other);
     bool isNull() const;
     bool operator==(const SslConfigurationPrivate &other) const;
     static QSharedPointer<SSL_CTX> makeContext(const SslConfiguration &config, bool asServer);
+    // the SSL_CTX is made once and shared by all connections using this configuration.
+    static QSharedPointer<SSL_CTX> context(const SslConfiguration &config, bool asServer);
+    void clearContexts();
     void setSendTlsExtHostName(bool sendTlsExtHostName);
 
     QList<Certificate> caCertificates;
@@ -231,32 +797,68 @@ public:
     QList<SslCipher> ciphers;
     QSharedPointer<ChooseTlsExtNameCallback> chooseTlsExtNameCallback;
     int peerVerifyDepth;
+    Ssl::SslProtocol sslProtocol;
     bool onlySecureProtocol;
     bool supportCompression;
+    bool kernelTls;
+    float peerVerifyCacheTimeout;
+    QSharedPointer<SslOcspStapler> ocspStapler;
+
+    QMutex contextLock;
+    QSharedPointer<SSL_CTX> clientContext;
+    QSharedPointer<SSL_CTX> serverContext;
 };
 
+SslConfigurationPrivate::SslConfigurationPrivate(const SslConfigurationPrivate &other)
+    : QSharedData(other)
+    , caCertificates(other.caCertificates)
+    , localCertificate(other.localCertificate)
+    , privateKey(other.privateKey)
+    , allowedNextProtocols(other.allowedNextProtocols)
+    , peerVerifyMode(other.peerVerifyMode)
+    , ciphers(other.ciphers)
+    , chooseTlsExtNameCallback(other.chooseTlsExtNameCallback)
+    , peerVerifyDepth(other.peerVerifyDepth)
+    , sslProtocol(other.sslProtocol)
+    , onlySecureProtocol(other.onlySecureProtocol)
+    , supportCompression(other.supportCompression)
+    , kernelTls(other.kernelTls)
+    , peerVerifyCacheTimeout(other.peerVerifyCacheTimeout)
+    , ocspStapler(other.ocspStapler)
+{
+    // the copy is going to be changed, do not share the contexts.
+}
+
 bool SslConfigurationPrivate::operator==(const SslConfigurationPrivate &other) const
 {
     return caCertificates == other.caCertificates && localCertificate == other.localCertificate
             && privateKey == other.privateKey && allowedNextProtocols == other.allowedNextProtocols
             && peerVerifyMode == other.peerVerifyMode && ciphers == other.ciphers
             && chooseTlsExtNameCallback == other.chooseTlsExtNameCallback && peerVerifyDepth == other.peerVerifyDepth
-            && onlySecureProtocol == other.onlySecureProtocol && supportCompression == other.supportCompression;
+            && sslProtocol == other.sslProtocol && onlySecureProtocol == other.onlySecureProtocol
+            && supportCompression == other.supportCompression
+            && kernelTls == other.kernelTls && peerVerifyCacheTimeout == other.peerVerifyCacheTimeout
+            && ocspStapler == other.ocspStapler;
 }
 
 bool SslConfigurationPrivate::isNull() const
 {
     return caCertificates.isEmpty() && localCertificate.isNull() && !privateKey.isValid()
             && allowedNextProtocols.isEmpty() && peerVerifyMode == Ssl::AutoVerifyPeer && ciphers.isEmpty()
-            && chooseTlsExtNameCallback.isNull() && peerVerifyDepth == 4 && onlySecureProtocol == true
-            && supportCompression == true;
+            && chooseTlsExtNameCallback.isNull() && peerVerifyDepth == 4
+            && sslProtocol == Ssl::SecureProtocols && onlySecureProtocol == true
+            && supportCompression == true && kernelTls == false && peerVerifyCacheTimeout == 3600.0f
+            && ocspStapler.isNull();
 }
 
 SslConfigurationPrivate::SslConfigurationPrivate()
     : peerVerifyMode(Ssl::AutoVerifyPeer)
     , peerVerifyDepth(4)
+    , sslProtocol(Ssl::SecureProtocols)
     , onlySecureProtocol(true)
     , supportCompression(true)
+    , kernelTls(false)
+    , peerVerifyCacheTimeout(3600.0f)
 {
     setSendTlsExtHostName(true);
 }
@@ -276,6 +878,10 @@ void SslConfigurationPrivate::setSendTlsExtHostName(bool sendTlsExtHostName)
     }
 }
 
+#ifdef QTNG_KERNEL_TLS13
+static void kernelTlsKeylog(const SSL *ssl, const char *line);
+#endif
+
 QSharedPointer<SSL_CTX> SslConfigurationPrivate::makeContext(const SslConfiguration &config, bool asServer)
 {
     QSharedPointer<SSL_CTX> ctx;
@@ -288,10 +894,61 @@ QSharedPointer<SSL_CTX> SslConfigurationPrivate::makeContext(const SslConfigurat
     if (!method) {
         return ctx;
     }
-    ctx.reset(SSL_CTX_new(method), SSL_CTX_free);
-    if (ctx.isNull()) {
+    SSL_CTX *rawContext = SSL_CTX_new(method);
+    if (!rawContext) {
         return ctx;
     }
+    SslTicketKeys *keys = asServer ? new SslTicketKeys() : nullptr;
+    SslVerifiedChains *chains = nullptr;
+    if (config.peerVerifyMode() == Ssl::VerifyPeer) {
+        chains = new SslVerifiedChains(config.peerVerifyCacheTimeout());
+    }
+    // the callbacks refer to the stapler, keep it alive.
+    QSharedPointer<SslOcspStapler> stapler = asServer ? config.ocspStapler() : QSharedPointer<SslOcspStapler>();
+    ctx.reset(rawContext, [keys, chains, stapler](SSL_CTX *rawContext) {
+        SSL_CTX_free(rawContext);
+        delete keys;
+        delete chains;
+    });
+    if (asServer) {
+        SSL_CTX_set_ex_data(rawContext, SslTicketKeys::exDataIndex(), keys);
+#ifdef QTNG_HAVE_EVP_MAC_TICKET
+        SSL_CTX_set_tlsext_ticket_key_evp_cb(rawContext, SslTicketKeys::callback);
+#else
+        SSL_CTX_set_tlsext_ticket_key_cb(rawContext, SslTicketKeys::callback);
+#endif
+        // the server side session cache requires a session id context.
+        static const unsigned char sessionIdContext[] = "qtng";
+        SSL_CTX_set_session_id_context(rawContext, sessionIdContext, sizeof(sessionIdContext) - 1);
+        SSL_CTX_set_session_cache_mode(rawContext, SSL_SESS_CACHE_SERVER);
+        if (!stapler.isNull()) {
+            SSL_CTX_set_tlsext_status_cb(rawContext, sslServerStatusCallback);
+            SSL_CTX_set_tlsext_status_arg(rawContext, stapler.data());
+        }
+    }
+    if (chains) {
+        const QList<Certificate> &caCertificates = config.caCertificates();
+        if (caCertificates.isEmpty()) {
+            SSL_CTX_set_default_verify_paths(rawContext);
+        } else {
+            X509_STORE *store = SSL_CTX_get_cert_store(rawContext);
+            for (const Certificate &certificate : caCertificates) {
+                if (!certificate.isNull()) {
+                    X509_STORE_add_cert(store, static_cast<X509 *>(certificate.handle()));
+                }
+            }
+        }
+        SSL_CTX_set_verify(rawContext, SSL_VERIFY_PEER, nullptr);
+        SSL_CTX_set_cert_verify_callback(rawContext, SslVerifiedChains::verify, chains);
+        if (!asServer) {
+            SSL_CTX_set_tlsext_status_cb(rawContext, sslClientStatusCallback);
+        }
+    }
+#ifdef QTNG_KERNEL_TLS13
+    if (config.kernelTls()) {
+        SSL_CTX_set_keylog_callback(rawContext, kernelTlsKeylog);
+    }
+#endif
     SSL_CTX_set_verify_depth(ctx.data(), config.peerVerifyDepth());
     long flags = SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3 | SSL_OP_NO_TLSv1;
     if (config.onlySecureProtocol()) {
@@ -301,6 +958,31 @@ QSharedPointer<SSL_CTX> SslConfigurationPrivate::makeContext(const SslConfigurat
         flags |= SSL_OP_NO_COMPRESSION;
     }
     SSL_CTX_set_options(ctx.data(), flags);
+    // the options above still apply, so TlsV1_0 does not work with onlySecureProtocol.
+    switch (config.sslProtocol()) {
+    case Ssl::TlsV1_0:
+        SSL_CTX_set_max_proto_version(ctx.data(), TLS1_VERSION);
+        break;
+    case Ssl::TlsV1_1:
+        SSL_CTX_set_min_proto_version(ctx.data(), TLS1_1_VERSION);
+        SSL_CTX_set_max_proto_version(ctx.data(), TLS1_1_VERSION);
+        break;
+    case Ssl::TlsV1_1OrLater:
+        SSL_CTX_set_min_proto_version(ctx.data(), TLS1_1_VERSION);
+        break;
+    case Ssl::TlsV1_2:
+        SSL_CTX_set_min_proto_version(ctx.data(), TLS1_2_VERSION);
+        SSL_CTX_set_max_proto_version(ctx.data(), TLS1_2_VERSION);
+        break;
+    case Ssl::TlsV1_2OrLater:
+        SSL_CTX_set_min_proto_version(ctx.data(), TLS1_2_VERSION);
+        break;
+    case Ssl::TlsV1_3:
+        SSL_CTX_set_min_proto_version(ctx.data(), TLS1_3_VERSION);
+        break;
+    default:
+        break;
+    }
     const PrivateKey &privateKey = config.privateKey();
     if (privateKey.isValid()) {
         int r = SSL_CTX_use_PrivateKey(ctx.data(), static_cast<EVP_PKEY *>(privateKey.handle()));
@@ -318,6 +1000,24 @@ QSharedPointer<SSL_CTX> SslConfigurationPrivate::makeContext(const SslConfigurat
     return ctx;
 }
 
+QSharedPointer<SSL_CTX> SslConfigurationPrivate::context(const SslConfiguration &config, bool asServer)
+{
+    SslConfigurationPrivate *d = const_cast<SslConfigurationPrivate *>(config.d.constData());
+    QMutexLocker locker(&d->contextLock);
+    QSharedPointer<SSL_CTX> &ctx = asServer ? d->serverContext : d->clientContext;
+    if (ctx.isNull()) {
+        ctx = makeContext(config, asServer);
+    }
+    return ctx;
+}
+
+void SslConfigurationPrivate::clearContexts()
+{
+    QMutexLocker locker(&contextLock);
+    clientContext.clear();
+    serverContext.clear();
+}
+
 SslConfiguration::SslConfiguration()
     : d(new SslConfigurationPrivate())
 {
@@ -397,6 +1097,11 @@ PrivateKey SslConfiguration::privateKey() const
     return d->privateKey;
 }
 
+Ssl::SslProtocol SslConfiguration::sslProtocol() const
+{
+    return d->sslProtocol;
+}
+
 bool SslConfiguration::onlySecureProtocol() const
 {
     return d->onlySecureProtocol;
@@ -407,6 +1112,21 @@ bool SslConfiguration::supportCompression() const
     return d->supportCompression;
 }
 
+bool SslConfiguration::kernelTls() const
+{
+    return d->kernelTls;
+}
+
+float SslConfiguration::peerVerifyCacheTimeout() const
+{
+    return d->peerVerifyCacheTimeout;
+}
+
+QSharedPointer<SslOcspStapler> SslConfiguration::ocspStapler() const
+{
+    return d->ocspStapler;
+}
+
 bool SslConfiguration::sendTlsExtHostName() const
 {
     return !d->chooseTlsExtNameCallback.isNull();
@@ -419,31 +1139,37 @@ QSharedPointer<ChooseTlsExtNameCallback> SslConfiguration::tlsExtHostNameCallbac
 
 void SslConfiguration::addCaCertificate(const Certificate &certificate)
 {
+    d->clearContexts();
     d->caCertificates.append(certificate);
 }
 
 void SslConfiguration::addCaCertificates(const QList<Certificate> &certificates)
 {
+    d->clearContexts();
     d->caCertificates.append(certificates);
 }
 
 void SslConfiguration::setAllowedNextProtocols(const QList<QByteArray> &protocols)
 {
+    d->clearContexts();
     d->allowedNextProtocols = protocols;
 }
 
 void SslConfiguration::setPeerVerifyDepth(int depth)
 {
+    d->clearContexts();
     d->peerVerifyDepth = depth;
 }
 
 void SslConfiguration::setPeerVerifyMode(Ssl::PeerVerifyMode mode)
 {
+    d->clearContexts();
     d->peerVerifyMode = mode;
 }
 
 void SslConfiguration::setLocalCertificate(const Certificate &certificate)
 {
+    d->clearContexts();
     d->localCertificate = certificate;
 }
 
@@ -467,12 +1193,14 @@ bool SslConfiguration::setLocalCertificate(const QString &path, Ssl::EncodingFor
     if (cert.isNull() || cert.isBlacklisted()) {
         return false;
     }
+    d->clearContexts();
     d->localCertificate = cert;
     return true;
 }
 
 void SslConfiguration::setPrivateKey(const PrivateKey &key)
 {
+    d->clearContexts();
     d->privateKey = key;
 }
 
@@ -496,27 +1224,55 @@ bool SslConfiguration::setPrivateKey(const QString &fileName, Ssl::EncodingForma
     if (!key.isValid()) {
         return false;
     }
+    d->clearContexts();
     d->privateKey = key;
     return true;
 }
 
+void SslConfiguration::setSslProtocol(Ssl::SslProtocol protocol)
+{
+    d->clearContexts();
+    d->sslProtocol = protocol;
+}
+
 void SslConfiguration::setOnlySecureProtocol(bool onlySecureProtocol)
 {
+    d->clearContexts();
     d->onlySecureProtocol = onlySecureProtocol;
 }
 
 void SslConfiguration::setSupportCompression(bool supportCompression)
 {
+    d->clearContexts();
     d->supportCompression = supportCompression;
 }
 
+void SslConfiguration::setKernelTls(bool kernelTls)
+{
+    d->kernelTls = kernelTls;
+}
+
+void SslConfiguration::setPeerVerifyCacheTimeout(float secs)
+{
+    d->clearContexts();
+    d->peerVerifyCacheTimeout = secs;
+}
+
+void SslConfiguration::setOcspStapler(QSharedPointer<SslOcspStapler> stapler)
+{
+    d->clearContexts();
+    d->ocspStapler = stapler;
+}
+
 void SslConfiguration::setSendTlsExtHostName(bool sendTlsExtHostName)
 {
+    d->clearContexts();
     d->setSendTlsExtHostName(sendTlsExtHostName);
 }
 
 void SslConfiguration::setTlsExtHostNameCallback(QSharedPointer<ChooseTlsExtNameCallback> callback)
 {
+    d->clearContexts();
     d->chooseTlsExtNameCallback = callback;
 }
 
@@ -706,56 +1462,519 @@ QDebug &operator<<(QDebug &debug, const SslError::Error &error)
     return debug;
 }
 
-/*
-static SslError _q_OpenSSL_to_SslError(int errorCode, const Certificate &cert)
+/*
+static SslError _q_OpenSSL_to_SslError(int errorCode, const Certificate &cert)
+{
+    SslError error;
+    switch (errorCode) {
+    case X509_V_OK:
+        // X509_V_OK is also reported if the peer had no certificate.
+        break;
+    case X509_V_ERR_UNABLE_TO_GET_ISSUER_CERT:
+        error = SslError(SslError::UnableToGetIssuerCertificate, cert); break;
+    case X509_V_ERR_UNABLE_TO_DECRYPT_CERT_SIGNATURE:
+        error = SslError(SslError::UnableToDecryptCertificateSignature, cert); break;
+    case X509_V_ERR_UNABLE_TO_DECODE_ISSUER_PUBLIC_KEY:
+        error = SslError(SslError::UnableToDecodeIssuerPublicKey, cert); break;
+    case X509_V_ERR_CERT_SIGNATURE_FAILURE:
+        error = SslError(SslError::CertificateSignatureFailed, cert); break;
+    case X509_V_ERR_CERT_NOT_YET_VALID:
+        error = SslError(SslError::CertificateNotYetValid, cert); break;
+    case X509_V_ERR_CERT_HAS_EXPIRED:
+        error = SslError(SslError::CertificateExpired, cert); break;
+    case X509_V_ERR_ERROR_IN_CERT_NOT_BEFORE_FIELD:
+        error = SslError(SslError::InvalidNotBeforeField, cert); break;
+    case X509_V_ERR_ERROR_IN_CERT_NOT_AFTER_FIELD:
+        error = SslError(SslError::InvalidNotAfterField, cert); break;
+    case X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT:
+        error = SslError(SslError::SelfSignedCertificate, cert); break;
+    case X509_V_ERR_SELF_SIGNED_CERT_IN_CHAIN:
+        error = SslError(SslError::SelfSignedCertificateInChain, cert); break;
+    case X509_V_ERR_UNABLE_TO_GET_ISSUER_CERT_LOCALLY:
+        error = SslError(SslError::UnableToGetLocalIssuerCertificate, cert); break;
+    case X509_V_ERR_UNABLE_TO_VERIFY_LEAF_SIGNATURE:
+        error = SslError(SslError::UnableToVerifyFirstCertificate, cert); break;
+    case X509_V_ERR_CERT_REVOKED:
+        error = SslError(SslError::CertificateRevoked, cert); break;
+    case X509_V_ERR_INVALID_CA:
+        error = SslError(SslError::InvalidCaCertificate, cert); break;
+    case X509_V_ERR_PATH_LENGTH_EXCEEDED:
+        error = SslError(SslError::PathLengthExceeded, cert); break;
+    case X509_V_ERR_INVALID_PURPOSE:
+        error = SslError(SslError::InvalidPurpose, cert); break;
+    case X509_V_ERR_CERT_UNTRUSTED:
+        error = SslError(SslError::CertificateUntrusted, cert); break;
+    case X509_V_ERR_CERT_REJECTED:
+        error = SslError(SslError::CertificateRejected, cert); break;
+    default:
+        error = SslError(SslError::UnspecifiedError, cert); break;
+    }
+    return error;
+}
+*/
+
+// the BIO of SslConnection. instead of pumping the memory BIOs through temporary buffers, the raw socket
+// receives into `incoming` and sends from `outgoing` directly. the BIO never blocks, it asks SSL_read() and
+// SSL_write() to retry, so the SSL object is never entered by two coroutines, and can be used in a thread pool.
+const int SslIncomingBufferSize = 1024 * 32;
+const int SslMaxOutgoingBufferSize = 1024 * 64;
+const int SslOutgoingBufferSize = 1024 * 17;  // a full record with its overhead.
+
+// counts the records passing through the BIO after ChangeCipherSpec, which is the sequence number of next record.
+// the kernel tls continues from it.
+struct SslRecordCounter
+{
+    SslRecordCounter()
+        : headerSize(0)
+        , bodyRemaining(0)
+        , encrypted(false)
+        , sequence(0)
+    {
+    }
+    void feed(const char *data, int len);
+    unsigned char header[5];
+    int headerSize;
+    int bodyRemaining;
+    bool encrypted;
+    quint64 sequence;
+};
+
+void SslRecordCounter::feed(const char *data, int len)
+{
+    while (len > 0) {
+        if (bodyRemaining > 0) {
+            int bytes = qMin(bodyRemaining, len);
+            bodyRemaining -= bytes;
+            data += bytes;
+            len -= bytes;
+            continue;
+        }
+        header[headerSize++] = static_cast<unsigned char>(*data++);
+        --len;
+        if (headerSize < static_cast<int>(sizeof(header))) {
+            continue;
+        }
+        headerSize = 0;
+        bodyRemaining = (header[3] << 8) | header[4];
+        if (header[0] == 20) {  // change_cipher_spec, the records after it are encrypted.
+            encrypted = true;
+            sequence = 0;
+        } else if (encrypted) {
+            ++sequence;
+        }
+    }
+}
+
+struct SslBuffers
+{
+    SslBuffers()
+        : incomingStart(0)
+        , incomingEnd(0)
+    {
+        // the reserved capacity is kept by resize(0), so the outgoing buffers are allocated once.
+        outgoing.reserve(SslOutgoingBufferSize);
+        sending.reserve(SslOutgoingBufferSize);
+    }
+    QByteArray incoming;
+    int incomingStart;
+    int incomingEnd;
+    QByteArray outgoing;
+    QByteArray sending;  // swapped with outgoing by pumpOutgoing(), so the library can write while sending.
+    SslRecordCounter incomingRecords;  // read by the library.
+    SslRecordCounter outgoingRecords;  // written by the library.
+#ifdef QTNG_KERNEL_TLS13
+    QByteArray clientTrafficSecret;  // TLS 1.3 application secrets, only logged for the kernel tls.
+    QByteArray serverTrafficSecret;
+#endif
+    Lock incomingLock;
+    Lock outgoingLock;
+};
+
+static int sslBufferWrite(BIO *bio, const char *data, int len)
+{
+    SslBuffers *buffers = static_cast<SslBuffers *>(BIO_get_data(bio));
+    BIO_clear_retry_flags(bio);
+    if (!buffers) {
+        return -1;
+    }
+    if (buffers->outgoing.size() >= SslMaxOutgoingBufferSize) {
+        BIO_set_retry_write(bio);
+        return -1;
+    }
+    buffers->outgoing.append(data, len);
+    buffers->outgoingRecords.feed(data, len);
+    return len;
+}
+
+static int sslBufferRead(BIO *bio, char *data, int len)
+{
+    SslBuffers *buffers = static_cast<SslBuffers *>(BIO_get_data(bio));
+    BIO_clear_retry_flags(bio);
+    if (!buffers) {
+        return -1;
+    }
+    int available = buffers->incomingEnd - buffers->incomingStart;
+    if (available <= 0) {
+        BIO_set_retry_read(bio);
+        return -1;
+    }
+    int bytes = qMin(len, available);
+    memcpy(data, buffers->incoming.constData() + buffers->incomingStart, static_cast<size_t>(bytes));
+    buffers->incomingStart += bytes;
+    buffers->incomingRecords.feed(data, bytes);
+    return bytes;
+}
+
+static long sslBufferCtrl(BIO *bio, int cmd, long num, void *ptr)
+{
+    Q_UNUSED(num);
+    Q_UNUSED(ptr);
+    SslBuffers *buffers = static_cast<SslBuffers *>(BIO_get_data(bio));
+    switch (cmd) {
+    case BIO_CTRL_PENDING:
+        return buffers ? buffers->incomingEnd - buffers->incomingStart : 0;
+    case BIO_CTRL_WPENDING:
+        return buffers ? buffers->outgoing.size() : 0;
+    case BIO_CTRL_FLUSH:
+    case BIO_CTRL_DUP:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static int sslBufferCreate(BIO *bio)
+{
+    BIO_set_init(bio, 1);
+    return 1;
+}
+
+static int sslBufferDestroy(BIO *bio)
+{
+    BIO_set_data(bio, nullptr);
+    return 1;
+}
+
+static BIO_METHOD *sslBufferMethod()
+{
+    static BIO_METHOD *method = [] {
+        BIO_METHOD *method = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "qtng buffers");
+        if (method) {
+            BIO_meth_set_write(method, sslBufferWrite);
+            BIO_meth_set_read(method, sslBufferRead);
+            BIO_meth_set_ctrl(method, sslBufferCtrl);
+            BIO_meth_set_create(method, sslBufferCreate);
+            BIO_meth_set_destroy(method, sslBufferDestroy);
+        }
+        return method;
+    }();
+    return method;
+}
+
+#if defined(Q_OS_LINUX) && defined(TLS_TX)
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+// P_hash() of RFC 5246 section 5.
+static bool tls12Prf(const EVP_MD *md, const QByteArray &secret, const QByteArray &labelAndSeed, unsigned char *out,
+                     int outLen)
+{
+    const unsigned char *key = reinterpret_cast<const unsigned char *>(secret.constData());
+    unsigned char a[EVP_MAX_MD_SIZE];
+    unsigned int aLen = 0;
+    if (!HMAC(md, key, secret.size(), reinterpret_cast<const unsigned char *>(labelAndSeed.constData()),
+              labelAndSeed.size(), a, &aLen)) {
+        return false;
+    }
+    int done = 0;
+    while (done < outLen) {
+        QByteArray input(reinterpret_cast<const char *>(a), static_cast<int>(aLen));
+        input.append(labelAndSeed);
+        unsigned char block[EVP_MAX_MD_SIZE];
+        unsigned int blockLen = 0;
+        if (!HMAC(md, key, secret.size(), reinterpret_cast<const unsigned char *>(input.constData()), input.size(),
+                  block, &blockLen)) {
+            return false;
+        }
+        int bytes = qMin<int>(static_cast<int>(blockLen), outLen - done);
+        memcpy(out + done, block, static_cast<size_t>(bytes));
+        done += bytes;
+        unsigned char next[EVP_MAX_MD_SIZE];
+        if (!HMAC(md, key, secret.size(), a, aLen, next, &aLen)) {
+            return false;
+        }
+        memcpy(a, next, aLen);
+    }
+    return true;
+}
+
+union KernelTlsCryptoInfo
+{
+    struct tls_crypto_info info;
+    struct tls12_crypto_info_aes_gcm_128 aes128;
+#ifdef TLS_CIPHER_AES_GCM_256
+    struct tls12_crypto_info_aes_gcm_256 aes256;
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    struct tls12_crypto_info_chacha20_poly1305 chacha20;
+#endif
+};
+
+// fill the crypto info of one direction. `key` and `iv` are the write key and iv of the direction, the iv of TLS 1.2
+// AES-GCM is the 4 bytes implicit part, while the others are 12 bytes. `recordSequence` is the sequence number of the
+// next record.
+static int makeKernelTlsCryptoInfo(int version, int nid, const unsigned char *key, const unsigned char *iv, int keyLen,
+                                   quint64 recordSequence, KernelTlsCryptoInfo *info)
+{
+    unsigned char sequence[8];
+    qToBigEndian<quint64>(recordSequence, sequence);
+    memset(info, 0, sizeof(*info));
+    info->info.version = static_cast<unsigned short>(version);
+    // with TLS 1.2 AES-GCM, the explicit nonce only has to be unique, use the sequence number like others do. with
+    // TLS 1.3, the nonce is the whole iv xor the sequence number, which is done by the kernel.
+    const bool tls12 = version == TLS_1_2_VERSION;
+    if (nid == NID_aes_128_gcm) {
+        info->info.cipher_type = TLS_CIPHER_AES_GCM_128;
+        memcpy(info->aes128.key, key, static_cast<size_t>(keyLen));
+        memcpy(info->aes128.salt, iv, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+        memcpy(info->aes128.iv, tls12 ? sequence : iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
+               TLS_CIPHER_AES_GCM_128_IV_SIZE);
+        memcpy(info->aes128.rec_seq, sequence, TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE);
+        return sizeof(info->aes128);
+#ifdef TLS_CIPHER_AES_GCM_256
+    } else if (nid == NID_aes_256_gcm) {
+        info->info.cipher_type = TLS_CIPHER_AES_GCM_256;
+        memcpy(info->aes256.key, key, static_cast<size_t>(keyLen));
+        memcpy(info->aes256.salt, iv, TLS_CIPHER_AES_GCM_256_SALT_SIZE);
+        memcpy(info->aes256.iv, tls12 ? sequence : iv + TLS_CIPHER_AES_GCM_256_SALT_SIZE,
+               TLS_CIPHER_AES_GCM_256_IV_SIZE);
+        memcpy(info->aes256.rec_seq, sequence, TLS_CIPHER_AES_GCM_256_REC_SEQ_SIZE);
+        return sizeof(info->aes256);
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    } else if (nid == NID_chacha20_poly1305) {
+        info->info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+        memcpy(info->chacha20.key, key, static_cast<size_t>(keyLen));
+        memcpy(info->chacha20.iv, iv, TLS_CIPHER_CHACHA20_POLY1305_IV_SIZE);
+        memcpy(info->chacha20.rec_seq, sequence, TLS_CIPHER_CHACHA20_POLY1305_REC_SEQ_SIZE);
+        return sizeof(info->chacha20);
+#endif
+    }
+    return 0;
+}
+
+// the digest of TLS 1.2 PRF is decided by the cipher suite.
+static const EVP_MD *kernelTlsPrfDigest(const SSL_CIPHER *cipher, int nid)
+{
+#ifdef LIBRESSL_VERSION_NUMBER
+    // libressl does not export the handshake digest, all the AEAD suites of TLS 1.2 use SHA384 with AES-256-GCM.
+    Q_UNUSED(cipher);
+    return nid == NID_aes_256_gcm ? EVP_sha384() : EVP_sha256();
+#else
+    Q_UNUSED(nid);
+    return SSL_CIPHER_get_handshake_digest(cipher);
+#endif
+}
+
+// the keyBlock is filled with client_write_key, server_write_key, client_write_IV and server_write_IV of TLS 1.2 key
+// expansion. AEAD ciphers have no MAC keys.
+static bool deriveTls12Keys(SSL *ssl, const SSL_CIPHER *cipher, int nid, int keyLen, int ivLen,
+                            unsigned char *keyBlock)
+{
+    const EVP_MD *md = kernelTlsPrfDigest(cipher, nid);
+    SSL_SESSION *session = SSL_get_session(ssl);
+    if (!md || !session) {
+        return false;
+    }
+    QByteArray masterKey(SSL_MAX_MASTER_KEY_LENGTH, Qt::Uninitialized);
+    masterKey.resize(static_cast<int>(SSL_SESSION_get_master_key(
+            session, reinterpret_cast<unsigned char *>(masterKey.data()), static_cast<size_t>(masterKey.size()))));
+    QByteArray clientRandom(SSL3_RANDOM_SIZE, Qt::Uninitialized);
+    QByteArray serverRandom(SSL3_RANDOM_SIZE, Qt::Uninitialized);
+    bool ok = !masterKey.isEmpty()
+            && SSL_get_client_random(ssl, reinterpret_cast<unsigned char *>(clientRandom.data()), SSL3_RANDOM_SIZE)
+                    == SSL3_RANDOM_SIZE
+            && SSL_get_server_random(ssl, reinterpret_cast<unsigned char *>(serverRandom.data()), SSL3_RANDOM_SIZE)
+                    == SSL3_RANDOM_SIZE;
+    if (ok) {
+        const QByteArray &labelAndSeed = QByteArray("key expansion") + serverRandom + clientRandom;
+        ok = tls12Prf(md, masterKey, labelAndSeed, keyBlock, keyLen * 2 + ivLen * 2);
+    }
+    OPENSSL_cleanse(masterKey.data(), static_cast<size_t>(masterKey.size()));
+    return ok;
+}
+
+#ifdef QTNG_KERNEL_TLS13
+
+// HKDF-Expand-Label() of RFC 8446 section 7.1 with empty context. the output is not longer than the digest, so it is
+// the first block of HKDF-Expand().
+static bool tls13ExpandLabel(const EVP_MD *md, const QByteArray &secret, const QByteArray &label, unsigned char *out,
+                             int outLen)
+{
+    if (outLen > EVP_MD_size(md)) {
+        return false;
+    }
+    const QByteArray &fullLabel = "tls13 " + label;
+    QByteArray info;
+    info.append(static_cast<char>(outLen >> 8));
+    info.append(static_cast<char>(outLen & 0xff));
+    info.append(static_cast<char>(fullLabel.size()));
+    info.append(fullLabel);
+    info.append('\x00');  // the length of context.
+    info.append('\x01');  // the counter of the first block.
+    unsigned char block[EVP_MAX_MD_SIZE];
+    unsigned int blockLen = 0;
+    if (!HMAC(md, secret.constData(), secret.size(), reinterpret_cast<const unsigned char *>(info.constData()),
+              static_cast<size_t>(info.size()), block, &blockLen)) {
+        return false;
+    }
+    memcpy(out, block, static_cast<size_t>(outLen));
+    OPENSSL_cleanse(block, sizeof(block));
+    return true;
+}
+
+// the keyBlock is filled like deriveTls12Keys(), but from the application traffic secrets of TLS 1.3.
+static bool deriveTls13Keys(const SSL_CIPHER *cipher, int keyLen, int ivLen, const QByteArray &clientSecret,
+                            const QByteArray &serverSecret, unsigned char *keyBlock)
+{
+    const EVP_MD *md = SSL_CIPHER_get_handshake_digest(cipher);
+    if (!md || clientSecret.isEmpty() || serverSecret.isEmpty()) {
+        return false;
+    }
+    return tls13ExpandLabel(md, clientSecret, "key", keyBlock, keyLen)
+            && tls13ExpandLabel(md, serverSecret, "key", keyBlock + keyLen, keyLen)
+            && tls13ExpandLabel(md, clientSecret, "iv", keyBlock + keyLen * 2, ivLen)
+            && tls13ExpandLabel(md, serverSecret, "iv", keyBlock + keyLen * 2 + ivLen, ivLen);
+}
+
+// the traffic secrets of TLS 1.3 are logged when the library switches to them, so the records of that direction
+// count from zero here.
+static void kernelTlsKeylog(const SSL *ssl, const char *line)
 {
-    SslError error;
-    switch (errorCode) {
-    case X509_V_OK:
-        // X509_V_OK is also reported if the peer had no certificate.
-        break;
-    case X509_V_ERR_UNABLE_TO_GET_ISSUER_CERT:
-        error = SslError(SslError::UnableToGetIssuerCertificate, cert); break;
-    case X509_V_ERR_UNABLE_TO_DECRYPT_CERT_SIGNATURE:
-        error = SslError(SslError::UnableToDecryptCertificateSignature, cert); break;
-    case X509_V_ERR_UNABLE_TO_DECODE_ISSUER_PUBLIC_KEY:
-        error = SslError(SslError::UnableToDecodeIssuerPublicKey, cert); break;
-    case X509_V_ERR_CERT_SIGNATURE_FAILURE:
-        error = SslError(SslError::CertificateSignatureFailed, cert); break;
-    case X509_V_ERR_CERT_NOT_YET_VALID:
-        error = SslError(SslError::CertificateNotYetValid, cert); break;
-    case X509_V_ERR_CERT_HAS_EXPIRED:
-        error = SslError(SslError::CertificateExpired, cert); break;
-    case X509_V_ERR_ERROR_IN_CERT_NOT_BEFORE_FIELD:
-        error = SslError(SslError::InvalidNotBeforeField, cert); break;
-    case X509_V_ERR_ERROR_IN_CERT_NOT_AFTER_FIELD:
-        error = SslError(SslError::InvalidNotAfterField, cert); break;
-    case X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT:
-        error = SslError(SslError::SelfSignedCertificate, cert); break;
-    case X509_V_ERR_SELF_SIGNED_CERT_IN_CHAIN:
-        error = SslError(SslError::SelfSignedCertificateInChain, cert); break;
-    case X509_V_ERR_UNABLE_TO_GET_ISSUER_CERT_LOCALLY:
-        error = SslError(SslError::UnableToGetLocalIssuerCertificate, cert); break;
-    case X509_V_ERR_UNABLE_TO_VERIFY_LEAF_SIGNATURE:
-        error = SslError(SslError::UnableToVerifyFirstCertificate, cert); break;
-    case X509_V_ERR_CERT_REVOKED:
-        error = SslError(SslError::CertificateRevoked, cert); break;
-    case X509_V_ERR_INVALID_CA:
-        error = SslError(SslError::InvalidCaCertificate, cert); break;
-    case X509_V_ERR_PATH_LENGTH_EXCEEDED:
-        error = SslError(SslError::PathLengthExceeded, cert); break;
-    case X509_V_ERR_INVALID_PURPOSE:
-        error = SslError(SslError::InvalidPurpose, cert); break;
-    case X509_V_ERR_CERT_UNTRUSTED:
-        error = SslError(SslError::CertificateUntrusted, cert); break;
-    case X509_V_ERR_CERT_REJECTED:
-        error = SslError(SslError::CertificateRejected, cert); break;
-    default:
-        error = SslError(SslError::UnspecifiedError, cert); break;
+    SslBuffers *buffers = static_cast<SslBuffers *>(BIO_get_data(SSL_get_rbio(ssl)));
+    if (!buffers) {
+        return;
     }
-    return error;
+    const QList<QByteArray> &parts = QByteArray(line).split(' ');
+    if (parts.size() != 3) {
+        return;
+    }
+    const bool clientSecret = parts.at(0) == "CLIENT_TRAFFIC_SECRET_0";
+    if (!clientSecret && parts.at(0) != "SERVER_TRAFFIC_SECRET_0") {
+        return;
+    }
+    // the client writes with the client secret, and the server reads with it.
+    SslRecordCounter &records =
+            clientSecret == (SSL_is_server(ssl) != 0) ? buffers->incomingRecords : buffers->outgoingRecords;
+    records.encrypted = true;
+    records.sequence = 0;
+    (clientSecret ? buffers->clientTrafficSecret : buffers->serverTrafficSecret) = QByteArray::fromHex(parts.at(2));
 }
-*/
+
+#endif
+
+// install the keys of a TLS 1.2 or TLS 1.3 connection into the kernel. `rxSequence` and `txSequence` are the sequence
+// numbers of the next records. the receiving direction is installed first, so if the kernel fails on it, nothing is
+// changed and the connection stays in userspace. if the kernel takes the receiving direction but fails on the sending
+// one, the connection is left half in the kernel.
+//
+// the kernel returns EIO from recv() for the records other than application data. a TLS 1.3 server sends session
+// tickets after the handshake, so the TLS 1.3 client keeps receiving in userspace and hands the sending over only.
+static void installKernelTls(SSL *ssl, int fd, bool asServer, quint64 rxSequence, quint64 txSequence,
+                             const QByteArray &clientSecret, const QByteArray &serverSecret, bool *rx, bool *tx)
+{
+    *rx = *tx = false;
+    const SSL_CIPHER *cipher = SSL_get_current_cipher(ssl);
+    if (!cipher) {
+        return;
+    }
+    const int nid = SSL_CIPHER_get_cipher_nid(cipher);
+    int keyLen;
+    if (nid == NID_aes_128_gcm) {
+        keyLen = 16;
+    } else if (nid == NID_aes_256_gcm || nid == NID_chacha20_poly1305) {
+        keyLen = 32;
+    } else {
+        return;
+    }
+    // client_write_key, server_write_key, client_write_IV, server_write_IV.
+    unsigned char keyBlock[32 * 2 + 12 * 2];
+    int version, ivLen;
+    bool installRx = true;
+#ifndef QTNG_KERNEL_TLS13
+    Q_UNUSED(clientSecret);
+    Q_UNUSED(serverSecret);
+#endif
+    if (SSL_version(ssl) == TLS1_2_VERSION) {
+        version = TLS_1_2_VERSION;
+        ivLen = nid == NID_chacha20_poly1305 ? 12 : 4;
+        if (!deriveTls12Keys(ssl, cipher, nid, keyLen, ivLen, keyBlock)) {
+            return;
+        }
+#ifdef QTNG_KERNEL_TLS13
+    } else if (SSL_version(ssl) == TLS1_3_VERSION) {
+        version = TLS_1_3_VERSION;
+        ivLen = 12;
+        installRx = asServer;
+        if (!deriveTls13Keys(cipher, keyLen, ivLen, clientSecret, serverSecret, keyBlock)) {
+            return;
+        }
+#endif
+    } else {
+        return;  // libressl does not export the traffic secrets of TLS 1.3.
+    }
+    const unsigned char *clientKey = keyBlock;
+    const unsigned char *serverKey = keyBlock + keyLen;
+    const unsigned char *clientIv = keyBlock + keyLen * 2;
+    const unsigned char *serverIv = clientIv + ivLen;
+
+    KernelTlsCryptoInfo rxInfo, txInfo;
+    int rxLen = makeKernelTlsCryptoInfo(version, nid, asServer ? clientKey : serverKey,
+                                        asServer ? clientIv : serverIv, keyLen, rxSequence, &rxInfo);
+    int txLen = makeKernelTlsCryptoInfo(version, nid, asServer ? serverKey : clientKey,
+                                        asServer ? serverIv : clientIv, keyLen, txSequence, &txInfo);
+    if (rxLen > 0 && txLen > 0 && setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == 0) {
+        if (installRx) {
+            *rx = setsockopt(fd, SOL_TLS, TLS_RX, &rxInfo, static_cast<socklen_t>(rxLen)) == 0;
+        }
+        if (*rx || !installRx) {
+            *tx = setsockopt(fd, SOL_TLS, TLS_TX, &txInfo, static_cast<socklen_t>(txLen)) == 0;
+        }
+    }
+    OPENSSL_cleanse(keyBlock, sizeof(keyBlock));
+    OPENSSL_cleanse(&rxInfo, sizeof(rxInfo));
+    OPENSSL_cleanse(&txInfo, sizeof(txInfo));
+}
+
+// with kernel tls, the close_notify alert must be sent as a control message.
+static void sendKernelTlsCloseNotify(int fd)
+{
+    char alert[2] = { 1, 0 };  // warning, close_notify
+    char control[CMSG_SPACE(sizeof(unsigned char))];
+    memset(control, 0, sizeof(control));
+    struct iovec vector;
+    vector.iov_base = alert;
+    vector.iov_len = sizeof(alert);
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_TLS;
+    header->cmsg_type = TLS_SET_RECORD_TYPE;
+    header->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+    *CMSG_DATA(header) = 21;  // alert
+    ::sendmsg(fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+#endif
 
 template<typename SocketType>
 class SslConnection
@@ -774,6 +1993,7 @@ public:
     qint32 send(const char *data, qint32 size, bool all);
     bool pumpOutgoing();
     bool pumpIncoming();
+    bool enableKernelTls();
     Certificate localCertificate() const;
     QList<Certificate> localCertificateChain() const;
     Certificate peerCertificate() const;
@@ -786,22 +2006,33 @@ public:
     QSharedPointer<SocketType> rawSocket;
     SslConfiguration config;
     QSharedPointer<SSL_CTX> ctx;
+    QSharedPointer<SslBuffers> buffers;  // must outlive ssl.
     QSharedPointer<SSL> ssl;
     QList<SslError> errors;
     QString peerVerifyName;
     QString tlsExtHostName;
+    QByteArray pendingSession;
+    QSharedPointer<ThreadPool> handshakePool;
     bool asServer;
+    bool kernelTlsRx;  // the kernel decrypts the incoming records.
+    bool kernelTlsTx;  // the kernel encrypts the outgoing records.
 };
 
 template<typename SocketType>
 SslConnection<SocketType>::SslConnection(const SslConfiguration &config)
     : config(config)
+    , asServer(false)
+    , kernelTlsRx(false)
+    , kernelTlsTx(false)
 {
     initOpenSSL();
 }
 
 template<typename SocketType>
 SslConnection<SocketType>::SslConnection()
+    : asServer(false)
+    , kernelTlsRx(false)
+    , kernelTlsTx(false)
 {
     initOpenSSL();
 }
@@ -824,25 +2055,27 @@ bool SslConnection<SocketType>::handshake(bool asServer, const QString &hostName
         return false;
     }
     this->asServer = asServer;
+    errors.clear();
 
-    BIO *incoming = BIO_new(BIO_s_mem());
-    if (!incoming) {
+    BIO_METHOD *method = sslBufferMethod();
+    if (!method) {
         return false;
     }
-    BIO *outgoing = BIO_new(BIO_s_mem());
-    if (!outgoing) {
-        BIO_free(incoming);
+    BIO *bio = BIO_new(method);
+    if (!bio) {
         return false;
     }
+    buffers.reset(new SslBuffers());
+    BIO_set_data(bio, buffers.data());
 
-    ctx = SslConfigurationPrivate::makeContext(config, asServer);
+    ctx = SslConfigurationPrivate::context(config, asServer);
     bool freeBIOs = true;
     if (!ctx.isNull()) {
         ssl.reset(SSL_new(ctx.data()), SSL_free);
         if (!ssl.isNull()) {
-            // do not free incoming & outgoing
+            // the bio is owned by ssl now.
             freeBIOs = false;
-            SSL_set_bio(ssl.data(), incoming, outgoing);
+            SSL_set_bio(ssl.data(), bio, bio);
             if (!asServer && !tlsExtHostName.isEmpty()) {
                 QSharedPointer<ChooseTlsExtNameCallback> callback = config.tlsExtHostNameCallback();
                 if (!callback.isNull()) {
@@ -852,7 +2085,40 @@ bool SslConnection<SocketType>::handshake(bool asServer, const QString &hostName
                     }
                 }
             }
-            if (_handshake()) {
+            if (!asServer) {
+                // ask for the stapled ocsp response. see SslSocket::ocspResponse()
+                SSL_set_tlsext_status_type(ssl.data(), TLSEXT_STATUSTYPE_ocsp);
+            }
+            if (!asServer && config.peerVerifyMode() == Ssl::VerifyPeer) {
+                // the certificate must match the name, not only chain to a trusted CA.
+                const QString &verifyName = peerVerifyName.isEmpty() ? tlsExtHostName : peerVerifyName;
+                if (!verifyName.isEmpty() && !SslVerifiedChains::setHostName(ssl.data(), verifyName)) {
+                    qtng_debug << "can not set the host name to verify.";
+                    ssl.clear();
+                    ctx.clear();
+                    return false;
+                }
+            }
+            if (!asServer && !pendingSession.isEmpty()) {
+                const unsigned char *p = reinterpret_cast<const unsigned char *>(pendingSession.constData());
+                SSL_SESSION *session = d2i_SSL_SESSION(nullptr, &p, pendingSession.size());
+                if (session) {
+                    SSL_set_session(ssl.data(), session);
+                    SSL_SESSION_free(session);
+                }
+                pendingSession.clear();
+            }
+            bool ok = _handshake();
+            if (config.peerVerifyMode() == Ssl::VerifyPeer) {
+                long verifyResult = SSL_get_verify_result(ssl.data());
+                if (verifyResult != X509_V_OK) {
+                    errors.append(_q_OpenSSL_to_SslError(static_cast<int>(verifyResult), peerCertificate()));
+                }
+            }
+            if (ok) {
+                if (config.kernelTls()) {
+                    enableKernelTls();
+                }
                 return true;
             }
             ssl.clear();
@@ -860,8 +2126,7 @@ bool SslConnection<SocketType>::handshake(bool asServer, const QString &hostName
         ctx.clear();
     }
     if (freeBIOs) {
-        BIO_free(incoming);
-        BIO_free(outgoing);
+        BIO_free(bio);
     }
     return false;
 }
@@ -873,15 +2138,18 @@ bool SslConnection<SocketType>::pumpOutgoing()
         qtng_warning << "ssl is null while pump outgoing.";
         return false;
     }
-    int pendingBytes;
-    QVarLengthArray<char, 1024 * 8> buf;
-    BIO *outgoing = SSL_get_wbio(ssl.data());
-    Q_ASSERT(outgoing);
-    while ((pendingBytes = BIO_pending(outgoing)) > 0) {
-        buf.resize(pendingBytes);
-        qint32 encryptedBytesRead = BIO_read(outgoing, buf.data(), pendingBytes);
-        qint32 actualWritten = rawSocket->sendall(buf.constData(), encryptedBytesRead);
-        if (actualWritten < encryptedBytesRead) {
+    QSharedPointer<SslBuffers> buffers = this->buffers;
+    // keep the order of records if two coroutines pump at the same time.
+    ScopedLock<Lock> l(buffers->outgoingLock);
+    if (!l.isSuccess()) {
+        return false;
+    }
+    while (!buffers->outgoing.isEmpty()) {
+        QByteArray &data = buffers->sending;
+        data.resize(0);  // the stale data of an interrupted sendall() is dropped.
+        data.swap(buffers->outgoing);
+        qint32 actualWritten = rawSocket->sendall(data.constData(), data.size());
+        if (actualWritten < data.size()) {
             return false;
         }
     }
@@ -895,33 +2163,96 @@ bool SslConnection<SocketType>::pumpIncoming()
         qtng_warning << "ssl is null while pump incoming.";
         return false;
     }
-    const QByteArray &buf = rawSocket->recv(1024 * 8);
-    if (buf.isEmpty()) {
+    QSharedPointer<SslBuffers> buffers = this->buffers;
+    ScopedLock<Lock> l(buffers->incomingLock);
+    if (!l.isSuccess()) {
         return false;
     }
-    int totalWritten = 0;
-    BIO *incoming = SSL_get_rbio(ssl.data());
-    Q_ASSERT(incoming);
-    while (totalWritten < buf.size()) {
-        int writtenToBio = BIO_write(incoming, buf.constData() + totalWritten, buf.size() - totalWritten);
-        if (writtenToBio > 0) {
-            totalWritten += writtenToBio;
-        } else {
-            qtng_debug << "Unable to decrypt data";
-            return false;
-        }
-    };
+    if (buffers->incomingStart < buffers->incomingEnd) {
+        // another coroutine received data while we were waiting for the lock.
+        return true;
+    }
+    if (buffers->incoming.size() < SslIncomingBufferSize) {
+        buffers->incoming.resize(SslIncomingBufferSize);
+    }
+    buffers->incomingStart = 0;
+    buffers->incomingEnd = 0;
+    qint32 bytes = rawSocket->recv(buffers->incoming.data(), buffers->incoming.size());
+    if (bytes <= 0) {
+        return false;
+    }
+    buffers->incomingEnd = bytes;
     return true;
 }
 
+template<typename SocketType>
+bool SslConnection<SocketType>::enableKernelTls()
+{
+#if defined(Q_OS_LINUX) && defined(TLS_TX)
+    if (ssl.isNull() || kernelTlsRx || kernelTlsTx) {
+        return kernelTlsRx && kernelTlsTx;
+    }
+    // only plain tcp sockets can be handed over to the kernel.
+    QSharedPointer<Socket> socket = convertSocketLikeToSocket(rawSocket);
+    if (socket.isNull() || socket->type() != Socket::TcpSocket) {
+        return false;
+    }
+    // the records already received or generated by the library must be handled in userspace.
+    if (!pumpOutgoing() || buffers->incomingStart < buffers->incomingEnd || SSL_pending(ssl.data()) > 0) {
+        return false;
+    }
+#ifdef QTNG_KERNEL_TLS13
+    installKernelTls(ssl.data(), static_cast<int>(socket->fileno()), asServer, buffers->incomingRecords.sequence,
+                     buffers->outgoingRecords.sequence, buffers->clientTrafficSecret, buffers->serverTrafficSecret,
+                     &kernelTlsRx, &kernelTlsTx);
+    OPENSSL_cleanse(buffers->clientTrafficSecret.data(), static_cast<size_t>(buffers->clientTrafficSecret.size()));
+    OPENSSL_cleanse(buffers->serverTrafficSecret.data(), static_cast<size_t>(buffers->serverTrafficSecret.size()));
+    buffers->clientTrafficSecret.clear();
+    buffers->serverTrafficSecret.clear();
+#else
+    installKernelTls(ssl.data(), static_cast<int>(socket->fileno()), asServer, buffers->incomingRecords.sequence,
+                     buffers->outgoingRecords.sequence, QByteArray(), QByteArray(), &kernelTlsRx, &kernelTlsTx);
+#endif
+    return kernelTlsRx && kernelTlsTx;
+#else
+    return false;
+#endif
+}
+
 template<typename SocketType>
 bool SslConnection<SocketType>::_handshake()
 {
     Q_ASSERT(!ssl.isNull());
     while (true) {
-        int result = asServer ? SSL_accept(ssl.data()) : SSL_connect(ssl.data());
+        int result, err;
+        if (handshakePool.isNull()) {
+            result = asServer ? SSL_accept(ssl.data()) : SSL_connect(ssl.data());
+            err = result <= 0 ? SSL_get_error(ssl.data(), result) : SSL_ERROR_NONE;
+        } else {
+            // the private key operations run in a worker thread, while the socket i/o stays in this coroutine.
+            // the SSL object only reads and writes the buffers of BIO there. the error queue is thread local, so
+            // SSL_get_error() must be called in the worker thread too.
+            QSharedPointer<SSL> ssl = this->ssl;
+            QSharedPointer<SslBuffers> buffers = this->buffers;  // keep alive while the worker is running.
+            QSharedPointer<SSL_CTX> ctx = this->ctx;  // the callbacks refer to the objects owned by ctx.
+            bool asServer = this->asServer;
+            QSharedPointer<QPair<int, int>> r(new QPair<int, int>(-1, SSL_ERROR_SSL));
+            try {
+                handshakePool->call([ssl, buffers, ctx, asServer, r] {
+                    r->first = asServer ? SSL_accept(ssl.data()) : SSL_connect(ssl.data());
+                    r->second = r->first <= 0 ? SSL_get_error(ssl.data(), r->first) : SSL_ERROR_NONE;
+                    ERR_clear_error();
+                });
+            } catch (...) {
+                // killed or timed out while the worker may be still running. the worker owns the SSL object from now,
+                // and this connection is unusable, so close() and the destructor never touch it concurrently.
+                this->ssl.clear();
+                throw;
+            }
+            result = r->first;
+            err = r->second;
+        }
         if (result <= 0) {
-            int err = SSL_get_error(ssl.data(), result);
             switch (err) {
             case SSL_ERROR_WANT_READ:
                 if (!pumpOutgoing())
@@ -962,6 +2293,9 @@ qint32 SslConnection<SocketType>::peek(char *data, qint32 size)
     if (ssl.isNull()) {
         return -1;
     }
+    if (kernelTlsRx) {
+        return rawSocket->peek(data, size);
+    }
     int result = SSL_peek(ssl.data(), data, size);
     if (result <= 0) {
         int err = SSL_get_error(ssl.data(), result);
@@ -1003,6 +2337,10 @@ qint32 SslConnection<SocketType>::recv(char *data, qint32 size, bool all)
     if (ssl.isNull()) {
         return -1;
     }
+    if (kernelTlsRx) {
+        // the kernel returns EIO for the alert records, close_notify included.
+        return all ? rawSocket->recvall(data, size) : rawSocket->recv(data, size);
+    }
     qint32 total = 0;
     while (true) {
         int result = SSL_read(ssl.data(), data + total, size - total);
@@ -1053,6 +2391,9 @@ qint32 SslConnection<SocketType>::send(const char *data, qint32 size, bool all)
     if (ssl.isNull() || size <= 0) {
         return -1;
     }
+    if (kernelTlsTx) {
+        return all ? rawSocket->sendall(data, size) : rawSocket->send(data, size);
+    }
     qint32 total = 0;
     // be careful for dead lock
     while (true) {
@@ -1119,6 +2460,17 @@ bool SslConnection<SocketType>::close()
     if (ssl.isNull() || !rawSocket->isValid()) {
         return false;
     }
+#if defined(Q_OS_LINUX) && defined(TLS_TX)
+    if (kernelTlsTx) {
+        sendKernelTlsCloseNotify(static_cast<int>(rawSocket->fileno()));
+        return true;
+    } else if (kernelTlsRx) {
+        // send our close_notify, but never read the peer's one from userspace.
+        SSL_set_shutdown(ssl.data(), SSL_RECEIVED_SHUTDOWN);
+        SSL_shutdown(ssl.data());
+        return pumpOutgoing();
+    }
+#endif
     int tried = 0;
     while (true) {
         int result = SSL_shutdown(ssl.data());
@@ -1459,6 +2811,105 @@ void SslSocket::setTlsExtHostName(const QString &tlsExtHostName)
     d->tlsExtHostName = tlsExtHostName;
 }
 
+QByteArray SslSocket::session() const
+{
+    Q_D(const SslSocket);
+    if (d->ssl.isNull()) {
+        return QByteArray();
+    }
+    SSL_SESSION *session = SSL_get1_session(d->ssl.data());
+    if (!session) {
+        return QByteArray();
+    }
+    QByteArray buf;
+    if (SSL_SESSION_is_resumable(session)) {
+        int len = i2d_SSL_SESSION(session, nullptr);
+        if (len > 0) {
+            buf.resize(len);
+            unsigned char *p = reinterpret_cast<unsigned char *>(buf.data());
+            i2d_SSL_SESSION(session, &p);
+        }
+    }
+    SSL_SESSION_free(session);
+    return buf;
+}
+
+QDateTime SslSocket::sessionExpiration() const
+{
+    Q_D(const SslSocket);
+    if (d->ssl.isNull()) {
+        return QDateTime();
+    }
+    SSL_SESSION *session = SSL_get_session(d->ssl.data());
+    if (!session) {
+        return QDateTime();
+    }
+    qint64 lifetime = SSL_SESSION_get_timeout(session);
+    if (SSL_SESSION_has_ticket(session)) {
+        const qint64 hint = static_cast<qint64>(SSL_SESSION_get_ticket_lifetime_hint(session));
+        if (hint > 0) {
+            lifetime = qMin(lifetime, hint);
+        }
+    }
+    return QDateTime::fromMSecsSinceEpoch((SSL_SESSION_get_time(session) + lifetime) * 1000, Qt::UTC);
+}
+
+void SslSocket::setSession(const QByteArray &session)
+{
+    Q_D(SslSocket);
+    d->pendingSession = session;
+}
+
+void SslSocket::setHandshakeThreadPool(QSharedPointer<ThreadPool> pool)
+{
+    Q_D(SslSocket);
+    d->handshakePool = pool;
+}
+
+QSharedPointer<ThreadPool> SslSocket::handshakeThreadPool() const
+{
+    Q_D(const SslSocket);
+    return d->handshakePool;
+}
+
+QByteArray SslSocket::ocspResponse() const
+{
+    Q_D(const SslSocket);
+    if (d->ssl.isNull()) {
+        return QByteArray();
+    }
+    const unsigned char *p = nullptr;
+    long len = SSL_get_tlsext_status_ocsp_resp(d->ssl.data(), &p);
+    if (len <= 0 || !p) {
+        return QByteArray();
+    }
+    return QByteArray(reinterpret_cast<const char *>(p), static_cast<int>(len));
+}
+
+bool SslSocket::isKernelTls() const
+{
+    Q_D(const SslSocket);
+    return d->kernelTlsRx && d->kernelTlsTx;
+}
+
+bool SslSocket::isKernelTlsRx() const
+{
+    Q_D(const SslSocket);
+    return d->kernelTlsRx;
+}
+
+bool SslSocket::isKernelTlsTx() const
+{
+    Q_D(const SslSocket);
+    return d->kernelTlsTx;
+}
+
+bool SslSocket::isSessionReused() const
+{
+    Q_D(const SslSocket);
+    return !d->ssl.isNull() && SSL_session_reused(d->ssl.data());
+}
+
 QSharedPointer<SocketLike> SslSocket::backend() const
 {
     Q_D(const SslSocket);
@@ -1719,6 +3170,61 @@ qint32 SslSocket::sendall(const QByteArray &data)
     return d->send(data.data(), data.size(), true);
 }
 
+qint32 SslSocket::sendv(const IoVector *vectors, int count)
+{
+    Q_D(SslSocket);
+    if (d->kernelTlsTx) {
+        return d->rawSocket->sendv(vectors, count);
+    }
+    const qint32 MaxRecordSize = 1024 * 16;
+    QByteArray record;
+    qint32 total = 0;
+    // like sendall(), returns the bytes sent before the error.
+    auto sendPart = [d, &total](const char *data, qint32 size) -> bool {
+        qint32 bytesSent = d->send(data, size, true);
+        if (bytesSent > 0) {
+            total += bytesSent;
+        }
+        return bytesSent == size;
+    };
+    for (int i = 0; i < count; ++i) {
+        const char *data = vectors[i].data;
+        qint32 left = vectors[i].size;
+        if (left <= 0) {
+            continue;
+        }
+        while (left > 0) {
+            // full records are encrypted directly from the caller's buffer.
+            if (record.isEmpty() && left >= MaxRecordSize) {
+                const qint32 direct = left - left % MaxRecordSize;
+                if (!sendPart(data, direct)) {
+                    return total > 0 ? total : -1;
+                }
+                data += direct;
+                left -= direct;
+                continue;
+            }
+            if (record.isEmpty()) {
+                record.reserve(MaxRecordSize);
+            }
+            const qint32 n = qMin(left, MaxRecordSize - record.size());
+            record.append(data, n);
+            data += n;
+            left -= n;
+            if (record.size() == MaxRecordSize) {
+                if (!sendPart(record.constData(), record.size())) {
+                    return total > 0 ? total : -1;
+                }
+                record.clear();
+            }
+        }
+    }
+    if (!record.isEmpty() && !sendPart(record.constData(), record.size())) {
+        return total > 0 ? total : -1;
+    }
+    return total > 0 ? total : -1;
+}
+
 SslSocket *SslSocket::createConnection(const HostAddress &host, quint16 port, const SslConfiguration &config,
                                        Socket::SocketError *error, int allowProtocol)
 {
@@ -1793,6 +3299,7 @@ public:
     virtual QByteArray recvall(qint32 size) override;
     virtual qint32 send(const QByteArray &data) override;
     virtual qint32 sendall(const QByteArray &data) override;
+    virtual qint32 sendv(const IoVector *vectors, int count) override;
 public:
     QSharedPointer<SslSocket> s;
 };
@@ -1978,6 +3485,11 @@ qint32 SslSocketLikeImpl::sendall(const QByteArray &data)
     return s->sendall(data);
 }
 
+qint32 SslSocketLikeImpl::sendv(const IoVector *vectors, int count)
+{
+    return s->sendv(vectors, count);
+}
+
 }  // anonymous namespace
 
 QSharedPointer<SocketLike> asSocketLike(QSharedPointer<SslSocket> s)
@@ -1997,6 +3509,31 @@ QSharedPointer<SslSocket> convertSocketLikeToSslSocket(QSharedPointer<SocketLike
 
 namespace {
 
+// with an AEAD cipher, each direction starts with a random salt (32 bytes), and the key of that direction is derived
+// from the shared key and the salt. so the directions and the connections sharing a key never reuse a nonce. the data
+// follows in frames: length (2 bytes, big endian), sequence number (8 bytes, big endian), the encrypted payload and
+// the tag (16 bytes). the header is authenticated as aad, and the nonce is the sequence number padded by zeros. the
+// sequence starts from 0, the frames out of order are rejected.
+const qint32 AeadSaltSize = 32;
+const qint32 AeadFrameHeaderSize = 2 + 8;
+const qint32 AeadNonceSize = 12;
+const qint32 AeadFrameTagSize = 16;
+const qint32 AeadFrameMaxPayloadSize = 1024 * 16;
+const qint32 StreamChunkSize = 1024 * 16;
+
+// PBKDF2 with one iteration is a HMAC of the shared key, which is fine for a random key.
+static bool deriveAeadKey(Cipher *cipher, const QByteArray &key, const QByteArray &salt)
+{
+    const QByteArray &derived = PBKDF2_HMAC(cipher->keySize(), key, salt, MessageDigest::Sha256, 1);
+    return !derived.isEmpty() && cipher->setKey(derived);
+}
+
+static void makeAeadNonce(quint64 sequence, char *nonce)
+{
+    memset(nonce, 0, AeadNonceSize - 8);
+    qToBigEndian<quint64>(sequence, reinterpret_cast<uchar *>(nonce + AeadNonceSize - 8));
+}
+
 class EncryptedSocketLike : public SocketLike
 {
 public:
@@ -2031,6 +3568,8 @@ public:
 
     qint32 recv(char *data, qint32 size, bool all);
     qint32 send(const char *data, qint32 size, bool all);
+    qint32 recvFrame(char *data, qint32 size, qint32 *direct);
+    qint32 sendFrames(const char *data, qint32 size);
 
     virtual qint32 peek(char *data, qint32 size) override;
     virtual qint32 peekRaw(char *data, qint32 size) override;
@@ -2046,13 +3585,34 @@ public:
     QSharedPointer<Cipher> incomingCipher;
     QSharedPointer<Cipher> outgoingCipher;
     QSharedPointer<SocketLike> s;
+    QByteArray key;  // the shared key of AEAD cipher.
+    QByteArray incomingFrame;  // the decrypted payload not returned yet.
+    qint32 incomingStart;
+    qint32 incomingEnd;
+    quint64 incomingSequence;
+    quint64 outgoingSequence;
+    QByteArray outgoingBuffer;
+    Lock sendLock;
+    bool aead;
+    bool incomingKeyed;  // the salt of peer is received.
+    bool outgoingKeyed;  // our salt is sent.
 };
 
 EncryptedSocketLike::EncryptedSocketLike(QSharedPointer<Cipher> cipher, QSharedPointer<SocketLike> s)
     : incomingCipher(cipher->copy(Cipher::Decrypt))
     , outgoingCipher(cipher->copy(Cipher::Encrypt))
     , s(s)
+    , incomingStart(0)
+    , incomingEnd(0)
+    , incomingSequence(0)
+    , outgoingSequence(0)
+    , aead(cipher->isAead())
+    , incomingKeyed(false)
+    , outgoingKeyed(false)
 {
+    if (aead) {
+        key = cipher->key();
+    }
 }
 
 Socket::SocketError EncryptedSocketLike::error() const
@@ -2183,31 +3743,148 @@ QVariant EncryptedSocketLike::option(Socket::SocketOption option) const
 
 qint32 EncryptedSocketLike::recv(char *data, qint32 size, bool all)
 {
-    QByteArray buf(size, Qt::Uninitialized);
-    QByteArray decrypted;
-    decrypted.reserve(size);
+    if (size <= 0) {
+        return -1;
+    }
+    if (!aead) {
+        // stream ciphers decrypt in place.
+        qint32 bs = all ? s->recvall(data, size) : s->recv(data, size);
+        if (bs <= 0) {
+            return bs;
+        }
+        if (incomingCipher->update(data, bs, data) != bs) {
+            qtng_warning << "EncryptedSocketLike can not decrypt data.";
+            return -1;
+        }
+        return bs;
+    }
 
-    qint32 bs;
-    if (all) {
-        bs = s->recvall(buf.data(), buf.size());
-    } else {
-        bs = s->recv(buf.data(), buf.size());
+    qint32 total = 0;
+    while (total < size) {
+        if (incomingStart < incomingEnd) {
+            qint32 bytes = qMin(size - total, incomingEnd - incomingStart);
+            memcpy(data + total, incomingFrame.constData() + incomingStart, static_cast<size_t>(bytes));
+            incomingStart += bytes;
+            total += bytes;
+        } else {
+            qint32 direct = 0;
+            qint32 r = recvFrame(data + total, size - total, &direct);
+            if (r <= 0) {
+                return total > 0 ? total : r;
+            }
+            total += direct;
+        }
+        if (!all && total > 0) {
+            break;
+        }
     }
+    return total;
+}
 
-    if (bs <= 0) {
-        return bs;
-    } else {
-        decrypted = incomingCipher->addData(buf.data(), bs);
-        if (decrypted.size() != bs) {
-            qtng_warning << "EncryptedSocketLike can not decrypt data: expected" << bs << "bytes, got"
-                         << decrypted.size() << "bytes";
+// returns 1 if a frame is received, 0 if the connection is closed, -1 on error. the payload is decrypted into
+// `data` directly if it fits, and `direct` is set to its size. otherwise it is kept in `incomingFrame`.
+qint32 EncryptedSocketLike::recvFrame(char *data, qint32 size, qint32 *direct)
+{
+    *direct = 0;
+    if (!incomingKeyed) {
+        char salt[AeadSaltSize];
+        qint32 bs = s->recvall(salt, AeadSaltSize);
+        if (bs == 0) {
+            return 0;
+        } else if (bs != AeadSaltSize) {
+            return -1;
+        }
+        if (!deriveAeadKey(incomingCipher.data(), key, QByteArray(salt, AeadSaltSize))) {
+            qtng_warning << "EncryptedSocketLike can not derive the key.";
             return -1;
         }
+        incomingKeyed = true;
+    }
+    char header[AeadFrameHeaderSize];
+    qint32 bs = s->recvall(header, AeadFrameHeaderSize);
+    if (bs == 0) {
+        return 0;
+    } else if (bs != AeadFrameHeaderSize) {
+        return -1;
+    }
+    const qint32 len = (static_cast<uchar>(header[0]) << 8) | static_cast<uchar>(header[1]);
+    if (len > AeadFrameMaxPayloadSize) {
+        qtng_warning << "EncryptedSocketLike got an invalid frame.";
+        return -1;
+    }
+    if (qFromBigEndian<quint64>(reinterpret_cast<const uchar *>(header + 2)) != incomingSequence) {
+        qtng_warning << "EncryptedSocketLike got a frame out of order.";
+        return -1;
+    }
+    char *payload;
+    if (len <= size) {
+        payload = data;
+    } else {
+        if (incomingFrame.size() < len) {
+            incomingFrame.resize(AeadFrameMaxPayloadSize);
+        }
+        payload = incomingFrame.data();
+    }
+    char tag[AeadFrameTagSize];
+    if ((len > 0 && s->recvall(payload, len) != len) || s->recvall(tag, AeadFrameTagSize) != AeadFrameTagSize) {
+        return -1;
+    }
+    char nonce[AeadNonceSize];
+    makeAeadNonce(incomingSequence, nonce);
+    if (!incomingCipher->open(nonce, AeadNonceSize, header, AeadFrameHeaderSize, payload, len, tag)) {
+        qtng_warning << "EncryptedSocketLike can not authenticate data.";
+        return -1;
+    }
+    ++incomingSequence;
+    if (payload == data) {
+        *direct = len;
+    } else {
+        incomingStart = 0;
+        incomingEnd = len;
     }
+    return 1;
+}
 
-    Q_ASSERT(decrypted.size() <= size);
-    memcpy(data, decrypted.constData(), static_cast<size_t>(decrypted.size()));
-    return decrypted.size();
+qint32 EncryptedSocketLike::sendFrames(const char *data, qint32 size)
+{
+    const qint32 frameSize = AeadFrameHeaderSize + AeadFrameMaxPayloadSize + AeadFrameTagSize;
+    if (outgoingBuffer.size() < AeadSaltSize + frameSize) {
+        outgoingBuffer.resize(AeadSaltSize + frameSize);
+    }
+    qint32 total = 0;
+    while (total < size) {
+        const qint32 len = qMin(size - total, AeadFrameMaxPayloadSize);
+        // the salt is sent with the first frame.
+        char *start = outgoingBuffer.data();
+        char *frame = start;
+        if (!outgoingKeyed) {
+            if (RAND_bytes(reinterpret_cast<unsigned char *>(start), AeadSaltSize) <= 0
+                || !deriveAeadKey(outgoingCipher.data(), key, QByteArray(start, AeadSaltSize))) {
+                qtng_warning << "EncryptedSocketLike can not derive the key.";
+                return -1;
+            }
+            outgoingKeyed = true;
+            frame += AeadSaltSize;
+        }
+        frame[0] = static_cast<char>((len >> 8) & 0xff);
+        frame[1] = static_cast<char>(len & 0xff);
+        qToBigEndian<quint64>(outgoingSequence, reinterpret_cast<uchar *>(frame + 2));
+        char nonce[AeadNonceSize];
+        makeAeadNonce(outgoingSequence, nonce);
+        ++outgoingSequence;
+        char *payload = frame + AeadFrameHeaderSize;
+        memcpy(payload, data + total, static_cast<size_t>(len));
+        if (!outgoingCipher->seal(nonce, AeadNonceSize, frame, AeadFrameHeaderSize, payload, len, payload + len)) {
+            qtng_warning << "EncryptedSocketLike can not encrypt data.";
+            return -1;
+        }
+        const qint32 bytes = static_cast<qint32>(frame - start) + AeadFrameHeaderSize + len + AeadFrameTagSize;
+        if (s->sendall(start, bytes) != bytes) {
+            return -1;
+        }
+        total += len;
+    }
+    return size;
 }
 
 qint32 EncryptedSocketLike::send(const char *data, qint32 size, bool)
@@ -2215,18 +3892,48 @@ qint32 EncryptedSocketLike::send(const char *data, qint32 size, bool)
     if (size <= 0) {
         return -1;
     }
-    const QByteArray &encrypted = outgoingCipher->addData(data, size);
-    qint32 bs = s->sendall(encrypted);  // only support sendall.
-    if (bs < encrypted.size()) {
+    // the cipher state must follow the order of data sent.
+    ScopedLock<Lock> l(sendLock);
+    if (!l.isSuccess()) {
         return -1;
-    } else {
-        return size;
     }
+    if (aead) {
+        return sendFrames(data, size);
+    }
+    if (outgoingBuffer.size() < StreamChunkSize) {
+        outgoingBuffer.resize(StreamChunkSize);
+    }
+    qint32 total = 0;
+    while (total < size) {  // only support sendall.
+        const qint32 len = qMin(size - total, StreamChunkSize);
+        if (outgoingCipher->update(data + total, len, outgoingBuffer.data()) != len) {
+            qtng_warning << "EncryptedSocketLike can not encrypt data.";
+            return -1;
+        }
+        if (s->sendall(outgoingBuffer.constData(), len) != len) {
+            return -1;
+        }
+        total += len;
+    }
+    return size;
 }
 
 qint32 EncryptedSocketLike::peek(char *data, qint32 size)
 {
-    return s->peek(data, size);
+    if (!aead) {
+        return s->peek(data, size);
+    }
+    // skip the empty frames, their payloads are not kept in incomingFrame.
+    while (incomingStart >= incomingEnd) {
+        qint32 direct = 0;
+        qint32 r = recvFrame(nullptr, 0, &direct);
+        if (r <= 0) {
+            return r;
+        }
+    }
+    qint32 bytes = qMin(size, incomingEnd - incomingStart);
+    memcpy(data, incomingFrame.constData() + incomingStart, static_cast<size_t>(bytes));
+    return bytes;
 }
 
 qint32 EncryptedSocketLike::peekRaw(char *data, qint32 size)
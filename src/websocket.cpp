@@ -115,6 +115,8 @@ public:
 
     // make frame packet.
     QByteArray toByteArray() const;
+    // the header of frame packet, including the mask key.
+    QByteArray headerBytes() const;
 public:
     inline bool isValid() const { return !rsv1 && !rsv2 && !rsv3 && !payload.isEmpty(); }
 };
@@ -139,7 +141,7 @@ private:
     QVector<WebSocketFrame> fragmentFrame(const PacketToWrite &writingPacket, const int blockSize);
     quint32 makeMaskkey();
     bool recvBytes(char *packet, size_t &packetSize);
-    bool sendBytes(const QByteArray &packet);
+    bool sendFrame(const WebSocketFrame &frame);
 public:
     CoroutineGroup *operations;
     HttpResponse response;
@@ -429,11 +431,11 @@ void WebSocketFrame::applyMaskTo(char *dst, int offset, int size) const
 }
 */
 
-QByteArray WebSocketFrame::toByteArray() const
+QByteArray WebSocketFrame::headerBytes() const
 {
     int len = payload.size();
-    QByteArray buf(len + 32, Qt::Uninitialized);
-    int packetSize = 2;
+    QByteArray buf(14, Qt::Uninitialized);
+    int headerSize = 2;
 
     if (fin) {
         buf[0] = 0x80;
@@ -454,22 +456,32 @@ QByteArray WebSocketFrame::toByteArray() const
     } else if (len < 65535) {
         buf[1] = buf[1] | 126;
         qToBigEndian<quint16>(len, ubuf + 2);
-        packetSize += 2;
+        headerSize += 2;
     } else {
         buf[1] = buf[1] | 127;
         qToBigEndian<quint64>(len, ubuf + 2);
-        packetSize += 8;
+        headerSize += 8;
     }
 
     if (maskkey > 0) {
-        qToBigEndian<quint32>(this->maskkey, ubuf + packetSize);
-        packetSize += 4;
-        applyMaskTo(buf.data(), packetSize, buf.size() - packetSize);
+        qToBigEndian<quint32>(this->maskkey, ubuf + headerSize);
+        headerSize += 4;
+    }
+    buf.truncate(headerSize);
+    return buf;
+}
+
+QByteArray WebSocketFrame::toByteArray() const
+{
+    const QByteArray &header = headerBytes();
+    QByteArray buf(header.size() + payload.size(), Qt::Uninitialized);
+    memcpy(buf.data(), header.constData(), static_cast<size_t>(header.size()));
+    if (maskkey > 0) {
+        applyMaskTo(buf.data(), header.size(), payload.size());
     } else {
-        memcpy(buf.data() + packetSize, payload.constData(), payload.size());
+        memcpy(buf.data() + header.size(), payload.constData(), static_cast<size_t>(payload.size()));
     }
-    packetSize += payload.size();
-    return buf.left(packetSize);
+    return buf;
 }
 
 WebSocketConnectionPrivate::WebSocketConnectionPrivate(QSharedPointer<SocketLike> connection,const QByteArray &headBytes,
@@ -641,8 +653,7 @@ void WebSocketConnectionPrivate::doSend()
             // the other coroutines may want to send something.
             Coroutine::sleep(0);
 
-            const QByteArray &packet = frame.toByteArray();
-            if (!sendBytes(packet)) {
+            if (!sendFrame(frame)) {
                 if (!writingPacket.done.isNull()) {
                     writingPacket.done->send(false);
                 }
@@ -701,8 +712,8 @@ void WebSocketConnectionPrivate::doReceive(const QByteArray &headBytes)
             WebSocketFrame closeFrame = makeControlFrame(CloseFrame);
             closeFrame.payload = makeClosePayload(WebSocketConnection::MessageTooBig,
                                                   QString::fromUtf8("the frame is too big to process."));
-            if (sendBytes(closeFrame.toByteArray())) {
-                // XXX do abort() only if sendBytes() returns success.
+            if (sendFrame(closeFrame)) {
+                // XXX do abort() only if sendFrame() returns success.
                 return abort(WebSocketConnection::MessageTooBig);
             } else {
                 return;
@@ -784,7 +795,7 @@ void WebSocketConnectionPrivate::doReceive(const QByteArray &headBytes)
                 state = WebSocketConnection::Closing;
                 WebSocketFrame closeFrame = makeControlFrame(CloseFrame);
                 closeFrame.payload = frame.payload;
-                if (!sendBytes(closeFrame.toByteArray())) {
+                if (!sendFrame(closeFrame)) {
                     return;
                 }
                 return abort(WebSocketConnection::NormalClosure);
@@ -797,7 +808,7 @@ void WebSocketConnectionPrivate::doReceive(const QByteArray &headBytes)
         } else if (frame.opcode == FrameType::PingFrame) {
             WebSocketFrame pongFrame = makeControlFrame(PongFrame);
             pongFrame.payload = frame.payload;
-            if (!sendBytes(pongFrame.toByteArray())) {
+            if (!sendFrame(pongFrame)) {
                 return;
             }
         } else if (frame.opcode == FrameType::PongFrame) {
@@ -832,7 +843,7 @@ void WebSocketConnectionPrivate::doKeepalive()
                 qtng_debug << "sending keepalive packet.";
             }
             const WebSocketFrame &pingFrame = makeControlFrame(PingFrame);
-            if (!sendBytes(pingFrame.toByteArray())) {
+            if (!sendFrame(pingFrame)) {
                 return;
             }
         }
@@ -850,7 +861,7 @@ bool WebSocketConnectionPrivate::close()
     state = WebSocketConnection::Closing;
     WebSocketFrame closeFrame = makeControlFrame(CloseFrame);
     closeFrame.payload = makeClosePayload(WebSocketConnection::NormalClosure, QString::fromUtf8("normal closure."));
-    if (!sendBytes(closeFrame.toByteArray())) {
+    if (!sendFrame(closeFrame)) {
         return false;
     }
     abort(WebSocketConnection::NormalClosure);
@@ -985,17 +996,27 @@ bool WebSocketConnectionPrivate::recvBytes(char *packet, size_t &packetSize)
     }
 }
 
-bool WebSocketConnectionPrivate::sendBytes(const QByteArray &packet)
+bool WebSocketConnectionPrivate::sendFrame(const WebSocketFrame &frame)
 {
     ScopedLock<Lock> locklock(writeLock);
+    // the payload of unmasked frames (server side) is sent without copying into a new packet.
+    QByteArray header, payload;
+    if (frame.maskkey > 0) {
+        payload = frame.toByteArray();
+    } else {
+        header = frame.headerBytes();
+        payload = frame.payload;
+    }
+    const qint32 packetSize = header.size() + payload.size();
     if (debugLevel >= 3) {
-        qtng_debug << "sending packet:" << packet;
+        qtng_debug << "sending packet:" << header << payload;
     } else if (debugLevel >= 2) {
-        qtng_debug << "sending packet:" << packet.size();
+        qtng_debug << "sending packet:" << packetSize;
     }
+    const IoVector packet[2] = { IoVector(header), IoVector(payload) };
     qint32 sentBytes;
     try {
-        sentBytes = connection->sendall(packet);
+        sentBytes = connection->sendv(packet, 2);
     } catch (CoroutineExitException &) {
         Q_ASSERT(errorCode != WebSocketConnection::NoError);
         return false;
@@ -1006,7 +1027,7 @@ bool WebSocketConnectionPrivate::sendBytes(const QByteArray &packet)
         abort(WebSocketConnection::InternalError);
         return false;
     }
-    if (sentBytes != packet.size()) {
+    if (sentBytes != packetSize) {
         abort(WebSocketConnection::AbnormalClosure);
         return false;
     }
@@ -0,0 +1,108 @@
+#include <QtCore/qendian.h>
+#include <string.h>
+#include "../include/xxhash.h"
+
+QTNETWORKNG_NAMESPACE_BEGIN
+
+// https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+const quint64 Prime64_1 = Q_UINT64_C(0x9E3779B185EBCA87);
+const quint64 Prime64_2 = Q_UINT64_C(0xC2B2AE3D27D4EB4F);
+const quint64 Prime64_3 = Q_UINT64_C(0x165667B19E3779F9);
+const quint64 Prime64_4 = Q_UINT64_C(0x85EBCA77C2B2AE63);
+const quint64 Prime64_5 = Q_UINT64_C(0x27D4EB2F165667C5);
+
+static inline quint64 rotateLeft(quint64 x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline quint64 read64(const char *p)
+{
+    quint64 v;
+    memcpy(&v, p, sizeof(v));
+    return qFromLittleEndian(v);
+}
+
+static inline quint32 read32(const char *p)
+{
+    quint32 v;
+    memcpy(&v, p, sizeof(v));
+    return qFromLittleEndian(v);
+}
+
+static inline quint64 round64(quint64 acc, quint64 input)
+{
+    acc += input * Prime64_2;
+    acc = rotateLeft(acc, 31);
+    return acc * Prime64_1;
+}
+
+static inline quint64 mergeRound64(quint64 acc, quint64 value)
+{
+    acc ^= round64(0, value);
+    return acc * Prime64_1 + Prime64_4;
+}
+
+quint64 xxhash64(const char *data, qint64 len, quint64 seed)
+{
+    const char *p = data;
+    const char *end = data + len;
+    quint64 h;
+    if (len >= 32) {
+        const char *limit = end - 32;
+        quint64 v1 = seed + Prime64_1 + Prime64_2;
+        quint64 v2 = seed + Prime64_2;
+        quint64 v3 = seed;
+        quint64 v4 = seed - Prime64_1;
+        do {
+            v1 = round64(v1, read64(p));
+            v2 = round64(v2, read64(p + 8));
+            v3 = round64(v3, read64(p + 16));
+            v4 = round64(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+        h = mergeRound64(h, v1);
+        h = mergeRound64(h, v2);
+        h = mergeRound64(h, v3);
+        h = mergeRound64(h, v4);
+    } else {
+        h = seed + Prime64_5;
+    }
+    h += static_cast<quint64>(len);
+
+    while (p + 8 <= end) {
+        h ^= round64(0, read64(p));
+        h = rotateLeft(h, 27) * Prime64_1 + Prime64_4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<quint64>(read32(p)) * Prime64_1;
+        h = rotateLeft(h, 23) * Prime64_2 + Prime64_3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= static_cast<quint64>(static_cast<uchar>(*p)) * Prime64_5;
+        h = rotateLeft(h, 11) * Prime64_1;
+        ++p;
+    }
+
+    h ^= h >> 33;
+    h *= Prime64_2;
+    h ^= h >> 29;
+    h *= Prime64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+QList<quint64> xxhash64Many(const QList<QByteArray> &data, quint64 seed)
+{
+    QList<quint64> result;
+    result.reserve(data.size());
+    for (const QByteArray &item : data) {
+        result.append(xxhash64(item.constData(), item.size(), seed));
+    }
+    return result;
+}
+
+QTNETWORKNG_NAMESPACE_END
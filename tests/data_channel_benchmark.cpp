@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include "qtnetworkng.h"
+
+using namespace qtng;
+
+// measure the round-trip latency of small packets on one virtual channel, while another virtual channel of the same
+// SocketChannel is busy with a bulk transfer.
+
+static void report(const char *name, QList<qint64> rtts)
+{
+    if (rtts.isEmpty()) {
+        printf("%-24s no samples\n", name);
+        return;
+    }
+    std::sort(rtts.begin(), rtts.end());
+    const int p50 = rtts.size() / 2;
+    const int p99 = qMin(rtts.size() - 1, rtts.size() * 99 / 100);
+    printf("%-24s p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms\n", name, rtts.at(p50) / 1000000.0,
+           rtts.at(p99) / 1000000.0, rtts.last() / 1000000.0);
+}
+
+static bool run(const char *name, quint32 rpcWeight, bool flowControl, int count)
+{
+    QSharedPointer<Socket> server(Socket::createServer(HostAddress::LocalHost, 0));
+    if (server.isNull()) {
+        qDebug() << "can not listen.";
+        return false;
+    }
+
+    CoroutineGroup operations;
+    operations.spawn([server, &operations] {
+        QSharedPointer<Socket> request(server->accept());
+        if (request.isNull()) {
+            return;
+        }
+        QSharedPointer<SocketChannel> channel(new SocketChannel(request, NegativePole));
+        QSharedPointer<VirtualChannel> bulk = channel->takeChannel();
+        QSharedPointer<VirtualChannel> rpc = channel->takeChannel();
+        if (bulk.isNull() || rpc.isNull()) {
+            return;
+        }
+        operations.spawn([bulk] {
+            while (!bulk->recvPacket().isEmpty()) { }
+        });
+        while (true) {
+            const QByteArray &packet = rpc->recvPacket();
+            if (packet.isEmpty() || !rpc->sendPacket(packet)) {
+                break;
+            }
+        }
+    });
+
+    QSharedPointer<Socket> client(Socket::createConnection(HostAddress::LocalHost, server->localPort()));
+    if (client.isNull()) {
+        qDebug() << "can not connect to server.";
+        return false;
+    }
+    QSharedPointer<SocketChannel> channel(new SocketChannel(client, PositivePole));
+    if (flowControl) {
+        channel->enableFlowControl();
+    }
+    QSharedPointer<VirtualChannel> bulk = channel->makeChannel();
+    QSharedPointer<VirtualChannel> rpc = channel->makeChannel();
+    rpc->setSendingWeight(rpcWeight);
+
+    operations.spawn([bulk] {
+        const QByteArray block(static_cast<int>(bulk->maxPayloadSize()), 'x');
+        while (bulk->sendPacket(block)) { }
+    });
+
+    QList<qint64> rtts;
+    const QByteArray ping(64, 'p');
+    QElapsedTimer timer;
+    for (int i = 0; i < count; ++i) {
+        timer.start();
+        if (!rpc->sendPacket(ping) || rpc->recvPacket().isEmpty()) {
+            break;
+        }
+        rtts.append(timer.nsecsElapsed());
+    }
+    const SocketChannelStats stats = channel->stats();
+    channel->abort();
+    operations.killall();
+    report(name, rtts);
+    printf("%-24s %llu writes, %.1f packets per write\n", "", static_cast<unsigned long long>(stats.batches),
+           stats.batches ? static_cast<double>(stats.packets) / stats.batches : 0.0);
+    return rtts.size() == count;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    int count = 2000;
+    if (argc > 1) {
+        count = QByteArray(argv[1]).toInt();
+    }
+    bool ok = run("weight 1", 1, false, count);
+    ok = run("weight 8", 8, false, count) && ok;
+    ok = run("weight 8, flow control", 8, true, count) && ok;
+    return ok ? 0 : 1;
+}
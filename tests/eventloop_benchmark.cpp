@@ -0,0 +1,128 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include "qtnetworkng.h"
+
+using namespace qtng;
+
+// compare the eventloops with echo and http workloads over localhost. run it twice to compare:
+//     eventloop_benchmark ev [connections] [requests]
+//     eventloop_benchmark io_uring [connections] [requests]
+
+class HelloRequestHandler : public BaseHttpRequestHandler
+{
+protected:
+    virtual void doGET() override
+    {
+        static const QByteArray body("hello, world!");
+        sendResponse(HttpStatus::OK);
+        sendHeader(ContentTypeHeader, "text/plain");
+        sendHeader(ContentLengthHeader, QByteArray::number(body.size()));
+        endHeader(body);
+    }
+    virtual void logRequest(HttpStatus, int) override { }
+};
+
+static void report(const char *name, int total, qint64 elapsed)
+{
+    printf("%-8s %8d requests  %10.1f requests/s\n", name, total, total / (qMax<qint64>(elapsed, 1) / 1000.0));
+}
+
+static bool echo(int connections, int requests)
+{
+    QSharedPointer<Socket> server(Socket::createServer(HostAddress::LocalHost, 0));
+    if (server.isNull()) {
+        qDebug() << "can not listen.";
+        return false;
+    }
+    CoroutineGroup operations;
+    operations.spawn([server, &operations] {
+        while (true) {
+            QSharedPointer<Socket> request(server->accept());
+            if (request.isNull()) {
+                return;
+            }
+            operations.spawn([request] {
+                char buf[1024];
+                while (true) {
+                    qint32 len = request->recv(buf, sizeof(buf));
+                    if (len <= 0 || request->sendall(buf, len) != len) {
+                        return;
+                    }
+                }
+            });
+        }
+    });
+
+    QSharedPointer<int> total(new int(0));
+    QElapsedTimer timer;
+    timer.start();
+    CoroutineGroup clients;
+    for (int i = 0; i < connections; ++i) {
+        clients.spawn([server, requests, total] {
+            QSharedPointer<Socket> client(Socket::createConnection(HostAddress::LocalHost, server->localPort()));
+            const QByteArray ping(64, 'p');
+            char buf[64];
+            for (int j = 0; !client.isNull() && j < requests; ++j) {
+                if (client->sendall(ping) != ping.size() || client->recvall(buf, sizeof(buf)) != sizeof(buf)) {
+                    break;
+                }
+                ++(*total);
+            }
+        });
+    }
+    clients.joinall();
+    report("echo", *total, timer.elapsed());
+    operations.killall();
+    return *total == connections * requests;
+}
+
+static bool http(int connections, int requests)
+{
+    TcpServer<HelloRequestHandler> httpd(HostAddress::LocalHost, 0);
+    if (!httpd.start()) {
+        qDebug() << "can not start http server.";
+        return false;
+    }
+    const QUrl url(QString::fromLatin1("http://127.0.0.1:%1/").arg(httpd.serverPort()));
+    QSharedPointer<int> total(new int(0));
+    QElapsedTimer timer;
+    timer.start();
+    CoroutineGroup clients;
+    for (int i = 0; i < connections; ++i) {
+        clients.spawn([url, requests, total] {
+            HttpSession session;
+            for (int j = 0; j < requests; ++j) {
+                HttpResponse response = session.get(url);
+                if (!response.isOk()) {
+                    break;
+                }
+                ++(*total);
+            }
+        });
+    }
+    clients.joinall();
+    report("http", *total, timer.elapsed());
+    httpd.stop();
+    return *total == connections * requests;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && QByteArray(argv[1]) == "io_uring") {
+        Coroutine::preferIoUring();
+    } else {
+        Coroutine::preferLibev();
+    }
+    QCoreApplication app(argc, argv);
+    int connections = 64;
+    int requests = 2000;
+    if (argc > 2) {
+        connections = QByteArray(argv[2]).toInt();
+    }
+    if (argc > 3) {
+        requests = QByteArray(argv[3]).toInt();
+    }
+    bool ok = echo(connections, requests);
+    ok = http(connections, requests / 10) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include "qtnetworkng.h"
+
+using namespace qtng;
+
+// hash small records in batch and large buffers, report the throughput of every algorithm.
+
+static void report(const char *name, const char *kind, qint64 bytes, qint64 elapsed)
+{
+    printf("%-10s %-8s %8.1f MB  %8.3f GB/s\n", name, kind, bytes / 1024.0 / 1024.0,
+           bytes / 1024.0 / 1024.0 / 1024.0 / (qMax<qint64>(elapsed, 1) / 1000.0));
+}
+
+static void benchmarkDigest(const char *name, MessageDigest::Algorithm algo, const QList<QByteArray> &records,
+                            const QByteArray &large, int rounds)
+{
+    QElapsedTimer timer;
+    timer.start();
+    qint64 bytes = 0;
+    for (int i = 0; i < rounds; ++i) {
+        MessageDigest::digestMany(records, algo);
+        bytes += records.size() * records.first().size();
+    }
+    report(name, "records", bytes, timer.elapsed());
+
+    MessageDigest m(algo);
+    timer.restart();
+    bytes = 0;
+    for (int i = 0; i < rounds; ++i) {
+        m.reset();
+        m.addData(large);
+        m.result();
+        bytes += large.size();
+    }
+    report(name, "large", bytes, timer.elapsed());
+}
+
+static void benchmarkXxhash(const QList<QByteArray> &records, const QByteArray &large, int rounds)
+{
+    QElapsedTimer timer;
+    timer.start();
+    qint64 bytes = 0;
+    for (int i = 0; i < rounds; ++i) {
+        xxhash64Many(records);
+        bytes += records.size() * records.first().size();
+    }
+    report("xxhash64", "records", bytes, timer.elapsed());
+
+    timer.restart();
+    bytes = 0;
+    quint64 h = 0;
+    for (int i = 0; i < rounds; ++i) {
+        h ^= xxhash64(large);
+        bytes += large.size();
+    }
+    report("xxhash64", "large", bytes, timer.elapsed());
+    if (h == 1) {  // keep the compiler from removing the loop.
+        printf("\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    int rounds = 100;
+    if (argc > 1) {
+        rounds = QByteArray(argv[1]).toInt();
+    }
+    QList<QByteArray> records;
+    for (int i = 0; i < 1024 * 16; ++i) {
+        records.append(QByteArray(64, static_cast<char>(i)));
+    }
+    QByteArray large(1024 * 1024, 'x');
+    benchmarkDigest("md5", MessageDigest::Md5, records, large, rounds);
+    benchmarkDigest("sha1", MessageDigest::Sha1, records, large, rounds);
+    benchmarkDigest("sha256", MessageDigest::Sha256, records, large, rounds);
+    benchmarkDigest("sha512", MessageDigest::Sha512, records, large, rounds);
+    benchmarkXxhash(records, large, rounds);
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QBuffer>
+#include "qtnetworkng.h"
+
+using namespace qtng;
+
+// encode and decode typical rpc messages, through QBuffer and through the byte array directly.
+
+static QVariantMap makeRequest(int id)
+{
+    QVariantMap request;
+    request.insert(QString::fromLatin1("id"), id);
+    request.insert(QString::fromLatin1("method"), QString::fromLatin1("storage.put"));
+    QVariantList params;
+    params << QString::fromLatin1("user:%1").arg(id) << QByteArray(200, 'x') << 3600 << true;
+    request.insert(QString::fromLatin1("params"), params);
+    return request;
+}
+
+struct PutRequest
+{
+    qint32 id = 0;
+    QString method;
+    QString key;
+    QByteArray value;
+    qint32 ttl = 0;
+    bool overwrite = false;
+};
+QTNG_MSGPACK_MAP_FIELDS(PutRequest, id, method, key, value, ttl, overwrite)
+
+static void report(const char *name, qint64 bytes, qint64 elapsed)
+{
+    printf("%-16s %8.1f MB  %8.1f MB/s\n", name, bytes / 1024.0 / 1024.0,
+           bytes / 1024.0 / 1024.0 / (qMax<qint64>(elapsed, 1) / 1000.0));
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    int count = 200000;
+    if (argc > 1) {
+        count = QByteArray(argv[1]).toInt();
+    }
+    const QVariantMap &request = makeRequest(1);
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 bytes = 0;
+    QByteArray packet;
+    for (int i = 0; i < count; ++i) {
+        packet.clear();
+        QBuffer buf(&packet);
+        buf.open(QIODevice::WriteOnly);
+        MsgPackStream s(&buf);
+        s << request;
+        bytes += packet.size();
+    }
+    report("encode qbuffer", bytes, timer.elapsed());
+
+    timer.restart();
+    bytes = 0;
+    for (int i = 0; i < count; ++i) {
+        packet.clear();
+        MsgPackStream s(&packet, QIODevice::WriteOnly);
+        s << request;
+        bytes += packet.size();
+    }
+    report("encode direct", bytes, timer.elapsed());
+
+    timer.restart();
+    bytes = 0;
+    for (int i = 0; i < count; ++i) {
+        QBuffer buf(&packet);
+        buf.open(QIODevice::ReadOnly);
+        MsgPackStream s(&buf);
+        QVariant v;
+        s >> v;
+        bytes += packet.size();
+    }
+    report("decode qbuffer", bytes, timer.elapsed());
+
+    timer.restart();
+    bytes = 0;
+    for (int i = 0; i < count; ++i) {
+        MsgPackStream s(packet);
+        QVariant v;
+        s >> v;
+        bytes += packet.size();
+    }
+    report("decode direct", bytes, timer.elapsed());
+
+    // the same message as a struct and as a QVariantMap.
+    PutRequest put;
+    put.id = 1;
+    put.method = QString::fromLatin1("storage.put");
+    put.key = QString::fromLatin1("user:1");
+    put.value = QByteArray(200, 'x');
+    put.ttl = 3600;
+    put.overwrite = true;
+    QVariantMap putMap;
+    putMap.insert(QString::fromLatin1("id"), put.id);
+    putMap.insert(QString::fromLatin1("method"), put.method);
+    putMap.insert(QString::fromLatin1("key"), put.key);
+    putMap.insert(QString::fromLatin1("value"), put.value);
+    putMap.insert(QString::fromLatin1("ttl"), put.ttl);
+    putMap.insert(QString::fromLatin1("overwrite"), put.overwrite);
+
+    timer.restart();
+    bytes = 0;
+    for (int i = 0; i < count; ++i) {
+        packet.clear();
+        MsgPackStream s(&packet, QIODevice::WriteOnly);
+        s << putMap;
+        bytes += packet.size();
+    }
+    report("encode qvariant", bytes, timer.elapsed());
+
+    timer.restart();
+    bytes = 0;
+    for (int i = 0; i < count; ++i) {
+        MsgPackStream s(packet);
+        QVariant v;
+        s >> v;
+        bytes += packet.size();
+    }
+    report("decode qvariant", bytes, timer.elapsed());
+
+    timer.restart();
+    bytes = 0;
+    for (int i = 0; i < count; ++i) {
+        packet.clear();
+        MsgPackStream s(&packet, QIODevice::WriteOnly);
+        s << put;
+        bytes += packet.size();
+    }
+    report("encode struct", bytes, timer.elapsed());
+
+    timer.restart();
+    bytes = 0;
+    for (int i = 0; i < count; ++i) {
+        MsgPackStream s(packet);
+        PutRequest r;
+        s >> r;
+        bytes += packet.size();
+    }
+    report("decode struct", bytes, timer.elapsed());
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include <sys/resource.h>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include "qtnetworkng.h"
+
+using namespace qtng;
+
+// relay the data through an Exchanger (or a plain recv()/sendall() loop) to a sink server,
+// and report the cpu time per GB relayed. the client and sink are in the same process, so their cost is included.
+
+static double cpuSeconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void copy(QSharedPointer<SocketLike> from, QSharedPointer<SocketLike> to)
+{
+    QByteArray buf(1024 * 8, Qt::Uninitialized);
+    while (true) {
+        qint32 len = from->recv(buf.data(), buf.size());
+        if (len <= 0 || to->sendall(buf.data(), len) != len) {
+            to->abort();
+            return;
+        }
+    }
+}
+
+static bool relay(bool useExchanger, qint64 total)
+{
+    CoroutineGroup operations;
+    QSharedPointer<Socket> sink(new Socket());
+    QSharedPointer<Socket> proxy(new Socket());
+    if (!sink->bind(HostAddress::LocalHost, 0) || !sink->listen(50) || !proxy->bind(HostAddress::LocalHost, 0)
+        || !proxy->listen(50)) {
+        qDebug() << "can not listen.";
+        return false;
+    }
+    const quint16 sinkPort = sink->localPort();
+
+    ValueEvent<qint64> received;
+    operations.spawn([sink, &received] {
+        QSharedPointer<Socket> request(sink->accept());
+        if (request.isNull()) {
+            received.send(-1);
+            return;
+        }
+        QByteArray buf(1024 * 64, Qt::Uninitialized);
+        qint64 bytes = 0;
+        while (true) {
+            qint32 len = request->recv(buf.data(), buf.size());
+            if (len <= 0) {
+                break;
+            }
+            bytes += len;
+        }
+        received.send(bytes);
+    });
+    operations.spawn([proxy, sinkPort, useExchanger] {
+        QSharedPointer<Socket> rawRequest(proxy->accept());
+        QSharedPointer<Socket> rawForward(Socket::createConnection(HostAddress::LocalHost, sinkPort));
+        if (rawRequest.isNull() || rawForward.isNull()) {
+            return;
+        }
+        QSharedPointer<SocketLike> request = asSocketLike(rawRequest);
+        QSharedPointer<SocketLike> forward = asSocketLike(rawForward);
+        if (useExchanger) {
+            Exchanger exchanger(request, forward);
+            exchanger.exchange();
+        } else {
+            CoroutineGroup directions;
+            directions.spawn([request, forward] { copy(request, forward); });
+            directions.spawn([request, forward] { copy(forward, request); });
+            directions.joinall();
+        }
+    });
+
+    QSharedPointer<Socket> client(Socket::createConnection(HostAddress::LocalHost, proxy->localPort()));
+    if (client.isNull()) {
+        qDebug() << "can not connect to proxy.";
+        return false;
+    }
+    QByteArray buf(1024 * 64, 'x');
+    double cpuStarted = cpuSeconds();
+    QElapsedTimer timer;
+    timer.start();
+    qint64 sent = 0;
+    while (sent < total) {
+        qint32 len = client->sendall(buf);
+        if (len != buf.size()) {
+            qDebug() << "can not send to proxy.";
+            return false;
+        }
+        sent += len;
+    }
+    client->close();
+    qint64 bytes = received.tryWait();
+    double cpu = cpuSeconds() - cpuStarted;
+    qint64 elapsed = timer.elapsed();
+    if (bytes != sent) {
+        qDebug() << "relayed" << bytes << "bytes, but" << sent << "bytes sent.";
+        return false;
+    }
+    double gb = bytes / (1024.0 * 1024.0 * 1024.0);
+    printf("%-10s %8.3f GB  %8.3f cpu secs/GB  %8.1f MB/s\n", useExchanger ? "exchanger" : "copy", gb, cpu / gb,
+           bytes / 1024.0 / 1024.0 / (qMax<qint64>(elapsed, 1) / 1000.0));
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    qint64 total = 1024LL * 1024 * 1024;  // 1GB
+    if (argc > 1) {
+        total = QByteArray(argv[1]).toLongLong() * 1024 * 1024;
+    }
+    if (!relay(false, total) || !relay(true, total)) {
+        return 1;
+    }
+    return 0;
+}
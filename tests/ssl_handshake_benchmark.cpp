@@ -0,0 +1,89 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include "qtnetworkng.h"
+
+using namespace qtng;
+
+// connect to a local SslSocket server again and again, and report the handshakes per second
+// with full handshakes and with resumed sessions. the client and server are in the same process.
+
+static bool run(bool resume, int count)
+{
+    SslConfiguration serverConfig = SslConfiguration::testPurpose("Goldfish", "CN", "Example");
+    QSharedPointer<SslSocket> server(new SslSocket(HostAddress::IPv4Protocol, serverConfig));
+    if (!server->bind(HostAddress::LocalHost, 0) || !server->listen(100)) {
+        qDebug() << "can not listen.";
+        return false;
+    }
+    const quint16 port = server->localPort();
+
+    CoroutineGroup operations;
+    operations.spawn([server, &operations] {
+        while (true) {
+            QSharedPointer<SslSocket> request(server->accept());
+            if (request.isNull()) {
+                return;
+            }
+            operations.spawn([request] {
+                // the TLS 1.3 session ticket is sent with the first response.
+                const QByteArray &data = request->recv(1);
+                if (!data.isEmpty()) {
+                    request->sendall(data);
+                }
+                request->close();
+            });
+        }
+    });
+
+    SslConfiguration clientConfig;
+    clientConfig.setPeerVerifyMode(Ssl::VerifyNone);
+    QByteArray session;
+    int reused = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < count; ++i) {
+        QSharedPointer<Socket> rawSocket(Socket::createConnection(HostAddress::LocalHost, port));
+        if (rawSocket.isNull()) {
+            qDebug() << "can not connect to server.";
+            return false;
+        }
+        SslSocket client(rawSocket, clientConfig);
+        if (resume) {
+            client.setSession(session);
+        }
+        if (!client.handshake(false, QString::fromLatin1("localhost"))) {
+            qDebug() << "can not handshake with server.";
+            return false;
+        }
+        if (client.sendall("x", 1) != 1 || client.recv(1) != "x") {
+            qDebug() << "can not talk to server.";
+            return false;
+        }
+        if (client.isSessionReused()) {
+            ++reused;
+        }
+        if (resume) {
+            session = client.session();
+        }
+        client.close();
+    }
+    qint64 elapsed = timer.elapsed();
+    server->close();
+    operations.killall();
+    printf("%-8s %6d handshakes  %6d resumed  %10.1f handshakes/s\n", resume ? "resume" : "full", count, reused,
+           count / (qMax<qint64>(elapsed, 1) / 1000.0));
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    int count = 1000;
+    if (argc > 1) {
+        count = QByteArray(argv[1]).toInt();
+    }
+    if (!run(false, count) || !run(true, count)) {
+        return 1;
+    }
+    return 0;
+}
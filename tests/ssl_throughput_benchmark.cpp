@@ -0,0 +1,77 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include "qtnetworkng.h"
+
+using namespace qtng;
+
+// download bulk data from a local SslSocket server and report the throughput.
+// the client and server are in the same process, so both sides of encryption are included.
+
+static bool download(qint64 total, qint32 blockSize)
+{
+    SslConfiguration serverConfig = SslConfiguration::testPurpose("Goldfish", "CN", "Example");
+    QSharedPointer<SslSocket> server(new SslSocket(HostAddress::IPv4Protocol, serverConfig));
+    if (!server->bind(HostAddress::LocalHost, 0) || !server->listen(50)) {
+        qDebug() << "can not listen.";
+        return false;
+    }
+
+    CoroutineGroup operations;
+    operations.spawn([server, total] {
+        QSharedPointer<SslSocket> request(server->accept());
+        if (request.isNull()) {
+            return;
+        }
+        QByteArray buf(1024 * 64, 'x');
+        qint64 sent = 0;
+        while (sent < total) {
+            qint32 len = static_cast<qint32>(qMin<qint64>(buf.size(), total - sent));
+            if (request->sendall(buf.constData(), len) != len) {
+                break;
+            }
+            sent += len;
+        }
+        request->close();
+    });
+
+    SslConfiguration clientConfig;
+    clientConfig.setPeerVerifyMode(Ssl::VerifyNone);
+    SslSocket client(HostAddress::IPv4Protocol, clientConfig);
+    if (!client.connect(HostAddress::LocalHost, server->localPort())) {
+        qDebug() << "can not connect to server.";
+        return false;
+    }
+    QByteArray buf(blockSize, Qt::Uninitialized);
+    QElapsedTimer timer;
+    timer.start();
+    qint64 received = 0;
+    while (true) {
+        qint32 len = client.recv(buf.data(), buf.size());
+        if (len <= 0) {
+            break;
+        }
+        received += len;
+    }
+    qint64 elapsed = timer.elapsed();
+    operations.killall();
+    if (received != total) {
+        qDebug() << "received" << received << "bytes, but" << total << "bytes sent.";
+        return false;
+    }
+    printf("block %6d  %8.1f MB  %8.1f MB/s\n", blockSize, received / 1024.0 / 1024.0,
+           received / 1024.0 / 1024.0 / (qMax<qint64>(elapsed, 1) / 1000.0));
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    qint64 total = 1024LL * 1024 * 512;  // 512MB
+    if (argc > 1) {
+        total = QByteArray(argv[1]).toLongLong() * 1024 * 1024;
+    }
+    if (!download(total, 1024 * 8) || !download(total, 1024 * 64)) {
+        return 1;
+    }
+    return 0;
+}
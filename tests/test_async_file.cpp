@@ -0,0 +1,113 @@
+#include <QtTest>
+#include "qtnetworkng.h"
+#ifdef Q_OS_UNIX
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+using namespace qtng;
+
+class TestAsyncFile: public QObject
+{
+    Q_OBJECT
+private slots:
+    void testReadWrite();
+    void testSlowFifo();
+};
+
+
+void TestAsyncFile::testReadWrite()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString &path = dir.filePath(QString::fromLatin1("data.bin"));
+
+    QSharedPointer<AsyncFile> f = AsyncFile::open(path, QString::fromLatin1("w"));
+    QVERIFY(!f.isNull());
+    const QByteArray data(1024 * 1024 + 7, 'x');
+    QCOMPARE(f->write(data.constData(), data.size()), data.size());
+    QCOMPARE(f->writeAt(0, "head", 4), 4);
+    QCOMPARE(f->size(), static_cast<qint64>(data.size()));
+    f->close();
+
+    f = AsyncFile::open(path);
+    QVERIFY(!f.isNull());
+    QCOMPARE(f->readall(nullptr), QByteArray("head") + data.mid(4));
+    char buf[4];
+    QCOMPARE(f->readAt(2, buf, 4), 4);
+    QCOMPARE(QByteArray(buf, 4), QByteArray("adxx"));
+    QVERIFY(f->seek(data.size() - 1));
+    QCOMPARE(f->read(buf, 4), 1);
+    QCOMPARE(f->read(buf, 4), 0);
+
+    QVERIFY(AsyncFile::open(dir.filePath(QString::fromLatin1("not-exists"))).isNull());
+}
+
+
+// writes a chunk after the ticker coroutine runs a few times, so the reader is blocked until then.
+class SlowWriter : public QThread
+{
+public:
+    SlowWriter(const QString &path, QAtomicInt *ticks)
+        : path(path)
+        , ticks(ticks) { }
+    virtual void run() override
+    {
+        QFile f(path);
+        if (!f.open(QIODevice::WriteOnly)) {
+            return;
+        }
+        for (int i = 0; i < 5; ++i) {
+            const int start = ticks->loadAcquire();
+            for (int waited = 0; ticks->loadAcquire() < start + 3; ++waited) {
+                // the ticker is blocked by the reader, give up and let the reader get a short result.
+                if (waited > 10 * 1000) {
+                    return;
+                }
+                QThread::msleep(1);
+            }
+            f.write("hello");
+            f.flush();
+        }
+    }
+    QString path;
+    QAtomicInt *ticks;
+};
+
+
+// read a fifo which is fed slowly, the other coroutines should not be blocked.
+void TestAsyncFile::testSlowFifo()
+{
+#ifdef Q_OS_UNIX
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString &path = dir.filePath(QString::fromLatin1("fifo"));
+    QCOMPARE(::mkfifo(QFile::encodeName(path).constData(), 0600), 0);
+
+    QAtomicInt ticks(0);
+    SlowWriter writer(path, &ticks);
+    writer.start();
+
+    CoroutineGroup operations;
+    operations.spawn([&ticks] {
+        while (true) {
+            Coroutine::msleep(10);
+            ticks.fetchAndAddOrdered(1);
+        }
+    });
+
+    // every chunk is written only after the ticker runs while the reader waits for it.
+    QSharedPointer<AsyncFile> f = AsyncFile::open(path);
+    QVERIFY(!f.isNull());
+    const QByteArray &data = f->readall(nullptr);
+    operations.killall();
+    writer.wait();
+    QCOMPARE(data, QByteArray("hellohellohellohellohello"));
+    QVERIFY(ticks.loadAcquire() >= 15);
+#else
+    QSKIP("fifo is not supported.");
+#endif
+}
+
+QTEST_MAIN(TestAsyncFile)
+#include "test_async_file.moc"
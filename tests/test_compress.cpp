@@ -0,0 +1,216 @@
+#include <QtTest>
+#include "qtnetworkng.h"
+#include "include/gzip.h"
+
+using namespace qtng;
+
+class TestCompress: public QObject
+{
+    Q_OBJECT
+private slots:
+    void testRoundTrip_data();
+    void testRoundTrip();
+    void testTruncated();
+    void testNegotiate();
+    void testNegotiateIdentity();
+    void testHttp_data();
+    void testHttp();
+};
+
+
+class CompressingHttpRequestHandler : public SimpleHttpRequestHandler
+{
+public:
+    CompressingHttpRequestHandler()
+    {
+        enableCompression = true;
+        setRootDir(QDir(rootPath));
+    }
+public:
+    static QString rootPath;
+    static QByteArray content;
+protected:
+    virtual void doGET() override
+    {
+        if (path == QString::fromLatin1("/dynamic")) {
+            sendResponse(HttpStatus::OK);
+            sendHeader("Content-Type", "text/plain");
+            endHeaderCompressed(content);
+            return;
+        }
+        SimpleHttpRequestHandler::doGET();
+    }
+};
+
+QString CompressingHttpRequestHandler::rootPath;
+QByteArray CompressingHttpRequestHandler::content;
+
+
+void TestCompress::testRoundTrip_data()
+{
+    QTest::addColumn<int>("method");
+    QTest::newRow("gzip") << static_cast<int>(CompressFile::Gzip);
+    QTest::newRow("deflate") << static_cast<int>(CompressFile::Deflate);
+    QTest::newRow("zstd") << static_cast<int>(CompressFile::Zstd);
+    QTest::newRow("br") << static_cast<int>(CompressFile::Brotli);
+}
+
+
+void TestCompress::testRoundTrip()
+{
+    QFETCH(int, method);
+    const CompressFile::Method m = static_cast<CompressFile::Method>(method);
+    if (!CompressFile::isSupported(m)) {
+        QSKIP("the codec is not built.");
+    }
+    QByteArray data;
+    for (int i = 0; i < 100000; ++i) {
+        data.append(QByteArray::number(i % 997)).append(' ');
+    }
+
+    // pull mode.
+    QSharedPointer<CompressFile> compressor(new CompressFile(m, FileLike::bytes(data)));
+    bool ok;
+    const QByteArray &compressed = compressor->readall(&ok);
+    QVERIFY(ok);
+    QVERIFY(compressed.size() < data.size());
+    QSharedPointer<DecompressFile> decompressor(new DecompressFile(m, FileLike::bytes(compressed)));
+    QCOMPARE(decompressor->readall(&ok), data);
+    QVERIFY(ok);
+
+    // push mode.
+    QSharedPointer<BytesIO> compressedOut(new BytesIO());
+    CompressFile writer(m, compressedOut);
+    for (int i = 0; i < data.size(); i += 4096) {
+        QCOMPARE(writer.write(data.constData() + i, qMin(4096, data.size() - i)), qMin(4096, data.size() - i));
+    }
+    writer.close();
+    QSharedPointer<BytesIO> out(new BytesIO());
+    DecompressFile reader(m, out);
+    const QByteArray &c = compressedOut->data();
+    for (int i = 0; i < c.size(); i += 1000) {
+        QCOMPARE(reader.write(c.constData() + i, qMin(1000, c.size() - i)), qMin(1000, c.size() - i));
+    }
+    reader.close();
+    QVERIFY(reader.isValid());
+    QCOMPARE(out->data(), data);
+}
+
+
+void TestCompress::testTruncated()
+{
+    const QByteArray data(1024 * 64, 'x');
+    QSharedPointer<CompressFile> compressor(new CompressFile(CompressFile::Gzip, FileLike::bytes(data)));
+    const QByteArray &compressed = compressor->readall(nullptr);
+    QSharedPointer<DecompressFile> decompressor(
+            new DecompressFile(CompressFile::Gzip, FileLike::bytes(compressed.left(compressed.size() / 2))));
+    bool ok;
+    decompressor->readall(&ok);
+    QVERIFY(!ok);
+}
+
+
+void TestCompress::testNegotiate()
+{
+    QCOMPARE(negotiateContentEncoding("gzip, deflate"), QByteArray("gzip"));
+    QCOMPARE(negotiateContentEncoding("deflate;q=1.0, gzip;q=0.5"), QByteArray("deflate"));
+    QCOMPARE(negotiateContentEncoding("identity"), QByteArray());
+    QCOMPARE(negotiateContentEncoding(""), QByteArray());
+    QCOMPARE(negotiateContentEncoding("*;q=0.1, gzip;q=0"), supportedContentEncodings().first() == "gzip"
+                     ? QByteArray("deflate")
+                     : supportedContentEncodings().first());
+    if (CompressFile::isSupported(CompressFile::Brotli)) {
+        QCOMPARE(negotiateContentEncoding("gzip, deflate, br"), QByteArray("br"));
+    }
+}
+
+
+void TestCompress::testNegotiateIdentity()
+{
+    bool identityAcceptable = false;
+    QCOMPARE(negotiateContentEncoding("gzip", &identityAcceptable), QByteArray("gzip"));
+    QVERIFY(identityAcceptable);
+    QCOMPARE(negotiateContentEncoding("", &identityAcceptable), QByteArray());
+    QVERIFY(identityAcceptable);
+    QCOMPARE(negotiateContentEncoding("identity;q=0.5, gzip;q=0", &identityAcceptable), QByteArray());
+    QVERIFY(identityAcceptable);
+
+    // the uncompressed response is refused.
+    QCOMPARE(negotiateContentEncoding("gzip, identity;q=0", &identityAcceptable), QByteArray("gzip"));
+    QVERIFY(!identityAcceptable);
+    QCOMPARE(negotiateContentEncoding("deflate;q=0.5, identity;Q=0.0", &identityAcceptable), QByteArray("deflate"));
+    QVERIFY(!identityAcceptable);
+    QCOMPARE(negotiateContentEncoding("gzip;q=0.3, *;q=0", &identityAcceptable), QByteArray("gzip"));
+    QVERIFY(!identityAcceptable);
+
+    // the wildcard does not apply to identity if it is listed.
+    QCOMPARE(negotiateContentEncoding("identity, *;q=0", &identityAcceptable), QByteArray());
+    QVERIFY(identityAcceptable);
+
+    // nothing is acceptable.
+    QCOMPARE(negotiateContentEncoding("unknown, identity;q=0", &identityAcceptable), QByteArray());
+    QVERIFY(!identityAcceptable);
+}
+
+
+
+void TestCompress::testHttp_data()
+{
+    QTest::addColumn<int>("method");
+    QTest::addColumn<QString>("path");
+    QTest::newRow("gzip dynamic") << static_cast<int>(CompressFile::Gzip) << QString::fromLatin1("/dynamic");
+    QTest::newRow("zstd dynamic") << static_cast<int>(CompressFile::Zstd) << QString::fromLatin1("/dynamic");
+    QTest::newRow("br dynamic") << static_cast<int>(CompressFile::Brotli) << QString::fromLatin1("/dynamic");
+    QTest::newRow("gzip static") << static_cast<int>(CompressFile::Gzip) << QString::fromLatin1("/static.txt");
+    QTest::newRow("zstd static") << static_cast<int>(CompressFile::Zstd) << QString::fromLatin1("/static.txt");
+    QTest::newRow("br static") << static_cast<int>(CompressFile::Brotli) << QString::fromLatin1("/static.txt");
+}
+
+
+void TestCompress::testHttp()
+{
+    QFETCH(int, method);
+    QFETCH(QString, path);
+    const CompressFile::Method m = static_cast<CompressFile::Method>(method);
+    if (!CompressFile::isSupported(m)) {
+        QSKIP("the codec is not built.");
+    }
+    QByteArray data;
+    for (int i = 0; i < 10000; ++i) {
+        data.append(QByteArray::number(i % 997)).append(' ');
+    }
+    QTemporaryDir root;
+    QVERIFY(root.isValid());
+    QFile f(root.filePath(QString::fromLatin1("static.txt")));
+    QVERIFY(f.open(QIODevice::WriteOnly));
+    QCOMPARE(f.write(data), static_cast<qint64>(data.size()));
+    f.close();
+    CompressingHttpRequestHandler::rootPath = root.path();
+    CompressingHttpRequestHandler::content = data;
+
+    TcpServer<CompressingHttpRequestHandler> httpd(HostAddress::LocalHost, 0);
+    QVERIFY(httpd.start());
+    const QByteArray &encoding = CompressFile::encodingName(m);
+    HttpSession session;
+    HttpRequest request(QString::fromLatin1("http://127.0.0.1:%1%2").arg(httpd.serverPort()).arg(path));
+    request.setHeader(QString::fromLatin1("Accept-Encoding"), encoding);
+    // the headers are checked before the body is decoded, which removes the Content-Encoding header.
+    request.setStreamResponse(true);
+    Timeout _(10.0);
+    HttpResponse response = session.send(request);
+    QVERIFY(response.isOk());
+    QCOMPARE(response.header(QString::fromLatin1("Content-Encoding")), encoding);
+    QCOMPARE(response.header(QString::fromLatin1("Vary")), QByteArray("Accept-Encoding"));
+    if (path == QString::fromLatin1("/static.txt")) {
+        // the compressed size of file is unknown before sending, so the body ends with the connection.
+        QCOMPARE(response.header(QString::fromLatin1("Connection")), QByteArray("close"));
+    } else {
+        QVERIFY(response.header(QString::fromLatin1("Content-Length")).toInt() < data.size());
+    }
+    QCOMPARE(response.body(), data);
+    QVERIFY(response.isOk());
+    httpd.stop();
+}
+
+QTEST_MAIN(TestCompress)
+#include "test_compress.moc"
@@ -15,12 +15,16 @@ private slots:
     void testSha384();
     void testSha512();
     void testRipemd160();
+    void testDigestMany();
+    void testXxhash64();
 //    void testBlake2b512();
 //    void testBlake2s256();
     void testAES128();
     void testAES256();
     void testBlowfish();
     void testDecrypt();
+    void testAesGcm();
+    void testChaCha20Poly1305();
     void testGenRSA();
     void testSignRSA();
     void testCryptoRSA();
@@ -71,6 +75,41 @@ void TestCrypto::testRipemd160()
     QCOMPARE(MessageDigest::hash("123456", MessageDigest::Ripemd160), QByteArray("d8913df37b24c97f28f840114d05bd110dbb2e44"));
 }
 
+void TestCrypto::testDigestMany()
+{
+    QList<QByteArray> data;
+    data << "123456" << "" << QByteArray(1000, 'x');
+    QList<QByteArray> hashes = MessageDigest::hashMany(data, MessageDigest::Sha256);
+    QCOMPARE(hashes.size(), data.size());
+    for (int i = 0; i < data.size(); ++i) {
+        QCOMPARE(hashes.at(i), MessageDigest::hash(data.at(i), MessageDigest::Sha256));
+    }
+
+    MessageDigest m(MessageDigest::Sha256);
+    QCOMPARE(m.digestSize(), 32);
+    char out[32];
+    for (const QByteArray &d : data) {
+        m.reset();
+        m.addData(d);
+        QVERIFY(m.result(out));
+        QCOMPARE(QByteArray(out, 32), MessageDigest::digest(d, MessageDigest::Sha256));
+    }
+}
+
+void TestCrypto::testXxhash64()
+{
+    QCOMPARE(xxhash64(QByteArray()), Q_UINT64_C(0xef46db3751d8e999));
+    QCOMPARE(xxhash64(QByteArray("abc")), Q_UINT64_C(0x44bc2cf5ad770999));
+    QByteArray large(1000, 'y');
+    QList<QByteArray> data;
+    data << "abc" << large;
+    QList<quint64> hashes = xxhash64Many(data);
+    QCOMPARE(hashes.size(), 2);
+    QCOMPARE(hashes.at(0), Q_UINT64_C(0x44bc2cf5ad770999));
+    QCOMPARE(hashes.at(1), xxhash64(large));
+    QVERIFY(xxhash64(large, 1) != xxhash64(large));
+}
+
 //void TestSsl::testBlake2b512()
 //{
 //    QCOMPARE(QMessageDigest::hash("123456", QMessageDigest::Blake2b512), QByteArray("ba3253876aed6bc22d4a6ff53d8406c6ad864195ed144ab5c87621b6c233b548baeae6956df346ec8c17f5ea10f35ee3cbc514797ed7ddd3145464e2a0bab413"));
@@ -84,7 +123,7 @@ void TestCrypto::testRipemd160()
 void TestCrypto::testAES128()
 {
     Cipher c(Cipher::AES128, Cipher::ECB, Cipher::Encrypt);
-    c.setOpensslPassword("123456", MessageDigest::Sha256, "12345678", 1);
+    c.setOpensslPassword("123456", "12345678", MessageDigest::Sha256, 1);
     QByteArray result;
     result.append(c.addData("fish is here."));
     result.append(c.finalData());
@@ -97,7 +136,7 @@ void TestCrypto::testAES128()
 void TestCrypto::testAES256()
 {
     Cipher c(Cipher::AES256, Cipher::ECB, Cipher::Encrypt);
-    c.setOpensslPassword("123456", MessageDigest::Sha256, "12345678", 1);
+    c.setOpensslPassword("123456", "12345678", MessageDigest::Sha256, 1);
     QByteArray result;
     result.append(c.addData("fish is here."));
     result.append(c.finalData());
@@ -110,7 +149,7 @@ void TestCrypto::testAES256()
 void TestCrypto::testBlowfish()
 {
     Cipher c(Cipher::Blowfish, Cipher::ECB, Cipher::Encrypt);
-    c.setOpensslPassword("123456", MessageDigest::Sha256, "12345678", 1);
+    c.setOpensslPassword("123456", "12345678", MessageDigest::Sha256, 1);
     QByteArray result;
     result.append(c.addData("fish is here."));
     result.append(c.finalData());
@@ -124,7 +163,7 @@ void TestCrypto::testBlowfish()
 void TestCrypto::testDecrypt()
 {
     Cipher c1(Cipher::Blowfish, Cipher::CBC, Cipher::Encrypt);
-    c1.setPassword("123456", MessageDigest::Sha256, "12345678", 10000);
+    c1.setPassword("123456", "12345678", MessageDigest::Sha256, 10000);
     QByteArray encryptedText;
     encryptedText.append(c1.addData("fish is here."));
     encryptedText.append(c1.finalData());
@@ -139,6 +178,55 @@ void TestCrypto::testDecrypt()
 }
 
 
+void TestCrypto::testAesGcm()
+{
+    // test case 2 of the GCM specification.
+    Cipher c1(Cipher::AES128, Cipher::GCM, Cipher::Encrypt);
+    c1.setKey(QByteArray(16, '\0'));
+    QVERIFY(c1.setInitialVector(QByteArray(12, '\0')));
+    QVERIFY(c1.isAead());
+    QByteArray data(16, '\0');
+    QCOMPARE(c1.update(data.constData(), data.size(), data.data()), 16);
+    char rest[32];
+    QCOMPARE(c1.final(rest), 0);
+    QCOMPARE(data.toHex(), QByteArray("0388dace60b6a392f328c2b971b2fe78"));
+    QCOMPARE(c1.tag().toHex(), QByteArray("ab6e47d42cec13bdf53a67b21257bddf"));
+
+    QScopedPointer<Cipher> c2(c1.copy(Cipher::Decrypt));
+    const QByteArray &iv = QByteArray(12, '\0');
+    const QByteArray &sealed = data + c1.tag();
+    bool ok = false;
+    QCOMPARE(c2->open(iv, sealed, QByteArray(), &ok), QByteArray(16, '\0'));
+    QVERIFY(ok);
+}
+
+
+void TestCrypto::testChaCha20Poly1305()
+{
+    Cipher c1(Cipher::ChaCha20Poly1305, Cipher::CBC, Cipher::Encrypt);
+    c1.setKey(QByteArray(32, 'k'));
+    QVERIFY(c1.setInitialVector(QByteArray(12, 'n')));
+    QScopedPointer<Cipher> c2(c1.copy(Cipher::Decrypt));
+
+    const QByteArray &iv = QByteArray::fromHex("000102030405060708090a0b");
+    const QByteArray &sealed = c1.seal(iv, "fish is here.", "header");
+    QCOMPARE(sealed.size(), 13 + 16);
+    bool ok = false;
+    QCOMPARE(c2->open(iv, sealed, "header", &ok), QByteArray("fish is here."));
+    QVERIFY(ok);
+
+    // the aad and the ciphertext are authenticated, and the cipher can be used again after a failure.
+    c2->open(iv, sealed, "HEADER", &ok);
+    QVERIFY(!ok);
+    QByteArray forged = sealed;
+    forged[0] = static_cast<char>(forged[0] ^ 1);
+    c2->open(iv, forged, "header", &ok);
+    QVERIFY(!ok);
+    QCOMPARE(c2->open(iv, sealed, "header", &ok), QByteArray("fish is here."));
+    QVERIFY(ok);
+}
+
+
 void TestCrypto::testGenRSA()
 {
     PrivateKey key1 = PrivateKey::generate(PrivateKey::Rsa, 2048);
@@ -234,7 +322,7 @@ void TestCrypto::testCertificate()
         { Certificate::CommonName, QStringLiteral("Goldfish") },
         { Certificate::CountryName, QStringLiteral("CN") },
     };
-    Certificate cert = Certificate::generate(pkey, MessageDigest::Sha256, 29472, now, now.addYears(10), subjectInfoes);
+    Certificate cert = Certificate::selfSign(pkey, MessageDigest::Sha256, 29472, now, now.addYears(10), subjectInfoes);
     QVERIFY(!cert.isNull());
     QVERIFY(qAbs(cert.effectiveDate().msecsTo(now)) < 1000);
     QVERIFY(qAbs(cert.expiryDate().msecsTo(now.addYears(10))) < 1000);
@@ -1,90 +1,463 @@
-#include <QCoreApplication>
-#include <QDebug>
+#include <QtTest>
 #include "qtnetworkng.h"
 
+using namespace qtng;
 
-class ServerCoroutine: public qtng::Coroutine
+class TestDataChannel: public QObject
 {
-public:
-    ServerCoroutine()
-    {
-        setObjectName("server");
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void testBatching();
+    void testMaxBatchSize();
+    void testFairness();
+    void testWindow();
+    void testAsyncWindow();
+    void testAbort();
+    void testStream();
+    void testStreamWithEmptyPackets();
+    void testStreamAborted();
+    void testStreamStalled();
+    void testVirtualChannel();
+};
+
+
+static bool makeSockets(QSharedPointer<Socket> *client, QSharedPointer<Socket> *server)
+{
+    QSharedPointer<Socket> listener(Socket::createServer(HostAddress::LocalHost, 0));
+    if (listener.isNull()) {
+        return false;
     }
+    client->reset(Socket::createConnection(HostAddress::LocalHost, listener->localPort()));
+    if (client->isNull()) {
+        return false;
+    }
+    server->reset(listener->accept());
+    return !server->isNull();
+}
 
-    virtual void run()
-    {
-        qtng::Socket server;
-        bool success = server.bind((quint16)7923, qtng::Socket::ReuseAddressHint);
-        if(!success) {
-            qDebug() << "port is used.";
-            return;
-        }
-        server.listen(5);
-        qtng::Socket *request = server.accept();
-        if(!request) {
-            qDebug() << "bad request.";
-            return;
+
+static bool makePair(QSharedPointer<SocketChannel> *client, QSharedPointer<SocketChannel> *server)
+{
+    QSharedPointer<Socket> connection, request;
+    if (!makeSockets(&connection, &request)) {
+        return false;
+    }
+    client->reset(new SocketChannel(connection, DataChannelPole::NegativePole));
+    server->reset(new SocketChannel(request, DataChannelPole::PositivePole));
+    return true;
+}
+
+
+// the other coroutines run while waiting.
+static bool waitFor(std::function<bool()> condition)
+{
+    for (int i = 0; i < 500; ++i) {
+        if (condition()) {
+            return true;
         }
-        qtng::SocketChannel channel(QSharedPointer<qtng::Socket>(request), qtng::NegativePole);
-        channel.setName("server_channel");
-        QByteArray t = channel.recvPacket();
-        quint32 channelNumber = t.toUInt();
-        qDebug() << "got subchannel number:" << channelNumber;
-        QSharedPointer<qtng::VirtualChannel> subChannel = channel.getChannel(channelNumber);
-        if(subChannel.isNull()) {
-            return;
+        Coroutine::msleep(10);
+    }
+    return condition();
+}
+
+
+static QByteArray makePacket(int i, int size)
+{
+    QByteArray packet = QByteArray::number(i);
+    packet.append(QByteArray(size - packet.size(), '.'));
+    return packet;
+}
+
+
+static QByteArray makeFrame(quint32 channelNumber, const QByteArray &payload)
+{
+    uchar header[sizeof(quint32) * 2];
+    qToBigEndian<quint32>(static_cast<quint32>(payload.size()), header);
+    qToBigEndian<quint32>(channelNumber, header + sizeof(quint32));
+    return QByteArray(reinterpret_cast<char *>(header), sizeof(header)) + payload;
+}
+
+
+static quint64 sumBuckets(const SocketChannelStats &stats)
+{
+    quint64 sum = 0;
+    for (int i = 0; i < SocketChannelStats::BatchSizeBuckets; ++i) {
+        sum += stats.batchSizes[i];
+    }
+    return sum;
+}
+
+
+void TestDataChannel::initTestCase()
+{
+#ifdef QTNG_TEST_IO_URING
+    // the same tests are built again to run with the io_uring eventloop.
+    Coroutine::preferIoUring();
+#endif
+}
+
+
+// the packets queued before the sending coroutine runs are coalesced into vectored writes of 64 packets.
+void TestDataChannel::testBatching()
+{
+    QSharedPointer<SocketChannel> client, server;
+    QVERIFY(makePair(&client, &server));
+
+    const int HeaderSize = sizeof(quint32) * 2;
+    const int count = 200;
+    for (int i = 0; i < count; ++i) {
+        QVERIFY(client->sendPacketAsync(makePacket(i, 10)));
+    }
+    for (int i = 0; i < count; ++i) {
+        QCOMPARE(server->recvPacket(), makePacket(i, 10));
+    }
+
+    const SocketChannelStats &stats = client->stats();
+    QCOMPARE(stats.packets, static_cast<quint64>(count));
+    QCOMPARE(stats.bytes, static_cast<quint64>(count * (10 + HeaderSize)));
+    QCOMPARE(stats.batches, static_cast<quint64>(4));  // 64 + 64 + 64 + 8
+    QCOMPARE(stats.batchSizes[6], static_cast<quint64>(3));
+    QCOMPARE(stats.batchSizes[3], static_cast<quint64>(1));
+    QCOMPARE(sumBuckets(stats), stats.batches);
+
+    // a single packet is written alone.
+    QVERIFY(client->sendPacket(makePacket(count, 10)));
+    QCOMPARE(server->recvPacket(), makePacket(count, 10));
+    QCOMPARE(client->stats().batches, static_cast<quint64>(5));
+    QCOMPARE(client->stats().batchSizes[0], static_cast<quint64>(1));
+}
+
+
+// the batch stops growing once it reaches the byte budget.
+void TestDataChannel::testMaxBatchSize()
+{
+    QSharedPointer<SocketChannel> client, server;
+    QVERIFY(makePair(&client, &server));
+    const int HeaderSize = sizeof(quint32) * 2;
+    client->setMaxBatchSize(5 * (10 + HeaderSize));
+    QCOMPARE(client->maxBatchSize(), static_cast<quint32>(5 * (10 + HeaderSize)));
+
+    const int count = 60;
+    for (int i = 0; i < count; ++i) {
+        QVERIFY(client->sendPacketAsync(makePacket(i, 10)));
+    }
+    for (int i = 0; i < count; ++i) {
+        QCOMPARE(server->recvPacket(), makePacket(i, 10));
+    }
+    const SocketChannelStats &stats = client->stats();
+    QCOMPARE(stats.packets, static_cast<quint64>(count));
+    QCOMPARE(stats.batches, static_cast<quint64>(count / 5));
+    QCOMPARE(stats.batchSizes[3], static_cast<quint64>(count / 5));  // 5 packets are in the 5-8 bucket.
+    QCOMPARE(sumBuckets(stats), stats.batches);
+}
+
+
+// the bulk channel queues all of its packets first, but the other channel gets three times of its share.
+void TestDataChannel::testFairness()
+{
+    QSharedPointer<Socket> connection, request;
+    QVERIFY(makeSockets(&connection, &request));
+    QSharedPointer<SocketChannel> client(new SocketChannel(connection, DataChannelPole::NegativePole));
+    QSharedPointer<VirtualChannel> bulk = client->makeChannel();
+    QSharedPointer<VirtualChannel> light = client->makeChannel();
+    QVERIFY(!bulk.isNull() && !light.isNull());
+    QVERIFY(light->setSendingWeight(3));
+    QCOMPARE(light->sendingWeight(), static_cast<quint32>(3));
+
+    const QByteArray packet(4000, 'x');
+    for (int i = 0; i < 40; ++i) {
+        QVERIFY(bulk->sendPacketAsync(packet));
+    }
+    for (int i = 0; i < 40; ++i) {
+        QVERIFY(light->sendPacketAsync(packet));
+    }
+
+    // read the frames from the raw socket, so the order is seen.
+    int bulkCount = 0;
+    int lightCount = 0;
+    while (bulkCount + lightCount < 40) {
+        const QByteArray &header = request->recvall(sizeof(quint32) * 2);
+        QCOMPARE(header.size(), static_cast<int>(sizeof(quint32) * 2));
+        const quint32 size = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(header.constData()));
+        const quint32 channelNumber =
+                qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(header.constData()) + sizeof(quint32));
+        QCOMPARE(request->recvall(static_cast<qint32>(size)).size(), static_cast<int>(size));
+        if (channelNumber == bulk->channelNumber()) {
+            ++bulkCount;
+        } else if (channelNumber == light->channelNumber()) {
+            ++lightCount;
         }
-        while(true) {
-            const QByteArray &packet = subChannel->recvPacket();
-            if(packet.isEmpty()) {
-                break;
+    }
+    QVERIFY(qAbs(lightCount - 30) <= 4);
+    QVERIFY(bulkCount > 0);
+}
+
+
+// the packets sent before the window is known are counted, and the sender resumes after the receiver reads.
+void TestDataChannel::testWindow()
+{
+    QSharedPointer<SocketChannel> client, server;
+    QVERIFY(makePair(&client, &server));
+    server->setCapacity(8);
+    server->enableFlowControl();
+    // in flight while the window is announced.
+    for (int i = 0; i < 5; ++i) {
+        QVERIFY(client->sendPacketAsync(makePacket(i, 10)));
+    }
+    QVERIFY(waitFor([client] { return client->isFlowControlEnabled(); }));
+
+    QSharedPointer<int> sent(new int(0));
+    CoroutineGroup operations;
+    operations.spawn([client, sent] {
+        for (int i = 5; i < 25; ++i) {
+            if (!client->sendPacket(makePacket(i, 10))) {
+                return;
             }
-            qDebug() << packet;
+            ++*sent;
         }
-        qDebug() << "exit server.";
+    });
+
+    QVERIFY(waitFor([server] { return server->receivingQueueSize() >= 8; }));
+    Coroutine::msleep(50);
+    QCOMPARE(*sent, 3);
+    QCOMPARE(server->receivingQueueSize(), static_cast<quint32>(8));
+
+    // a quarter of the capacity is read, so the window is updated.
+    QCOMPARE(server->recvPacket(), makePacket(0, 10));
+    QCOMPARE(server->recvPacket(), makePacket(1, 10));
+    QVERIFY(waitFor([sent] { return *sent >= 5; }));
+    QVERIFY(waitFor([server] { return server->receivingQueueSize() >= 8; }));
+    Coroutine::msleep(50);
+    QCOMPARE(*sent, 5);
+    QCOMPARE(server->receivingQueueSize(), static_cast<quint32>(8));
+
+    for (int i = 2; i < 25; ++i) {
+        QCOMPARE(server->recvPacket(), makePacket(i, 10));
     }
-};
+    operations.joinall();
+    QCOMPARE(*sent, 20);
+}
 
 
-class ClientCoroutine: public qtng::Coroutine
+// sendPacketAsync() is never blocked, but it does not send more than the window either.
+void TestDataChannel::testAsyncWindow()
 {
-public:
-    ClientCoroutine()
-    {
-        setObjectName("client");
+    QSharedPointer<SocketChannel> client, server;
+    QVERIFY(makePair(&client, &server));
+    server->setCapacity(4);
+    server->enableFlowControl();
+    QVERIFY(waitFor([client] { return client->isFlowControlEnabled(); }));
+
+    for (int i = 0; i < 10; ++i) {
+        QVERIFY(client->sendPacketAsync(makePacket(i, 10)));
+    }
+    QVERIFY(waitFor([server] { return server->receivingQueueSize() >= 4; }));
+    Coroutine::msleep(50);
+    QCOMPARE(server->receivingQueueSize(), static_cast<quint32>(4));
+    for (int i = 0; i < 10; ++i) {
+        QCOMPARE(server->recvPacket(), makePacket(i, 10));
     }
+    QVERIFY(client->stats().packets >= 10);
+}
 
-    virtual void run()
-    {
-        QSharedPointer<qtng::Socket> client = QSharedPointer<qtng::Socket>::create();
-//        bool success = client->connect(HostAddress::LocalHost, 7923);
-        bool success = client->connect("127.0.0.1", 7923);
-        if(!success) {
-            return;
-        }
-        qtng::SocketChannel channel(client, qtng::PositivePole);
-        channel.setName("client_channel");
-        QSharedPointer<qtng::VirtualChannel> subChannel = channel.makeChannel();
-        channel.sendPacket(QByteArray::number(subChannel->channelNumber()));
-        for(int i = 0; i < 5; ++i) {
-            success = subChannel->sendPacket(QByteArray::number(i));
-            if(!success) {
-                qDebug() << "exit client.";
+
+void TestDataChannel::testAbort()
+{
+    // the sender waiting for the window is woken up.
+    QSharedPointer<SocketChannel> client, server;
+    QVERIFY(makePair(&client, &server));
+    server->setCapacity(4);
+    server->enableFlowControl();
+    QVERIFY(waitFor([client] { return client->isFlowControlEnabled(); }));
+
+    QSharedPointer<QList<bool>> results(new QList<bool>());
+    CoroutineGroup operations;
+    operations.spawn([client, results] {
+        for (int i = 0; i < 10; ++i) {
+            const bool ok = client->sendPacket(makePacket(i, 10));
+            results->append(ok);
+            if (!ok) {
                 return;
             }
         }
-        success = subChannel->sendPacket(QByteArray());
-        qDebug() << "exit client.";
+    });
+    QVERIFY(waitFor([server] { return server->receivingQueueSize() >= 4; }));
+    client->abort();
+    operations.joinall();
+    QCOMPARE(*results, QList<bool>() << true << true << true << true << false);
+    QVERIFY(client->isBroken());
+    QVERIFY(!client->sendPacket(makePacket(0, 10)));
+    QVERIFY(!client->sendPacketAsync(makePacket(0, 10)));
+
+    // the senders waiting for the full sending queue are rejected, nothing is queued after abort.
+    QSharedPointer<Socket> connection, request;
+    QVERIFY(makeSockets(&connection, &request));
+    connection->setOption(Socket::SendBufferSizeSocketOption, 1024 * 8);
+    request->setOption(Socket::ReceiveBufferSizeSocketOption, 1024 * 8);
+    QSharedPointer<SocketChannel> blocked(new SocketChannel(connection, DataChannelPole::NegativePole));
+    const QByteArray packet(1024 * 60, 'x');
+    QSharedPointer<int> succeeded(new int(0));
+    for (int i = 0; i < 1000; ++i) {
+        operations.spawn([blocked, packet, succeeded] {
+            if (blocked->sendPacket(packet)) {
+                ++*succeeded;
+            }
+        });
     }
-};
+    QVERIFY(waitFor([blocked] { return blocked->sendingQueueSize() >= 256; }));
+    blocked->abort();
+    operations.joinall();
+    QCOMPARE(blocked->sendingQueueSize(), static_cast<quint32>(0));
+    QVERIFY(*succeeded < 1000 - 256);
+}
 
-int main(int argc, char** argv) //simple_data_channel
+
+void TestDataChannel::testStream()
 {
-    QCoreApplication app(argc, argv);
-    Q_UNUSED(app);
-    qtng::CoroutineGroup operations;
-    operations.start(new ServerCoroutine);
-    operations.start(new ClientCoroutine);
-    operations.joinall();
-    return 0;
+    QSharedPointer<SocketChannel> client, server;
+    QVERIFY(makePair(&client, &server));
+    server->setStreamingThreshold(1000);
+
+    const QByteArray large = makePacket(1, 1024 * 30);
+    QVERIFY(client->sendPacketAsync(large));
+    QVERIFY(client->sendPacketAsync(makePacket(2, 10)));
+    QVERIFY(client->sendPacketAsync(large));
+    QVERIFY(client->sendPacketAsync(large));
+
+    bool ok = false;
+    QSharedPointer<FileLike> stream = server->recvPacketStream();
+    QVERIFY(!stream.isNull());
+    QCOMPARE(stream->size(), static_cast<qint64>(large.size()));
+    QCOMPARE(stream->readall(&ok), large);
+    QVERIFY(ok);
+
+    stream = server->recvPacketStream();
+    QVERIFY(!stream.isNull());
+    QCOMPARE(stream->readall(&ok), makePacket(2, 10));
+    QVERIFY(ok);
+
+    // the stream is closed without reading, the next packet is still there.
+    stream = server->recvPacketStream();
+    QVERIFY(!stream.isNull());
+    stream->close();
+    QCOMPARE(server->recvPacket(), large);
+}
+
+
+// the empty packets are not mistaken for the streams.
+void TestDataChannel::testStreamWithEmptyPackets()
+{
+    QSharedPointer<Socket> connection, request;
+    QVERIFY(makeSockets(&connection, &request));
+    QSharedPointer<SocketChannel> server(new SocketChannel(request, DataChannelPole::PositivePole));
+    server->setStreamingThreshold(1000);
+
+    const QByteArray large = makePacket(1, 1024 * 30);
+    QByteArray frames;
+    frames.append(makeFrame(DataChannelNumber, QByteArray()));
+    frames.append(makeFrame(DataChannelNumber, large));
+    frames.append(makeFrame(DataChannelNumber, QByteArray()));
+    frames.append(makeFrame(DataChannelNumber, QByteArray("abc")));
+    frames.append(makeFrame(DataChannelNumber, large));
+    QCOMPARE(connection->sendall(frames), frames.size());
+
+    char buf[16];
+    QSharedPointer<FileLike> stream = server->recvPacketStream();
+    QVERIFY(!stream.isNull());
+    QCOMPARE(stream->size(), static_cast<qint64>(0));
+    QCOMPARE(stream->read(buf, sizeof(buf)), 0);
+
+    bool ok = false;
+    stream = server->recvPacketStream();
+    QVERIFY(!stream.isNull());
+    QCOMPARE(stream->readall(&ok), large);
+    QVERIFY(ok);
+
+    stream = server->recvPacketStream();
+    QVERIFY(!stream.isNull());
+    QCOMPARE(stream->size(), static_cast<qint64>(0));
+
+    QCOMPARE(server->recvPacket(), QByteArray("abc"));
+    QCOMPARE(server->recvPacket(), large);
+    QVERIFY(!server->isBroken());
+}
+
+
+void TestDataChannel::testStreamAborted()
+{
+    QSharedPointer<Socket> connection, request;
+    QVERIFY(makeSockets(&connection, &request));
+    QSharedPointer<SocketChannel> server(new SocketChannel(request, DataChannelPole::PositivePole));
+    server->setStreamingThreshold(1000);
+
+    const QByteArray &frame = makeFrame(DataChannelNumber, makePacket(1, 1024 * 30));
+    QCOMPARE(connection->sendall(frame.left(1024 * 10)), 1024 * 10);
+    QSharedPointer<FileLike> stream = server->recvPacketStream();
+    QVERIFY(!stream.isNull());
+    connection->close();
+
+    bool ok = true;
+    stream->readall(&ok);
+    QVERIFY(!ok);
+    QVERIFY(server->isBroken());
+    QVERIFY(server->recvPacketStream().isNull());
+}
+
+
+// the reader of a stream stops reading, the stream is dropped while the other channels keep flowing.
+void TestDataChannel::testStreamStalled()
+{
+    QSharedPointer<SocketChannel> client, server;
+    QVERIFY(makePair(&client, &server));
+    client->setMaxPacketSize(1024 * 1024 * 4);
+    server->setMaxPacketSize(1024 * 1024 * 4);
+    server->setStreamingThreshold(1000);
+    QSharedPointer<VirtualChannel> clientSub = client->makeChannel();
+    QVERIFY(!clientSub.isNull());
+    QSharedPointer<VirtualChannel> serverSub = server->takeChannel();
+    QVERIFY(!serverSub.isNull());
+
+    // far more than the 16 chunks buffered by the stream.
+    const QByteArray large = makePacket(1, 1024 * 1024 * 3);
+    QVERIFY(client->sendPacketAsync(large));
+    for (int i = 0; i < 5; ++i) {
+        QVERIFY(clientSub->sendPacketAsync(makePacket(i, 10)));
+    }
+    QVERIFY(client->sendPacketAsync(makePacket(2, 10)));
+
+    QSharedPointer<FileLike> stream = server->recvPacketStream();
+    QVERIFY(!stream.isNull());
+    QCOMPARE(stream->size(), static_cast<qint64>(large.size()));
+    for (int i = 0; i < 5; ++i) {
+        QCOMPARE(serverSub->recvPacket(), makePacket(i, 10));
+    }
+    QCOMPARE(server->recvPacket(), makePacket(2, 10));
+
+    bool ok = true;
+    stream->readall(&ok);
+    QVERIFY(!ok);
+    QVERIFY(!server->isBroken());
+    QVERIFY(!client->isBroken());
 }
+
+
+void TestDataChannel::testVirtualChannel()
+{
+    QSharedPointer<SocketChannel> client, server;
+    QVERIFY(makePair(&client, &server));
+    QSharedPointer<VirtualChannel> clientSub = client->makeChannel();
+    QVERIFY(!clientSub.isNull());
+    QSharedPointer<VirtualChannel> serverSub = server->takeChannel();
+    QVERIFY(!serverSub.isNull());
+    QCOMPARE(serverSub->channelNumber(), clientSub->channelNumber());
+    for (int i = 0; i < 5; ++i) {
+        QVERIFY(clientSub->sendPacket(QByteArray::number(i)));
+    }
+    for (int i = 0; i < 5; ++i) {
+        QCOMPARE(serverSub->recvPacket(), QByteArray::number(i));
+    }
+}
+
+QTEST_MAIN(TestDataChannel)
+#include "test_data_channel.moc"
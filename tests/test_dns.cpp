@@ -0,0 +1,360 @@
+#include <QtTest>
+#include "qtnetworkng.h"
+
+using namespace qtng;
+
+// a tiny authoritative server of the `example.test` zone, for both udp and tcp.
+class DnsResponder
+{
+public:
+    DnsResponder();
+    bool start();
+    quint16 port() const { return udp->localPort(); }
+    int queries(const QByteArray &name) const { return counter.value(name); }
+private:
+    void serveUdp();
+    void serveTcp();
+    QByteArray respond(const QByteArray &request, bool overUdp);
+    static void appendUInt16(QByteArray &packet, quint16 value);
+    static void appendName(QByteArray &packet, const QByteArray &name);
+    static void appendRecord(QByteArray &packet, const QByteArray &name, quint16 type, quint32 ttl,
+                             const QByteArray &rdata);
+private:
+    QSharedPointer<Socket> udp;
+    QSharedPointer<Socket> tcp;
+    QMap<QByteArray, int> counter;
+    CoroutineGroup operations;
+};
+
+DnsResponder::DnsResponder()
+    : udp(new Socket(HostAddress::IPv4Protocol, Socket::UdpSocket))
+    , tcp(new Socket(HostAddress::IPv4Protocol, Socket::TcpSocket))
+{
+}
+
+bool DnsResponder::start()
+{
+    if (!udp->bind(HostAddress::LocalHost, 0) || !tcp->bind(HostAddress::LocalHost, udp->localPort())
+        || !tcp->listen(10)) {
+        return false;
+    }
+    operations.spawn([this] { serveUdp(); });
+    operations.spawn([this] { serveTcp(); });
+    return true;
+}
+
+void DnsResponder::serveUdp()
+{
+    while (true) {
+        HostAddress addr;
+        quint16 port;
+        const QByteArray &request = udp->recvfrom(512, &addr, &port);
+        if (request.isEmpty()) {
+            return;
+        }
+        const QByteArray &response = respond(request, true);
+        if (!response.isEmpty()) {
+            udp->sendto(response, addr, port);
+        }
+    }
+}
+
+void DnsResponder::serveTcp()
+{
+    while (true) {
+        QSharedPointer<Socket> request(tcp->accept());
+        if (request.isNull()) {
+            return;
+        }
+        const QByteArray &header = request->recvall(2);
+        if (header.size() != 2) {
+            continue;
+        }
+        const QByteArray &response = respond(request->recvall((uchar(header[0]) << 8) | uchar(header[1])), false);
+        QByteArray packet;
+        appendUInt16(packet, response.size());
+        request->sendall(packet + response);
+    }
+}
+
+QByteArray DnsResponder::respond(const QByteArray &request, bool overUdp)
+{
+    if (request.size() < 12) {
+        return QByteArray();
+    }
+    // queries from DnsResolver are never compressed.
+    QByteArray name;
+    int offset = 12;
+    while (offset < request.size() && request.at(offset) != 0) {
+        const int len = request.at(offset);
+        if (!name.isEmpty()) {
+            name.append('.');
+        }
+        name.append(request.mid(offset + 1, len));
+        offset += len + 1;
+    }
+    offset += 1;
+    if (offset + 4 > request.size()) {
+        return QByteArray();
+    }
+    const quint16 type = (uchar(request[offset]) << 8) | uchar(request[offset + 1]);
+    const QByteArray question = request.mid(12, offset + 4 - 12);
+    name = name.toLower();
+    counter[name] += 1;
+
+    const HostAddress v4(QString::fromLatin1("10.0.0.1"));
+    const HostAddress v6(QString::fromLatin1("2001:db8::1"));
+    QByteArray ipv4(4, 0);
+    qToBigEndian<quint32>(v4.toIPv4Address(), reinterpret_cast<uchar *>(ipv4.data()));
+    const QByteArray ipv6(reinterpret_cast<const char *>(v6.toIPv6Address().c), 16);
+    const QByteArray wwwName = "www.example.test";
+
+    int rcode = 0;
+    bool truncated = false;
+    int count = 0;
+    QByteArray answers;
+    if (name == "www.example.test") {
+        if (type == 1) {
+            appendRecord(answers, name, 1, 300, ipv4);
+            count = 1;
+        } else if (type == 28) {
+            appendRecord(answers, name, 28, 60, ipv6);
+            count = 1;
+        }
+    } else if (name == "alias.example.test") {
+        QByteArray target;
+        appendName(target, wwwName);
+        appendRecord(answers, name, 5, 30, target);
+        if (type == 1) {
+            appendRecord(answers, wwwName, 1, 300, ipv4);
+        } else {
+            appendRecord(answers, wwwName, 28, 60, ipv6);
+        }
+        count = 2;
+    } else if (name == "short.example.test") {
+        if (type == 1) {
+            appendRecord(answers, name, 1, 1, ipv4);
+            count = 1;
+        }
+    } else if (name == "tcp.example.test") {
+        if (overUdp) {
+            truncated = true;
+        } else if (type == 1) {
+            appendRecord(answers, name, 1, 300, ipv4);
+            count = 1;
+        }
+    } else if (name == "broken.example.test") {
+        rcode = 2;  // SERVFAIL
+    } else {
+        rcode = 3;  // NXDOMAIN
+    }
+
+    QByteArray response = request.left(2);
+    appendUInt16(response, 0x8580 | (truncated ? 0x0200 : 0) | rcode);  // QR, AA, RD, RA
+    appendUInt16(response, 1);
+    appendUInt16(response, count);
+    appendUInt16(response, 0);
+    appendUInt16(response, 0);
+    response.append(question);
+    response.append(answers);
+    return response;
+}
+
+void DnsResponder::appendUInt16(QByteArray &packet, quint16 value)
+{
+    packet.append(static_cast<char>(value >> 8));
+    packet.append(static_cast<char>(value & 0xff));
+}
+
+void DnsResponder::appendName(QByteArray &packet, const QByteArray &name)
+{
+    for (const QByteArray &label : name.split('.')) {
+        packet.append(static_cast<char>(label.size()));
+        packet.append(label);
+    }
+    packet.append('\0');
+}
+
+void DnsResponder::appendRecord(QByteArray &packet, const QByteArray &name, quint16 type, quint32 ttl,
+                                const QByteArray &rdata)
+{
+    appendName(packet, name);
+    appendUInt16(packet, type);
+    appendUInt16(packet, 1);
+    appendUInt16(packet, ttl >> 16);
+    appendUInt16(packet, ttl & 0xffff);
+    appendUInt16(packet, rdata.size());
+    packet.append(rdata);
+}
+
+class TestDns : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void testResolve();
+    void testCname();
+    void testNameError();
+    void testTruncated();
+    void testSearchDomains();
+    void testFailover();
+    void testHosts();
+    void testResolvConf();
+    void testCacheTtl();
+private:
+    QSharedPointer<DnsResolver> makeResolver();
+    QSharedPointer<DnsResponder> responder;
+};
+
+void TestDns::initTestCase()
+{
+    responder.reset(new DnsResponder());
+    QVERIFY(responder->start());
+}
+
+void TestDns::cleanupTestCase()
+{
+    responder.reset();
+}
+
+QSharedPointer<DnsResolver> TestDns::makeResolver()
+{
+    QSharedPointer<DnsResolver> resolver(new DnsResolver(false));
+    resolver->addNameServer(HostAddress::LocalHost, responder->port());
+    resolver->setTimeout(1.0);
+    return resolver;
+}
+
+void TestDns::testResolve()
+{
+    QSharedPointer<DnsResolver> resolver = makeResolver();
+    quint32 ttl = 0;
+    QList<HostAddress> expected;
+    expected << HostAddress(QString::fromLatin1("2001:db8::1")) << HostAddress(QString::fromLatin1("10.0.0.1"));
+    QCOMPARE(resolver->resolve(QString::fromLatin1("www.example.test"),
+                               HostAddress::IPv4Protocol | HostAddress::IPv6Protocol, &ttl),
+             expected);
+    QCOMPARE(ttl, 60u);
+
+    expected.clear();
+    expected << HostAddress(QString::fromLatin1("10.0.0.1"));
+    QCOMPARE(resolver->resolve(QString::fromLatin1("WWW.Example.Test."), HostAddress::IPv4Protocol, &ttl), expected);
+    QCOMPARE(ttl, 300u);
+}
+
+void TestDns::testCname()
+{
+    QSharedPointer<DnsResolver> resolver = makeResolver();
+    quint32 ttl = 0;
+    const QList<HostAddress> &addresses = resolver->resolve(
+            QString::fromLatin1("alias.example.test"), HostAddress::IPv4Protocol | HostAddress::IPv6Protocol, &ttl);
+    QCOMPARE(addresses.size(), 2);
+    QVERIFY(addresses.contains(HostAddress(QString::fromLatin1("10.0.0.1"))));
+    QCOMPARE(ttl, 30u);
+}
+
+void TestDns::testNameError()
+{
+    QSharedPointer<DnsResolver> resolver = makeResolver();
+    QList<HostAddress> addresses;
+    QVERIFY(!resolver->query(QString::fromLatin1("missing.example.test"), HostAddress::IPv4Protocol, &addresses));
+    QVERIFY(addresses.isEmpty());
+    QVERIFY(resolver->resolve(QString::fromLatin1("missing.example.test")).isEmpty());
+
+    // a name without AAAA records is not an error.
+    QVERIFY(resolver->query(QString::fromLatin1("short.example.test"), HostAddress::IPv6Protocol, &addresses));
+    QVERIFY(addresses.isEmpty());
+}
+
+void TestDns::testTruncated()
+{
+    QSharedPointer<DnsResolver> resolver = makeResolver();
+    QList<HostAddress> expected;
+    expected << HostAddress(QString::fromLatin1("10.0.0.1"));
+    QCOMPARE(resolver->resolve(QString::fromLatin1("tcp.example.test"), HostAddress::IPv4Protocol), expected);
+}
+
+void TestDns::testSearchDomains()
+{
+    QSharedPointer<DnsResolver> resolver = makeResolver();
+    resolver->setSearchDomains(QStringList() << QString::fromLatin1("nowhere.test")
+                                             << QString::fromLatin1("example.test"));
+    QCOMPARE(resolver->resolve(QString::fromLatin1("www"), HostAddress::IPv4Protocol).size(), 1);
+    QVERIFY(responder->queries("www.nowhere.test") > 0);
+}
+
+void TestDns::testFailover()
+{
+    // the first server never answers.
+    Socket silent(HostAddress::IPv4Protocol, Socket::UdpSocket);
+    QVERIFY(silent.bind(HostAddress::LocalHost, 0));
+    QSharedPointer<DnsResolver> resolver(new DnsResolver(false));
+    resolver->addNameServer(HostAddress::LocalHost, silent.localPort());
+    resolver->addNameServer(HostAddress::LocalHost, responder->port());
+    resolver->setTimeout(0.2f);
+    resolver->setAttempts(1);
+    QCOMPARE(resolver->resolve(QString::fromLatin1("www.example.test"), HostAddress::IPv4Protocol).size(), 1);
+
+    QList<HostAddress> addresses;
+    // SERVFAIL from all servers.
+    QVERIFY(!resolver->query(QString::fromLatin1("broken.example.test"), HostAddress::IPv4Protocol, &addresses));
+}
+
+void TestDns::testHosts()
+{
+    QTemporaryFile hosts;
+    QVERIFY(hosts.open());
+    hosts.write("# comment\n127.0.0.5  myhost.test  myalias # trailing\n::1 myhost.test\n\nbad line\n");
+    hosts.close();
+
+    QSharedPointer<DnsResolver> resolver = makeResolver();
+    QVERIFY(resolver->loadHosts(hosts.fileName()));
+    QList<HostAddress> expected;
+    expected << HostAddress(QString::fromLatin1("127.0.0.5")) << HostAddress(HostAddress::LocalHostIPv6);
+    QCOMPARE(resolver->resolve(QString::fromLatin1("MyHost.test")), expected);
+    expected.removeLast();
+    QCOMPARE(resolver->resolve(QString::fromLatin1("myalias"), HostAddress::IPv4Protocol), expected);
+    QCOMPARE(responder->queries("myhost.test"), 0);
+}
+
+void TestDns::testResolvConf()
+{
+    QTemporaryFile conf;
+    QVERIFY(conf.open());
+    conf.write("nameserver 127.0.0.1\nnameserver ::1 ; local\ndomain a.test\nsearch b.test c.test\n"
+               "options ndots:2 timeout:3 attempts:4 rotate\n");
+    conf.close();
+
+    DnsResolver resolver(false);
+    QVERIFY(resolver.loadResolvConf(conf.fileName()));
+    QCOMPARE(resolver.nameServers().size(), 2);
+    QCOMPARE(resolver.nameServers().at(1).first, HostAddress(HostAddress::LocalHostIPv6));
+    QCOMPARE(resolver.nameServers().at(1).second, static_cast<quint16>(53));
+    QCOMPARE(resolver.searchDomains(), QStringList() << QString::fromLatin1("b.test") << QString::fromLatin1("c.test"));
+    QCOMPARE(resolver.ndots(), 2);
+    QCOMPARE(resolver.timeout(), 3.0f);
+    QCOMPARE(resolver.attempts(), 4);
+    QVERIFY(!resolver.loadResolvConf(QString::fromLatin1("/nonexistent/resolv.conf")));
+}
+
+void TestDns::testCacheTtl()
+{
+    QSharedPointer<SocketDnsCache> cache(new SocketDnsCache());
+    cache->setResolver(makeResolver());
+    const QString name = QString::fromLatin1("short.example.test");
+    const int before = responder->queries("short.example.test");
+    QCOMPARE(cache->resolve(name).size(), 1);
+    const int once = responder->queries("short.example.test");
+    QVERIFY(once > before);
+    QCOMPARE(cache->resolve(name).size(), 1);
+    QCOMPARE(responder->queries("short.example.test"), once);
+
+    // the A record has a ttl of 1 second.
+    Coroutine::msleep(1100);
+    QCOMPARE(cache->resolve(name).size(), 1);
+    QVERIFY(responder->queries("short.example.test") > once);
+}
+
+QTEST_MAIN(TestDns)
+#include "test_dns.moc"
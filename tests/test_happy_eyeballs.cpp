@@ -0,0 +1,85 @@
+#include <QtTest>
+#include "qtnetworkng.h"
+
+using namespace qtng;
+
+class TestHappyEyeballs: public QObject
+{
+    Q_OBJECT
+private slots:
+    void testInterleave();
+    void testDroppingAddress();
+    void testSequential();
+};
+
+
+void TestHappyEyeballs::testInterleave()
+{
+    const HostAddress v6a(QString::fromLatin1("2001:db8::1"));
+    const HostAddress v6b(QString::fromLatin1("2001:db8::2"));
+    const HostAddress v4a(QString::fromLatin1("192.0.2.1"));
+    const HostAddress v4b(QString::fromLatin1("192.0.2.2"));
+    const HostAddress v4c(QString::fromLatin1("192.0.2.3"));
+
+    QList<HostAddress> addresses;
+    addresses << v6a << v6b << v4a << v4b << v4c;
+    QList<HostAddress> expected;
+    expected << v6a << v4a << v6b << v4b << v4c;
+    QCOMPARE(interleaveAddresses(addresses, HostAddress::IPv4Protocol | HostAddress::IPv6Protocol), expected);
+
+    addresses.clear();
+    addresses << v4a << v6a << v6b;
+    expected.clear();
+    expected << v4a << v6a << v6b;
+    QCOMPARE(interleaveAddresses(addresses, HostAddress::IPv4Protocol | HostAddress::IPv6Protocol), expected);
+
+    expected.clear();
+    expected << v6a << v6b;
+    QCOMPARE(interleaveAddresses(addresses, HostAddress::IPv6Protocol), expected);
+}
+
+
+void TestHappyEyeballs::testDroppingAddress()
+{
+    QScopedPointer<Socket> server(Socket::createServer(HostAddress::LocalHost, 0));
+    QVERIFY(!server.isNull());
+
+    // 100::/64 is a discard prefix (RFC 6666), and 192.0.2.0/24 is reserved for documentation (RFC 5737).
+    // connecting to them either drops silently or fails.
+    QList<HostAddress> addresses;
+    addresses << HostAddress(QString::fromLatin1("100::1")) << HostAddress(QString::fromLatin1("192.0.2.1"))
+              << HostAddress(QString::fromLatin1("100::2")) << HostAddress(HostAddress::LocalHost);
+    QSharedPointer<SocketDnsCache> dnsCache(new SocketDnsCache());
+    dnsCache->addHost(QString::fromLatin1("happy-eyeballs.test"), addresses);
+
+    QElapsedTimer timer;
+    timer.start();
+    Socket::SocketError error = Socket::UnknownSocketError;
+    QScopedPointer<Socket> client(Socket::createConnection(QString::fromLatin1("happy-eyeballs.test"),
+                                                           server->localPort(), &error, dnsCache));
+    QVERIFY(!client.isNull());
+    QCOMPARE(error, Socket::NoError);
+    QCOMPARE(client->peerAddress(), HostAddress(HostAddress::LocalHost));
+    QVERIFY(timer.elapsed() < 3000);
+}
+
+
+void TestHappyEyeballs::testSequential()
+{
+    QScopedPointer<Socket> server(Socket::createServer(HostAddress::LocalHost, 0));
+    QVERIFY(!server.isNull());
+
+    float oldDelay = Socket::connectionAttemptDelay();
+    Socket::setConnectionAttemptDelay(0);
+    QSharedPointer<SocketDnsCache> dnsCache(new SocketDnsCache());
+    dnsCache->addHost(QString::fromLatin1("sequential.test"), HostAddress(HostAddress::LocalHost));
+    Socket::SocketError error = Socket::UnknownSocketError;
+    QScopedPointer<Socket> client(Socket::createConnection(QString::fromLatin1("sequential.test"),
+                                                           server->localPort(), &error, dnsCache));
+    Socket::setConnectionAttemptDelay(oldDelay);
+    QVERIFY(!client.isNull());
+    QCOMPARE(error, Socket::NoError);
+}
+
+QTEST_MAIN(TestHappyEyeballs)
+#include "test_happy_eyeballs.moc"
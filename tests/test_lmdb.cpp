@@ -0,0 +1,511 @@
+#include <QtTest>
+#include "qtnetworkng.h"
+
+using namespace qtng;
+
+class TestLmdb: public QObject
+{
+    Q_OBJECT
+private slots:
+    void testConcurrentReaders();
+    void testWriterSerialization();
+    void testGroupCommit_data();
+    void testGroupCommit();
+    void testFailingSubmission_data();
+    void testFailingSubmission();
+    void testDeleteWhileCommitting();
+    void testGetMany();
+    void testForEach();
+    void testForEachPrefix();
+    void testAppend();
+    void testValueViewLifetime();
+};
+
+
+static QSharedPointer<Lmdb> openLmdb(const QTemporaryDir &dir, bool writeMap = false)
+{
+    return Lmdb::Builder(dir.filePath(QString::fromLatin1("test.db"))).writeMap(writeMap).create();
+}
+
+
+static int readCounter(QSharedPointer<Lmdb> lmdb)
+{
+    QSharedPointer<const Transaction> txn = lmdb->toRead();
+    if (txn.isNull()) {
+        return -1;
+    }
+    return txn->db(QString::fromLatin1("counter")).value("n").toInt();
+}
+
+
+class ReaderThread : public QThread
+{
+public:
+    ReaderThread(QSharedPointer<Lmdb> lmdb)
+        : lmdb(lmdb)
+        , errors(0)
+    {
+    }
+    virtual void run() override
+    {
+        for (int i = 0; i < 100; ++i) {
+            QSharedPointer<const Transaction> txn = lmdb->toRead();
+            if (txn.isNull()) {
+                ++errors;
+                continue;
+            }
+            const Database &db = txn->db(QString::fromLatin1("data"));
+            for (int j = 0; j < 100; ++j) {
+                if (db.value(QByteArray::number(j)) != QByteArray::number(j * j)) {
+                    ++errors;
+                }
+            }
+        }
+    }
+    QSharedPointer<Lmdb> lmdb;
+    int errors;
+};
+
+
+void TestLmdb::testConcurrentReaders()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QSharedPointer<Lmdb> lmdb = openLmdb(dir);
+    QVERIFY(!lmdb.isNull());
+    {
+        QSharedPointer<Transaction> txn = lmdb->toWrite();
+        QVERIFY(!txn.isNull());
+        Database &db = txn->db(QString::fromLatin1("data"));
+        for (int i = 0; i < 100; ++i) {
+            QVERIFY(!db.insert(QByteArray::number(i), QByteArray::number(i * i)).isEnd());
+        }
+        QVERIFY(txn->commit());
+    }
+
+    // the readers of other threads do not block each other.
+    QList<QSharedPointer<ReaderThread>> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.append(QSharedPointer<ReaderThread>::create(lmdb));
+        threads.last()->start();
+    }
+
+    // more coroutines than the idle readers hold read transactions at the same time.
+    QSharedPointer<int> errors(new int(0));
+    CoroutineGroup operations;
+    for (int i = 0; i < 200; ++i) {
+        operations.spawn([lmdb, errors, i] {
+            QSharedPointer<const Transaction> txn = lmdb->toRead();
+            if (txn.isNull()) {
+                ++*errors;
+                return;
+            }
+            const Database &db = txn->db(QString::fromLatin1("data"));
+            Coroutine::msleep(10);
+            if (db.value(QByteArray::number(i % 100)) != QByteArray::number((i % 100) * (i % 100))) {
+                ++*errors;
+            }
+        });
+    }
+    operations.joinall();
+    QCOMPARE(*errors, 0);
+
+    for (QSharedPointer<ReaderThread> thread : threads) {
+        QVERIFY(thread->wait(10 * 1000));
+        QCOMPARE(thread->errors, 0);
+    }
+
+    // the reader sees the snapshot when it began.
+    QSharedPointer<const Transaction> reader = lmdb->toRead();
+    QSharedPointer<Transaction> writer = lmdb->toWrite();
+    writer->db(QString::fromLatin1("data")).insert("0", "changed");
+    QVERIFY(writer->commit());
+    QCOMPARE(reader->db(QString::fromLatin1("data")).value("0"), QByteArray("0"));
+    QCOMPARE(lmdb->toRead()->db(QString::fromLatin1("data")).value("0"), QByteArray("changed"));
+}
+
+
+class WriterThread : public QThread
+{
+public:
+    WriterThread(QSharedPointer<Lmdb> lmdb)
+        : lmdb(lmdb)
+    {
+    }
+    virtual void run() override
+    {
+        for (int i = 0; i < 10; ++i) {
+            QSharedPointer<Transaction> txn = lmdb->toWrite();
+            if (txn.isNull()) {
+                continue;
+            }
+            Database &db = txn->db(QString::fromLatin1("counter"));
+            db.insert("n", QByteArray::number(db.value("n").toInt() + 1));
+            txn->commit();
+        }
+    }
+    QSharedPointer<Lmdb> lmdb;
+};
+
+
+// the coroutines of one thread wait for the write transaction in turn, instead of deadlocking at the writer mutex.
+void TestLmdb::testWriterSerialization()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QSharedPointer<Lmdb> lmdb = openLmdb(dir);
+    QVERIFY(!lmdb.isNull());
+
+    WriterThread thread(lmdb);
+    thread.start();
+
+    QSharedPointer<int> active(new int(0));
+    QSharedPointer<int> maxActive(new int(0));
+    CoroutineGroup operations;
+    for (int i = 0; i < 20; ++i) {
+        operations.spawn([lmdb, active, maxActive] {
+            QSharedPointer<Transaction> txn = lmdb->toWrite();
+            if (txn.isNull()) {
+                return;
+            }
+            ++*active;
+            *maxActive = qMax(*maxActive, *active);
+            Database &db = txn->db(QString::fromLatin1("counter"));
+            const int n = db.value("n").toInt();
+            Coroutine::msleep(1);  // the others run while this one holds the transaction.
+            db.insert("n", QByteArray::number(n + 1));
+            --*active;
+            txn->commit();
+        });
+    }
+    operations.joinall();
+    QVERIFY(thread.wait(10 * 1000));
+    QCOMPARE(*maxActive, 1);
+    QCOMPARE(readCounter(lmdb), 30);
+}
+
+
+void TestLmdb::testGroupCommit_data()
+{
+    QTest::addColumn<bool>("writeMap");
+    QTest::newRow("nested") << false;
+    QTest::newRow("writemap") << true;
+}
+
+
+void TestLmdb::testGroupCommit()
+{
+    QFETCH(bool, writeMap);
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QSharedPointer<Lmdb> lmdb = openLmdb(dir, writeMap);
+    QVERIFY(!lmdb.isNull());
+
+    QSharedPointer<QList<bool>> results(new QList<bool>());
+    CoroutineGroup operations;
+    for (int i = 0; i < 50; ++i) {
+        operations.spawn([lmdb, results, i] {
+            QMap<QByteArray, QByteArray> items;
+            items.insert(QByteArray::number(i), QByteArray::number(i * 2));
+            results->append(lmdb->submit(QString::fromLatin1("data"), items));
+        });
+    }
+    operations.joinall();
+    QCOMPARE(results->size(), 50);
+    QVERIFY(!results->contains(false));
+
+    QSharedPointer<const Transaction> txn = lmdb->toRead();
+    const Database &db = txn->db(QString::fromLatin1("data"));
+    QCOMPARE(db.size(), static_cast<qint64>(50));
+    for (int i = 0; i < 50; ++i) {
+        QCOMPARE(db.value(QByteArray::number(i)), QByteArray::number(i * 2));
+    }
+}
+
+
+void TestLmdb::testFailingSubmission_data()
+{
+    QTest::addColumn<bool>("writeMap");
+    QTest::newRow("nested") << false;
+    QTest::newRow("writemap") << true;
+}
+
+
+// the changes of the failed function are rolled back, and the others in the same batch are committed.
+void TestLmdb::testFailingSubmission()
+{
+    QFETCH(bool, writeMap);
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QSharedPointer<Lmdb> lmdb = openLmdb(dir, writeMap);
+    QVERIFY(!lmdb.isNull());
+
+    QSharedPointer<QMap<int, bool>> results(new QMap<int, bool>());
+    CoroutineGroup operations;
+    for (int i = 0; i < 10; ++i) {
+        operations.spawn([lmdb, results, i] {
+            const bool ok = lmdb->submit([i](Transaction &txn) -> bool {
+                Database &db = txn.db(QString::fromLatin1("data"));
+                db.insert(QByteArray::number(i), "value");
+                return i != 3 && i != 7;
+            });
+            results->insert(i, ok);
+        });
+    }
+    operations.joinall();
+
+    QCOMPARE(results->size(), 10);
+    QSharedPointer<const Transaction> txn = lmdb->toRead();
+    const Database &db = txn->db(QString::fromLatin1("data"));
+    for (int i = 0; i < 10; ++i) {
+        const bool expected = i != 3 && i != 7;
+        QCOMPARE(results->value(i), expected);
+        QCOMPARE(db.contains(QByteArray::number(i)), expected);
+    }
+}
+
+
+// the last reference of Lmdb is dropped by a submitter while the writer coroutine is still running.
+void TestLmdb::testDeleteWhileCommitting()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QSharedPointer<Lmdb> lmdb = openLmdb(dir);
+    QVERIFY(!lmdb.isNull());
+
+    QSharedPointer<int> done(new int(0));
+    CoroutineGroup operations;
+    for (int i = 0; i < 5; ++i) {
+        operations.spawn([lmdb, done, i] {
+            QMap<QByteArray, QByteArray> items;
+            items.insert(QByteArray::number(i), "value");
+            if (lmdb->submit(QString::fromLatin1("data"), items)) {
+                ++*done;
+            }
+        });
+    }
+    QMap<QByteArray, QByteArray> items;
+    items.insert("last", "value");
+    QVERIFY(lmdb->submit(QString::fromLatin1("data"), items));
+    lmdb.clear();
+    operations.joinall();
+    Coroutine::msleep(10);  // the writer finishes and deletes the Lmdb.
+    QCOMPARE(*done, 5);
+
+    lmdb = openLmdb(dir);
+    QVERIFY(!lmdb.isNull());
+    QCOMPARE(lmdb->toRead()->db(QString::fromLatin1("data")).size(), static_cast<qint64>(6));
+}
+
+
+
+static void insertNumbers(QSharedPointer<Lmdb> lmdb, int count)
+{
+    QSharedPointer<Transaction> txn = lmdb->toWrite();
+    Database &db = txn->db(QString::fromLatin1("data"));
+    for (int i = 0; i < count; ++i) {
+        db.insert(QByteArray::number(i).rightJustified(3, '0'), QByteArray::number(i * i));
+    }
+    txn->commit();
+}
+
+
+void TestLmdb::testGetMany()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QSharedPointer<Lmdb> lmdb = openLmdb(dir);
+    QVERIFY(!lmdb.isNull());
+    insertNumbers(lmdb, 10);
+
+    // the keys are not sorted, and some of them are missing.
+    const QList<QByteArray> keys = QList<QByteArray>() << "007" << "missing" << "002" << "005" << "" << "002";
+    QSharedPointer<const Transaction> reader = lmdb->toRead();
+    const QMap<QByteArray, LmdbValueView> &result = reader->db(QString::fromLatin1("data")).getMany(keys);
+    QCOMPARE(result.size(), 3);
+    QCOMPARE(result.value("002").toByteArray(), QByteArray("4"));
+    QCOMPARE(result.value("005").toByteArray(), QByteArray("25"));
+    QCOMPARE(result.value("007").toByteArray(), QByteArray("49"));
+    QVERIFY(!result.contains("missing"));
+
+    // the write transaction returns copies.
+    QSharedPointer<Transaction> writer = lmdb->toWrite();
+    Database &db = writer->db(QString::fromLatin1("data"));
+    const QMap<QByteArray, LmdbValueView> &copies = db.getMany(keys);
+    db.insert("002", "changed");
+    QCOMPARE(copies.size(), 3);
+    QVERIFY(copies.value("002") == QByteArray("4"));
+    QVERIFY(db.valueView("002") == QByteArray("changed"));
+    QVERIFY(writer->commit());
+}
+
+
+void TestLmdb::testForEach()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QSharedPointer<Lmdb> lmdb = openLmdb(dir);
+    QVERIFY(!lmdb.isNull());
+    insertNumbers(lmdb, 20);
+
+    QSharedPointer<const Transaction> reader = lmdb->toRead();
+    const Database &db = reader->db(QString::fromLatin1("data"));
+    QList<QByteArray> keys;
+    QList<QByteArray> values;
+    Database::Visitor collect = [&keys, &values](const QByteArray &key, const QByteArray &value) -> bool {
+        keys.append(QByteArray(key.constData(), key.size()));
+        values.append(QByteArray(value.constData(), value.size()));
+        return true;
+    };
+
+    // [from, to)
+    QCOMPARE(db.forEach("005", "009", collect), static_cast<qint64>(4));
+    QCOMPARE(keys, QList<QByteArray>() << "005" << "006" << "007" << "008");
+    QCOMPARE(values, QList<QByteArray>() << "25" << "36" << "49" << "64");
+
+    // the empty bounds are the first and the last item. `from` does not need to exist.
+    keys.clear();
+    values.clear();
+    QCOMPARE(db.forEach(QByteArray(), "002", collect), static_cast<qint64>(2));
+    QCOMPARE(keys, QList<QByteArray>() << "000" << "001");
+    keys.clear();
+    values.clear();
+    QCOMPARE(db.forEach("0175", QByteArray(), collect), static_cast<qint64>(2));
+    QCOMPARE(keys, QList<QByteArray>() << "018" << "019");
+    keys.clear();
+    values.clear();
+    QCOMPARE(db.forEach("100", QByteArray(), collect), static_cast<qint64>(0));
+    QVERIFY(keys.isEmpty());
+
+    // stops at the item the visitor returns false.
+    keys.clear();
+    QCOMPARE(db.forEach(QByteArray(), QByteArray(), [&keys](const QByteArray &key, const QByteArray &) -> bool {
+        keys.append(QByteArray(key.constData(), key.size()));
+        return keys.size() < 3;
+    }), static_cast<qint64>(3));
+    QCOMPARE(keys, QList<QByteArray>() << "000" << "001" << "002");
+}
+
+
+void TestLmdb::testForEachPrefix()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QSharedPointer<Lmdb> lmdb = openLmdb(dir);
+    QVERIFY(!lmdb.isNull());
+    {
+        QSharedPointer<Transaction> txn = lmdb->toWrite();
+        Database &db = txn->db(QString::fromLatin1("data"));
+        db.insert("app", "0");
+        db.insert("apple", "1");
+        db.insert("apple:pie", "2");
+        db.insert("apples", "3");
+        db.insert("applf", "4");
+        db.insert("banana", "5");
+        QVERIFY(txn->commit());
+    }
+
+    QSharedPointer<const Transaction> reader = lmdb->toRead();
+    const Database &db = reader->db(QString::fromLatin1("data"));
+    QList<QByteArray> keys;
+    Database::Visitor collect = [&keys](const QByteArray &key, const QByteArray &) -> bool {
+        keys.append(QByteArray(key.constData(), key.size()));
+        return true;
+    };
+    QCOMPARE(db.forEachPrefix("apple", collect), static_cast<qint64>(3));
+    QCOMPARE(keys, QList<QByteArray>() << "apple" << "apple:pie" << "apples");
+    keys.clear();
+    QCOMPARE(db.forEachPrefix("cherry", collect), static_cast<qint64>(0));
+    QVERIFY(keys.isEmpty());
+    keys.clear();
+    QCOMPARE(db.forEachPrefix("b", collect), static_cast<qint64>(1));
+    QCOMPARE(keys, QList<QByteArray>() << "banana");
+}
+
+
+void TestLmdb::testAppend()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QSharedPointer<Lmdb> lmdb = openLmdb(dir);
+    QVERIFY(!lmdb.isNull());
+
+    QList<QPair<QByteArray, QByteArray>> items;
+    for (int i = 0; i < 1000; ++i) {
+        items.append(qMakePair(QByteArray::number(i).rightJustified(4, '0'), QByteArray::number(i)));
+    }
+    {
+        QSharedPointer<Transaction> txn = lmdb->toWrite();
+        QCOMPARE(txn->db(QString::fromLatin1("data")).append(items), static_cast<qint64>(1000));
+        QVERIFY(txn->commit());
+    }
+    {
+        QSharedPointer<const Transaction> reader = lmdb->toRead();
+        const Database &db = reader->db(QString::fromLatin1("data"));
+        QCOMPARE(db.size(), static_cast<qint64>(1000));
+        QCOMPARE(db.value("0000"), QByteArray("0"));
+        QCOMPARE(db.value("0999"), QByteArray("999"));
+    }
+
+    // the keys must be greater than the last one in the database.
+    {
+        QSharedPointer<Transaction> txn = lmdb->toWrite();
+        Database &db = txn->db(QString::fromLatin1("data"));
+        QList<QPair<QByteArray, QByteArray>> lower;
+        lower.append(qMakePair(QByteArray("0500"), QByteArray("changed")));
+        QCOMPARE(db.append(lower), static_cast<qint64>(-1));
+        QList<QPair<QByteArray, QByteArray>> unsorted;
+        unsorted.append(qMakePair(QByteArray("2000"), QByteArray("a")));
+        unsorted.append(qMakePair(QByteArray("1500"), QByteArray("b")));
+        QCOMPARE(db.append(unsorted), static_cast<qint64>(-1));
+        txn->abort();
+    }
+
+    QSharedPointer<const Transaction> reader = lmdb->toRead();
+    const Database &db = reader->db(QString::fromLatin1("data"));
+    QCOMPARE(db.value("0500"), QByteArray("500"));
+    QVERIFY(!db.contains("2000"));
+}
+
+
+// the view keeps its read transaction, so the page it refers to is not reused by the later writers.
+void TestLmdb::testValueViewLifetime()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QSharedPointer<Lmdb> lmdb = openLmdb(dir);
+    QVERIFY(!lmdb.isNull());
+    insertNumbers(lmdb, 10);
+
+    LmdbValueView view;
+    QMap<QByteArray, LmdbValueView> views;
+    {
+        QSharedPointer<const Transaction> reader = lmdb->toRead();
+        const Database &db = reader->db(QString::fromLatin1("data"));
+        view = db.valueView("003");
+        views = db.getMany(QList<QByteArray>() << "004" << "005");
+    }
+    QVERIFY(view == QByteArray("9"));
+
+    // overwrite the values many times, so the freed pages would be reused if the view did not pin them.
+    for (int i = 0; i < 10; ++i) {
+        QSharedPointer<Transaction> writer = lmdb->toWrite();
+        Database &db = writer->db(QString::fromLatin1("data"));
+        db.insert("003", QByteArray(100, static_cast<char>('a' + i)));
+        db.insert("004", QByteArray(100, static_cast<char>('a' + i)));
+        QVERIFY(writer->commit());
+    }
+    QCOMPARE(view.toByteArray(), QByteArray("9"));
+    QCOMPARE(views.value("004").toByteArray(), QByteArray("16"));
+    QCOMPARE(views.value("005").toByteArray(), QByteArray("25"));
+    QCOMPARE(lmdb->toRead()->db(QString::fromLatin1("data")).value("003"), QByteArray(100, 'j'));
+
+    // the view outlives the Lmdb.
+    lmdb.clear();
+    QCOMPARE(view.toByteArray(), QByteArray("9"));
+    view = LmdbValueView();
+    views.clear();
+}
+
+QTEST_MAIN(TestLmdb)
+#include "test_lmdb.moc"
@@ -21,8 +21,53 @@ private slots:
     void testString();
     void testByteArray();
     void testDateTime();
+    void testDirectBuffer();
+    void testFields();
+    void testMapFields();
+    void testVersionedFields();
+    void testView();
+    void testTruncatedExt();
+    void testSkipDeepNesting();
+    void testDecoder();
+    void testDecoderLimit();
+    void testNeverUsed();
 };
 
+struct Point
+{
+    qint32 x = 0;
+    qint32 y = 0;
+    QString name;
+};
+QTNG_MSGPACK_FIELDS(Point, x, y, name)
+
+struct OldPoint
+{
+    qint32 x = 0;
+};
+QTNG_MSGPACK_FIELDS(OldPoint, x)
+
+struct NamedPoint
+{
+    qint32 x = 0;
+    qint32 y = -1;
+    QString name;
+};
+QTNG_MSGPACK_MAP_FIELDS(NamedPoint, x, y, name)
+
+struct PointV1
+{
+    qint32 x = 0;
+};
+QTNG_MSGPACK_VERSIONED_FIELDS(PointV1, 1, x)
+
+struct PointV2
+{
+    qint32 x = 0;
+    qint32 y = 0;
+};
+QTNG_MSGPACK_VERSIONED_FIELDS(PointV2, 2, x, y)
+
 
 void TestMsgPack::testUInt8()
 {
@@ -364,5 +409,367 @@ void TestMsgPack::testDateTime()
     QCOMPARE(dt, t);
 }
 
+void TestMsgPack::testDirectBuffer()
+{
+    QVariantMap m;
+    m.insert("id", 12345);
+    m.insert("method", QString::fromLatin1("echo"));
+    m.insert("params", QVariantList() << 1 << QString::fromLatin1("fish") << QByteArray(300, 'x'));
+
+    QByteArray direct;
+    MsgPackStream os(&direct, QIODevice::WriteOnly);
+    QVERIFY(os.device() == nullptr);
+    os << m;
+    QVERIFY(os.status() == MsgPackStream::Ok);
+
+    QByteArray buffered;
+    QBuffer buf(&buffered);
+    buf.open(QIODevice::WriteOnly);
+    MsgPackStream bos(&buf);
+    bos << m;
+    QVERIFY(bos.status() == MsgPackStream::Ok);
+    QCOMPARE(direct, buffered);
+
+    MsgPackStream is(direct);
+    QVariant v;
+    is >> v;
+    QVERIFY(is.status() == MsgPackStream::Ok);
+    QVERIFY(is.atEnd());
+    QCOMPARE(v.toMap(), m);
+    is >> v;
+    QVERIFY(is.status() == MsgPackStream::ReadPastEnd);
+
+    // append to and overwrite the existing data, the same as QBuffer.
+    QByteArray bs;
+    MsgPackStream first(&bs, QIODevice::WriteOnly);
+    first << static_cast<quint8>(1) << static_cast<quint8>(2);
+    MsgPackStream second(&bs, QIODevice::Append);
+    second << static_cast<quint8>(3);
+    QCOMPARE(bs, QByteArray("\x01\x02\x03"));
+    MsgPackStream third(&bs, QIODevice::WriteOnly);
+    third << static_cast<quint8>(4);
+    QCOMPARE(bs, QByteArray("\x04\x02\x03"));
+}
+
+void TestMsgPack::testFields()
+{
+    Point p;
+    p.x = 1;
+    p.y = -2;
+    p.name = QString::fromLatin1("fish");
+    QList<Point> points;
+    points << p << p;
+    QByteArray bs;
+    MsgPackStream os(&bs, QIODevice::WriteOnly);
+    os << points;
+    QVERIFY(os.status() == MsgPackStream::Ok);
+
+    QByteArray expected;
+    MsgPackStream es(&expected, QIODevice::WriteOnly);
+    es.writeArrayHeader(2);
+    for (int i = 0; i < 2; ++i) {
+        es.writeArrayHeader(3);
+        es << p.x << p.y << p.name;
+    }
+    QCOMPARE(bs, expected);
+
+    MsgPackStream is(bs);
+    QList<Point> t;
+    is >> t;
+    QVERIFY(is.status() == MsgPackStream::Ok);
+    QCOMPARE(t.size(), 2);
+    QCOMPARE(t[1].x, 1);
+    QCOMPARE(t[1].y, -2);
+    QCOMPARE(t[1].name, QString::fromLatin1("fish"));
+
+    // the extra fields are skipped, and the missing fields keep default values.
+    MsgPackStream ois(bs);
+    QList<OldPoint> old;
+    ois >> old;
+    QVERIFY(ois.status() == MsgPackStream::Ok);
+    QCOMPARE(old.size(), 2);
+    QCOMPARE(old[1].x, 1);
+    OldPoint o;
+    o.x = 3;
+    QByteArray obs;
+    MsgPackStream oos(&obs, QIODevice::WriteOnly);
+    oos << o;
+    MsgPackStream nis(obs);
+    Point n;
+    nis >> n;
+    QVERIFY(nis.status() == MsgPackStream::Ok);
+    QCOMPARE(n.x, 3);
+    QCOMPARE(n.y, 0);
+}
+
+void TestMsgPack::testMapFields()
+{
+    NamedPoint p;
+    p.x = 1;
+    p.y = 2;
+    p.name = QString::fromLatin1("fish");
+    QByteArray bs;
+    MsgPackStream os(&bs, QIODevice::WriteOnly);
+    os << p;
+    QVERIFY(os.status() == MsgPackStream::Ok);
+    MsgPackStream vs(bs);
+    QVariant v;
+    vs >> v;
+    QVariantMap m = v.toMap();
+    QCOMPARE(m.size(), 3);
+    QCOMPARE(m.value(QString::fromLatin1("x")).toInt(), 1);
+    QCOMPARE(m.value(QString::fromLatin1("y")).toInt(), 2);
+    QCOMPARE(m.value(QString::fromLatin1("name")).toString(), QString::fromLatin1("fish"));
+
+    // unknown keys are skipped.
+    m.remove(QString::fromLatin1("y"));
+    m.insert(QString::fromLatin1("extra"), QVariantList() << 1 << QByteArray("x") << QVariantMap());
+    QByteArray ms;
+    MsgPackStream mos(&ms, QIODevice::WriteOnly);
+    mos << m;
+    MsgPackStream is(ms);
+    NamedPoint t;
+    is >> t;
+    QVERIFY(is.status() == MsgPackStream::Ok);
+    QVERIFY(is.atEnd());
+    QCOMPARE(t.x, 1);
+    QCOMPARE(t.y, -1);
+    QCOMPARE(t.name, QString::fromLatin1("fish"));
+}
+
+void TestMsgPack::testVersionedFields()
+{
+    PointV1 p1;
+    p1.x = 5;
+    QByteArray bs1;
+    MsgPackStream os1(&bs1, QIODevice::WriteOnly);
+    os1 << p1;
+    MsgPackStream is1(bs1);
+    PointV2 p2;
+    is1 >> p2;
+    QVERIFY(is1.status() == MsgPackStream::Ok);
+    QCOMPARE(p2.x, 5);
+    QCOMPARE(p2.y, 0);
+
+    QByteArray bs2;
+    MsgPackStream os2(&bs2, QIODevice::WriteOnly);
+    os2 << p2;
+    MsgPackStream is2(bs2);
+    PointV1 t;
+    is2 >> t;
+    QVERIFY(is2.status() == MsgPackStream::ReadCorruptData);
+}
+
+void TestMsgPack::testView()
+{
+    QVariantMap inner;
+    inner.insert(QString::fromLatin1("b"), QByteArray("xyz"));
+    QVariantList list;
+    list << 1 << -300 << 1.5 << inner;
+    QVariantMap m;
+    m.insert(QString::fromLatin1("a"), list);
+    m.insert(QString::fromLatin1("c"), QString::fromLatin1("fish"));
+    m.insert(QString::fromLatin1("d"), QVariant());
+    m.insert(QString::fromLatin1("e"), true);
+    QByteArray bs;
+    MsgPackStream os(&bs, QIODevice::WriteOnly);
+    os << m;
+
+    MsgPackView view(bs);
+    QCOMPARE(view.type(), MsgPackView::Map);
+    QCOMPARE(view.size(), 4u);
+    QCOMPARE(view["a"].type(), MsgPackView::Array);
+    QCOMPARE(view["a"].size(), 4u);
+    QCOMPARE(view["a"][0].toInt(), 1);
+    QCOMPARE(view["a"][1].toInt64(), Q_INT64_C(-300));
+    QCOMPARE(view["a"][2].toDouble(), 1.5);
+    QCOMPARE(view["a"][3]["b"].type(), MsgPackView::Binary);
+    QCOMPARE(view["a"][3]["b"].toByteArray(), QByteArray("xyz"));
+    QCOMPARE(view[QString::fromLatin1("c")].toString(), QString::fromLatin1("fish"));
+    QVERIFY(view["d"].isNil());
+    QVERIFY(view["e"].toBool());
+    QVERIFY(!view["f"].isValid());
+    QVERIFY(!view["a"][4].isValid());
+    QVERIFY(!view["a"][0]["b"].isValid());
+    QVERIFY(view.contains("c"));
+
+    // the slices point to the backing buffer.
+    const QByteArray c = view["c"].toByteArray();
+    QVERIFY(c.constData() >= bs.constData() && c.constData() < bs.constData() + bs.size());
+    QByteArray encodedList;
+    MsgPackStream ls(&encodedList, QIODevice::WriteOnly);
+    ls << list;
+    QCOMPARE(view["a"].raw(), encodedList);
+    QCOMPARE(view["a"].toVariant().toList().size(), 4);
+    QCOMPARE(view.toVariant().toMap().size(), 4);
+
+    QStringList keys;
+    for (MsgPackView::const_iterator itor = view.begin(); itor != view.end(); ++itor) {
+        keys.append(itor.key().toString());
+    }
+    QCOMPARE(keys.size(), 4);
+    QVERIFY(keys.contains(QString::fromLatin1("a")));
+    QVERIFY(keys.contains(QString::fromLatin1("e")));
+    int sum = 0;
+    int count = 0;
+    for (const MsgPackView &e : view["a"]) {
+        sum += e.toInt();
+        ++count;
+    }
+    QCOMPARE(count, 4);
+    QCOMPARE(sum, 1 - 300);
+
+    // the iterators of different containers are not equal even if they have the same number of elements left.
+    const MsgPackView &a = view["a"];
+    MsgPackView::const_iterator second = a.begin();
+    ++second;
+    QVERIFY(second != a.begin());
+    QVERIFY(a.begin() != view.begin());
+    QVERIFY(view.begin() == view.begin());
+    const MsgPackView empty(QByteArray("\x90", 1));
+    QVERIFY(empty.begin() == empty.end());
+
+    // truncated data gives invalid views instead of reading beyond the buffer.
+    MsgPackView truncated(bs.left(bs.size() - 1));
+    QCOMPARE(truncated.type(), MsgPackView::Map);
+    QVERIFY(truncated.raw().isEmpty());
+    QVERIFY(!MsgPackView(QByteArray()).isValid());
+}
+
+void TestMsgPack::testTruncatedExt()
+{
+    // fixext4: the type byte and four bytes of payload.
+    const QByteArray full("\xd6\x01abcd", 6);
+    QCOMPARE(MsgPackView(full).type(), MsgPackView::Extension);
+    QCOMPARE(MsgPackView(full).extType(), static_cast<quint8>(1));
+    for (int i = 1; i < full.size(); ++i) {
+        QVERIFY2(!MsgPackView(full.left(i)).isValid(), qPrintable(QString::number(i)));
+        // the header is checked before the payload inside containers too.
+        const QByteArray &array = QByteArray("\x91", 1) + full.left(i);
+        QVERIFY(MsgPackView(array).raw().isEmpty());
+        QVERIFY(!MsgPackView(array)[0].isValid());
+    }
+    QCOMPARE(MsgPackView(QByteArray("\x91", 1) + full)[0].extType(), static_cast<quint8>(1));
+
+    MsgPackDecoder decoder;
+    QVERIFY(decoder.feed(full.left(1)));
+    QCOMPARE(decoder.packetCount(), 0);
+    QVERIFY(decoder.feed(full.mid(1, 2)));
+    QCOMPARE(decoder.packetCount(), 0);
+    QVERIFY(decoder.feed(full.mid(3)));
+    QCOMPARE(decoder.packetCount(), 1);
+    QCOMPARE(decoder.nextPacket(), full);
+}
+
+void TestMsgPack::testSkipDeepNesting()
+{
+    // one element arrays nested deep enough to overflow the stack by recursion.
+    const int depth = 1000 * 1000;
+    QByteArray bs(depth, '\x91');
+    bs.append('\xc0');
+    bs.append('\x05');
+    MsgPackStream s(bs);
+    QVERIFY(s.skip());
+    int i = 0;
+    s >> i;
+    QCOMPARE(s.status(), MsgPackStream::Ok);
+    QCOMPARE(i, 5);
+
+    MsgPackStream truncated(bs.left(depth));
+    QVERIFY(!truncated.skip());
+    QCOMPARE(truncated.status(), MsgPackStream::ReadPastEnd);
+}
+
+void TestMsgPack::testDecoder()
+{
+    QVariantMap m;
+    m.insert(QString::fromLatin1("id"), 1);
+    m.insert(QString::fromLatin1("args"), QVariantList() << QString::fromLatin1("fish") << QByteArray(300, 'x'));
+    QByteArray bs;
+    MsgPackStream os(&bs, QIODevice::WriteOnly);
+    os << m << 5 << QString::fromLatin1("tail");
+
+    // feed one byte at a time.
+    MsgPackDecoder decoder;
+    for (int i = 0; i < bs.size(); ++i) {
+        QVERIFY(decoder.feed(bs.constData() + i, 1));
+    }
+    QCOMPARE(decoder.packetCount(), 3);
+    QCOMPARE(decoder.bufferedSize(), Q_INT64_C(0));
+    QVariant v;
+    QVERIFY(decoder.next(v));
+    QCOMPARE(v.toMap().value(QString::fromLatin1("id")).toInt(), 1);
+    QCOMPARE(v.toMap().value(QString::fromLatin1("args")).toList().size(), 2);
+    int i = 0;
+    QVERIFY(decoder.next(i));
+    QCOMPARE(i, 5);
+    QCOMPARE(decoder.nextView().toString(), QString::fromLatin1("tail"));
+    QVERIFY(!decoder.hasPacket());
+
+    // feed all at once, then a partial object.
+    QVERIFY(decoder.feed(bs + bs.left(10)));
+    QCOMPARE(decoder.packetCount(), 3);
+    QCOMPARE(decoder.bufferedSize(), Q_INT64_C(10));
+    QVERIFY(decoder.feed(bs.mid(10)));
+    QList<QByteArray> packets;
+    while (decoder.hasPacket()) {
+        packets.append(decoder.nextPacket());
+    }
+    QCOMPARE(packets.size(), 6);
+    QCOMPARE(packets[0] + packets[1] + packets[2], bs);
+    QCOMPARE(packets[3] + packets[4] + packets[5], bs);
+}
+
+void TestMsgPack::testDecoderLimit()
+{
+    QByteArray bs;
+    MsgPackStream os(&bs, QIODevice::WriteOnly);
+    os << QByteArray(100, 'x');
+
+    MsgPackDecoder decoder;
+    decoder.setLengthLimit(50);
+    QVERIFY(!decoder.feed(bs.left(3)));
+    QCOMPARE(decoder.status(), MsgPackStream::ReadCorruptData);
+    QVERIFY(!decoder.feed(QByteArray("\x01")));
+    decoder.reset();
+    QCOMPARE(decoder.status(), MsgPackStream::Ok);
+
+    // many small elements exceed the limit too.
+    QVariantList l;
+    for (int i = 0; i < 60; ++i) {
+        l.append(i);
+    }
+    bs.clear();
+    MsgPackStream ls(&bs, QIODevice::WriteOnly);
+    ls << l;
+    QVERIFY(!decoder.feed(bs));
+    decoder.reset();
+    decoder.setLengthLimit(1024);
+    QVERIFY(decoder.feed(bs));
+    QCOMPARE(decoder.packetCount(), 1);
+}
+
+void TestMsgPack::testNeverUsed()
+{
+    // 0xc1 is never used by msgpack, it is corrupted data instead of nil.
+    const QByteArray bs("\x92\x01\xc1", 3);
+    MsgPackStream s(bs);
+    QVariant v;
+    s >> v;
+    QCOMPARE(s.status(), MsgPackStream::ReadCorruptData);
+    MsgPackStream skipped(bs);
+    QVERIFY(!skipped.skip());
+    QCOMPARE(skipped.status(), MsgPackStream::ReadCorruptData);
+
+    QVERIFY(!MsgPackView(bs.mid(2)).isValid());
+    QVERIFY(!MsgPackView(bs)[1].isValid());
+    QVERIFY(MsgPackView(bs).raw().isEmpty());
+
+    MsgPackDecoder decoder;
+    QVERIFY(!decoder.feed(bs));
+    QCOMPARE(decoder.status(), MsgPackStream::ReadCorruptData);
+    QCOMPARE(decoder.packetCount(), 0);
+}
+
 QTEST_MAIN(TestMsgPack)
 #include "test_msgpack.moc"
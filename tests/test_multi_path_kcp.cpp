@@ -0,0 +1,223 @@
+#include <QtTest>
+#include "qtnetworkng.h"
+
+using namespace qtng;
+
+class TestMultiPathKcp: public QObject
+{
+    Q_OBJECT
+private slots:
+    void testRoundRobin();
+    void testMinRtt();
+    void testMinRttBacklog();
+    void testWeighted();
+    void testWeightedBacklog();
+    void testRedundant();
+    void testInactive();
+    void testPathStats();
+};
+
+
+static QVector<MultiPathKcpPathStats> makePaths(const QList<float> &rtts)
+{
+    // the paths are sent just now, the schedulers do not probe them until they are idle for a second.
+    quint64 now = static_cast<quint64>(QDateTime::currentMSecsSinceEpoch());
+    QVector<MultiPathKcpPathStats> paths;
+    for (int i = 0; i < rtts.size(); ++i) {
+        MultiPathKcpPathStats path;
+        path.addr = HostAddress(HostAddress::LocalHost);
+        path.port = static_cast<quint16>(10000 + i);
+        path.active = true;
+        path.srtt = rtts.at(i);
+        path.rttvar = 0.0f;
+        path.lossRate = 0.0f;
+        path.throughput = 0.0f;
+        path.inflightBytes = 0;
+        path.sentPackets = 0;
+        path.sentBytes = 0;
+        path.ackedBytes = 0;
+        path.receivedBytes = 0;
+        path.lastSendTimestamp = now;
+        path.lastActiveTimestamp = now;
+        paths.append(path);
+    }
+    return paths;
+}
+
+
+static QVector<int> countSchedules(QSharedPointer<MultiPathKcpScheduler> scheduler,
+                                   const QVector<MultiPathKcpPathStats> &paths, int times)
+{
+    QVector<int> counts(paths.size(), 0);
+    for (int i = 0; i < times; ++i) {
+        int duplicate = -1;
+        int index = scheduler->schedule(paths, false, &duplicate);
+        if (index >= 0 && index < paths.size()) {
+            ++counts[index];
+        }
+    }
+    return counts;
+}
+
+
+void TestMultiPathKcp::testRoundRobin()
+{
+    QSharedPointer<MultiPathKcpScheduler> scheduler = createMultiPathKcpScheduler(RoundRobinSchedule);
+    const QVector<int> &counts = countSchedules(scheduler, makePaths(QList<float>() << 10 << 100 << 1000), 300);
+    QCOMPARE(counts, QVector<int>() << 100 << 100 << 100);
+}
+
+
+void TestMultiPathKcp::testMinRtt()
+{
+    QSharedPointer<MultiPathKcpScheduler> scheduler = createMultiPathKcpScheduler(MinRttSchedule);
+    QVector<MultiPathKcpPathStats> paths = makePaths(QList<float>() << 50 << 20 << 80);
+    QCOMPARE(countSchedules(scheduler, paths, 10), QVector<int>() << 0 << 10 << 0);
+
+    // the lossy path is slower than its rtt.
+    paths[1].lossRate = 0.5f;
+    QCOMPARE(countSchedules(scheduler, paths, 10), QVector<int>() << 10 << 0 << 0);
+}
+
+
+void TestMultiPathKcp::testMinRttBacklog()
+{
+    QSharedPointer<MultiPathKcpScheduler> scheduler = createMultiPathKcpScheduler(MinRttSchedule);
+    QVector<MultiPathKcpPathStats> paths = makePaths(QList<float>() << 20 << 50);
+    paths[0].throughput = 100 * 1000.0f;
+    paths[1].throughput = 1000 * 1000.0f;
+    QCOMPARE(countSchedules(scheduler, paths, 10), QVector<int>() << 10 << 0);
+
+    // 100KB in flight at 100KB/s takes one second to drain, the slower path delivers earlier.
+    paths[0].inflightBytes = 100 * 1000;
+    QCOMPARE(countSchedules(scheduler, paths, 10), QVector<int>() << 0 << 10);
+}
+
+
+void TestMultiPathKcp::testWeighted()
+{
+    QSharedPointer<MultiPathKcpScheduler> scheduler = createMultiPathKcpScheduler(WeightedSchedule);
+    const QVector<int> &counts = countSchedules(scheduler, makePaths(QList<float>() << 10 << 30), 400);
+    // the weights are 3:1
+    QVERIFY(qAbs(counts.at(0) - 300) <= 2);
+    QVERIFY(qAbs(counts.at(1) - 100) <= 2);
+}
+
+
+void TestMultiPathKcp::testWeightedBacklog()
+{
+    QSharedPointer<MultiPathKcpScheduler> scheduler = createMultiPathKcpScheduler(WeightedSchedule);
+    QVector<MultiPathKcpPathStats> paths = makePaths(QList<float>() << 10 << 10);
+    paths[0].throughput = 1000 * 1000.0f;
+    paths[1].throughput = 10 * 1000.0f;
+    QVector<int> counts = countSchedules(scheduler, paths, 200);
+    QCOMPARE(counts.at(0), counts.at(1));
+
+    // the slow path can not keep up with its share.
+    paths[0].inflightBytes = 10 * 1000;
+    paths[1].inflightBytes = 10 * 1000;
+    counts = countSchedules(scheduler, paths, 200);
+    QVERIFY(counts.at(0) > counts.at(1) * 10);
+}
+
+
+void TestMultiPathKcp::testRedundant()
+{
+    QSharedPointer<MultiPathKcpScheduler> scheduler = createMultiPathKcpScheduler(RedundantSchedule);
+    const QVector<MultiPathKcpPathStats> &paths = makePaths(QList<float>() << 50 << 20 << 80);
+    int duplicate = -1;
+    QCOMPARE(scheduler->schedule(paths, false, &duplicate), 1);
+    QCOMPARE(duplicate, -1);
+    QCOMPARE(scheduler->schedule(paths, true, &duplicate), 1);
+    QCOMPARE(duplicate, 0);
+}
+
+
+void TestMultiPathKcp::testInactive()
+{
+    QVector<MultiPathKcpPathStats> paths = makePaths(QList<float>() << 10 << 30 << 50);
+    paths[0].active = false;
+    const QList<MultiPathKcpSchedule> schedules = QList<MultiPathKcpSchedule>()
+            << RoundRobinSchedule << MinRttSchedule << WeightedSchedule << RedundantSchedule;
+    for (MultiPathKcpSchedule schedule : schedules) {
+        const QVector<int> &counts = countSchedules(createMultiPathKcpScheduler(schedule), paths, 100);
+        QCOMPARE(counts.at(0), 0);
+    }
+}
+
+
+
+void TestMultiPathKcp::testPathStats()
+{
+    // two paths over the loopback interface, reserve the ports before binding the server.
+    QList<QPair<HostAddress, quint16>> hosts;
+    {
+        Socket probe1(HostAddress::IPv4Protocol, Socket::UdpSocket);
+        Socket probe2(HostAddress::IPv4Protocol, Socket::UdpSocket);
+        QVERIFY(probe1.bind(HostAddress::LocalHost, 0));
+        QVERIFY(probe2.bind(HostAddress::LocalHost, 0));
+        hosts.append(qMakePair(HostAddress(HostAddress::LocalHost), probe1.localPort()));
+        hosts.append(qMakePair(HostAddress(HostAddress::LocalHost), probe2.localPort()));
+    }
+    QSharedPointer<SocketLike> server = createMultiKcpServer(hosts, 50, Loopback);
+    QVERIFY(!server.isNull());
+    const QByteArray payload(1024 * 64, 'p');
+
+    CoroutineGroup operations;
+    operations.spawn([server, payload] {
+        QSharedPointer<SocketLike> request = server->accept();
+        if (request.isNull()) {
+            return;
+        }
+        if (request->recvall(payload.size()) == payload) {
+            request->sendall("ok");
+        }
+        request->recv(1);  // wait for the client to close.
+    });
+
+    Timeout _(10.0);
+    QSharedPointer<SocketLike> client =
+            createMultiPathKcpConnection(hosts, nullptr, HostAddress::IPv4Protocol, Loopback);
+    QVERIFY(!client.isNull());
+    MultiPathKcpSocketLikeHelper helper(client);
+    QVERIFY(helper.isValid());
+    // both paths carry the payload.
+    QVERIFY(helper.setSchedule(RoundRobinSchedule));
+    QCOMPARE(client->sendall(payload), payload.size());
+    QCOMPARE(client->recvall(2), QByteArray("ok"));
+
+    // the last acks may arrive after the reply.
+    QVector<MultiPathKcpPathStats> paths;
+    while (true) {
+        paths = helper.pathStats();
+        bool drained = paths.size() == 2;
+        for (const MultiPathKcpPathStats &path : paths) {
+            drained = drained && path.inflightBytes == 0;
+        }
+        if (drained) {
+            break;
+        }
+        Coroutine::msleep(10);
+    }
+    const quint64 now = static_cast<quint64>(QDateTime::currentMSecsSinceEpoch());
+    quint64 ackedBytes = 0;
+    quint64 receivedBytes = 0;
+    for (const MultiPathKcpPathStats &path : paths) {
+        QVERIFY(path.active);
+        QVERIFY(path.sentPackets > 0);
+        QVERIFY(path.sentBytes > 0);
+        QVERIFY(path.ackedBytes > 0);
+        // the rtt is sampled from the acks of peer.
+        QVERIFY(path.srtt > 0.0f);
+        QVERIFY(path.lastSendTimestamp > 0 && path.lastSendTimestamp <= now);
+        ackedBytes += path.ackedBytes;
+        receivedBytes += path.receivedBytes;
+    }
+    QVERIFY(ackedBytes >= static_cast<quint64>(payload.size()));
+    QVERIFY(receivedBytes > 0);
+    client->close();
+    operations.joinall();
+}
+
+QTEST_MAIN(TestMultiPathKcp)
+#include "test_multi_path_kcp.moc"
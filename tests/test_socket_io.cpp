@@ -0,0 +1,224 @@
+#include <QtTest>
+#include "qtnetworkng.h"
+
+using namespace qtng;
+
+class TestSocketIo: public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void testSendvRecvv();
+    void testPartialWrites();
+    void testManyVectors();
+    void testEmptyVectors();
+    void testKillWhileReceiving();
+    void testAbortWhileWaiting();
+};
+
+
+static QByteArray makeData(int size)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i) {
+        data[i] = static_cast<char>(i * 7 + i / 251);
+    }
+    return data;
+}
+
+
+static bool makePair(QSharedPointer<Socket> *client, QSharedPointer<Socket> *server)
+{
+    QSharedPointer<Socket> listener(Socket::createServer(HostAddress::LocalHost, 0));
+    if (listener.isNull()) {
+        return false;
+    }
+    client->reset(Socket::createConnection(HostAddress::LocalHost, listener->localPort()));
+    if (client->isNull()) {
+        return false;
+    }
+    server->reset(listener->accept());
+    return !server->isNull();
+}
+
+
+void TestSocketIo::initTestCase()
+{
+#ifdef QTNG_TEST_IO_URING
+    // the same tests are built again to run with the io_uring eventloop.
+    Coroutine::preferIoUring();
+#endif
+}
+
+
+void TestSocketIo::testSendvRecvv()
+{
+    QSharedPointer<Socket> client, server;
+    QVERIFY(makePair(&client, &server));
+
+    const QByteArray header("header:");
+    const QByteArray body("hello, world!");
+    IoVector vectors[] = { IoVector(header), IoVector(body) };
+    QCOMPARE(client->sendv(vectors, 2), header.size() + body.size());
+
+    // scatter to two buffers in order.
+    char first[4];
+    char second[64];
+    IoVector buffers[] = { IoVector(first, sizeof(first)), IoVector(second, sizeof(second)) };
+    qint32 received = 0;
+    QByteArray result;
+    while (received < header.size() + body.size()) {
+        qint32 bytes = server->recvv(buffers, 2);
+        QVERIFY(bytes > 0);
+        result.append(first, qMin<qint32>(bytes, sizeof(first)));
+        if (bytes > static_cast<qint32>(sizeof(first))) {
+            result.append(second, bytes - static_cast<qint32>(sizeof(first)));
+        }
+        received += bytes;
+    }
+    QCOMPARE(result, header + body);
+}
+
+
+// the payload is much larger than the socket buffer, so the kernel accepts it partly many times. the vectors must be
+// resumed at the right position.
+void TestSocketIo::testPartialWrites()
+{
+    QSharedPointer<Socket> client, server;
+    QVERIFY(makePair(&client, &server));
+    client->setOption(Socket::SendBufferSizeSocketOption, 1024 * 8);
+
+    const QByteArray &data = makeData(1024 * 1024 * 4 + 13);
+    QVector<IoVector> vectors;
+    // odd sizes, so the partial writes end in the middle of vectors.
+    for (int offset = 0, i = 0; offset < data.size(); ++i) {
+        qint32 size = qMin(data.size() - offset, 1000 + (i * 4099) % 70000);
+        vectors.append(IoVector(data.constData() + offset, size));
+        offset += size;
+    }
+
+    QByteArray received;
+    CoroutineGroup operations;
+    operations.spawn([server, &received, &data] {
+        char buf[1024 * 3];
+        while (received.size() < data.size()) {
+            qint32 bytes = server->recv(buf, sizeof(buf));
+            if (bytes <= 0) {
+                return;
+            }
+            received.append(buf, bytes);
+            // read slowly, so the sender is blocked many times.
+            if (received.size() % 7 == 0) {
+                Coroutine::msleep(1);
+            }
+        }
+    });
+    QCOMPARE(client->sendv(vectors.constData(), vectors.size()), data.size());
+    operations.joinall();
+    QCOMPARE(received, data);
+}
+
+
+// more vectors than IOV_MAX are sent by several calls.
+void TestSocketIo::testManyVectors()
+{
+    QSharedPointer<Socket> client, server;
+    QVERIFY(makePair(&client, &server));
+
+    const QByteArray &data = makeData(5000 * 3);
+    QVector<IoVector> vectors;
+    for (int i = 0; i < 5000; ++i) {
+        vectors.append(IoVector(data.constData() + i * 3, 3));
+    }
+    QByteArray received;
+    CoroutineGroup operations;
+    operations.spawn([server, &received, &data] { received = server->recvall(data.size()); });
+    QCOMPARE(client->sendv(vectors.constData(), vectors.size()), data.size());
+    operations.joinall();
+    QCOMPARE(received, data);
+
+    // the receiver scatters into more buffers than IOV_MAX, the first ones are filled.
+    QVector<QByteArray> buffers(3000, QByteArray(1, '\0'));
+    QVector<IoVector> targets;
+    for (QByteArray &buffer : buffers) {
+        targets.append(IoVector(buffer.data(), buffer.size()));
+    }
+    QCOMPARE(client->sendall(data.left(10)), 10);
+    qint32 total = 0;
+    while (total < 10) {
+        qint32 bytes = server->recvv(targets.data() + total, targets.size() - total);
+        QVERIFY(bytes > 0);
+        total += bytes;
+    }
+    for (int i = 0; i < 10; ++i) {
+        QCOMPARE(buffers.at(i).at(0), data.at(i));
+    }
+}
+
+
+void TestSocketIo::testEmptyVectors()
+{
+    QSharedPointer<Socket> client, server;
+    QVERIFY(makePair(&client, &server));
+
+    const QByteArray body("payload");
+    IoVector vectors[] = { IoVector(), IoVector(body), IoVector() };
+    QCOMPARE(client->sendv(vectors, 3), body.size());
+    QCOMPARE(server->recvall(body.size()), body);
+    IoVector nothing[] = { IoVector(), IoVector() };
+    QCOMPARE(client->sendv(nothing, 2), -1);
+}
+
+
+// the request of a killed coroutine is cancelled before recv() leaves, it takes neither the data nor the buffer.
+void TestSocketIo::testKillWhileReceiving()
+{
+    QSharedPointer<Socket> client, server;
+    QVERIFY(makePair(&client, &server));
+
+    QSharedPointer<QByteArray> buf(new QByteArray(64, '\0'));
+    QSharedPointer<bool> finished(new bool(false));
+    CoroutineGroup operations;
+    operations.spawnWithName(QString::fromLatin1("receiving"), [server, buf, finished] {
+        server->recv(buf->data(), buf->size());
+        *finished = true;
+    });
+    Coroutine::msleep(10);
+    QVERIFY(operations.kill(QString::fromLatin1("receiving")));
+    QVERIFY(!*finished);
+
+    QCOMPARE(client->sendall(QByteArray("hello")), 5);
+    QCOMPARE(server->recvall(5), QByteArray("hello"));
+    QCOMPARE(*buf, QByteArray(64, '\0'));
+}
+
+
+// aborting the socket wakes up the coroutines waiting in recv() and accept().
+void TestSocketIo::testAbortWhileWaiting()
+{
+    QSharedPointer<Socket> client, server;
+    QVERIFY(makePair(&client, &server));
+    QSharedPointer<Socket> listener(Socket::createServer(HostAddress::LocalHost, 0));
+    QVERIFY(!listener.isNull());
+
+    QSharedPointer<qint32> received(new qint32(0));
+    QSharedPointer<bool> accepted(new bool(true));
+    CoroutineGroup operations;
+    operations.spawn([server, received] {
+        char buf[64];
+        *received = server->recv(buf, sizeof(buf));
+    });
+    operations.spawn([listener, accepted] {
+        QScopedPointer<Socket> request(listener->accept());
+        *accepted = !request.isNull();
+    });
+    Coroutine::msleep(10);
+    server->abort();
+    listener->abort();
+    QVERIFY(operations.joinall());
+    QCOMPARE(*received, -1);
+    QVERIFY(!*accepted);
+}
+
+QTEST_MAIN(TestSocketIo)
+#include "test_socket_io.moc"